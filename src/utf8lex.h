@@ -19,7 +19,10 @@
 #ifndef UTF8LEX_H_INCLUDED
 #define UTF8LEX_H_INCLUDED
 
-#include <inttypes.h>  // For uint32_t.
+#include <inttypes.h>  // For int64_t, uint32_t.
+#include <pthread.h>  // For pthread_t.
+#include <semaphore.h>  // For sem_t.
+#include <stdatomic.h>  // For _Atomic.
 #include <stdbool.h>  // For bool, true, false.
 
 // 8-bit character units for pcre2:
@@ -30,21 +33,44 @@
 #define UTF8LEX_MAX_BYTES_PER_CHAR 6
 
 typedef struct _STRUCT_utf8lex_buffer           utf8lex_buffer_t;
+typedef struct _STRUCT_utf8lex_buffer_pool      utf8lex_buffer_pool_t;
+typedef struct _STRUCT_utf8lex_capture          utf8lex_capture_t;
 typedef uint32_t                                utf8lex_cat_t;
+typedef struct _STRUCT_utf8lex_chunk            utf8lex_chunk_t;
 typedef struct _STRUCT_utf8lex_cat_definition   utf8lex_cat_definition_t;
+typedef struct _STRUCT_utf8lex_compact_token    utf8lex_compact_token_t;
 typedef struct _STRUCT_utf8lex_definition       utf8lex_definition_t;
 typedef struct _STRUCT_utf8lex_definition_type  utf8lex_definition_type_t;
 typedef enum _ENUM_utf8lex_error                utf8lex_error_t;
+typedef struct _STRUCT_utf8lex_files            utf8lex_files_t;
+typedef enum _ENUM_utf8lex_granularity          utf8lex_granularity_t;
+typedef struct _STRUCT_utf8lex_grapheme         utf8lex_grapheme_t;
+typedef struct _STRUCT_utf8lex_grapheme_cache   utf8lex_grapheme_cache_t;
+typedef struct _STRUCT_utf8lex_include          utf8lex_include_t;
+typedef struct _STRUCT_utf8lex_instruction      utf8lex_instruction_t;
+typedef struct _STRUCT_utf8lex_intern_table     utf8lex_intern_table_t;
+typedef struct _STRUCT_utf8lex_line_index       utf8lex_line_index_t;
 typedef struct _STRUCT_utf8lex_literal_definition utf8lex_literal_definition_t;
 typedef struct _STRUCT_utf8lex_location         utf8lex_location_t;
+typedef enum _ENUM_utf8lex_location_mode        utf8lex_location_mode_t;
 typedef struct _STRUCT_utf8lex_multi_definition utf8lex_multi_definition_t;
 typedef enum _ENUM_utf8lex_multi_type           utf8lex_multi_type_t;
+typedef enum _ENUM_utf8lex_opcode               utf8lex_opcode_t;
 typedef enum _ENUM_utf8lex_printable_flag       utf8lex_printable_flag_t;
+typedef struct _STRUCT_utf8lex_program          utf8lex_program_t;
+typedef struct _STRUCT_utf8lex_reader           utf8lex_reader_t;
 typedef struct _STRUCT_utf8lex_reference        utf8lex_reference_t;
 typedef struct _STRUCT_utf8lex_regex_definition utf8lex_regex_definition_t;
+typedef struct _STRUCT_utf8lex_resume           utf8lex_resume_t;
 typedef struct _STRUCT_utf8lex_rule             utf8lex_rule_t;
+typedef struct _STRUCT_utf8lex_session          utf8lex_session_t;
+typedef struct _STRUCT_utf8lex_slice           utf8lex_slice_t;
 typedef struct _STRUCT_ut8lex_state             utf8lex_state_t;
+typedef struct _STRUCT_utf8lex_stream           utf8lex_stream_t;
 typedef struct _STRUCT_utf8lex_string           utf8lex_string_t;
+typedef struct _STRUCT_utf8lex_symbol           utf8lex_symbol_t;
+typedef struct _STRUCT_utf8lex_window           utf8lex_window_t;
+typedef struct _STRUCT_utf8lex_worker           utf8lex_worker_t;
 typedef struct _STRUCT_utf8lex_target_language  utf8lex_target_language_t;
 typedef struct _STRUCT_utf8lex_token            utf8lex_token_t;
 typedef enum _ENUM_utf8lex_unit                 utf8lex_unit_t;
@@ -63,6 +89,10 @@ typedef struct STRUCT_utf8lex_lloc              utf8lex_lloc_t;
 // utf8lex_lex():
 //
 // Start / continue lexing from the specified table and state.
+// Only the rules that are active in the state's current mode
+// (see utf8lex_rule_set_modes() and utf8lex_state_push_mode()) are tried.
+// Tokens matching skip rules (see utf8lex_rule_set_skip()) are consumed
+// (and the state's locations moved past them), but never returned.
 //
 extern utf8lex_error_t utf8lex_lex(
         utf8lex_rule_t * first_rule,
@@ -70,6 +100,60 @@ extern utf8lex_error_t utf8lex_lex(
         utf8lex_token_t *token_pointer
         );
 
+//
+// utf8lex_program_lex():
+//
+// Same as utf8lex_lex(), but steps through a program of rules
+// that were compiled by utf8lex_program_compile().
+//
+extern utf8lex_error_t utf8lex_program_lex(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        );
+
+//
+// utf8lex_lex_batch():
+//
+// Same as utf8lex_program_lex(), but lexes up to max_tokens tokens
+// in one call, into the caller's array of tokens.  Stops early
+// on MORE, EOF, NO_MATCH or any other error, and returns that error
+// (or UTF8LEX_OK if all max_tokens tokens were lexed).
+// Either way, the number of tokens lexed successfully is returned
+// in num_tokens_pointer, and those tokens are good.
+//
+// Only the first token of a batch refills the state's stream, window
+// or reader (see utf8lex_state_set_stream(), etc): refilling moves
+// the bytes of the tokens already in the batch.  So a batch stops
+// early, returning UTF8LEX_OK with fewer than max_tokens tokens,
+// when it needs more bytes; the next call refills.
+//
+// The rule code is not run in between tokens, so the mode (start condition)
+// stays the same for the whole batch; callers that switch modes in rule
+// code should lex one token at a time instead.
+//
+extern utf8lex_error_t utf8lex_lex_batch(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_token_t *tokens,  // Array of (at least) max_tokens tokens.
+        uint32_t max_tokens,
+        uint32_t *num_tokens_pointer  // Number of tokens lexed.
+        );
+
+//
+// utf8lex_lex_batch_compact():
+//
+// Same as utf8lex_lex_batch(), but packs the tokens into
+// the caller's array of compact tokens (see utf8lex_compact_token_t).
+//
+extern utf8lex_error_t utf8lex_lex_batch_compact(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_compact_token_t *tokens,  // At least max_tokens tokens.
+        uint32_t max_tokens,
+        uint32_t *num_tokens_pointer  // Number of tokens lexed.
+        );
+
 
 enum _ENUM_utf8lex_error
 {
@@ -111,6 +195,7 @@ enum _ENUM_utf8lex_error
   UTF8LEX_ERROR_BAD_MIN,  // Min must be 0 or greater.
   UTF8LEX_ERROR_BAD_MAX,  // Max must be >= min, or -1 for no limit.
   UTF8LEX_ERROR_BAD_MULTI_TYPE,  // Multi type must be sequence, OR, etc.
+  UTF8LEX_ERROR_BAD_MODE,  // Mode must be 0 <= mode < UTF8LEX_MODES_MAX, etc.
   UTF8LEX_ERROR_BAD_REGEX,  // Could not compile regex definition.
   UTF8LEX_ERROR_BAD_UTF8,  // Could not process the UTF-8 text.
   UTF8LEX_ERROR_BAD_ERROR,  // Invalid error NONE <= e <= MAX.
@@ -131,18 +216,48 @@ enum _ENUM_utf8lex_unit
   UTF8LEX_UNIT_GRAPHEME,
   UTF8LEX_UNIT_LINE,
 
+  // Optional units, only counted by states that enable them
+  // (see utf8lex_state_set_units()), reset at newlines like chars:
+  UTF8LEX_UNIT_UTF16,  // UTF-16 code units (e.g. language server positions).
+  UTF8LEX_UNIT_WIDTH,  // Display width in columns (East Asian wide = 2).
+
   UTF8LEX_UNIT_MAX
 };
 
+// The units that every state counts, which cannot be disabled:
+#define UTF8LEX_UNITS_DEFAULT \
+  ((uint32_t) ((1 << UTF8LEX_UNIT_BYTE) \
+               | (1 << UTF8LEX_UNIT_CHAR) \
+               | (1 << UTF8LEX_UNIT_GRAPHEME) \
+               | (1 << UTF8LEX_UNIT_LINE)))
+// All units, optional ones included:
+#define UTF8LEX_UNITS_ALL ((uint32_t) ((1 << UTF8LEX_UNIT_MAX) - 1))
+
 struct _STRUCT_utf8lex_location
 {
-  int start;  // First byte / char / grapheme / and so on of a token.
-  int length;  // # of bytes / chars / graphemes / and so on of a token.
-  int after;  // Either -1, or reset the start location to this, if >= 0.
+  int64_t start;  // First byte / char / grapheme / and so on of a token.
+  int64_t length;  // # of bytes / chars / graphemes / and so on of a token.
+  int64_t after;  // Either -1, or reset the start location to this, if >= 0.
 
-  unsigned long hash;  // The sum of bytes / chars / graphemes / and so on.
+  uint64_t hash;  // Hash of the bytes, see utf8lex_hash_concat().
 };
 
+// Every location's hash is a polynomial hash of all its bytes, mod 2^64:
+//
+//     hash(b[0] .. b[n-1]) = b[0] * P^(n-1) + b[1] * P^(n-2) + ... + b[n-1]
+//
+// So it can be accumulated one byte (or one grapheme, or one token)
+// at a time, while the bytes are being lexed, without reading them again.
+#define UTF8LEX_HASH_PRIME ((uint64_t) 0x100000001B3)
+
+// Returns the hash of the bytes of hash1 followed by the bytes of hash2
+// (length2_bytes bytes long):
+extern uint64_t utf8lex_hash_concat(
+        uint64_t hash1,
+        uint64_t hash2,
+        uint64_t length2_bytes
+        );
+
 
 struct _STRUCT_utf8lex_string
 {
@@ -195,6 +310,9 @@ struct _STRUCT_utf8lex_buffer
   utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Length of str.
   utf8lex_string_t *str;  // One chunk of text from the file / other source.
   bool is_eof;  // No more bytes to read?  (If so, do not return UTF8LEX_MORE).
+
+  utf8lex_buffer_pool_t *pool;  // The pool this buffer came from, or NULL.
+  uint32_t refs;  // Pooled buffers only: # of references (chain, tokens).
 };
 
 extern utf8lex_error_t utf8lex_buffer_init(
@@ -207,11 +325,27 @@ extern utf8lex_error_t utf8lex_buffer_clear(
         utf8lex_buffer_t *self
         );
 
+// Appends the tail buffer to the end of self's chain.  O(1) for pooled
+// buffers, which go through utf8lex_buffer_pool_append() (see
+// utf8lex_buffer_pool_t), otherwise walks the chain.  Pooled and
+// unpooled buffers cannot be mixed (UTF8LEX_ERROR_CHAIN_INSERT).
 extern utf8lex_error_t utf8lex_buffer_add(
         utf8lex_buffer_t *self,
         utf8lex_buffer_t *tail
         );
 
+// Pooled buffers only (no-ops for other buffers): a token or view
+// that outlives the next call to utf8lex_buffer_pool_acquire()
+// holds a reference to every buffer its bytes are in,
+// so that they are not recycled out from under it
+// (see also utf8lex_token_retain(), utf8lex_token_release()).
+extern utf8lex_error_t utf8lex_buffer_retain(
+        utf8lex_buffer_t *self
+        );
+extern utf8lex_error_t utf8lex_buffer_release(
+        utf8lex_buffer_t *self
+        );
+
 // buffer functions in utf8lex_file.c:
 
 // Do NOT call utf8lex_buffer_init() before calling utf8lex_buffer_mmap().
@@ -235,6 +369,311 @@ extern utf8lex_error_t utf8lex_buffer_readf(
         FILE *fp
         );
 
+//
+// utf8lex_stream_t:
+//
+// Streams bytes from a file descriptor (a pipe, a socket, a file, ...)
+// into one buffer, backed by a ring of capacity bytes that is mapped
+// twice, back to back, so that bytes which wrap around the end
+// of the ring are still contiguous, without copying.
+//
+// Once the state lexing the stream's buffer has been told about it
+// (utf8lex_state_set_stream()), utf8lex_lex() refills the ring itself
+// whenever a definition asks for MORE, releasing the bytes before
+// the token being lexed, so memory stays the same no matter how many
+// bytes are streamed.  A token's bytes are only valid until the next
+// call to utf8lex_lex(), and no single token can be longer than the ring.
+// (Released bytes are gone, so use UTF8LEX_LOCATION_MODE_ALL:
+// utf8lex_location_resolve() cannot read them back.)
+//
+struct _STRUCT_utf8lex_stream
+{
+  int fd;  // Where bytes are read from.
+  unsigned char *ring;  // 2 * capacity bytes, the second half a mirror.
+  size_t capacity;  // Multiple of the page size.
+  uint64_t released_bytes;  // # of bytes released (absolute start of str).
+  uint64_t read_bytes;  // # of bytes read in so far.
+  bool is_following;  // Wait for more at the end of the file (tail -f)?
+  int watch_fd;  // inotify fd while following a path, or -1 to poll.
+
+  utf8lex_string_t str;  // The unreleased bytes, somewhere in the ring.
+  utf8lex_buffer_t buffer;  // The buffer to lex.
+};
+
+// Maps the ring (the stream's buffer starts out empty, not at EOF):
+extern utf8lex_error_t utf8lex_stream_init(
+        utf8lex_stream_t *self,
+        int fd,
+        size_t capacity  // Multiple of the page size.
+        );
+// Unmaps the ring (the fd is left open):
+extern utf8lex_error_t utf8lex_stream_clear(
+        utf8lex_stream_t *self
+        );
+// Releases the bytes before the token that the state is lexing,
+// then reads as many bytes as fit into the rest of the ring
+// (setting is_eof once the fd has no more).  Returns UTF8LEX_MORE
+// if a non-blocking fd has nothing to read yet, UTF8LEX_ERROR_MAX_LENGTH
+// if the token being lexed already fills the ring, or UTF8LEX_ERROR_STATE
+// if is_eof is already set.
+extern utf8lex_error_t utf8lex_stream_refill(
+        utf8lex_stream_t *self,
+        utf8lex_state_t *state
+        );
+
+//
+// Follow mode (like tail -f), for lexing a file that is still being
+// written to:  instead of setting is_eof at the end of the file,
+// utf8lex_stream_refill() (and so utf8lex_lex()) returns UTF8LEX_MORE,
+// leaving the state exactly where it was (including a token cut off
+// at the end of the file so far).  Call utf8lex_stream_wait() until
+// more has been appended, then utf8lex_lex() again, which picks up
+// from where it stopped, without lexing anything twice.
+// The last token in the file so far is only returned once more bytes
+// follow it (which might yet change its last grapheme), or after
+// unfollowing.  utf8lex_stream_unfollow() lets the next read at the end of the file
+// set is_eof, as usual.  (Truncated or rotated files are not detected.)
+//
+// Follows the fd's file (given its path, for inotify on Linux,
+// or NULL to just poll):
+extern utf8lex_error_t utf8lex_stream_follow(
+        utf8lex_stream_t *self,
+        unsigned char *path  // Path of the fd's file, or NULL to poll.
+        );
+extern utf8lex_error_t utf8lex_stream_unfollow(
+        utf8lex_stream_t *self
+        );
+// Waits until the followed file is written to (or, when polling,
+// just waits), or until timeout_milliseconds (-1 for no timeout,
+// which only makes sense with inotify):
+extern utf8lex_error_t utf8lex_stream_wait(
+        utf8lex_stream_t *self,
+        int timeout_milliseconds
+        );
+
+
+//
+// utf8lex_reader_t:
+//
+// Reads ahead from a file descriptor in a background thread, so that
+// reading the next buffer(s) overlaps with lexing the current one,
+// instead of blocking the lexer in utf8lex_buffer_read().
+//
+// The reader owns num_buffers buffers of buffer_size bytes each
+// (all mapped up front).  The read-ahead thread fills the free ones,
+// in order, and hands them over to the lexer through a single-producer,
+// single-consumer queue: the buffers are used strictly round robin,
+// so the queue is just 2 counts, one per thread, with a semaphore
+// on each side for waiting (no locks).  utf8lex_reader_next() waits
+// for the next filled buffer and appends it to the reader's chain,
+// first handing the buffers that the state has lexed past back
+// to the read-ahead thread.
+//
+// Once the state lexing the reader's first buffer has been told about it
+// (utf8lex_state_set_reader()), utf8lex_lex() calls utf8lex_reader_next()
+// itself whenever a definition asks for MORE.  A token's bytes are only
+// valid until the next call to utf8lex_lex().  (Recycled buffers are gone,
+// so use UTF8LEX_LOCATION_MODE_ALL: utf8lex_location_resolve() cannot
+// read them back.)
+//
+#define UTF8LEX_READER_MAX 16
+// To decompress: room for zlib's state and window, and the bytes
+// of compressed input that are read from the fd at a time:
+#define UTF8LEX_READER_ARENA_BYTES 65536
+#define UTF8LEX_READER_COMPRESSED_BYTES 65536
+
+struct _STRUCT_utf8lex_reader
+{
+  int fd;  // Where bytes are read from.
+  unsigned char *chunks;  // num_buffers * buffer_size bytes.
+  size_t buffer_size;  // Multiple of the page size.
+  uint32_t num_buffers;  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+
+  utf8lex_string_t strs[UTF8LEX_READER_MAX];
+  utf8lex_buffer_t buffers[UTF8LEX_READER_MAX];
+  utf8lex_error_t errors[UTF8LEX_READER_MAX];  // OK, EOF or FILE_READ.
+
+  unsigned char *arena;  // zlib's memory, or NULL if not decompressing.
+  size_t arena_used;  // # of bytes of the arena that zlib has allocated.
+  unsigned char *compressed;  // Compressed bytes read from the fd, or NULL.
+  void *inflater;  // The z_stream (in the arena), or NULL.
+  bool is_inflating;  // In the middle of a gzip member?
+
+  pthread_t thread;  // The read-ahead thread.
+  sem_t free_buffers;  // # of buffers the read-ahead thread can fill.
+  sem_t filled_buffers;  // # of filled buffers not yet appended.
+  _Atomic uint64_t num_filled;  // Read-ahead thread: # buffers filled.
+  _Atomic bool is_stopping;  // Set by utf8lex_reader_clear().
+
+  uint64_t num_appended;  // Lexer: # of filled buffers appended (or EOF).
+  uint32_t num_in_chain;  // Lexer: # of buffers in the chain.
+  utf8lex_buffer_t *head;  // First buffer in the chain, or NULL.
+  utf8lex_buffer_t *tail;  // Last buffer in the chain, or NULL.
+};
+
+// Starts the read-ahead thread (the chain starts out empty, call
+// utf8lex_reader_next() for the first buffer):
+extern utf8lex_error_t utf8lex_reader_init(
+        utf8lex_reader_t *self,
+        int fd,
+        size_t buffer_size,  // Multiple of the page size.
+        uint32_t num_buffers  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+        );
+// Same as utf8lex_reader_init(), but the read-ahead thread inflates
+// the gzip (or zlib) compressed bytes it reads from the fd (one or more
+// gzip members, as with "cat a.gz b.gz"), so that the buffers
+// hold the decompressed bytes.  Bad or truncated compressed data
+// is reported as UTF8LEX_ERROR_FILE_READ by utf8lex_reader_next().
+extern utf8lex_error_t utf8lex_reader_init_gzip(
+        utf8lex_reader_t *self,
+        int fd,
+        size_t buffer_size,  // Multiple of the page size.
+        uint32_t num_buffers  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+        );
+// Stops the read-ahead thread (once its current read, if any, returns)
+// and unmaps the buffers (the fd is left open):
+extern utf8lex_error_t utf8lex_reader_clear(
+        utf8lex_reader_t *self
+        );
+// Hands back the buffers that the state (or NULL) has lexed past,
+// then waits for the next filled buffer and appends it to the chain.
+// At the end of the file, marks the end of the chain is_eof instead.
+// Returns UTF8LEX_ERROR_MAX_LENGTH if the token being lexed already
+// spans every buffer, or UTF8LEX_ERROR_STATE if the end of the chain
+// is already marked is_eof.
+extern utf8lex_error_t utf8lex_reader_next(
+        utf8lex_reader_t *self,
+        utf8lex_state_t *state  // Or NULL.
+        );
+
+//
+// utf8lex_window_t:
+//
+// Maps a (huge) file one fixed size window at a time, instead of
+// all at once like utf8lex_buffer_mmap(), so that address space and
+// memory stay bounded no matter how big the file is.  No more than
+// 2 windows are mapped at once: each one is a buffer in a chain
+// of (at most) 2 buffers, so moving from one window to the next
+// looks just like moving from one buffer to the next to the lexer,
+// and tokens can straddle 2 windows.
+//
+// Once the state lexing the first window has been told about it
+// (utf8lex_state_set_window()), utf8lex_lex() maps the next window
+// whenever a definition asks for MORE at the end of the chain,
+// unmapping the window that the state has lexed past (and dropping
+// its pages).  A token's bytes are only valid until the next call
+// to utf8lex_lex(), and no token can be longer than one window
+// plus the rest of the window it starts in.  (Unmapped bytes are gone,
+// so use UTF8LEX_LOCATION_MODE_ALL: utf8lex_location_resolve()
+// cannot read them back.)
+//
+#define UTF8LEX_WINDOW_POPULATE 0x1  // MAP_POPULATE each window.
+#define UTF8LEX_WINDOW_HUGE_PAGES 0x2  // MADV_HUGEPAGE each window.
+
+struct _STRUCT_utf8lex_window
+{
+  int fd;  // The file being mapped, open until utf8lex_window_clear().
+  uint64_t file_size;  // # of bytes in the whole file.
+  size_t window_size;  // Multiple of the page size.
+  uint32_t flags;  // UTF8LEX_WINDOW_POPULATE, ... or 0.
+  uint64_t next_offset;  // Where in the file the next window starts.
+
+  uint64_t offsets[2];  // Where in the file each window starts.
+  utf8lex_string_t strs[2];  // The mapped windows.
+  utf8lex_buffer_t buffers[2];  // One buffer per window.
+  utf8lex_buffer_t *head;  // The window being lexed (or lexed past).
+  utf8lex_buffer_t *tail;  // The window after it, or the head.
+};
+
+// Opens the file and maps the first window (self->head):
+extern utf8lex_error_t utf8lex_window_init(
+        utf8lex_window_t *self,
+        unsigned char *path,
+        size_t window_size,  // Multiple of the page size.
+        uint32_t flags  // UTF8LEX_WINDOW_POPULATE, ... or 0.
+        );
+// Unmaps the windows and closes the file:
+extern utf8lex_error_t utf8lex_window_clear(
+        utf8lex_window_t *self
+        );
+// Maps the next window onto the end of the chain, first unmapping
+// the window that the state has lexed past, if there is one.
+// Returns UTF8LEX_ERROR_MAX_LENGTH if the token being lexed already
+// spans both windows, or UTF8LEX_ERROR_STATE if the whole file
+// has already been mapped.
+extern utf8lex_error_t utf8lex_window_advance(
+        utf8lex_window_t *self,
+        utf8lex_state_t *state
+        );
+
+//
+// utf8lex_buffer_pool_t:
+//
+// A fixed number of fixed size, page-aligned chunks of bytes, all mapped
+// up front, each with its own buffer and string, that are handed out
+// to be read into and appended to the end of a chain, then recycled
+// once the lexer has moved on past them.  The pool keeps track of the
+// head and tail of its chain, so appending is O(1), and once every
+// chunk has been used at least once, reading and lexing any number
+// of bytes needs no more memory.
+//
+// Every buffer in the chain holds one reference (its own); tokens
+// and views that are kept around hold more (utf8lex_token_retain()).
+// Each call to utf8lex_buffer_pool_acquire() first recycles the buffers
+// at the head of the chain that the state has lexed past, and that no
+// token holds, then hands out a free chunk.  (Recycled buffers are gone,
+// so use UTF8LEX_LOCATION_MODE_ALL: utf8lex_location_resolve() cannot
+// read them back.)
+//
+#define UTF8LEX_BUFFER_POOL_MAX 64
+
+struct _STRUCT_utf8lex_buffer_pool
+{
+  unsigned char *chunks;  // num_chunks * chunk_size bytes, page-aligned.
+  size_t chunk_size;  // Multiple of the page size.
+  uint32_t num_chunks;  // 1 <= num_chunks <= UTF8LEX_BUFFER_POOL_MAX.
+
+  utf8lex_string_t strs[UTF8LEX_BUFFER_POOL_MAX];
+  utf8lex_buffer_t buffers[UTF8LEX_BUFFER_POOL_MAX];
+
+  utf8lex_buffer_t *free;  // Free buffers, linked through next.
+  uint32_t num_free;
+
+  utf8lex_buffer_t *head;  // First buffer in the chain, or NULL.
+  utf8lex_buffer_t *tail;  // Last buffer in the chain, or NULL.
+};
+
+extern utf8lex_error_t utf8lex_buffer_pool_init(
+        utf8lex_buffer_pool_t *self,
+        size_t chunk_size,  // Multiple of the page size.
+        uint32_t num_chunks  // 1 <= num_chunks <= UTF8LEX_BUFFER_POOL_MAX.
+        );
+extern utf8lex_error_t utf8lex_buffer_pool_clear(
+        utf8lex_buffer_pool_t *self
+        );
+// Recycles the buffers that the state (or NULL) has lexed past,
+// then sets an empty buffer with chunk_size bytes of room to read into.
+// Returns UTF8LEX_ERROR_MAX_LENGTH if every chunk is in use.
+extern utf8lex_error_t utf8lex_buffer_pool_acquire(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_state_t *state,  // Or NULL.
+        utf8lex_buffer_t **buffer_pointer  // Mutable.
+        );
+// Appends an acquired buffer to the end of the pool's chain:
+extern utf8lex_error_t utf8lex_buffer_pool_append(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_buffer_t *buffer,
+        bool is_eof
+        );
+// Acquires a buffer, fills it from the fd, and appends it.
+// At the end of the file, marks the end of the chain is_eof instead.
+// Returns UTF8LEX_MORE if a non-blocking fd has nothing to read yet.
+extern utf8lex_error_t utf8lex_buffer_pool_read(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_state_t *state,  // Or NULL.
+        int fd
+        );
+
 
 //
 // Base categories are equivalent to (but not equal to) those
@@ -493,6 +932,7 @@ struct _STRUCT_utf8lex_literal_definition
   // plus char and grapheme resets to account for newlines
   // (after == -1 -> no reset; after >= 0 -> reset state, buffer positions
   // to the specified char, grapheme locations):
+  // (Counted by grapheme, see utf8lex_literal_locations().)
   utf8lex_location_t loc[UTF8LEX_UNIT_MAX];
 };
 
@@ -506,6 +946,16 @@ extern utf8lex_error_t utf8lex_literal_definition_clear(
         // self must be utf8lex_literal_definition_t *:
         utf8lex_definition_t *self
         );
+// Points to the literal's locations for the specified granularity:
+// its own loc, unless it is lexed by codepoint and has graphemes
+// of 2 or more codepoints, in which case they are counted again
+// (by codepoint) into the scratch locations.
+extern utf8lex_error_t utf8lex_literal_locations(
+        utf8lex_literal_definition_t *self,
+        utf8lex_granularity_t granularity,
+        utf8lex_location_t scratch[UTF8LEX_UNIT_MAX],  // Mutable.
+        utf8lex_location_t **loc_pointer  // Mutable.
+        );
 
 
 // A token definition that matches one or more other definitions,
@@ -546,6 +996,16 @@ extern utf8lex_error_t utf8lex_literal_definition_clear(
 //     D1 D2* | D3+  == D1 followed by ((or or more D2) or (1 or more D3))
 //     D1 (D2 | D3)* == D1 followed by (0 or more D2s and/or D3s)
 //
+// By default, logically ORed expressions match the first alternative
+// that succeeds, so "=" | "===" never matches "===".  An OR
+// multi-definition can instead be initialized with is_longest = true,
+// in which case every alternative is tried from the same starting
+// point, and the alternative that matches the most bytes wins
+// (ties go to the earliest alternative).  In a .l file, "||" separates
+// the alternatives of a longest-match OR:
+//
+//     D1 || D2 || D3 == the longest of D1, D2 or D3
+//
 extern utf8lex_definition_type_t *UTF8LEX_DEFINITION_TYPE_MULTI;
 
 // No more than (this many) utf8lex_multi_definition_t's can be
@@ -611,6 +1071,7 @@ struct _STRUCT_utf8lex_multi_definition
   utf8lex_definition_t base;
 
   utf8lex_multi_type_t multi_type;  // Sequence or ORed references, and so on.
+  bool is_longest;  // OR only: true = longest alternative, false = first.
   utf8lex_reference_t *references;  // Sequence / ORed definition names.
   utf8lex_definition_t *db;  // Logical | () etc sub-expression definitions.
 
@@ -622,7 +1083,8 @@ extern utf8lex_error_t utf8lex_multi_definition_init(
         utf8lex_definition_t *prev,  // Previous definition in DB, or NULL.
         unsigned char *name,  // Usually all uppercase name of definition.
         utf8lex_multi_definition_t *parent,  // Parent or NULL.
-        utf8lex_multi_type_t multi_type  // Sequence or ORed references, etc.
+        utf8lex_multi_type_t multi_type,  // Sequence or ORed references, etc.
+        bool is_longest  // OR only: true = longest alternative, false = first.
         );
 extern utf8lex_error_t utf8lex_multi_definition_clear(
         // self must be utf8lex_multi_definition_t *:
@@ -640,12 +1102,27 @@ extern utf8lex_error_t utf8lex_multi_definition_resolve(
 // and so on:
 extern utf8lex_definition_type_t *UTF8LEX_DEFINITION_TYPE_REGEX;
 
+// No more than (this many) regex capture groups can be copied into
+// a token.  Tokens keep their captures in a fixed size array,
+// so that lexing a token never needs to allocate memory for them.
+#define UTF8LEX_CAPTURES_MAX 8
+
+// A regex token that carries on past the end of its buffer is matched
+// against a window of bytes stitched together from the end of its buffer
+// and the rest of the chain.  Windows of up to this many bytes are
+// stitched on the stack; bigger ones are mapped for the one match.
+#define UTF8LEX_REGEX_WINDOW_MAX 4096
+
 struct _STRUCT_utf8lex_regex_definition
 {
   utf8lex_definition_t base;
 
   unsigned char *pattern;
   pcre2_code *regex;
+
+  // # of capture groups, (1), (2), ..., to copy into each matching token.
+  // 0 (the default) means only the whole match is kept, no captures.
+  int num_captures;
 };
 
 // PCRE2 regex definition language:
@@ -660,6 +1137,13 @@ extern utf8lex_error_t utf8lex_regex_definition_clear(
         // self must be utf8lex_regex_definition_t *:
         utf8lex_definition_t *self
         );
+// Opt in to copying the first (num_captures) capture groups of
+// every match into the token (token->captures[0] is group (1), and so on).
+// Returns UTF8LEX_ERROR_MAX_LENGTH if num_captures > UTF8LEX_CAPTURES_MAX.
+extern utf8lex_error_t utf8lex_regex_definition_set_captures(
+        utf8lex_regex_definition_t *self,
+        int num_captures  // 0 <= num_captures <= UTF8LEX_CAPTURES_MAX.
+        );
 
 // No more than (this many) utf8lex_rule_t's can be in a database.
 // (to prevent infinite loops due to adding the same rule twice etc).
@@ -668,6 +1152,17 @@ extern utf8lex_error_t utf8lex_regex_definition_clear(
 // heap space is being initialized, or something like that.)
 #define UTF8LEX_RULES_DB_LENGTH_MAX 4096
 
+// Modes (start conditions, in flex terms) restrict which rules are tried,
+// for example to lex the inside of a comment or string differently
+// from the code around it.  Each rule is active in a set of modes,
+// and each state is in exactly one mode at a time.
+// No more than (this many) modes, since a rule's modes are a bit mask:
+#define UTF8LEX_MODES_MAX 32
+// The mode that every state starts in (flex's INITIAL):
+#define UTF8LEX_MODE_INITIAL 0
+// Mask of all modes (the default for every rule):
+#define UTF8LEX_MODES_ALL ((uint32_t) 0xFFFFFFFF)
+
 struct _STRUCT_utf8lex_rule
 {
   utf8lex_rule_t *prev;
@@ -678,6 +1173,9 @@ struct _STRUCT_utf8lex_rule
   utf8lex_definition_t *definition;  // Such as cat, literal, regex.
   unsigned char *code;
   size_t code_length_bytes;
+  bool is_skip;  // true = consume matching tokens without returning them.
+  bool is_interned;  // true = intern matching tokens' text into symbols.
+  uint32_t modes;  // Mask of (1 << mode) for each mode the rule is active in.
 };
 
 extern utf8lex_error_t utf8lex_rule_init(
@@ -691,6 +1189,28 @@ extern utf8lex_error_t utf8lex_rule_init(
 extern utf8lex_error_t utf8lex_rule_clear(
         utf8lex_rule_t *self
         );
+// Marks the rule as a skip rule (such as whitespace or comments):
+// utf8lex_lex() keeps lexing past its tokens, returning only the next
+// token that does not match a skip rule (or EOF, MORE, etc).
+// Rules are not skip rules by default.
+extern utf8lex_error_t utf8lex_rule_set_skip(
+        utf8lex_rule_t *self,
+        bool is_skip  // true = skip matching tokens, false = return them.
+        );
+// Marks the rule's tokens (such as identifiers) for interning: when the
+// state has an intern table, each token gets the symbol id of its text
+// (see utf8lex_intern_table_t).  Rules are not interned by default.
+extern utf8lex_error_t utf8lex_rule_set_interned(
+        utf8lex_rule_t *self,
+        bool is_interned  // true = intern matching tokens, false = don't.
+        );
+// Restricts the rule to the specified modes, such as
+// (1 << UTF8LEX_MODE_INITIAL) | (1 << MY_COMMENT_MODE).
+// Rules are active in all modes (UTF8LEX_MODES_ALL) by default.
+extern utf8lex_error_t utf8lex_rule_set_modes(
+        utf8lex_rule_t *self,
+        uint32_t modes  // Mask of (1 << mode) for each mode (not 0).
+        );
 
 extern utf8lex_error_t utf8lex_rule_find(
         utf8lex_rule_t *first_rule,  // Database to search.
@@ -703,16 +1223,165 @@ extern utf8lex_error_t utf8lex_rule_find_by_id(
         utf8lex_rule_t ** found_pointer  // Gets set when found.
         );
 
+
+// A compiled program: the rules from a linked list of utf8lex_rule_t's,
+// flattened into a contiguous array of compact, cache-line-aligned
+// instructions, one per rule, in the same order as the rules.
+// utf8lex_program_lex() steps through the instructions with a switch
+// on the opcode, calling the builtin lexers directly (literals
+// are matched inline, against bytes copied into the instruction).
+// Only user-defined definition types are called through their
+// definition_type->lex function pointers.
+//
+// All the NULL and definition_type checks that utf8lex_lex() makes
+// for every rule on every call are made once, by utf8lex_program_compile().
+// So a program must be re-compiled if its rules or definitions change.
+//
+// Each mode gets its own run of instructions, containing only
+// the rules that are active in that mode, so utf8lex_program_lex()
+// never even looks at the rules of other modes.
+enum _ENUM_utf8lex_opcode
+{
+  UTF8LEX_OPCODE_NONE = -1,
+
+  UTF8LEX_OPCODE_CAT = 0,
+  UTF8LEX_OPCODE_LITERAL,
+  UTF8LEX_OPCODE_REGEX,
+  UTF8LEX_OPCODE_MULTI,
+  UTF8LEX_OPCODE_CUSTOM,  // User-defined definition_type.
+
+  UTF8LEX_OPCODE_MAX
+};
+
+// Size of a cache line, to which instructions are aligned:
+#define UTF8LEX_CACHE_LINE_BYTES 64
+
+// Literals up to (this many) bytes are copied into the instruction;
+// only the first (this many) bytes of longer literals are.
+#define UTF8LEX_INSTRUCTION_LITERAL_MAX 24
+
+// No more than (this many) rules can be compiled into one program.
+// (Each instruction takes up one cache line, so a program is big:
+// declare it static, rather than on the stack.)
+#define UTF8LEX_PROGRAM_LENGTH_MAX UTF8LEX_RULES_DB_LENGTH_MAX
+
+struct _STRUCT_utf8lex_instruction
+{
+  utf8lex_opcode_t opcode;
+  bool is_skip;  // The rule's is_skip: consume tokens, don't return them.
+  bool is_interned;  // The rule's is_interned: intern tokens into symbols.
+  utf8lex_cat_t cat;  // CAT: categories to match.
+  int min;  // CAT: minimum consecutive graphemes.
+  int max;  // CAT: maximum consecutive graphemes, or -1 for no limit.
+  int length_bytes;  // LITERAL: # bytes in the literal.
+  int num_captures;  // REGEX: # capture groups to copy into tokens.
+
+  utf8lex_rule_t *rule;  // The rule (for the token, and for callbacks).
+  utf8lex_definition_t *definition;  // The rule's definition.
+
+  union
+  {
+    // LITERAL: the literal (or the first part of a longer literal):
+    unsigned char literal[UTF8LEX_INSTRUCTION_LITERAL_MAX];
+    // REGEX: the compiled regular expression:
+    pcre2_code *regex;
+    // CUSTOM: the user-defined definition_type's lexer:
+    utf8lex_error_t (*lex)(
+        utf8lex_rule_t *rule,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        );
+  };
+} __attribute__ ((aligned (UTF8LEX_CACHE_LINE_BYTES)));
+
+struct _STRUCT_utf8lex_program
+{
+  uint32_t num_modes;  // # of modes compiled (the state's mode must be less).
+  uint32_t mode_first[UTF8LEX_MODES_MAX];  // 1st instruction of each mode.
+  uint32_t mode_length[UTF8LEX_MODES_MAX];  // # instructions for each mode.
+
+  uint32_t num_instructions;
+  utf8lex_instruction_t instructions[UTF8LEX_PROGRAM_LENGTH_MAX];
+
+  // Every compiled rule, in any mode, indexed by its id
+  // (NULL for ids not compiled), for utf8lex_compact_token_expand():
+  utf8lex_rule_t *rules_by_id[UTF8LEX_RULES_DB_LENGTH_MAX];
+};
+
+// Compiles the rules for UTF8LEX_MODE_INITIAL only:
+extern utf8lex_error_t utf8lex_program_compile(
+        utf8lex_program_t *self,
+        utf8lex_rule_t *first_rule  // The rules to compile, in order.
+        );
+// Compiles the rules for modes 0, 1, ..., (num_modes - 1):
+extern utf8lex_error_t utf8lex_program_compile_modes(
+        utf8lex_program_t *self,
+        utf8lex_rule_t *first_rule,  // The rules to compile, in order.
+        uint32_t num_modes  // 1 <= num_modes <= UTF8LEX_MODES_MAX.
+        );
+extern utf8lex_error_t utf8lex_program_clear(
+        utf8lex_program_t *self
+        );
+
+// Lexers for the builtin definition types, WITHOUT any argument checks.
+// Called by the builtin definition types' lexers after checking
+// their arguments, and by utf8lex_program_lex() for compiled rules.
+extern utf8lex_error_t utf8lex_lex_cat_unchecked(
+        utf8lex_rule_t *rule,
+        utf8lex_cat_t cat_mask,  // The category / ies to match.
+        int min,  // Minimum consecutive occurrences of the cat (1 or more).
+        int max,  // Maximum consecutive occurrences (-1 = no limit).
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        );
+extern utf8lex_error_t utf8lex_lex_multi_unchecked(
+        utf8lex_rule_t *rule,
+        utf8lex_multi_definition_t *multi,  // The rule's multi-definition.
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        );
+extern utf8lex_error_t utf8lex_lex_regex_unchecked(
+        utf8lex_rule_t *rule,
+        pcre2_code *regex,  // The compiled regular expression.
+        int num_captures,  // 0 <= num_captures <= UTF8LEX_CAPTURES_MAX.
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        );
+// Compares a literal that runs past the end of the state's buffer
+// with the bytes of the buffers chained after it: UTF8LEX_OK if they
+// all match, UTF8LEX_MORE if the chain ends part way through (and more
+// can be read in), or UTF8LEX_NO_MATCH.
+extern utf8lex_error_t utf8lex_lex_literal_chain(
+        utf8lex_state_t *state,
+        unsigned char *literal_bytes,
+        size_t length_bytes
+        );
+
+// One capture group (sub-span) of a regex token:
+struct _STRUCT_utf8lex_capture
+{
+  int64_t start_byte;  // Bytes offset into token str, or -1 if unset.
+  int64_t length_bytes;  // # bytes in the capture group (0 if unset).
+};
+
 struct _STRUCT_utf8lex_token
 {
   utf8lex_rule_t *rule;  // The rule that matched this token.
   utf8lex_definition_t *definition;  // The matching definition.
 
-  int start_byte;  // Bytes offset into str where token starts.
-  int length_bytes;  // # bytes in token.
-  utf8lex_string_t *str;
+  int64_t start_byte;  // Bytes offset into str where token starts.
+  int64_t length_bytes;  // # bytes in token.
+  utf8lex_buffer_t *buffer;  // The buffer the token starts in.
+  utf8lex_string_t *str;  // The buffer's str.
 
   utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Absolute location of token.
+
+  // Interned symbol id, or UTF8LEX_SYMBOL_NONE (see utf8lex_intern_table_t):
+  uint32_t symbol_id;
+
+  // Capture groups, only for regex definitions with num_captures > 0:
+  int num_captures;
+  utf8lex_capture_t captures[UTF8LEX_CAPTURES_MAX];
 };
 
 extern utf8lex_error_t utf8lex_token_init(
@@ -737,10 +1406,330 @@ extern utf8lex_error_t utf8lex_token_cat_string(
         unsigned char *str,  // Text will be concatenated starting at '\0'.
         size_t max_bytes);
 
+//
+// Token views:
+//
+// A token's text, without copying it: one slice (pointer, length)
+// per buffer that the token's bytes are in.  Most tokens are in
+// just one buffer, but a token can start near the end of one buffer
+// and carry on into the next buffer(s) in the chain.
+//
+// The slices point straight into the buffers' strings, so they are
+// only valid for as long as the token's buffer, and every buffer after
+// it that the token spans, are still in the chain with the same bytes:
+// once a buffer is cleared, or its str is refilled or freed, the slices
+// (and the token) must not be used.
+//
+struct _STRUCT_utf8lex_slice
+{
+  unsigned char *bytes;  // Not 0-terminated.
+  size_t length_bytes;
+};
+
+// Holds (or lets go of) a reference to every pooled buffer the token's
+// bytes are in, for as long as the token, or a view of it, is kept
+// (see utf8lex_buffer_pool_t):
+extern utf8lex_error_t utf8lex_token_retain(
+        utf8lex_token_t *self
+        );
+extern utf8lex_error_t utf8lex_token_release(
+        utf8lex_token_t *self
+        );
+
+// Sets up to max_slices slices of the token's text, and the number
+// of slices it takes.  Returns UTF8LEX_MORE (with num_slices set
+// to the number needed) if the token spans more than max_slices buffers.
+extern utf8lex_error_t utf8lex_token_view(
+        utf8lex_token_t *self,
+        utf8lex_slice_t *slices,  // Array of (at least) max_slices slices.
+        uint32_t max_slices,
+        uint32_t *num_slices_pointer  // Mutable.
+        );
+// Sets a pointer to the token's text, all in one piece: straight into
+// the buffer if the token is all in one buffer, otherwise the token
+// is copied into the caller's scratch bytes (not 0-terminated).
+// Returns UTF8LEX_MORE if the token has to be copied, and it does not
+// fit in max_scratch_bytes.
+extern utf8lex_error_t utf8lex_token_contiguous(
+        utf8lex_token_t *self,
+        unsigned char *scratch,  // Only used when the token is in 2+ buffers.
+        size_t max_scratch_bytes,
+        unsigned char **bytes_pointer  // Mutable.
+        );
+
+//
+// utf8lex_compact_token_t:
+//
+// A packed, 16 byte form of a token, for callers that keep lots of
+// tokens around: just the absolute byte offset, the length in bytes,
+// and the id of the rule that matched.
+//
+// The char, grapheme and line locations are not stored, they are
+// computed on request by utf8lex_compact_token_expand(), by reading
+// the state's chain of buffers (which must still hold the token's bytes,
+// starting from the first buffer in the chain at absolute byte 0)
+// from the start of the token's line (see utf8lex_location_read())
+// up to the end of the token.  Capture groups are not kept.
+//
+struct _STRUCT_utf8lex_compact_token
+{
+  uint64_t start_byte;  // Absolute byte offset where the token starts.
+  uint32_t length_bytes;  // # bytes in token.
+  uint32_t rule_id;  // The id of the rule that matched this token.
+};
+
+// Packs the specified (full) token into the compact token:
+extern utf8lex_error_t utf8lex_compact_token_init(
+        utf8lex_compact_token_t *self,
+        utf8lex_token_t *token  // The token to pack.
+        );
+extern utf8lex_error_t utf8lex_compact_token_clear(
+        utf8lex_compact_token_t *self
+        );
+// Unpacks the compact token into a full token, looking up its rule
+// (by id, in the program) and re-computing its (absolute) locations
+// in every unit:
+extern utf8lex_error_t utf8lex_compact_token_expand(
+        utf8lex_compact_token_t *self,
+        utf8lex_program_t *program,  // The program the token was lexed with.
+        utf8lex_state_t *state,  // The state the token was lexed with.
+        utf8lex_token_t *token_pointer  // Mutable.
+        );
+
+//
+// Location modes:
+//
+// By default (UTF8LEX_LOCATION_MODE_ALL), every token updates the state's
+// byte, char, grapheme and line locations.
+//
+// In UTF8LEX_LOCATION_MODE_LAZY, only byte locations are kept up to date
+// while lexing: the state's and tokens' char, grapheme and line start
+// locations stay at 0 (and regex definitions do not even count the chars,
+// graphemes and lines in their matches).  Instead, utf8lex_location_resolve()
+// computes them on request (for error messages and so on), reading from
+// the start of the line, which it looks up in the state's line index.
+//
+enum _ENUM_utf8lex_location_mode
+{
+  UTF8LEX_LOCATION_MODE_NONE = -1,
+
+  UTF8LEX_LOCATION_MODE_ALL = 0,
+  UTF8LEX_LOCATION_MODE_LAZY,
+
+  UTF8LEX_LOCATION_MODE_MAX
+};
+
+//
+// Granularities:
+//
+// By default (UTF8LEX_GRANULARITY_GRAPHEME), lexing advances one grapheme
+// cluster at a time, as segmented by utf8proc_grapheme_break_stateful().
+//
+// In UTF8LEX_GRANULARITY_CODEPOINT, lexing advances one codepoint
+// at a time, skipping grapheme segmentation altogether (CR LF is still
+// read as one line separator).  Intended for machine-generated text
+// (logs, CSV, JSON and so on), where grapheme clusters do not matter.
+// Every codepoint counts as one grapheme, so grapheme locations
+// are the same as char locations.
+//
+enum _ENUM_utf8lex_granularity
+{
+  UTF8LEX_GRANULARITY_NONE = -1,
+
+  UTF8LEX_GRANULARITY_GRAPHEME = 0,
+  UTF8LEX_GRANULARITY_CODEPOINT,
+
+  UTF8LEX_GRANULARITY_MAX
+};
+
+//
+// utf8lex_line_index_t:
+//
+// The absolute byte offsets at which lines start (line 0 always starts
+// at byte 0, so it is not stored), in order, built up as tokens are lexed.
+// The caller provides the array of line starts.  Once it is full,
+// lexing carries on without adding more lines, and locations past
+// the last indexed line are resolved by reading from that line.
+//
+struct _STRUCT_utf8lex_line_index
+{
+  uint64_t *line_starts;  // line_starts[n] is the first byte of line n + 1.
+  uint32_t max_lines;  // # of line starts that fit in the array.
+  uint32_t num_lines;  // # of line starts stored so far.
+  bool is_after_cr;  // true = the last bytes added ended with a CR.
+  unsigned char partial[2];  // Unfinished separator at the end of the last.
+  uint32_t num_partial;  // # of partial bytes, 0 if none.
+  uint64_t end_byte;  // Absolute byte offset after the last bytes added.
+};
+
+extern utf8lex_error_t utf8lex_line_index_init(
+        utf8lex_line_index_t *self,
+        uint64_t *line_starts,  // Array of (at least) max_lines line starts.
+        uint32_t max_lines
+        );
+extern utf8lex_error_t utf8lex_line_index_clear(
+        utf8lex_line_index_t *self
+        );
+// Adds the start of every line that begins after a line separator
+// in the specified bytes (normally one token, which starts at absolute
+// byte start_byte).  Line starts that do not fit are dropped.
+// A CR at the end of one call and a LF at the start of the next
+// (at the following byte) are one line separator, as ever, and so is
+// a multi-byte separator split between calls (between buffers).
+extern utf8lex_error_t utf8lex_line_index_add(
+        utf8lex_line_index_t *self,
+        unsigned char *bytes,
+        size_t length_bytes,
+        uint64_t start_byte  // Absolute byte offset of bytes[0].
+        );
+
+//
+// utf8lex_intern_table_t:
+//
+// Interns the text of tokens (such as identifiers) into symbols,
+// so that each distinct text is copied exactly once, into the table's
+// arena, and every token with the same text gets the same symbol id.
+// Lookups use the hash that the lexers already computed while matching
+// (see utf8lex_hash_concat()), so tokens are never hashed twice,
+// and their bytes are only compared against symbols with the same hash.
+//
+// The caller provides the open-addressed hash slots (num_slots must be
+// a power of 2, greater than max_symbols), the symbols, and the arena.
+// Symbol ids are 0, 1, 2, ... in the order the symbols were first seen,
+// and stay the same until the table is cleared.  While lexing, a token
+// that straddles buffers is copied into the unused end of the arena
+// to be looked up, so it needs room there even if it was seen before.
+//
+#define UTF8LEX_SYMBOL_NONE UINT32_MAX
+
+struct _STRUCT_utf8lex_symbol
+{
+  uint64_t hash;  // The hash of the symbol's bytes.
+  uint64_t arena_offset;  // Where the bytes start in the arena.
+  uint64_t length_bytes;  // # of bytes in the symbol.
+};
+
+struct _STRUCT_utf8lex_intern_table
+{
+  uint32_t *slots;  // Symbol id + 1 in each slot, or 0 for an empty slot.
+  uint32_t num_slots;  // A power of 2, > max_symbols.
+  utf8lex_symbol_t *symbols;  // symbols[id] is the symbol with that id.
+  uint32_t max_symbols;  // # of symbols that fit in the array.
+  uint32_t num_symbols;  // # of symbols interned so far.
+  unsigned char *arena;  // The bytes of all the symbols, back to back.
+  uint64_t max_arena_bytes;  // # of bytes that fit in the arena.
+  uint64_t arena_bytes;  // # of bytes used so far.
+};
+
+extern utf8lex_error_t utf8lex_intern_table_init(
+        utf8lex_intern_table_t *self,
+        uint32_t *slots,  // Array of num_slots slots.
+        uint32_t num_slots,  // Power of 2, > max_symbols.
+        utf8lex_symbol_t *symbols,  // Array of (at least) max_symbols.
+        uint32_t max_symbols,
+        unsigned char *arena,  // Array of (at least) max_arena_bytes.
+        uint64_t max_arena_bytes
+        );
+extern utf8lex_error_t utf8lex_intern_table_clear(
+        utf8lex_intern_table_t *self
+        );
+// Looks up the specified bytes (whose hash has already been computed),
+// adding them as a new symbol if they have not been interned before.
+// Returns UTF8LEX_ERROR_MAX_LENGTH if a new symbol does not fit
+// in the symbols array or the arena.
+extern utf8lex_error_t utf8lex_intern(
+        utf8lex_intern_table_t *self,
+        unsigned char *bytes,
+        uint64_t length_bytes,
+        uint64_t hash,  // Hash of the bytes, see utf8lex_hash_concat().
+        uint32_t *symbol_id_pointer  // Mutable.
+        );
+// Sets the bytes and length of the specified symbol (pointing into
+// the arena, not copied, and not 0-terminated):
+extern utf8lex_error_t utf8lex_intern_table_symbol(
+        utf8lex_intern_table_t *self,
+        uint32_t symbol_id,
+        unsigned char **bytes_pointer,  // Mutable.
+        uint64_t *length_bytes_pointer  // Mutable.
+        );
+
+//
+// utf8lex_resume_t:
+//
+// When a definition runs out of bytes part way through a token
+// and returns UTF8LEX_MORE, it can save how far it got, so that once
+// more bytes have been read in, it carries on from there instead of
+// matching the whole token all over again.  Only the rule that asked
+// for MORE, at the same token start, can pick up where it left off,
+// and lexing any token throws the saved progress away.
+//
+// CAT definitions save the # of graphemes matched so far, SEQUENCE
+// multi-definitions the reference they were matching and how many
+// times it had already repeated.  (REGEX definitions start over:
+// pcre2_match() can only re-scan a partial match, not resume it.)
+//
+struct _STRUCT_utf8lex_resume
+{
+  utf8lex_rule_t *rule;  // The rule that asked for MORE, or NULL.
+  int64_t start_byte;  // Absolute byte offset of the token's start.
+  uint32_t step;  // Definition-specific, e.g. which reference.
+  int64_t count;  // Definition-specific, e.g. # of graphemes matched.
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Lengths matched so far.
+};
+
+// No more than (this many) modes can be pushed onto a state's mode stack:
+#define UTF8LEX_MODE_STACK_MAX 32
+
+//
+// utf8lex_include_t:
+//
+// Where lexing was in one source (buffer chain) when another source
+// was pushed on top of it by utf8lex_state_push_buffer() (for example,
+// by the rule code for an "include" directive).  Each source keeps
+// its own buffer offsets and absolute locations (starting from 0),
+// and its own stream / window / reader and line index, so nothing
+// has to be re-lexed or rebuilt when lexing goes back to it.
+//
+// No more than (this many) sources can be pushed onto a state:
+#define UTF8LEX_INCLUDE_STACK_MAX 16
+
+struct _STRUCT_utf8lex_include
+{
+  utf8lex_buffer_t *buffer;  // The buffer that was being lexed.
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Absolute location in source.
+  utf8lex_line_index_t *line_index;  // The source's line index, or NULL.
+  utf8lex_stream_t *stream;  // The source's stream, or NULL.
+  utf8lex_window_t *window;  // The source's windows, or NULL.
+  utf8lex_reader_t *reader;  // The source's reader, or NULL.
+};
+
 struct _STRUCT_ut8lex_state
 {
   utf8lex_buffer_t *buffer;  // Current buffer being lexed.
   utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Current location within buffer.
+
+  uint32_t mode;  // Current mode, which determines the rules to try.
+  uint32_t num_pushed_modes;  // # of modes saved by utf8lex_state_push_mode().
+  uint32_t pushed_modes[UTF8LEX_MODE_STACK_MAX];  // Saved modes, oldest first.
+
+  uint32_t num_includes;  // # of sources saved by utf8lex_state_push_buffer().
+  utf8lex_include_t includes[UTF8LEX_INCLUDE_STACK_MAX];  // Oldest first.
+
+  utf8lex_location_mode_t location_mode;  // Locations to track while lexing.
+  uint32_t units;  // Mask of (1 << unit) for each unit counted.
+  utf8lex_granularity_t granularity;  // Graphemes or codepoints.
+  utf8lex_line_index_t *line_index;  // Line starts, or NULL for no index.
+  utf8lex_intern_table_t *intern_table;  // Symbols, or NULL for no interning.
+  utf8lex_stream_t *stream;  // Refilled on MORE, or NULL for no refills.
+  utf8lex_window_t *window;  // Advanced on MORE, or NULL for no windows.
+  utf8lex_reader_t *reader;  // Read from on MORE, or NULL for no reader.
+  utf8lex_resume_t resume;  // How far the token got before MORE.
+  // Graphemes already decoded for the token being lexed, or NULL
+  // to decode every grapheme read (see utf8lex_grapheme_cache_t):
+  utf8lex_grapheme_cache_t *grapheme_cache;
+  // Regex match data with room for UTF8LEX_CAPTURES_MAX captures,
+  // reused for every regex match, or NULL to create one per match:
+  pcre2_match_data *match_data;
 };
 
 extern utf8lex_error_t utf8lex_state_init(
@@ -751,6 +1740,330 @@ extern utf8lex_error_t utf8lex_state_clear(
         utf8lex_state_t *self
         );
 
+// Switches the state to the specified mode (like flex's BEGIN):
+extern utf8lex_error_t utf8lex_state_set_mode(
+        utf8lex_state_t *self,
+        uint32_t mode  // 0 <= mode < UTF8LEX_MODES_MAX.
+        );
+// Saves the current mode, then switches to the specified mode
+// (like flex's yy_push_state()):
+extern utf8lex_error_t utf8lex_state_push_mode(
+        utf8lex_state_t *self,
+        uint32_t mode  // 0 <= mode < UTF8LEX_MODES_MAX.
+        );
+// Switches back to the most recently pushed mode
+// (like flex's yy_pop_state()).  Returns UTF8LEX_ERROR_STATE
+// if no modes have been pushed.
+extern utf8lex_error_t utf8lex_state_pop_mode(
+        utf8lex_state_t *self
+        );
+
+// Saves the current source (see utf8lex_include_t), then starts lexing
+// the specified buffer (chain) from its beginning, at location 0
+// (like flex's yypush_buffer_state()).  The new source has no stream,
+// window, reader or line index until they are set.  At the EOF of
+// the new source, lexing automatically pops back to the saved one,
+// carrying on right where it left off (so no token spans sources).
+// Returns UTF8LEX_ERROR_MAX_LENGTH if UTF8LEX_INCLUDE_STACK_MAX sources
+// have already been pushed.
+extern utf8lex_error_t utf8lex_state_push_buffer(
+        utf8lex_state_t *self,
+        utf8lex_buffer_t *buffer  // Owned by the caller.
+        );
+// Goes back to lexing the most recently pushed source (like flex's
+// yypop_buffer_state(), except the caller still owns the buffer
+// that was being lexed, and can clear it once its tokens are done with).
+// Returns UTF8LEX_ERROR_STATE if no sources have been pushed.
+extern utf8lex_error_t utf8lex_state_pop_buffer(
+        utf8lex_state_t *self
+        );
+
+// Sets which locations are tracked while lexing (see
+// utf8lex_location_mode_t):
+extern utf8lex_error_t utf8lex_state_set_location_mode(
+        utf8lex_state_t *self,
+        utf8lex_location_mode_t location_mode
+        );
+// Counts the specified units (UTF8LEX_UNITS_DEFAULT, plus optional
+// units such as (1 << UTF8LEX_UNIT_UTF16)) while lexing.  Optional units
+// that are not enabled are never counted, their lengths are always 0.
+extern utf8lex_error_t utf8lex_state_set_units(
+        utf8lex_state_t *self,
+        uint32_t units  // Must include UTF8LEX_UNITS_DEFAULT.
+        );
+// Sets whether lexing advances by grapheme or by codepoint (see
+// utf8lex_granularity_t):
+extern utf8lex_error_t utf8lex_state_set_granularity(
+        utf8lex_state_t *self,
+        utf8lex_granularity_t granularity
+        );
+// Builds up the specified line index (or stops, if NULL) while lexing:
+extern utf8lex_error_t utf8lex_state_set_line_index(
+        utf8lex_state_t *self,
+        utf8lex_line_index_t *line_index  // Or NULL.
+        );
+// Saves how far the specified rule got matching the token that starts
+// at the state's current location, before it ran out of bytes
+// (see utf8lex_resume_t):
+extern utf8lex_error_t utf8lex_state_save_resume(
+        utf8lex_state_t *self,
+        utf8lex_rule_t *rule,
+        uint32_t step,
+        int64_t count,
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX]  // Lengths matched so far.
+        );
+// Takes back (and forgets) the progress saved for the specified rule,
+// or returns UTF8LEX_NO_MATCH if there is none for the token
+// at the state's current location.
+extern utf8lex_error_t utf8lex_state_take_resume(
+        utf8lex_state_t *self,
+        utf8lex_rule_t *rule,
+        uint32_t *step_pointer,  // Mutable.
+        int64_t *count_pointer,  // Mutable.
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX]  // Mutable.
+        );
+// Refills the specified stream (or stops, if NULL) whenever lexing
+// needs MORE bytes, instead of returning UTF8LEX_MORE:
+extern utf8lex_error_t utf8lex_state_set_stream(
+        utf8lex_state_t *self,
+        utf8lex_stream_t *stream  // Or NULL.
+        );
+// Maps the specified window's next window (or stops, if NULL) whenever
+// lexing needs MORE bytes, instead of returning UTF8LEX_MORE:
+extern utf8lex_error_t utf8lex_state_set_window(
+        utf8lex_state_t *self,
+        utf8lex_window_t *window  // Or NULL.
+        );
+// Appends the specified reader's next buffer (or stops, if NULL)
+// whenever lexing needs MORE bytes, instead of returning UTF8LEX_MORE:
+extern utf8lex_error_t utf8lex_state_set_reader(
+        utf8lex_state_t *self,
+        utf8lex_reader_t *reader  // Or NULL.
+        );
+// Interns the tokens of interned rules into the specified table
+// (or stops interning, if NULL) while lexing:
+extern utf8lex_error_t utf8lex_state_set_intern_table(
+        utf8lex_state_t *self,
+        utf8lex_intern_table_t *intern_table  // Or NULL.
+        );
+
+//
+// utf8lex_session_t:
+//
+// Lexes many small documents, one after another, from memory, with
+// a program that was compiled once.  utf8lex_session_reset() points
+// the session's string, buffer and state at the next document in O(1),
+// keeping everything else: the state's settings (location mode, units,
+// intern table, ...) and its scratch space (the regex match data)
+// stay warm from one document to the next.  The caller owns the bytes
+// of each document, which must not change until the session is reset
+// or cleared.  Each document is lexed from location 0, in the initial
+// mode, up to EOF.
+//
+struct _STRUCT_utf8lex_session
+{
+  utf8lex_program_t *program;  // The compiled rules to lex with.
+  utf8lex_string_t str;  // The current document's bytes.
+  utf8lex_buffer_t buffer;  // The (only) buffer, holding the document.
+  utf8lex_state_t state;  // Settings can be changed between documents.
+};
+
+extern utf8lex_error_t utf8lex_session_init(
+        utf8lex_session_t *self,
+        utf8lex_program_t *program  // Compiled, and outliving the session.
+        );
+extern utf8lex_error_t utf8lex_session_clear(
+        utf8lex_session_t *self
+        );
+// Starts lexing the specified document.  The state's line index
+// (if any) is emptied, but its intern table (if any) is not,
+// so that symbol ids stay the same across documents:
+extern utf8lex_error_t utf8lex_session_reset(
+        utf8lex_session_t *self,
+        unsigned char *bytes,  // Owned by the caller.
+        size_t length_bytes
+        );
+// Same as utf8lex_program_lex(), with the session's program and state:
+extern utf8lex_error_t utf8lex_session_lex(
+        utf8lex_session_t *self,
+        utf8lex_token_t *token_pointer
+        );
+
+//
+// utf8lex_parallel_lex():
+//
+// Lexes the rest of the state's (one, whole, EOF) buffer, such as
+// an mmapped file, in num_chunks chunks, one thread per chunk.
+// Each chunk after the first speculatively starts lexing right after
+// a newline, so its lines are counted from 0 but its columns (chars,
+// graphemes, ...) are already right, and stops at the first token
+// that starts in the next chunk.  Then the chunks are checked in order:
+// a chunk is in sync with the one before it if it lexed a token
+// starting where the one before it stopped (from there on, the tokens
+// can only be the same).  A chunk that is out of sync (for example,
+// one that started inside a multi-line comment or string) is re-lexed
+// from where the chunk before it stopped, only until it is in sync
+// again.  Finally each chunk's line numbers are fixed up by the number
+// of lines before it (a prefix sum of the lines in each chunk).
+//
+// The tokens are exactly the same as lexing the buffer with
+// utf8lex_program_lex() one token at a time (token->buffer is the
+// state's buffer), except that they are returned chunk by chunk:
+// chunks[c].tokens[chunks[c].first_token] onwards, num_tokens of them.
+// As with utf8lex_lex_batch(), the rule code is not run in between
+// tokens, so the mode stays the same for the whole buffer.
+// The state must not have a stream, window, reader, line index
+// or intern table, since they cannot be shared between threads.
+//
+// Returns UTF8LEX_EOF once the whole buffer has been lexed (moving
+// the state to the end of it), or the error that stopped lexing
+// (the tokens before the error are good, the chunks after it are empty),
+// or UTF8LEX_ERROR_MAX_LENGTH if a chunk has too little room for tokens.
+//
+struct _STRUCT_utf8lex_chunk
+{
+  // Set by the caller:
+  utf8lex_token_t *tokens;  // Room for max_tokens tokens.
+  uint32_t max_tokens;
+
+  // Set by utf8lex_parallel_lex():
+  uint32_t first_token;  // Index of the chunk's first (good) token.
+  uint32_t num_tokens;  // # of good tokens from first_token on.
+
+  // Used by utf8lex_parallel_lex() while lexing:
+  utf8lex_program_t *program;  // The (shared, read-only) program.
+  int64_t start_byte;  // Where the chunk starts (speculatively).
+  int64_t end_byte;  // Where the next chunk starts.
+  int64_t stop_byte;  // First token start >= end_byte, or EOF / error.
+  utf8lex_location_t stop_loc[UTF8LEX_UNIT_MAX];  // Location of stop_byte.
+  utf8lex_error_t error;  // Why lexing stopped (OK, EOF, or an error).
+  utf8lex_buffer_t buffer;  // The state's buffer, lexed from start_byte.
+  utf8lex_state_t state;  // The chunk's own state.
+  pthread_t thread;
+};
+
+extern utf8lex_error_t utf8lex_parallel_lex(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_chunk_t *chunks,  // Array of num_chunks chunks.
+        uint32_t num_chunks  // >= 1.
+        );
+
+//
+// utf8lex_files_t:
+//
+// Lexes many files with one compiled program, concurrently, one thread
+// per worker.  Each worker has its own session (state, buffer, regex
+// match data) and its own batch of tokens, so nothing is shared between
+// threads but the (read-only) program and the list of files.
+// The files are dealt out to the workers in even, contiguous ranges;
+// a worker that runs out of files steals the back half of another
+// worker's remaining range, so that a few big files do not leave
+// the other workers idle.
+//
+// Each file is mmapped, lexed with utf8lex_lex_batch() up to max_tokens
+// tokens at a time, and then unmapped.  Every batch is passed to the
+// on_tokens() callback, from the worker's thread, along with the error
+// that ended the batch: UTF8LEX_OK if there are more tokens to come,
+// UTF8LEX_EOF for the file's last (possibly empty) batch, or the error
+// that stopped lexing the file.  The tokens (and the bytes they point to) are only
+// good until the callback returns.  If the callback returns anything
+// but UTF8LEX_OK, the rest of that file is not lexed.
+//
+// As with utf8lex_lex_batch(), the rule code is not run in between
+// tokens, so each file is lexed in the initial mode.
+//
+struct _STRUCT_utf8lex_files
+{
+  utf8lex_program_t *program;  // The compiled rules to lex with.
+  unsigned char **paths;  // The num_files files to lex.
+  uint32_t num_files;
+  utf8lex_error_t *errors;  // How each of the num_files files ended.
+
+  // Called with each batch of tokens (can be called from any thread):
+  utf8lex_error_t (*on_tokens)(
+          utf8lex_files_t *self,
+          uint32_t file_index,  // Index into paths.
+          utf8lex_token_t *tokens,
+          uint32_t num_tokens,
+          utf8lex_error_t error  // OK (more to come), EOF, or an error.
+          );
+  void *context;  // Anything the callback needs.
+
+  // Used by utf8lex_files_lex() while lexing:
+  utf8lex_worker_t *workers;  // Every worker can steal from every other.
+  uint32_t num_workers;
+};
+
+struct _STRUCT_utf8lex_worker
+{
+  // Set by the caller:
+  utf8lex_token_t *tokens;  // Room for max_tokens tokens per batch.
+  uint32_t max_tokens;
+
+  // Used by utf8lex_files_lex() while lexing:
+  utf8lex_files_t *files;
+  uint32_t next_file;  // Next file index to lex.
+  uint32_t end_file;  // Files next_file up to (not incl) end_file are left.
+  pthread_mutex_t lock;  // Guards next_file and end_file (stealing).
+  utf8lex_session_t session;
+  utf8lex_string_t file_str;  // The mmapped bytes of the current file.
+  utf8lex_buffer_t file_buffer;
+  pthread_t thread;
+};
+
+extern utf8lex_error_t utf8lex_files_init(
+        utf8lex_files_t *self,
+        utf8lex_program_t *program,  // Compiled.
+        unsigned char **paths,  // Array of num_files paths.
+        uint32_t num_files,
+        utf8lex_error_t *errors,  // Array of num_files errors.
+        utf8lex_error_t (*on_tokens)(
+                utf8lex_files_t *self,
+                uint32_t file_index,
+                utf8lex_token_t *tokens,
+                uint32_t num_tokens,
+                utf8lex_error_t error
+                ),
+        void *context
+        );
+extern utf8lex_error_t utf8lex_files_clear(
+        utf8lex_files_t *self
+        );
+// Lexes all the files, returning UTF8LEX_EOF if every one of them
+// was lexed to EOF, otherwise the error from the first file (in order
+// of paths) that was not.  Each file's own outcome is in errors[].
+extern utf8lex_error_t utf8lex_files_lex(
+        utf8lex_files_t *self,
+        utf8lex_worker_t *workers,  // Array of num_workers workers.
+        uint32_t num_workers  // >= 1.
+        );
+
+// Computes the (absolute) location of the specified absolute byte offset
+// in the specified unit (char, grapheme, line, ...).  Lines come straight
+// from the state's line index if it is complete up to the byte offset,
+// otherwise the state's chain of buffers (which must still hold
+// the bytes) is read from the start of the byte offset's line.
+extern utf8lex_error_t utf8lex_location_resolve(
+        utf8lex_state_t *state,
+        uint64_t byte_offset,  // Absolute byte offset.
+        utf8lex_unit_t unit,  // The unit to resolve to.
+        int64_t *location_pointer  // Mutable.
+        );
+// Reads the state's chain of buffers from the start of start_byte's line
+// to end_byte, setting the (absolute) start locations of start_byte,
+// plus the length, after and hash of the bytes up to end_byte,
+// in every unit.  Also sets the buffer and offset of start_byte
+// (unless buffer_pointer, offset_pointer are NULL).
+extern utf8lex_error_t utf8lex_location_read(
+        utf8lex_state_t *state,
+        uint64_t start_byte,  // Absolute byte offset.
+        uint64_t end_byte,  // Absolute byte offset, >= start_byte.
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX],  // Mutable.
+        utf8lex_buffer_t **buffer_pointer,  // Mutable, or NULL.
+        off_t *offset_pointer  // Mutable, or NULL.
+        );
+
 // Determines the category/ies of the specified Unicode 32 bit codepoint.
 // Pass in a reference to the utf8lex_cat_t; on success, the specified
 // utf8lex_cat_t pointer will be overwritten.
@@ -759,6 +2072,44 @@ extern utf8lex_error_t utf8lex_cat_codepoint(
         utf8lex_cat_t *cat_pointer  // Mutable.
         );
 
+//
+// utf8lex_grapheme_cache_t:
+//
+// The graphemes decoded while lexing one token, so that the alternatives
+// of an OR multi-definition, which all start reading from the same byte,
+// decode each grapheme only once between them.  Each grapheme is kept
+// in the slot for (its start offset % UTF8LEX_GRAPHEME_CACHE_LENGTH),
+// replacing whichever grapheme was there before, so graphemes further
+// than that from where the token starts might be decoded more than once.
+// Only meaningful while the strings being lexed stay the same, and for
+// states with the same units and granularity, so a cache lives no longer
+// than the lexing of one token.
+//
+#define UTF8LEX_GRAPHEME_CACHE_LENGTH 64
+
+struct _STRUCT_utf8lex_grapheme
+{
+  utf8lex_string_t *str;  // The string the grapheme starts in, or NULL.
+  off_t offset;  // Start byte, relative to the start of str.
+  off_t end_offset;  // Byte after the grapheme, relative to start of str.
+  utf8lex_buffer_t *end_buffer;  // Buffer it ends in, or NULL if same one.
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];  // Lengths, afters and hashes.
+  int32_t codepoint;  // First codepoint of the grapheme.
+  utf8lex_cat_t cat;  // Category/ies of the first codepoint.
+};
+
+struct _STRUCT_utf8lex_grapheme_cache
+{
+  utf8lex_grapheme_t graphemes[UTF8LEX_GRAPHEME_CACHE_LENGTH];
+};
+
+extern utf8lex_error_t utf8lex_grapheme_cache_init(
+        utf8lex_grapheme_cache_t *self
+        );
+extern utf8lex_error_t utf8lex_grapheme_cache_clear(
+        utf8lex_grapheme_cache_t *self
+        );
+
 // Reads to the end of a grapheme, sets the first codepoint of the
 // grapheme, and the number of bytes read.
 // Note that CR, LF (U+000D, U+000A), often equivalent to '\r\n')
@@ -766,12 +2117,16 @@ extern utf8lex_error_t utf8lex_cat_codepoint(
 // since the 2 characters, combined in sequence, usually represent
 // one single line separator.
 // The state is used only for the string buffer to read from,
-// not for its location info.
+// not for its location info.  If the grapheme carries on into the next
+// buffer(s) in the chain, the state is moved on to the buffer it ends in
+// (and the offset keeps counting from the start of the original buffer).
 // The offset, lengths, codepoint and cat are all set upon
 // successfully reading one complete grapheme cluster.
 // loc[*].after will be -1 if no newlines were encountered, or 0
 // or more if the character / grapheme positions were reset to 0 at newline.
 // (Bytes and lines will never have their after locations reset, always -1.)
+// If the state has a grapheme cache, a grapheme that was already decoded
+// at the same offset of the same string is copied out of the cache.
 extern utf8lex_error_t utf8lex_read_grapheme(
         utf8lex_state_t *state,
         off_t *offset_pointer,  // Mutable.
@@ -49,6 +49,9 @@ utf8lex_error_t utf8lex_buffer_init(
   self->str = str;
   self->is_eof = is_eof;
 
+  self->pool = NULL;
+  self->refs = (uint32_t) 0;
+
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
@@ -121,6 +124,34 @@ utf8lex_error_t utf8lex_buffer_add(
     return UTF8LEX_ERROR_CHAIN_INSERT;
   }
 
+  // Pooled buffers go through the pool, so that it knows where its
+  // chain begins and ends (and can recycle it):
+  if (self->pool != NULL
+      || tail->pool != NULL)
+  {
+    if (tail->pool != self->pool)
+    {
+      // Pooled and unpooled buffers cannot share a chain.
+      return UTF8LEX_ERROR_CHAIN_INSERT;
+    }
+    else if (self->pool->tail == NULL)
+    {
+      // The pool's chain is empty, so self starts it.
+      utf8lex_error_t error = utf8lex_buffer_pool_append(
+          self->pool,  // self
+          self,  // buffer
+          self->is_eof);  // is_eof
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+    }
+
+    return utf8lex_buffer_pool_append(self->pool,  // self
+                                      tail,  // buffer
+                                      tail->is_eof);  // is_eof
+  }
+
   // Find the end of the buffer, in case this (self) buffer is not at the end:
   utf8lex_buffer_t *buffer = self;
   int infinite_loop = (int) UTF8LEX_BUFFER_STRINGS_MAX;
@@ -143,3 +174,62 @@ utf8lex_error_t utf8lex_buffer_add(
 
   return UTF8LEX_OK;
 }
+
+utf8lex_error_t utf8lex_buffer_retain(
+        utf8lex_buffer_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->pool == NULL)
+  {
+    // Not pooled, the caller owns it.
+    return UTF8LEX_OK;
+  }
+  else if (self->refs == (uint32_t) 0)
+  {
+    // Already back in the pool.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  self->refs ++;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_buffer_release(
+        utf8lex_buffer_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->pool == NULL)
+  {
+    // Not pooled, the caller owns it.
+    return UTF8LEX_OK;
+  }
+  else if (self->refs == (uint32_t) 0)
+  {
+    // Already back in the pool.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  self->refs --;
+  if (self->refs > (uint32_t) 0)
+  {
+    return UTF8LEX_OK;
+  }
+
+  // Nobody holds it, not even the chain: back into the pool.
+  utf8lex_buffer_pool_t *pool = self->pool;
+  self->prev = NULL;
+  self->next = pool->free;
+  pool->free = self;
+  pool->num_free ++;
+
+  return UTF8LEX_OK;
+}
@@ -0,0 +1,367 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>  // For errno, EAGAIN, EINTR.
+#include <inttypes.h>  // For uint32_t.
+#include <stdbool.h>  // For bool, true, false.
+#include <stdio.h>
+#include <unistd.h>  // For read(), sysconf().
+
+#include <sys/mman.h>  // For mmap(), munmap().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                         utf8lex_buffer_pool_t
+// ---------------------------------------------------------------------
+
+utf8lex_error_t utf8lex_buffer_pool_init(
+        utf8lex_buffer_pool_t *self,
+        size_t chunk_size,  // Multiple of the page size.
+        uint32_t num_chunks  // 1 <= num_chunks <= UTF8LEX_BUFFER_POOL_MAX.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (num_chunks == (uint32_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  else if (num_chunks > (uint32_t) UTF8LEX_BUFFER_POOL_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (chunk_size == (size_t) 0
+      || page_size <= 0L
+      || (chunk_size % (size_t) page_size) != (size_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  // All the chunks at once, so that no memory is ever needed after init.
+  // mmap() hands back page-aligned memory, and each chunk is a whole
+  // number of pages, so every chunk is page-aligned, too.
+  unsigned char *chunks = (unsigned char *) mmap(
+      (void *) NULL,  // addr
+      (size_t) num_chunks * chunk_size,  // length
+      PROT_READ | PROT_WRITE,  // prot
+      MAP_PRIVATE | MAP_ANONYMOUS,  // flags
+      -1,  // fd
+      (off_t) 0);  // offset
+  if ((void *) chunks == MAP_FAILED)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  self->chunks = chunks;
+  self->chunk_size = chunk_size;
+  self->num_chunks = num_chunks;
+
+  self->free = NULL;
+  self->num_free = (uint32_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+
+  // Push the chunks onto the free list backwards, so that they
+  // are handed out in order:
+  for (int32_t c = (int32_t) num_chunks - 1; c >= 0; c --)
+  {
+    utf8lex_string_t *str = &(self->strs[c]);
+    utf8lex_error_t error = utf8lex_string_init(
+        str,  // self
+        chunk_size,  // max_length_bytes
+        (size_t) 0,  // length_bytes
+        &(chunks[(size_t) c * chunk_size]));  // bytes
+    if (error != UTF8LEX_OK)
+    {
+      munmap(chunks, (size_t) num_chunks * chunk_size);
+      return error;
+    }
+
+    utf8lex_buffer_t *buffer = &(self->buffers[c]);
+    error = utf8lex_buffer_init(buffer,  // self
+                                NULL,  // prev
+                                str,  // str
+                                false);  // is_eof
+    if (error != UTF8LEX_OK)
+    {
+      munmap(chunks, (size_t) num_chunks * chunk_size);
+      return error;
+    }
+    buffer->pool = self;
+    buffer->refs = (uint32_t) 0;
+
+    buffer->next = self->free;
+    self->free = buffer;
+    self->num_free ++;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_buffer_pool_clear(
+        utf8lex_buffer_pool_t *self
+        )
+{
+  if (self == NULL
+      || self->chunks == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  int munmap_error = munmap(self->chunks,
+                            (size_t) self->num_chunks * self->chunk_size);
+  if (munmap_error != 0)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  for (uint32_t c = (uint32_t) 0; c < self->num_chunks; c ++)
+  {
+    // Don't unlink: the whole chain is going away at once.
+    self->buffers[c].prev = NULL;
+    self->buffers[c].next = NULL;
+    utf8lex_buffer_clear(&(self->buffers[c]));
+    self->buffers[c].pool = NULL;
+    self->buffers[c].refs = (uint32_t) 0;
+    utf8lex_string_clear(&(self->strs[c]));
+  }
+
+  self->chunks = NULL;
+  self->chunk_size = (size_t) 0;
+  self->num_chunks = (uint32_t) 0;
+
+  self->free = NULL;
+  self->num_free = (uint32_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+
+  return UTF8LEX_OK;
+}
+
+// Drops the chain's reference to each buffer at the head of the chain
+// that the state has lexed past, stopping at the first buffer
+// that a token still holds, so the rest of the chain stays intact.
+static utf8lex_error_t utf8lex_buffer_pool_recycle(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_state_t *state
+        )
+{
+  while (self->head != NULL
+         && self->head != state->buffer
+         && self->head->next != NULL
+         && self->head->refs == (uint32_t) 1)
+  {
+    utf8lex_buffer_t *consumed = self->head;
+    self->head = consumed->next;
+    self->head->prev = NULL;
+    consumed->next = NULL;
+
+    utf8lex_error_t error = utf8lex_buffer_release(consumed);
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_buffer_pool_acquire(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_state_t *state,  // Or NULL.
+        utf8lex_buffer_t **buffer_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || self->chunks == NULL
+      || buffer_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  if (state != NULL
+      && state->buffer != NULL)
+  {
+    utf8lex_error_t error = utf8lex_buffer_pool_recycle(self,  // self
+                                                        state);  // state
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+  }
+
+  if (self->free == NULL)
+  {
+    // Every chunk is either still being lexed, or held by a token.
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  utf8lex_buffer_t *buffer = self->free;
+  self->free = buffer->next;
+  self->num_free --;
+
+  buffer->next = NULL;
+  buffer->prev = NULL;
+  buffer->fd = -1;
+  buffer->fp = NULL;
+  buffer->is_eof = false;
+  buffer->str->length_bytes = (size_t) 0;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    buffer->loc[unit].start = 0;
+    buffer->loc[unit].length = 0;
+  }
+  buffer->refs = (uint32_t) 1;  // The chain's reference, once appended.
+
+  *buffer_pointer = buffer;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_buffer_pool_append(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_buffer_t *buffer,
+        bool is_eof
+        )
+{
+  if (self == NULL
+      || buffer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (buffer->pool != self
+           || buffer->refs == (uint32_t) 0
+           || buffer->prev != NULL
+           || buffer->next != NULL
+           || buffer == self->head)
+  {
+    // Not acquired from this pool, or already in the chain.
+    return UTF8LEX_ERROR_CHAIN_INSERT;
+  }
+  else if (self->tail != NULL
+           && (self->tail->next != NULL
+               || self->tail->refs == (uint32_t) 0))
+  {
+    // The chain's tail was linked to, or released, behind the pool's back.
+    return UTF8LEX_ERROR_CHAIN_INSERT;
+  }
+
+  buffer->is_eof = is_eof;
+
+  if (self->tail == NULL)
+  {
+    self->head = buffer;
+  }
+  else
+  {
+    self->tail->next = buffer;
+    buffer->prev = self->tail;
+  }
+  self->tail = buffer;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_buffer_pool_read(
+        utf8lex_buffer_pool_t *self,
+        utf8lex_state_t *state,  // Or NULL.
+        int fd
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_DESCRIPTOR;
+  }
+  else if (self->tail != NULL
+           && self->tail->is_eof == true)
+  {
+    // Nothing more to read.
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_buffer_t *buffer = NULL;
+  utf8lex_error_t error = utf8lex_buffer_pool_acquire(
+      self,  // self
+      state,  // state
+      &buffer);  // buffer_pointer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  ssize_t num_bytes_read = -1;
+  while (true)
+  {
+    num_bytes_read = read(fd,
+                          buffer->str->bytes,
+                          buffer->str->max_length_bytes);
+    if (num_bytes_read >= (ssize_t) 0
+        || errno != EINTR)
+    {
+      break;
+    }
+  }
+
+  if (num_bytes_read < (ssize_t) 0)
+  {
+    utf8lex_buffer_release(buffer);
+    if (errno == EAGAIN
+        || errno == EWOULDBLOCK)
+    {
+      // Non-blocking fd with nothing to read yet.  Try again later.
+      return UTF8LEX_MORE;
+    }
+
+    return UTF8LEX_ERROR_FILE_READ;
+  }
+  else if (num_bytes_read == (ssize_t) 0
+           && self->tail != NULL)
+  {
+    // End of file: no need for an empty buffer at the end of the chain.
+    utf8lex_buffer_release(buffer);
+    self->tail->is_eof = true;
+    return UTF8LEX_OK;
+  }
+
+  buffer->fd = fd;
+  buffer->str->length_bytes = (size_t) num_bytes_read;
+
+  error = utf8lex_buffer_pool_append(
+      self,  // self
+      buffer,  // buffer
+      (num_bytes_read == (ssize_t) 0) ? true : false);  // is_eof
+  if (error != UTF8LEX_OK)
+  {
+    utf8lex_buffer_release(buffer);
+    return error;
+  }
+
+  return UTF8LEX_OK;
+}
@@ -148,6 +148,29 @@ static utf8lex_error_t utf8lex_lex_cat(
     return UTF8LEX_ERROR_DEFINITION_TYPE;
   }
 
+  utf8lex_cat_definition_t *cat_definition =
+    (utf8lex_cat_definition_t *) rule->definition;
+
+  return utf8lex_lex_cat_unchecked(
+      rule,  // rule
+      cat_definition->cat,  // cat
+      cat_definition->min,  // min
+      cat_definition->max,  // max
+      state,  // state
+      token_pointer);  // token_pointer
+}
+
+// Called by utf8lex_lex_cat() and by compiled programs
+// (utf8lex_program_lex()), which have already checked their arguments.
+utf8lex_error_t utf8lex_lex_cat_unchecked(
+        utf8lex_rule_t *rule,
+        utf8lex_cat_t cat_mask,  // The category / ies to match.
+        int min,  // Minimum consecutive occurrences of the cat (1 or more).
+        int max,  // Maximum consecutive occurrences (-1 = no limit).
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
   off_t offset = (off_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
   utf8lex_location_t token_loc[UTF8LEX_UNIT_MAX];
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
@@ -155,22 +178,67 @@ static utf8lex_error_t utf8lex_lex_cat(
        unit ++)
   {
     token_loc[unit].start = state->loc[unit].start;
-    token_loc[unit].length = (int) 0;
+    token_loc[unit].length = (int64_t) 0;
     token_loc[unit].after = -1;  // No reset.
-    token_loc[unit].hash = (unsigned long) 0;
+    token_loc[unit].hash = (uint64_t) 0;
   }
 
-  utf8lex_cat_definition_t *cat_definition =
-    (utf8lex_cat_definition_t *) rule->definition;
-  for (int ug = 0;
-       cat_definition->max == -1 || ug < cat_definition->max;
+  // The token can straddle buffers: offset is relative to the buffer
+  // we're reading from, but the token starts in start_buffer.
+  utf8lex_buffer_t *start_buffer = state->buffer;
+  utf8lex_buffer_t *buffer = state->buffer;
+
+  // If this rule ran out of bytes part way through this token last time,
+  // carry on from the grapheme where it stopped:
+  uint32_t resume_step = (uint32_t) 0;
+  int64_t resume_count = (int64_t) 0;
+  if (state->resume.rule == rule
+      && utf8lex_state_take_resume(state,  // self
+                                   rule,  // rule
+                                   &resume_step,  // step_pointer
+                                   &resume_count,  // count_pointer
+                                   token_loc)  // loc
+         == UTF8LEX_OK)
+  {
+    offset += (off_t) token_loc[UTF8LEX_UNIT_BYTE].length;
+    while ((size_t) offset > buffer->str->length_bytes
+           && buffer->next != NULL)
+    {
+      offset -= (off_t) buffer->str->length_bytes;
+      buffer = buffer->next;
+    }
+  }
+
+  for (int64_t ug = resume_count;
+       max == -1 || ug < max;
        ug ++)
   {
+    if ((size_t) offset >= buffer->str->length_bytes)
+    {
+      if (buffer->next != NULL)
+      {
+        // Carry on reading from the next buffer in the chain.
+        buffer = buffer->next;
+        offset = (off_t) 0;
+      }
+      else if (buffer->is_eof == false)
+      {
+        // The token might carry on in bytes that haven't been read yet.
+        utf8lex_state_save_resume(state,  // self
+                                  rule,  // rule
+                                  (uint32_t) 0,  // step
+                                  ug,  // count
+                                  token_loc);  // loc
+        return UTF8LEX_MORE;
+      }
+    }
+
     // Read in one UTF-8 grapheme cluster:
     off_t grapheme_offset = offset;
     utf8lex_location_t grapheme_loc[UTF8LEX_UNIT_MAX];  // Unitialized is fine.
     int32_t codepoint = (int32_t) -1;
     utf8lex_cat_t cat = UTF8LEX_CAT_NONE;
+    state->buffer = buffer;
     utf8lex_error_t error = utf8lex_read_grapheme(
         state,  // state, including absolute locations.
         &grapheme_offset,  // start byte, relative to start of buffer string.
@@ -178,14 +246,24 @@ static utf8lex_error_t utf8lex_lex_cat(
         &codepoint,  // codepoint
         &cat  //cat
         );
+    // If the grapheme straddled buffers, utf8lex_read_grapheme() moved
+    // the state on to the buffer it ended in:
+    utf8lex_buffer_t *grapheme_buffer = state->buffer;
+    state->buffer = start_buffer;
 
     if (error == UTF8LEX_MORE)
     {
+      // The grapheme might carry on in bytes that haven't been read yet.
+      utf8lex_state_save_resume(state,  // self
+                                rule,  // rule
+                                (uint32_t) 0,  // step
+                                ug,  // count
+                                token_loc);  // loc
       return error;
     }
     else if (error != UTF8LEX_OK)
     {
-      if (ug < cat_definition->min)
+      if (ug < min)
       {
         return error;
       }
@@ -197,12 +275,12 @@ static utf8lex_error_t utf8lex_lex_cat(
       }
     }
 
-    if (cat_definition->cat & cat)
+    if (cat_mask & cat)
     {
       // A/the category we're looking for.
       error = UTF8LEX_OK;
     }
-    else if (ug < cat_definition->min)
+    else if (ug < min)
     {
       // Not the category we're looking for, and we haven't found
       // at least (min) graphemes matching this category, so fail
@@ -219,7 +297,19 @@ static utf8lex_error_t utf8lex_lex_cat(
     // We found another grapheme of the expected cat.
     // Keep looking for more matches for this token,
     // until we hit the max.
+    for (utf8lex_buffer_t *skipped = buffer;
+         skipped != grapheme_buffer;
+         skipped = skipped->next)
+    {
+      grapheme_offset -= (off_t) skipped->str->length_bytes;
+    }
+    buffer = grapheme_buffer;
     offset = grapheme_offset;
+    // Hash of the bytes so far, followed by the grapheme's bytes:
+    uint64_t hash = utf8lex_hash_concat(
+        token_loc[UTF8LEX_UNIT_BYTE].hash,  // hash1
+        grapheme_loc[UTF8LEX_UNIT_BYTE].hash,  // hash2
+        (uint64_t) grapheme_loc[UTF8LEX_UNIT_BYTE].length);  // length2_bytes
     for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
          unit < UTF8LEX_UNIT_MAX;
          unit ++)
@@ -229,8 +319,8 @@ static utf8lex_error_t utf8lex_lex_cat(
       token_loc[unit].length += grapheme_loc[unit].length;
       // Possible resets to char, grapheme position due to newlines:
       token_loc[unit].after = grapheme_loc[unit].after;
-      // Hash of the grapheme (unsigned long, can wrap to 0):
-      token_loc[unit].hash = grapheme_loc[unit].hash;
+      // Hash of the bytes so far (lines are not hashed):
+      token_loc[unit].hash = (unit == UTF8LEX_UNIT_LINE) ? (uint64_t) 0 : hash;
     }
   }
 
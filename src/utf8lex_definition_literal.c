@@ -17,7 +17,7 @@
  */
 
 #include <stdio.h>
-#include <inttypes.h>  // For int32_t.
+#include <inttypes.h>  // For int32_t, int64_t, PRId64.
 #include <stdbool.h>  // For bool, true, false.
 #include <string.h>  // For strlen(), memcpy().
 
@@ -28,46 +28,23 @@
 //                      utf8lex_literal_definition_t
 // ---------------------------------------------------------------------
 
-utf8lex_error_t utf8lex_literal_definition_init(
-        utf8lex_literal_definition_t *self,
-        utf8lex_definition_t *prev,  // Previous definition in DB, or NULL.
-        unsigned char *name,  // Usually all uppercase name of definition.
-        unsigned char *str
+// Counts the bytes, chars, graphemes, lines and so on in the literal,
+// advancing by grapheme or by codepoint:
+static utf8lex_error_t utf8lex_literal_count(
+        unsigned char *str,
+        size_t num_bytes,
+        utf8lex_granularity_t granularity,
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX]  // Mutable.
         )
 {
-  if (self == NULL
-      || name == NULL
-      || str == NULL)
-  {
-    return UTF8LEX_ERROR_NULL_POINTER;
-  }
-  else if (prev != NULL
-           && prev->next != NULL)
-  {
-    return UTF8LEX_ERROR_CHAIN_INSERT;
-  }
-
-  size_t num_bytes = strlen(str);
-  if (num_bytes == (size_t) 0)
-  {
-    return UTF8LEX_ERROR_EMPTY_DEFINITION;
-  }
-
-  self->base.definition_type = UTF8LEX_DEFINITION_TYPE_LITERAL;
-  self->base.name = name;
-  self->base.next = NULL;
-  self->base.prev = prev;
-  self->str = str;
-
-  // We know how many bytes the ltieral is.
-  // Now we'll now use utf8proc to count how many characters,
-  // graphemes, lines, etc. are in the matching region.
+  // Use utf8proc to count how many characters, graphemes, lines, etc.
+  // are in the literal.
 
   utf8lex_string_t utf8lex_str;
   utf8lex_string_init(&utf8lex_str,  // self
                       num_bytes,     // max_length_bytes
                       num_bytes,     // length_bytes
-                      self->str);    // bytes
+                      str);          // bytes
   utf8lex_buffer_t buffer;
   utf8lex_buffer_init(&buffer,       // self
                       NULL,          // prev
@@ -76,6 +53,11 @@ utf8lex_error_t utf8lex_literal_definition_init(
   utf8lex_state_t state;
   utf8lex_state_init(&state,         // self
                      &buffer);       // buffer
+  // Count every unit, including the optional ones, once and for all:
+  utf8lex_state_set_units(&state,    // self
+                          UTF8LEX_UNITS_ALL);  // units
+  utf8lex_state_set_granularity(&state,  // self
+                                granularity);  // granularity
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
@@ -83,7 +65,7 @@ utf8lex_error_t utf8lex_literal_definition_init(
     state.loc[unit].start = 0;
     state.loc[unit].length = 0;
     state.loc[unit].after = -1;
-    state.loc[unit].hash = (unsigned long) 0;
+    state.loc[unit].hash = (uint64_t) 0;
   }
 
   off_t offset = (off_t) 0;
@@ -92,14 +74,15 @@ utf8lex_error_t utf8lex_literal_definition_init(
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
   {
-    literal_loc[unit].start = (int) 0;
-    literal_loc[unit].length = (int) 0;
-    literal_loc[unit].after = (int) -1;  // No reset.
+    literal_loc[unit].start = (int64_t) 0;
+    literal_loc[unit].length = (int64_t) 0;
+    literal_loc[unit].after = (int64_t) -1;  // No reset.
+    literal_loc[unit].hash = (uint64_t) 0;
   }
 
   // Keep reading graphemes until we've reached the end of the literal string:
   for (int ug = 0;
-       literal_loc[UTF8LEX_UNIT_BYTE].length < (int) num_bytes;
+       literal_loc[UTF8LEX_UNIT_BYTE].length < (int64_t) num_bytes;
        ug ++)
   {
     // Read in one UTF-8 grapheme cluster per loop iteration:
@@ -125,6 +108,11 @@ utf8lex_error_t utf8lex_literal_definition_init(
     // We found another grapheme inside the literal string.
     // Keep looking for more graphemes inside the literal string.
     offset = grapheme_offset;
+    // Hash of the bytes so far, followed by the grapheme's bytes:
+    uint64_t hash = utf8lex_hash_concat(
+        literal_loc[UTF8LEX_UNIT_BYTE].hash,  // hash1
+        grapheme_loc[UTF8LEX_UNIT_BYTE].hash,  // hash2
+        (uint64_t) grapheme_loc[UTF8LEX_UNIT_BYTE].length);  // length2_bytes
     for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
          unit < UTF8LEX_UNIT_MAX;
          unit ++)
@@ -134,16 +122,16 @@ utf8lex_error_t utf8lex_literal_definition_init(
       literal_loc[unit].length += grapheme_loc[unit].length;
       // Possible resets to char, grapheme position due to newlines:
       literal_loc[unit].after = grapheme_loc[unit].after;
-      // Hash of the grapheme (unsigned long, can wrap to 0):
-      literal_loc[unit].hash = grapheme_loc[unit].hash;
+      // Hash of the bytes so far (lines are not hashed):
+      literal_loc[unit].hash = (unit == UTF8LEX_UNIT_LINE) ? (uint64_t) 0 : hash;
     }
   }
 
   // Check to make sure strlen and utf8proc agree on # bytes.  (They should.)
-  if (literal_loc[UTF8LEX_UNIT_BYTE].length != (int) num_bytes)
+  if (literal_loc[UTF8LEX_UNIT_BYTE].length != (int64_t) num_bytes)
   {
     fprintf(stderr,
-            "*** strlen and utf8proc disagree: strlen = %d vs utf8proc = %d\n",
+            "*** strlen and utf8proc disagree: strlen = %d vs utf8proc = %" PRId64 "\n",
             (int) num_bytes,
             literal_loc[UTF8LEX_UNIT_BYTE].length);
   }
@@ -152,10 +140,57 @@ utf8lex_error_t utf8lex_literal_definition_init(
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
   {
-    self->loc[unit].start = literal_loc[unit].start;
-    self->loc[unit].length = literal_loc[unit].length;
-    self->loc[unit].after = literal_loc[unit].after;
-    self->loc[unit].hash = literal_loc[unit].hash;
+    loc[unit].start = literal_loc[unit].start;
+    loc[unit].length = literal_loc[unit].length;
+    loc[unit].after = literal_loc[unit].after;
+    loc[unit].hash = literal_loc[unit].hash;
+  }
+
+  return UTF8LEX_OK;
+
+}
+
+utf8lex_error_t utf8lex_literal_definition_init(
+        utf8lex_literal_definition_t *self,
+        utf8lex_definition_t *prev,  // Previous definition in DB, or NULL.
+        unsigned char *name,  // Usually all uppercase name of definition.
+        unsigned char *str
+        )
+{
+  if (self == NULL
+      || name == NULL
+      || str == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (prev != NULL
+           && prev->next != NULL)
+  {
+    return UTF8LEX_ERROR_CHAIN_INSERT;
+  }
+
+  size_t num_bytes = strlen(str);
+  if (num_bytes == (size_t) 0)
+  {
+    return UTF8LEX_ERROR_EMPTY_DEFINITION;
+  }
+
+  self->base.definition_type = UTF8LEX_DEFINITION_TYPE_LITERAL;
+  self->base.name = name;
+  self->base.next = NULL;
+  self->base.prev = prev;
+  self->str = str;
+
+  // We know how many bytes the literal is.  Count everything else
+  // up front (by grapheme, see utf8lex_literal_locations()):
+  utf8lex_error_t error = utf8lex_literal_count(
+      self->str,  // str
+      num_bytes,  // num_bytes
+      UTF8LEX_GRANULARITY_GRAPHEME,  // granularity
+      self->loc);  // loc
+  if (error != UTF8LEX_OK)
+  {
+    return error;
   }
 
   if (self->base.prev == NULL)
@@ -217,6 +252,76 @@ utf8lex_error_t utf8lex_literal_definition_clear(
 }
 
 
+utf8lex_error_t utf8lex_literal_locations(
+        utf8lex_literal_definition_t *self,
+        utf8lex_granularity_t granularity,
+        utf8lex_location_t scratch[UTF8LEX_UNIT_MAX],  // Mutable.
+        utf8lex_location_t **loc_pointer  // Mutable.
+        )
+{
+  if (granularity != UTF8LEX_GRANULARITY_CODEPOINT
+      || self->loc[UTF8LEX_UNIT_GRAPHEME].length
+         == self->loc[UTF8LEX_UNIT_CHAR].length)
+  {
+    // Every grapheme in the literal is one codepoint, so it counts
+    // the same either way.
+    *loc_pointer = self->loc;
+    return UTF8LEX_OK;
+  }
+
+  // Only literals with graphemes of 2 or more codepoints, lexed
+  // by codepoint, are counted again, every time they match.
+  utf8lex_error_t error = utf8lex_literal_count(
+      self->str,  // str
+      (size_t) self->loc[UTF8LEX_UNIT_BYTE].length,  // num_bytes
+      UTF8LEX_GRANULARITY_CODEPOINT,  // granularity
+      scratch);  // loc
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  *loc_pointer = scratch;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_lex_literal_chain(
+        utf8lex_state_t *state,
+        unsigned char *literal_bytes,
+        size_t length_bytes
+        )
+{
+  utf8lex_buffer_t *buffer = state->buffer;
+  size_t offset = (size_t) buffer->loc[UTF8LEX_UNIT_BYTE].start;
+  for (size_t c = (size_t) 0; c < length_bytes; c ++)
+  {
+    while (offset >= buffer->str->length_bytes)
+    {
+      if (buffer->next == NULL)
+      {
+        // Not enough bytes to read the string.
+        // (It was matching for maybe a few bytes, anyway.)
+        return (buffer->is_eof == true)
+          ? UTF8LEX_NO_MATCH  // No more bytes can be read in, we're at EOF.
+          : UTF8LEX_MORE;  // Need to read more bytes for the full literal.
+      }
+
+      // The literal carries on into the next buffer:
+      buffer = buffer->next;
+      offset = (size_t) 0;
+    }
+
+    if (buffer->str->bytes[offset] != literal_bytes[c])
+    {
+      return UTF8LEX_NO_MATCH;
+    }
+    offset ++;
+  }
+
+  return UTF8LEX_OK;
+}
+
 static utf8lex_error_t utf8lex_lex_literal(
         utf8lex_rule_t *rule,
         utf8lex_state_t *state,
@@ -259,33 +364,52 @@ static utf8lex_error_t utf8lex_lex_literal(
 
   if (remaining_bytes < token_length_bytes)
   {
-    // Not enough bytes to read the string.
-    // (It was matching for maybe a few bytes, anyway.)
-    if (state->buffer->is_eof)
-    {
-      // No more bytes can be read in, we're at EOF.
-      return UTF8LEX_NO_MATCH;
-    }
-    else
+    // The rest of the literal (if any) is in the next buffer(s).
+    utf8lex_error_t error = utf8lex_lex_literal_chain(
+        state,  // state
+        literal->str,  // literal_bytes
+        token_length_bytes);  // length_bytes
+    if (error != UTF8LEX_OK)
     {
-      // Need to read more bytes for the full grapheme.
-      return UTF8LEX_MORE;
+      return error;
     }
   }
 
   // Matched the literal exactly.
+  utf8lex_location_t codepoint_loc[UTF8LEX_UNIT_MAX];
+  utf8lex_location_t *literal_loc = NULL;
+  utf8lex_error_t error = utf8lex_literal_locations(
+      literal,  // self
+      state->granularity,  // granularity
+      codepoint_loc,  // scratch
+      &literal_loc);  // loc_pointer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
   utf8lex_location_t token_loc[UTF8LEX_UNIT_MAX];
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
   {
+    // The literal's optional units were all counted up front,
+    // but only the units that the state counts are kept:
+    bool is_counted = (state->units & ((uint32_t) 1 << unit))
+      ? true
+      : false;
     token_loc[unit].start = state->loc[unit].start;
-    token_loc[unit].length = literal->loc[unit].length;
-    token_loc[unit].after = literal->loc[unit].after;  // -1 or new location.
-    token_loc[unit].hash = literal->loc[unit].hash;
+    token_loc[unit].length = (is_counted == true)
+      ? literal_loc[unit].length
+      : (int64_t) 0;
+    token_loc[unit].after = (is_counted == true)
+      ? literal_loc[unit].after  // -1 or new location.
+      : (int64_t) -1;
+    token_loc[unit].hash = (is_counted == true)
+      ? literal_loc[unit].hash
+      : (uint64_t) 0;
   }
 
-  utf8lex_error_t error = utf8lex_token_init(
+  error = utf8lex_token_init(
       token_pointer,  // self
       rule,  // rule
       rule->definition,  // definition
@@ -213,7 +213,8 @@ utf8lex_error_t utf8lex_multi_definition_init(
         utf8lex_definition_t *prev,  // Previous definition in DB, or NULL.
         unsigned char *name,  // Usually all uppercase name of definition.
         utf8lex_multi_definition_t *parent,  // Parent or NULL.
-        utf8lex_multi_type_t multi_type  // Sequence or ORed references, etc.
+        utf8lex_multi_type_t multi_type,  // Sequence or ORed references, etc.
+        bool is_longest  // OR only: true = longest alternative, false = first.
         )
 {
   if (self == NULL
@@ -231,6 +232,11 @@ utf8lex_error_t utf8lex_multi_definition_init(
   {
     return UTF8LEX_ERROR_BAD_MULTI_TYPE;
   }
+  else if (is_longest == true
+           && multi_type != UTF8LEX_MULTI_TYPE_OR)
+  {
+    return UTF8LEX_ERROR_BAD_MULTI_TYPE;
+  }
 
   self->base.definition_type = UTF8LEX_DEFINITION_TYPE_MULTI;
   self->base.name = name;
@@ -238,6 +244,7 @@ utf8lex_error_t utf8lex_multi_definition_init(
   self->base.prev = prev;
 
   self->multi_type = multi_type;
+  self->is_longest = is_longest;
   self->references = NULL;  // Empty to start.  We'll add references here.
   self->db = NULL;  // Empty to start.  We'll add | multi-definitions here.
 
@@ -367,6 +374,7 @@ utf8lex_error_t utf8lex_multi_definition_clear(
   multi_definition->base.id = (uint32_t) 0;
   multi_definition->base.name = NULL;
 
+  multi_definition->is_longest = false;
   multi_definition->references = NULL;
   multi_definition->db = NULL;
 
@@ -491,6 +499,42 @@ static utf8lex_error_t utf8lex_lex_multi(
     return UTF8LEX_ERROR_EMPTY_DEFINITION;
   }
 
+  return utf8lex_lex_multi_unchecked(
+      rule,  // rule
+      multi,  // multi
+      state,  // state
+      token_pointer);  // token_pointer
+}
+
+// Once the children have matched past the end of multi_buffer's str,
+// multi_buffer carries on in the next buffer of the state's chain,
+// the same way utf8lex_lex_advance() moves the state's buffer along
+// (but without touching the state's own buffers).
+static inline void utf8lex_multi_buffer_follow(
+        utf8lex_buffer_t *multi_buffer
+        )
+{
+  while (multi_buffer->loc[UTF8LEX_UNIT_BYTE].start
+         >= (int64_t) multi_buffer->str->length_bytes
+         && multi_buffer->next != NULL)
+  {
+    multi_buffer->loc[UTF8LEX_UNIT_BYTE].start -=
+      (int64_t) multi_buffer->str->length_bytes;
+    multi_buffer->str = multi_buffer->next->str;
+    multi_buffer->is_eof = multi_buffer->next->is_eof;
+    multi_buffer->next = multi_buffer->next->next;
+  }
+}
+
+// Called by utf8lex_lex_multi() and by compiled programs
+// (utf8lex_program_lex()), which have already checked their arguments.
+utf8lex_error_t utf8lex_lex_multi_unchecked(
+        utf8lex_rule_t *rule,
+        utf8lex_multi_definition_t *multi,  // The rule's multi-definition.
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
   // We need to push our own state, and pop on either success or error,
   // so that we do not update the state's location until
   // the entire multi-definition has been completely matched.
@@ -500,10 +544,31 @@ static utf8lex_error_t utf8lex_lex_multi(
                                               NULL,  // prev
                                               state->buffer->str,  // str
                                               state->buffer->is_eof);  // is_eof
+  // The children read on through the rest of the state's chain:
+  multi_buffer.next = state->buffer->next;
   error = utf8lex_state_init(&multi_state,  // self
                              &multi_buffer);  // buffer
+  // Child tokens track the same locations as the state being lexed:
+  multi_state.location_mode = state->location_mode;
+  multi_state.units = state->units;
+  multi_state.granularity = state->granularity;
+  // The alternatives of an OR all read from where this multi-definition
+  // starts, so they share one cache of decoded graphemes (as do any
+  // multi-definitions nested inside them):
+  utf8lex_grapheme_cache_t grapheme_cache;
+  multi_state.grapheme_cache = state->grapheme_cache;
+  if (multi_state.grapheme_cache == NULL
+      && multi->multi_type == UTF8LEX_MULTI_TYPE_OR
+      && multi->references != NULL
+      && multi->references->next != NULL)
+  {
+    error = utf8lex_grapheme_cache_init(&grapheme_cache);
+    multi_state.grapheme_cache = &grapheme_cache;
+  }
 
   utf8lex_location_t sequence_loc[UTF8LEX_UNIT_MAX];
+  // For ORs: the location of the best matching alternative so far.
+  utf8lex_location_t or_loc[UTF8LEX_UNIT_MAX];
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
@@ -511,24 +576,63 @@ static utf8lex_error_t utf8lex_lex_multi(
     multi_state.loc[unit].start = state->loc[unit].start;
     multi_state.loc[unit].length = 0;
     multi_state.loc[unit].after = -1;
-    multi_state.loc[unit].hash = (unsigned long) 0;
+    multi_state.loc[unit].hash = (uint64_t) 0;
 
     multi_buffer.loc[unit].start = state->buffer->loc[unit].start;
     multi_buffer.loc[unit].length = 0;
     multi_buffer.loc[unit].after = -1;
-    multi_buffer.loc[unit].hash = (unsigned long) 0;
+    multi_buffer.loc[unit].hash = (uint64_t) 0;
 
     sequence_loc[unit].start = state->loc[unit].start;
-    sequence_loc[unit].length = (int) 0;
-    sequence_loc[unit].after = (int) -1;  // No reset after token.
-    sequence_loc[unit].hash = (unsigned long) 0;
+    sequence_loc[unit].length = (int64_t) 0;
+    sequence_loc[unit].after = (int64_t) -1;  // No reset after token.
+    sequence_loc[unit].hash = (uint64_t) 0;
   }
 
   utf8lex_reference_t *reference = multi->references;
   uint32_t infinite_loop = UTF8LEX_REFERENCES_LENGTH_MAX;
   bool is_infinite_loop = true;
   utf8lex_definition_t *matching_definition = NULL;
-  for (uint32_t r = 0; r < infinite_loop; r ++)
+
+  // If this sequence ran out of bytes part way through this token
+  // last time, skip the references it already matched, and carry on
+  // from the repetition where it stopped:
+  uint32_t first_r = (uint32_t) 0;
+  int64_t first_m = (int64_t) 0;
+  if (state->resume.rule == rule
+      && multi->multi_type == UTF8LEX_MULTI_TYPE_SEQUENCE
+      && utf8lex_state_take_resume(state,  // self
+                                   rule,  // rule
+                                   &first_r,  // step_pointer
+                                   &first_m,  // count_pointer
+                                   sequence_loc)  // loc
+         == UTF8LEX_OK)
+  {
+    for (uint32_t r = (uint32_t) 0; r < first_r && reference != NULL; r ++)
+    {
+      reference = reference->next;
+    }
+    if (first_r > (uint32_t) 0)
+    {
+      // Tied to the first definition in the sequence, same as below.
+      matching_definition = multi->references->definition_or_null;
+    }
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      multi_buffer.loc[unit].start += sequence_loc[unit].length;
+      multi_buffer.loc[unit].after = sequence_loc[unit].after;
+      multi_buffer.loc[unit].hash = sequence_loc[unit].hash;
+
+      multi_state.loc[unit].start += sequence_loc[unit].length;
+      multi_state.loc[unit].after = sequence_loc[unit].after;
+      multi_state.loc[unit].hash = sequence_loc[unit].hash;
+    }
+    utf8lex_multi_buffer_follow(&multi_buffer);
+  }
+
+  for (uint32_t r = first_r; r < infinite_loop; r ++)
   {
     if (reference == NULL)
     {
@@ -562,7 +666,7 @@ static utf8lex_error_t utf8lex_lex_multi(
       max = (int) UTF8LEX_REFERENCES_LENGTH_MAX;
     }
     int m;
-    for (m = 0; m < max; m ++)
+    for (m = (int) first_m; m < max; m ++)
     {
       error = definition->definition_type->lex(
           &child_rule,
@@ -572,49 +676,121 @@ static utf8lex_error_t utf8lex_lex_multi(
       {
         break;
       }
+      else if (error == UTF8LEX_MORE
+               && multi->multi_type == UTF8LEX_MULTI_TYPE_SEQUENCE)
+      {
+        // Next time, start over from this reference and repetition.
+        utf8lex_state_save_resume(state,  // self
+                                  rule,  // rule
+                                  r,  // step
+                                  (int64_t) m,  // count
+                                  sequence_loc);  // loc
+        return error;
+      }
       else if (error != UTF8LEX_OK)
       {
         return error;
       }
 
+      // Hash of the sequence so far, followed by the child token's bytes:
+      uint64_t hash = utf8lex_hash_concat(
+          sequence_loc[UTF8LEX_UNIT_BYTE].hash,  // hash1
+          child_token.loc[UTF8LEX_UNIT_BYTE].hash,  // hash2
+          (uint64_t) child_token.loc[UTF8LEX_UNIT_BYTE].length);  // length2_bytes
       for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
            unit < UTF8LEX_UNIT_MAX;
            unit ++)
       {
+        // Lines are not hashed:
+        uint64_t unit_hash = (unit == UTF8LEX_UNIT_LINE) ? (uint64_t) 0 : hash;
+
         multi_buffer.loc[unit].start += child_token.loc[unit].length;
         multi_buffer.loc[unit].length = 0;
         multi_buffer.loc[unit].after = child_token.loc[unit].after;
-        multi_buffer.loc[unit].hash
-          <<= (8 * child_token.loc[UTF8LEX_UNIT_BYTE].length);
-        multi_buffer.loc[unit].hash |= child_token.loc[unit].hash;
+        multi_buffer.loc[unit].hash = unit_hash;
 
         multi_state.loc[unit].start += child_token.loc[unit].length;
         multi_state.loc[unit].length = 0;
         multi_state.loc[unit].after = child_token.loc[unit].after;
-        multi_state.loc[unit].hash
-          <<= (8 * child_token.loc[UTF8LEX_UNIT_BYTE].length);
-        multi_state.loc[unit].hash |= child_token.loc[unit].hash;
+        multi_state.loc[unit].hash = unit_hash;
 
         sequence_loc[unit].length += child_token.loc[unit].length;
         sequence_loc[unit].after = child_token.loc[unit].after;
-        sequence_loc[unit].hash
-          <<= (8 * child_token.loc[UTF8LEX_UNIT_BYTE].length);
-        sequence_loc[unit].hash |= child_token.loc[unit].hash;
+        sequence_loc[unit].hash = unit_hash;
       }
+      utf8lex_multi_buffer_follow(&multi_buffer);
     }
 
+    first_m = (int64_t) 0;
+
     if (m == UTF8LEX_REFERENCES_LENGTH_MAX)
     {
       return UTF8LEX_ERROR_INFINITE_LOOP;
     }
-    else if (m < reference->min
-             && multi->multi_type == UTF8LEX_MULTI_TYPE_OR)
+    else if (multi->multi_type == UTF8LEX_MULTI_TYPE_OR)
     {
-      // Carry on searching for a definition that matches the incoming text.
-      if (reference->next == NULL)
+      if (m >= reference->min
+          && (matching_definition == NULL
+              || sequence_loc[UTF8LEX_UNIT_BYTE].length
+                 > or_loc[UTF8LEX_UNIT_BYTE].length))
+      {
+        // Best alternative so far (ties go to the earliest alternative).
+        matching_definition = definition;
+        for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+             unit < UTF8LEX_UNIT_MAX;
+             unit ++)
+        {
+          or_loc[unit].start = sequence_loc[unit].start;
+          or_loc[unit].length = sequence_loc[unit].length;
+          or_loc[unit].after = sequence_loc[unit].after;
+          or_loc[unit].hash = sequence_loc[unit].hash;
+        }
+
+        // First match wins, unless we're looking for the longest match.
+        // Even then, once one alternative has consumed every remaining
+        // byte of the final buffer, no other alternative can beat it.
+        size_t remaining_bytes = state->buffer->str->length_bytes
+          - (size_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
+        utf8lex_buffer_t *tail = state->buffer;
+        while (tail->next != NULL)
+        {
+          tail = tail->next;
+          remaining_bytes += tail->str->length_bytes;
+        }
+        if (multi->is_longest == false
+            || (tail->is_eof == true
+                && (size_t) or_loc[UTF8LEX_UNIT_BYTE].length
+                   >= remaining_bytes))
+        {
+          is_infinite_loop = false;
+          break;
+        }
+      }
+
+      // Carry on searching for a definition that matches the incoming text
+      // (or for a longer match).  The next alternative starts over from
+      // where this multi-definition started (multi_state and multi_buffer
+      // are rewound), but the graphemes it reads that an earlier
+      // alternative already decoded come out of multi_state's cache.
+      for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+           unit < UTF8LEX_UNIT_MAX;
+           unit ++)
       {
-        return UTF8LEX_NO_MATCH;
+        multi_state.loc[unit].start = sequence_loc[unit].start;
+        multi_state.loc[unit].after = -1;
+        multi_state.loc[unit].hash = (uint64_t) 0;
+
+        multi_buffer.loc[unit].start = state->buffer->loc[unit].start;
+        multi_buffer.loc[unit].after = -1;
+        multi_buffer.loc[unit].hash = (uint64_t) 0;
+
+        sequence_loc[unit].length = (int64_t) 0;
+        sequence_loc[unit].after = (int64_t) -1;
+        sequence_loc[unit].hash = (uint64_t) 0;
       }
+      multi_buffer.str = state->buffer->str;
+      multi_buffer.is_eof = state->buffer->is_eof;
+      multi_buffer.next = state->buffer->next;
 
       reference = reference->next;
       continue;
@@ -623,12 +799,6 @@ static utf8lex_error_t utf8lex_lex_multi(
     {
       return UTF8LEX_NO_MATCH;
     }
-    else if (multi->multi_type == UTF8LEX_MULTI_TYPE_OR)
-    {
-      is_infinite_loop = false;
-      matching_definition = definition;
-      break;
-    }
     else if (multi->multi_type == UTF8LEX_MULTI_TYPE_SEQUENCE)
     {
       if (matching_definition == NULL)
@@ -647,11 +817,30 @@ static utf8lex_error_t utf8lex_lex_multi(
   {
     return UTF8LEX_ERROR_INFINITE_LOOP;
   }
+  else if (matching_definition == NULL
+           && multi->multi_type == UTF8LEX_MULTI_TYPE_OR)
+  {
+    // None of the alternatives matched.
+    return UTF8LEX_NO_MATCH;
+  }
   else if (matching_definition == NULL)
   {
     return UTF8LEX_ERROR_STATE;
   }
 
+  if (multi->multi_type == UTF8LEX_MULTI_TYPE_OR)
+  {
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      sequence_loc[unit].start = or_loc[unit].start;
+      sequence_loc[unit].length = or_loc[unit].length;
+      sequence_loc[unit].after = or_loc[unit].after;
+      sequence_loc[unit].hash = or_loc[unit].hash;
+    }
+  }
+
   // Matched the multi-definition references exactly.
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
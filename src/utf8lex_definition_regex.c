@@ -17,7 +17,9 @@
  */
 
 #include <stdio.h>
-#include <inttypes.h>  // For uint32_t, int32_t.
+#include <inttypes.h>  // For uint32_t, int32_t, int64_t, PRId64.
+#include <string.h>  // For memcpy().
+#include <sys/mman.h>  // For mmap(), munmap().
 
 // 8-bit character units for pcre2:
 #define PCRE2_CODE_UNIT_WIDTH 8
@@ -88,6 +90,7 @@ utf8lex_error_t utf8lex_regex_definition_init(
   self->base.next = NULL;
   self->base.prev = prev;
   self->pattern = pattern;
+  self->num_captures = 0;  // Opt in with utf8lex_regex_definition_set_captures()
 
   if (self->base.prev == NULL)
   {
@@ -141,6 +144,34 @@ utf8lex_error_t utf8lex_regex_definition_clear(
   regex_definition->base.name = NULL;
   regex_definition->pattern = NULL;
   regex_definition->regex = NULL;
+  regex_definition->num_captures = 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_regex_definition_set_captures(
+        utf8lex_regex_definition_t *self,
+        int num_captures  // 0 <= num_captures <= UTF8LEX_CAPTURES_MAX.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->base.definition_type != UTF8LEX_DEFINITION_TYPE_REGEX)
+  {
+    return UTF8LEX_ERROR_DEFINITION_TYPE;
+  }
+  else if (num_captures < 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  else if (num_captures > UTF8LEX_CAPTURES_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  self->num_captures = num_captures;
 
   return UTF8LEX_OK;
 }
@@ -169,6 +200,60 @@ static utf8lex_error_t utf8lex_lex_regex(
     return UTF8LEX_ERROR_DEFINITION_TYPE;
   }
 
+  utf8lex_regex_definition_t *regex_definition =
+    (utf8lex_regex_definition_t *) rule->definition;
+  if (regex_definition->regex == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (regex_definition->num_captures < 0
+           || regex_definition->num_captures > UTF8LEX_CAPTURES_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  return utf8lex_lex_regex_unchecked(
+      rule,  // rule
+      regex_definition->regex,  // regex
+      regex_definition->num_captures,  // num_captures
+      state,  // state
+      token_pointer);  // token_pointer
+}
+
+// Frees the match data, unless it is the state's (reusable) match data.
+static inline void utf8lex_regex_match_free(
+        utf8lex_state_t *state,
+        pcre2_match_data *match
+        )
+{
+  if (match != state->match_data)
+  {
+    pcre2_match_data_free(match);
+  }
+}
+
+// Unmaps the stitched window, unless it is on the stack (map_bytes 0).
+static inline void utf8lex_regex_window_free(
+        unsigned char *window,
+        size_t map_bytes
+        )
+{
+  if (map_bytes > (size_t) 0)
+  {
+    munmap(window, map_bytes);
+  }
+}
+
+// Called by utf8lex_lex_regex() and by compiled programs
+// (utf8lex_program_lex()), which have already checked their arguments.
+utf8lex_error_t utf8lex_lex_regex_unchecked(
+        utf8lex_rule_t *rule,
+        pcre2_code *regex,  // The compiled regular expression.
+        int num_captures,  // 0 <= num_captures <= UTF8LEX_CAPTURES_MAX.
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
   off_t offset = (off_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
   size_t remaining_bytes = state->buffer->str->length_bytes - (size_t) offset;
 
@@ -177,17 +262,22 @@ static utf8lex_error_t utf8lex_lex_regex(
   //
   // For differences between the traditional and "DFA" algorithms, see:
   // https://pcre2project.github.io/pcre2/doc/html/pcre2matching.html
-  pcre2_match_data *match = pcre2_match_data_create(
-      1,  // ovecsize.  We only care about the whole match, not sub-groups.
-      NULL);  // gcontext.
+  //
+  // The state's match data is reused if it has one (see utf8lex_session_t),
+  // otherwise match data is created (and freed) for this match only.
+  pcre2_match_data *match = state->match_data;
   if (match == NULL)
   {
-    return UTF8LEX_ERROR_STATE;
+    match = pcre2_match_data_create(
+        // ovecsize: the whole match, plus any sub-groups we've opted into.
+        (uint32_t) 1 + (uint32_t) num_captures,
+        NULL);  // gcontext.
+    if (match == NULL)
+    {
+      return UTF8LEX_ERROR_STATE;
+    }
   }
 
-  utf8lex_regex_definition_t *regex_definition =
-    (utf8lex_regex_definition_t *) rule->definition;
-
   // Match options:
   // https://pcre2project.github.io/pcre2/doc/html/pcre2api.html#matchoptions
   //     PCRE2_ANCHORED
@@ -221,34 +311,132 @@ static utf8lex_error_t utf8lex_lex_regex(
   //     an empty string at the start of the subject. With PCRE2_NOTEMPTY set,
   //     this match is not valid, so pcre2_match() searches further
   //     into the string for occurrences of "a" or "b".
+  //     PCRE2_PARTIAL_HARD
+  //     If the subject string runs out before the match is complete,
+  //     or before it can tell that the match could not be longer,
+  //     return PCRE2_ERROR_PARTIAL instead of a (shorter) match.
+  //     Only used when there are (or might be) more bytes after
+  //     this buffer.
+  utf8lex_buffer_t *buffer = state->buffer;
+  bool is_more = (buffer->next != NULL || buffer->is_eof == false)
+    ? true
+    : false;
+  uint32_t options = (uint32_t) PCRE2_ANCHORED;
+  if (is_more == true)
+  {
+    options |= (uint32_t) PCRE2_PARTIAL_HARD;
+  }
+
+  // The subject, and where the token starts in it: the buffer's own
+  // bytes, unless the token carries on into the next buffer(s).
+  unsigned char *subject = buffer->str->bytes;
+  size_t subject_length_bytes = buffer->str->length_bytes;
+  off_t subject_offset = offset;
   int pcre2_error = pcre2_match(
-      regex_definition->regex,  // The pcre2_code (compiled regex).
-      (PCRE2_SPTR) state->buffer->str->bytes,  // subject
-      (PCRE2_SIZE) state->buffer->str->length_bytes,  // length
-      (PCRE2_SIZE) offset,  // startoffset
-      (uint32_t) PCRE2_ANCHORED,  // options (see above)
+      regex,  // The pcre2_code (compiled regex).
+      (PCRE2_SPTR) subject,  // subject
+      (PCRE2_SIZE) subject_length_bytes,  // length
+      (PCRE2_SIZE) subject_offset,  // startoffset
+      options,  // options (see above)
       match,  // match_data
       (pcre2_match_context *) NULL);  // NULL means use defaults.
 
+  // Bytes from the end of this buffer and the start of the next one(s),
+  // stitched together, only for a match that runs off the end.
+  // The window holds every byte in the chain from the token on, so
+  // a token is never too long to stitch: small windows are stitched
+  // on the stack, bigger ones in memory mapped for this match only.
+  unsigned char stack_window[UTF8LEX_REGEX_WINDOW_MAX];
+  unsigned char *window = stack_window;
+  size_t window_map_bytes = (size_t) 0;
+  if (pcre2_error == PCRE2_ERROR_PARTIAL
+      && buffer->next != NULL)
+  {
+    // Copy any bytes that lookbehinds might need, then the token
+    // so far, then the next buffer(s):
+    uint32_t max_lookbehind = (uint32_t) 0;
+    pcre2_pattern_info(regex,  // code
+                       PCRE2_INFO_MAXLOOKBEHIND,  // what
+                       &max_lookbehind);  // where
+    // (Lookbehinds are measured in characters, not bytes.)
+    off_t lookbehind_bytes = (off_t) max_lookbehind
+      * (off_t) UTF8LEX_MAX_BYTES_PER_CHAR;
+    if (lookbehind_bytes > offset)
+    {
+      lookbehind_bytes = offset;
+    }
+    size_t window_buffer_offset = (size_t) (offset - lookbehind_bytes);
+    size_t window_max_bytes =
+      buffer->str->length_bytes - window_buffer_offset;
+    utf8lex_buffer_t *last_buffer = buffer;
+    while (last_buffer->next != NULL)
+    {
+      last_buffer = last_buffer->next;
+      window_max_bytes += last_buffer->str->length_bytes;
+    }
+
+    if (window_max_bytes > (size_t) UTF8LEX_REGEX_WINDOW_MAX)
+    {
+      void *mapped = mmap(NULL,  // addr
+                          window_max_bytes,  // length
+                          PROT_READ | PROT_WRITE,  // prot
+                          MAP_PRIVATE | MAP_ANONYMOUS,  // flags
+                          -1,  // fd
+                          (off_t) 0);  // offset
+      if (mapped == MAP_FAILED)
+      {
+        utf8lex_regex_match_free(state, match);
+        return UTF8LEX_ERROR_FILE_MMAP;
+      }
+      window = (unsigned char *) mapped;
+      window_map_bytes = window_max_bytes;
+    }
+
+    size_t window_length_bytes = (size_t) 0;
+    for (utf8lex_buffer_t *window_buffer = buffer;
+         window_buffer != NULL;
+         window_buffer = window_buffer->next)
+    {
+      size_t num_bytes = window_buffer->str->length_bytes
+        - window_buffer_offset;
+      memcpy(&(window[window_length_bytes]),
+             &(window_buffer->str->bytes[window_buffer_offset]),
+             num_bytes);
+      window_length_bytes += num_bytes;
+      window_buffer_offset = (size_t) 0;
+    }
+
+    options = (uint32_t) PCRE2_ANCHORED;
+    if (last_buffer->is_eof == false)
+    {
+      options |= (uint32_t) PCRE2_PARTIAL_HARD;
+    }
+
+    subject = window;
+    subject_length_bytes = window_length_bytes;
+    subject_offset = lookbehind_bytes;
+    pcre2_error = pcre2_match(
+        regex,  // The pcre2_code (compiled regex).
+        (PCRE2_SPTR) subject,  // subject
+        (PCRE2_SIZE) subject_length_bytes,  // length
+        (PCRE2_SIZE) subject_offset,  // startoffset
+        options,  // options (see above)
+        match,  // match_data
+        (pcre2_match_context *) NULL);  // NULL means use defaults.
+  }
+
   if (pcre2_error == PCRE2_ERROR_NOMATCH)
   {
-    pcre2_match_data_free(match);
+    utf8lex_regex_match_free(state, match);
+    utf8lex_regex_window_free(window, window_map_bytes);
     return UTF8LEX_NO_MATCH;
   }
   else if (pcre2_error == PCRE2_ERROR_PARTIAL)
   {
-    pcre2_match_data_free(match);
-    if (state->buffer->is_eof)
-    {
-      // No more bytes can be read in, we're at EOF.
-      // Bad UTF-8 character at the end of the buffer.
-      return UTF8LEX_ERROR_BAD_UTF8;
-    }
-    else
-    {
-      // Need to read more bytes for the full grapheme.
-      return UTF8LEX_MORE;
-    }
+    // The match might carry on in bytes that haven't been read yet.
+    utf8lex_regex_match_free(state, match);
+    utf8lex_regex_window_free(window, window_map_bytes);
+    return UTF8LEX_MORE;
   }
   // Negative number indicates error:
   // https://pcre2project.github.io/pcre2/doc/html/pcre2api.html#SEC32
@@ -262,14 +450,16 @@ static utf8lex_error_t utf8lex_lex_regex(
     fprintf(stderr, "*** ut8flex: pcre2 regex match error: %s\n",
             pcre2_error_message);
     fflush(stderr);
-    pcre2_match_data_free(match);
+    utf8lex_regex_match_free(state, match);
+    utf8lex_regex_window_free(window, window_map_bytes);
     return UTF8LEX_ERROR_REGEX;
   }
 
   uint32_t num_ovectors = pcre2_get_ovector_count(match);
   if (num_ovectors == (uint32_t) 0)
   {
-    pcre2_match_data_free(match);
+    utf8lex_regex_match_free(state, match);
+    utf8lex_regex_window_free(window, window_map_bytes);
     return UTF8LEX_ERROR_REGEX;
   }
 
@@ -282,20 +472,53 @@ static utf8lex_error_t utf8lex_lex_regex(
       &pcre2_match_length_bytes);
   size_t match_length_bytes = (size_t) pcre2_match_length_bytes;
 
-  pcre2_match_data_free(match);
+  // Copy out the capture groups (if any) before the match data is freed.
+  // Groups that did not participate in the match are left unset.
+  utf8lex_capture_t captures[UTF8LEX_CAPTURES_MAX];
+  PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(match);
+  for (int c = 0; c < num_captures; c ++)
+  {
+    uint32_t ov = (uint32_t) (c + 1);
+    if (ov >= num_ovectors
+        || ovector[2 * ov] == PCRE2_UNSET
+        || ovector[(2 * ov) + 1] == PCRE2_UNSET)
+    {
+      captures[c].start_byte = -1;
+      captures[c].length_bytes = 0;
+    }
+    else
+    {
+      // Relative to the start of the buffer the token starts in,
+      // even if the match was stitched together in the window:
+      captures[c].start_byte = (int64_t) offset
+        + (int64_t) ovector[2 * ov]
+        - (int64_t) subject_offset;
+      captures[c].length_bytes =
+        (int64_t) (ovector[(2 * ov) + 1] - ovector[2 * ov]);
+    }
+  }
+
+  utf8lex_regex_match_free(state, match);
+
+  // Lazy locations hash the matched bytes straight from the subject
+  // (see utf8lex_hash_concat()), before the window goes away:
+  uint64_t lazy_hash = (uint64_t) 0;
+  if (state->location_mode == UTF8LEX_LOCATION_MODE_LAZY)
+  {
+    unsigned char *match_bytes = &(subject[subject_offset]);
+    for (size_t b = (size_t) 0; b < match_length_bytes; b ++)
+    {
+      lazy_hash *= UTF8LEX_HASH_PRIME;
+      lazy_hash += (uint64_t) match_bytes[b];
+    }
+  }
+  utf8lex_regex_window_free(window, window_map_bytes);
 
   if (match_length_bytes == (size_t) 0)
   {
     return UTF8LEX_NO_MATCH;
   }
 
-  PCRE2_UCHAR match_substring[256];
-  PCRE2_SIZE match_substring_length = 256;
-  pcre2_substring_copy_bynumber(match,
-                                (uint32_t) 0,
-                                match_substring,
-                                &match_substring_length);
-
   // Matched.
   //
   // We know how many bytes matched the regular expression.
@@ -307,21 +530,52 @@ static utf8lex_error_t utf8lex_lex_regex(
        unit ++)
   {
     token_loc[unit].start = state->loc[unit].start;
-    token_loc[unit].length = (int) 0;
-    token_loc[unit].after = (int) -1;  // No reset after token.
-    token_loc[unit].hash = (unsigned long) 0;
+    token_loc[unit].length = (int64_t) 0;
+    token_loc[unit].after = (int64_t) -1;  // No reset after token.
+    token_loc[unit].hash = (uint64_t) 0;
+  }
+
+  if (state->location_mode == UTF8LEX_LOCATION_MODE_LAZY)
+  {
+    // Only bytes are tracked, so don't bother counting chars,
+    // graphemes and lines.  But, same as utf8lex_read_grapheme(),
+    // a match running up to the end of the bytes read in so far
+    // might not have ended yet.
+    if ((offset + (off_t) match_length_bytes)
+        >= (off_t) state->buffer->str->length_bytes
+        && state->buffer->next == NULL
+        && state->buffer->is_eof == false)
+    {
+      return UTF8LEX_MORE;
+    }
+    token_loc[UTF8LEX_UNIT_BYTE].length = (int64_t) match_length_bytes;
+
+    // The hash still covers every byte:
+    token_loc[UTF8LEX_UNIT_BYTE].hash = lazy_hash;
+    token_loc[UTF8LEX_UNIT_CHAR].hash = lazy_hash;
+    token_loc[UTF8LEX_UNIT_GRAPHEME].hash = lazy_hash;
   }
 
-  // Keep reading graphemes until we've reached the end of the regex match:
-  for (int ug = 0;
+  // Keep reading graphemes until we've reached the end of the regex match
+  // (which might carry on into the next buffer(s) in the chain):
+  utf8lex_buffer_t *start_buffer = state->buffer;
+  for (int64_t ug = 0;
        token_loc[UTF8LEX_UNIT_BYTE].length < match_length_bytes;
        ug ++)
   {
+    if ((size_t) offset >= buffer->str->length_bytes
+        && buffer->next != NULL)
+    {
+      buffer = buffer->next;
+      offset = (off_t) 0;
+    }
+
     // Read in one UTF-8 grapheme cluster per loop iteration:
     off_t grapheme_offset = offset;
     utf8lex_location_t grapheme_loc[UTF8LEX_UNIT_MAX];  // Unitialized is fine.
     int32_t codepoint = (int32_t) -1;
     utf8lex_cat_t cat = UTF8LEX_CAT_NONE;
+    state->buffer = buffer;
     utf8lex_error_t error = utf8lex_read_grapheme(
         state,  // state, including absolute locations.
         &grapheme_offset,  // start byte, relative to start of buffer string.
@@ -329,6 +583,10 @@ static utf8lex_error_t utf8lex_lex_regex(
         &codepoint,  // codepoint
         &cat  //cat
         );
+    // If the grapheme straddled buffers, utf8lex_read_grapheme() moved
+    // the state on to the buffer it ended in:
+    utf8lex_buffer_t *grapheme_buffer = state->buffer;
+    state->buffer = start_buffer;
 
     if (error != UTF8LEX_OK)
     {
@@ -339,7 +597,19 @@ static utf8lex_error_t utf8lex_lex_regex(
 
     // We found another grapheme inside the regex match.
     // Keep looking for more graphemes inside the regex match.
+    for (utf8lex_buffer_t *skipped = buffer;
+         skipped != grapheme_buffer;
+         skipped = skipped->next)
+    {
+      grapheme_offset -= (off_t) skipped->str->length_bytes;
+    }
+    buffer = grapheme_buffer;
     offset = grapheme_offset;
+    // Hash of the bytes so far, followed by the grapheme's bytes:
+    uint64_t hash = utf8lex_hash_concat(
+        token_loc[UTF8LEX_UNIT_BYTE].hash,  // hash1
+        grapheme_loc[UTF8LEX_UNIT_BYTE].hash,  // hash2
+        (uint64_t) grapheme_loc[UTF8LEX_UNIT_BYTE].length);  // length2_bytes
     for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
          unit < UTF8LEX_UNIT_MAX;
          unit ++)
@@ -349,8 +619,8 @@ static utf8lex_error_t utf8lex_lex_regex(
       token_loc[unit].length += grapheme_loc[unit].length;
       // Possible resets to char, grapheme position due to newlines:
       token_loc[unit].after = grapheme_loc[unit].after;
-      // Hash of the grapheme (unsigned long, can wrap to 0):
-      token_loc[unit].hash = grapheme_loc[unit].hash;
+      // Hash of the bytes so far (lines are not hashed):
+      token_loc[unit].hash = (unit == UTF8LEX_UNIT_LINE) ? (uint64_t) 0 : hash;
     }
   }
 
@@ -358,7 +628,7 @@ static utf8lex_error_t utf8lex_lex_regex(
   if (token_loc[UTF8LEX_UNIT_BYTE].length != match_length_bytes)
   {
     fprintf(stderr,
-            "*** utf8lex: pcre2 and utf8proc disagree: pcre2 match_length_bytes = %d vs utf8proc = %d\n",
+            "*** utf8lex: pcre2 and utf8proc disagree: pcre2 match_length_bytes = %d vs utf8proc = %" PRId64 "\n",
             (int) match_length_bytes,
             token_loc[UTF8LEX_UNIT_BYTE].length);
   }
@@ -374,6 +644,13 @@ static utf8lex_error_t utf8lex_lex_regex(
     return error;
   }
 
+  token_pointer->num_captures = num_captures;
+  for (int c = 0; c < num_captures; c ++)
+  {
+    token_pointer->captures[c].start_byte = captures[c].start_byte;
+    token_pointer->captures[c].length_bytes = captures[c].length_bytes;
+  }
+
   return UTF8LEX_OK;
 }
 
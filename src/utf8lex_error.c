@@ -177,6 +177,10 @@ utf8lex_error_t utf8lex_error_string(
     num_bytes_written = snprintf(str->bytes, str->max_length_bytes,
                                  "UTF8LEX_ERROR_BAD_MULTI_TYPE");
     break;
+  case UTF8LEX_ERROR_BAD_MODE:
+    num_bytes_written = snprintf(str->bytes, str->max_length_bytes,
+                                 "UTF8LEX_ERROR_BAD_MODE");
+    break;
   case UTF8LEX_ERROR_BAD_REGEX:
     num_bytes_written = snprintf(str->bytes, str->max_length_bytes,
                                  "UTF8LEX_ERROR_BAD_REGEX");
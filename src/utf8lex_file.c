@@ -95,6 +95,9 @@ utf8lex_error_t utf8lex_buffer_mmap(
 
   self->is_eof = true;
 
+  self->pool = NULL;
+  self->refs = (uint32_t) 0;
+
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
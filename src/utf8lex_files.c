@@ -0,0 +1,383 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For uint32_t.
+#include <pthread.h>  // For pthread_create(), pthread_mutex_lock(), ...
+#include <stdbool.h>  // For bool, true, false.
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                           utf8lex_files_t
+// ---------------------------------------------------------------------
+
+// What an empty (0-byte) file is lexed as (mmap() cannot map it):
+static unsigned char utf8lex_files_no_bytes[1] = { 0 };
+
+utf8lex_error_t utf8lex_files_init(
+        utf8lex_files_t *self,
+        utf8lex_program_t *program,  // Compiled.
+        unsigned char **paths,  // Array of num_files paths.
+        uint32_t num_files,
+        utf8lex_error_t *errors,  // Array of num_files errors.
+        utf8lex_error_t (*on_tokens)(
+                utf8lex_files_t *self,
+                uint32_t file_index,
+                utf8lex_token_t *tokens,
+                uint32_t num_tokens,
+                utf8lex_error_t error
+                ),
+        void *context
+        )
+{
+  if (self == NULL
+      || program == NULL
+      || (paths == NULL && num_files > (uint32_t) 0)
+      || (errors == NULL && num_files > (uint32_t) 0)
+      || on_tokens == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  for (uint32_t f = (uint32_t) 0; f < num_files; f ++)
+  {
+    if (paths[f] == NULL)
+    {
+      return UTF8LEX_ERROR_NULL_POINTER;
+    }
+    errors[f] = UTF8LEX_OK;
+  }
+
+  self->program = program;
+  self->paths = paths;
+  self->num_files = num_files;
+  self->errors = errors;
+  self->on_tokens = on_tokens;
+  self->context = context;
+  self->workers = NULL;
+  self->num_workers = (uint32_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_files_clear(
+        utf8lex_files_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->program = NULL;
+  self->paths = NULL;
+  self->num_files = (uint32_t) 0;
+  self->errors = NULL;
+  self->on_tokens = NULL;
+  self->context = NULL;
+  self->workers = NULL;
+  self->num_workers = (uint32_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+
+// Takes the next file from the worker's own range, if there are any left.
+static bool utf8lex_files_take(
+        utf8lex_worker_t *worker,
+        uint32_t *file_index_pointer
+        )
+{
+  bool is_taken = false;
+  pthread_mutex_lock(&(worker->lock));
+  if (worker->next_file < worker->end_file)
+  {
+    *file_index_pointer = worker->next_file;
+    worker->next_file ++;
+    is_taken = true;
+  }
+  pthread_mutex_unlock(&(worker->lock));
+
+  return is_taken;
+}
+
+// Steals the back half of another worker's remaining files (at least
+// one file), into this worker's (empty) range.  Only one lock is held
+// at a time, so workers stealing from each other cannot deadlock.
+static bool utf8lex_files_steal(
+        utf8lex_worker_t *worker
+        )
+{
+  utf8lex_worker_t *workers = worker->files->workers;
+  uint32_t num_workers = worker->files->num_workers;
+  uint32_t w = (uint32_t) (worker - workers);
+  for (uint32_t v = (uint32_t) 1; v < num_workers; v ++)
+  {
+    utf8lex_worker_t *victim = &(workers[(w + v) % num_workers]);
+    uint32_t first_stolen = (uint32_t) 0;
+    uint32_t num_stolen = (uint32_t) 0;
+    pthread_mutex_lock(&(victim->lock));
+    if (victim->next_file < victim->end_file)
+    {
+      uint32_t num_left = victim->end_file - victim->next_file;
+      num_stolen = (num_left + (uint32_t) 1) / (uint32_t) 2;
+      victim->end_file -= num_stolen;
+      first_stolen = victim->end_file;
+    }
+    pthread_mutex_unlock(&(victim->lock));
+
+    if (num_stolen > (uint32_t) 0)
+    {
+      pthread_mutex_lock(&(worker->lock));
+      worker->next_file = first_stolen;
+      worker->end_file = first_stolen + num_stolen;
+      pthread_mutex_unlock(&(worker->lock));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Lexes one file, batch by batch, passing each batch to the callback,
+// and returns how the file ended (EOF, or an error).
+static utf8lex_error_t utf8lex_files_lex_file(
+        utf8lex_worker_t *worker,
+        uint32_t file_index
+        )
+{
+  utf8lex_files_t *files = worker->files;
+
+  worker->file_str.bytes = NULL;
+  worker->file_buffer.str = &(worker->file_str);
+  utf8lex_error_t error = utf8lex_buffer_mmap(
+      &(worker->file_buffer),  // self
+      files->paths[file_index]);  // path
+  bool is_mapped = (error == UTF8LEX_OK)
+    ? true
+    : false;
+  if (error == UTF8LEX_ERROR_FILE_EMPTY)
+  {
+    error = utf8lex_session_reset(&(worker->session),  // self
+                                  utf8lex_files_no_bytes,  // bytes
+                                  (size_t) 0);  // length_bytes
+  }
+  else if (error == UTF8LEX_OK)
+  {
+    error = utf8lex_session_reset(
+        &(worker->session),  // self
+        worker->file_str.bytes,  // bytes
+        worker->file_str.length_bytes);  // length_bytes
+  }
+  if (error != UTF8LEX_OK)
+  {
+    if (is_mapped == true)
+    {
+      utf8lex_buffer_munmap(&(worker->file_buffer));
+    }
+    return error;
+  }
+
+  utf8lex_error_t lex_error = UTF8LEX_OK;
+  while (lex_error == UTF8LEX_OK)
+  {
+    uint32_t num_tokens = (uint32_t) 0;
+    lex_error = utf8lex_lex_batch(
+        files->program,  // program
+        &(worker->session.state),  // state
+        worker->tokens,  // tokens
+        worker->max_tokens,  // max_tokens
+        &num_tokens);  // num_tokens_pointer
+    error = files->on_tokens(files,  // self
+                             file_index,  // file_index
+                             worker->tokens,  // tokens
+                             num_tokens,  // num_tokens
+                             lex_error);  // error
+    if (error != UTF8LEX_OK)
+    {
+      // The callback stopped lexing this file.
+      lex_error = error;
+      break;
+    }
+  }
+
+  if (is_mapped == true)
+  {
+    error = utf8lex_buffer_munmap(&(worker->file_buffer));
+    if (error != UTF8LEX_OK
+        && lex_error == UTF8LEX_EOF)
+    {
+      return error;
+    }
+  }
+
+  return lex_error;
+}
+
+// Lexes the worker's own files, then steals more, until there are none.
+static void utf8lex_files_work(
+        utf8lex_worker_t *worker
+        )
+{
+  utf8lex_files_t *files = worker->files;
+  while (true)
+  {
+    uint32_t file_index;
+    if (utf8lex_files_take(worker, &file_index) == false)
+    {
+      if (utf8lex_files_steal(worker) == false)
+      {
+        // Every file has been taken (a file that was in the middle
+        // of being stolen is lexed by the worker that stole it).
+        break;
+      }
+      continue;
+    }
+
+    files->errors[file_index] = utf8lex_files_lex_file(worker,  // worker
+                                                       file_index);
+  }
+}
+
+static void *utf8lex_files_thread(
+        void *worker_pointer  // utf8lex_worker_t *
+        )
+{
+  utf8lex_files_work((utf8lex_worker_t *) worker_pointer);
+  return NULL;
+}
+
+utf8lex_error_t utf8lex_files_lex(
+        utf8lex_files_t *self,
+        utf8lex_worker_t *workers,  // Array of num_workers workers.
+        uint32_t num_workers  // >= 1.
+        )
+{
+  if (self == NULL
+      || self->program == NULL
+      || self->on_tokens == NULL
+      || workers == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (num_workers == (uint32_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  for (uint32_t w = (uint32_t) 0; w < num_workers; w ++)
+  {
+    if (workers[w].tokens == NULL)
+    {
+      return UTF8LEX_ERROR_NULL_POINTER;
+    }
+    else if (workers[w].max_tokens == (uint32_t) 0)
+    {
+      return UTF8LEX_ERROR_BAD_LENGTH;
+    }
+  }
+
+  self->workers = workers;
+  self->num_workers = num_workers;
+
+  // Deal out the files in even, contiguous ranges:
+  uint32_t num_ready = (uint32_t) 0;
+  utf8lex_error_t error = UTF8LEX_OK;
+  for (uint32_t w = (uint32_t) 0; w < num_workers; w ++)
+  {
+    utf8lex_worker_t *worker = &(workers[w]);
+    worker->files = self;
+    worker->next_file = (uint32_t)
+      (((uint64_t) self->num_files * (uint64_t) w)
+       / (uint64_t) num_workers);
+    worker->end_file = (uint32_t)
+      (((uint64_t) self->num_files * (uint64_t) (w + (uint32_t) 1))
+       / (uint64_t) num_workers);
+
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      worker->file_buffer.loc[unit].start = -1;
+      worker->file_buffer.loc[unit].length = -1;
+    }
+    worker->file_str.bytes = NULL;
+    worker->file_buffer.str = &(worker->file_str);
+
+    error = utf8lex_session_init(&(worker->session),  // self
+                                 self->program);  // program
+    if (error != UTF8LEX_OK)
+    {
+      break;
+    }
+    if (pthread_mutex_init(&(worker->lock), NULL) != 0)
+    {
+      utf8lex_session_clear(&(worker->session));
+      error = UTF8LEX_ERROR_STATE;
+      break;
+    }
+    num_ready ++;
+  }
+
+  if (error == UTF8LEX_OK)
+  {
+    // Worker 0 lexes in this thread, the rest in their own threads:
+    uint32_t num_threads = (uint32_t) 0;
+    for (uint32_t w = (uint32_t) 1; w < num_workers; w ++)
+    {
+      if (pthread_create(&(workers[w].thread),
+                         (pthread_attr_t *) NULL,  // attr
+                         utf8lex_files_thread,  // start_routine
+                         (void *) &(workers[w])) != 0)  // arg
+      {
+        // Worker 0 steals the files of the workers with no threads.
+        break;
+      }
+      num_threads ++;
+    }
+    utf8lex_files_work(&(workers[0]));
+    for (uint32_t w = (uint32_t) 1; w <= num_threads; w ++)
+    {
+      pthread_join(workers[w].thread, (void **) NULL);
+    }
+  }
+
+  for (uint32_t w = (uint32_t) 0; w < num_ready; w ++)
+  {
+    pthread_mutex_destroy(&(workers[w].lock));
+    utf8lex_session_clear(&(workers[w].session));
+  }
+  self->workers = NULL;
+  self->num_workers = (uint32_t) 0;
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  for (uint32_t f = (uint32_t) 0; f < self->num_files; f ++)
+  {
+    if (self->errors[f] != UTF8LEX_EOF)
+    {
+      return self->errors[f];
+    }
+  }
+
+  return UTF8LEX_EOF;
+}
@@ -18,7 +18,7 @@
 
 #include <stdio.h>
 #include <fcntl.h>  // For open(), unlink()
-#include <inttypes.h>  // For uint32_t
+#include <inttypes.h>  // For uint32_t, PRId64
 #include <stdbool.h>  // For bool, true, false
 #include <string.h>  // For strlen(), strcpy(), strcat, strncpy
 #include <unistd.h>  // For write()
@@ -76,6 +76,13 @@ struct _STRUCT_utf8lex_db
   unsigned char reference_names[UTF8LEX_DEFINITIONS_DB_LENGTH_MAX][UTF8LEX_NAME_LENGTH_MAX];
   utf8lex_reference_t references[UTF8LEX_DEFINITIONS_DB_LENGTH_MAX];
 
+  // Modes (start conditions) from the .l file.  Mode 0 is always INITIAL.
+  // Rules without any <MODE,...> are active in INITIAL
+  // and in every inclusive (%s) mode, but not in exclusive (%x) modes.
+  uint32_t num_modes;
+  unsigned char mode_names[UTF8LEX_MODES_MAX][UTF8LEX_NAME_LENGTH_MAX];
+  bool is_mode_exclusive[UTF8LEX_MODES_MAX];
+
   // Rules from the .l file:
   uint32_t num_rules;
   unsigned char rule_names[UTF8LEX_RULES_DB_LENGTH_MAX][UTF8LEX_NAME_LENGTH_MAX];
@@ -110,9 +117,21 @@ struct _STRUCT_utf8lex_generate_lexicon
   // %}
   utf8lex_literal_definition_t enclosed_close_definition;
   utf8lex_rule_t enclosed_close;
+  // %skip
+  utf8lex_literal_definition_t skip_definition;
+  utf8lex_rule_t skip;
+  // %s (must be lexed after %skip)
+  utf8lex_literal_definition_t start_inclusive_definition;
+  utf8lex_rule_t start_inclusive;
+  // %x
+  utf8lex_literal_definition_t start_exclusive_definition;
+  utf8lex_rule_t start_exclusive;
   // "
   utf8lex_literal_definition_t quote_definition;
   utf8lex_rule_t quote;
+  // || (must be lexed before |)
+  utf8lex_literal_definition_t or_longest_definition;
+  utf8lex_rule_t or_longest;
   // |
   utf8lex_literal_definition_t or_definition;
   utf8lex_rule_t or;
@@ -131,6 +150,15 @@ struct _STRUCT_utf8lex_generate_lexicon
   // (backslash)
   utf8lex_literal_definition_t backslash_definition;
   utf8lex_rule_t backslash;
+  // <
+  utf8lex_literal_definition_t modes_open_definition;
+  utf8lex_rule_t modes_open;
+  // >
+  utf8lex_literal_definition_t modes_close_definition;
+  utf8lex_rule_t modes_close;
+  // ,
+  utf8lex_literal_definition_t comma_definition;
+  utf8lex_rule_t comma;
 
   // ID
   utf8lex_regex_definition_t id_definition;
@@ -180,6 +208,10 @@ static utf8lex_error_t utf8lex_generate_setup_db(
   db->num_multi_definitions = (uint32_t) 0;
   db->num_references = (uint32_t) 0;
 
+  strcpy(db->mode_names[UTF8LEX_MODE_INITIAL], "INITIAL");
+  db->is_mode_exclusive[UTF8LEX_MODE_INITIAL] = false;
+  db->num_modes = (uint32_t) 1;
+
   db->num_rules = (uint32_t) 0;
 
   // Whole database:
@@ -311,6 +343,54 @@ static utf8lex_error_t utf8lex_generate_setup(
                             (size_t) 0);  // code_length_bytes
   if (error != UTF8LEX_OK) { return error; }
   prev = &(lex->enclosed_close);
+  // %skip
+  error = utf8lex_literal_definition_init(&(lex->skip_definition),
+                                          prev_definition,  // prev
+                                          "SKIP",  // name
+                                          "%skip");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->skip_definition);
+  error = utf8lex_rule_init(&(lex->skip),
+                            prev,
+                            "skip",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->skip_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->skip);
+  // %s
+  error = utf8lex_literal_definition_init(&(lex->start_inclusive_definition),
+                                          prev_definition,  // prev
+                                          "START_INCLUSIVE",  // name
+                                          "%s");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->start_inclusive_definition);
+  error = utf8lex_rule_init(&(lex->start_inclusive),
+                            prev,
+                            "start_inclusive",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->start_inclusive_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->start_inclusive);
+  // %x
+  error = utf8lex_literal_definition_init(&(lex->start_exclusive_definition),
+                                          prev_definition,  // prev
+                                          "START_EXCLUSIVE",  // name
+                                          "%x");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->start_exclusive_definition);
+  error = utf8lex_rule_init(&(lex->start_exclusive),
+                            prev,
+                            "start_exclusive",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->start_exclusive_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->start_exclusive);
   // "
   error = utf8lex_literal_definition_init(&(lex->quote_definition),
                                           prev_definition,  // prev
@@ -327,6 +407,22 @@ static utf8lex_error_t utf8lex_generate_setup(
                             (size_t) 0);  // code_length_bytes
   if (error != UTF8LEX_OK) { return error; }
   prev = &(lex->quote);
+  // ||
+  error = utf8lex_literal_definition_init(&(lex->or_longest_definition),
+                                          prev_definition,  // prev
+                                          "OR_LONGEST",  // name
+                                          "||");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->or_longest_definition);
+  error = utf8lex_rule_init(&(lex->or_longest),
+                            prev,
+                            "or_longest",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->or_longest_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->or_longest);
   // |
   error = utf8lex_literal_definition_init(&(lex->or_definition),
                                           prev_definition,  // prev
@@ -423,6 +519,54 @@ static utf8lex_error_t utf8lex_generate_setup(
                             (size_t) 0);  // code_length_bytes
   if (error != UTF8LEX_OK) { return error; }
   prev = &(lex->backslash);
+  // <
+  error = utf8lex_literal_definition_init(&(lex->modes_open_definition),
+                                          prev_definition,  // prev
+                                          "MODES_OPEN",  // name
+                                          "<");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->modes_open_definition);
+  error = utf8lex_rule_init(&(lex->modes_open),
+                            prev,
+                            "modes_open",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->modes_open_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->modes_open);
+  // >
+  error = utf8lex_literal_definition_init(&(lex->modes_close_definition),
+                                          prev_definition,  // prev
+                                          "MODES_CLOSE",  // name
+                                          ">");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->modes_close_definition);
+  error = utf8lex_rule_init(&(lex->modes_close),
+                            prev,
+                            "modes_close",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->modes_close_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->modes_close);
+  // ,
+  error = utf8lex_literal_definition_init(&(lex->comma_definition),
+                                          prev_definition,  // prev
+                                          "COMMA",  // name
+                                          ",");
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *) &(lex->comma_definition);
+  error = utf8lex_rule_init(&(lex->comma),
+                            prev,
+                            "comma",  // name
+                            (utf8lex_definition_t *)
+                            &(lex->comma_definition),  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  prev = &(lex->comma);
 
   // definition ID
   error = utf8lex_regex_definition_init(&(lex->id_definition),
@@ -643,7 +787,7 @@ static utf8lex_error_t utf8lex_generate_token_error(
                                         (size_t) token->length_bytes,
                                         (size_t) 32);  // max_bytes
   fprintf(stderr,
-          "ERROR utf8lex %d.%d %s %s [#%d]: \"%s\"\n",
+          "ERROR utf8lex %" PRId64 ".%" PRId64 " %s %s [#%d]: \"%s\"\n",
           state->loc[UTF8LEX_UNIT_LINE].start + 1,
           state->loc[UTF8LEX_UNIT_CHAR].start,
           message,
@@ -684,7 +828,7 @@ static utf8lex_error_t utf8lex_generate_read_to_eol(
         (size_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].length,
         (size_t) 32);
     fprintf(stderr,
-            "ERROR utf8lex: Failed to read to EOL %d.%d: \"%s\"\n",
+            "ERROR utf8lex: Failed to read to EOL %" PRId64 ".%" PRId64 ": \"%s\"\n",
             state->loc[UTF8LEX_UNIT_LINE].start + 1,
             state->loc[UTF8LEX_UNIT_CHAR].start,
             some_of_remaining_buffer);
@@ -709,7 +853,7 @@ static utf8lex_error_t utf8lex_generate_read_to_eol(
         (size_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].length,
         (size_t) 32);
     fprintf(stderr,
-            "ERROR utf8lex: Failed to read newline %d.%d: \"%s\"\n",
+            "ERROR utf8lex: Failed to read newline %" PRId64 ".%" PRId64 ": \"%s\"\n",
             state->loc[UTF8LEX_UNIT_LINE].start + 1,
             state->loc[UTF8LEX_UNIT_CHAR].start,
             some_of_remaining_buffer);
@@ -722,7 +866,7 @@ static utf8lex_error_t utf8lex_generate_read_to_eol(
     // We can't really generate an empty token, so we fake it here.
     line_token_pointer->rule = &(lex->to_eol);
     line_token_pointer->start_byte = newline_token_pointer->start_byte;
-    line_token_pointer->length_bytes = (int) 0;
+    line_token_pointer->length_bytes = (int64_t) 0;
     line_token_pointer->str = newline_token_pointer->str;
     for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
          unit < UTF8LEX_UNIT_MAX;
@@ -730,8 +874,8 @@ static utf8lex_error_t utf8lex_generate_read_to_eol(
     {
       line_token_pointer->loc[unit].start =
         newline_token_pointer->loc[unit].start;
-      line_token_pointer->loc[unit].length = (int) 0;
-      line_token_pointer->loc[unit].after = (int) -1;
+      line_token_pointer->loc[unit].length = (int64_t) 0;
+      line_token_pointer->loc[unit].after = (int64_t) -1;
     }
   }
 
@@ -794,6 +938,204 @@ static utf8lex_error_t utf8lex_generate_write_line(
   return UTF8LEX_OK;
 }
 
+// Declares modes (start conditions): %s NAME1 NAME2 ... (inclusive)
+// or %x NAME1 NAME2 ... (exclusive), after the %s or %x has been lexed.
+static utf8lex_error_t utf8lex_generate_declare_modes(
+        utf8lex_generate_lexicon_t *lex,
+        utf8lex_state_t *state,
+        bool is_exclusive  // true = %x, false = %s.
+        )
+{
+  if (lex == NULL
+      || state == NULL)
+  {
+    fprintf(stderr, "ERROR 275 in utf8lex_generate_declare_modes(): UTF8LEX_ERROR_NULL_POINTER\n");
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  utf8lex_error_t error = UTF8LEX_OK;
+  utf8lex_token_t token;
+  uint32_t num_declared = (uint32_t) 0;
+  int infinite_loop_protector = 0;
+  while (true)
+  {
+    infinite_loop_protector ++;
+    if (infinite_loop_protector > UTF8LEX_LEX_FILE_NUM_LINES_MAX)
+    {
+      fprintf(stderr, "ERROR 276 in utf8lex_generate_declare_modes(): UTF8LEX_ERROR_INFINITE_LOOP\n");
+      return UTF8LEX_ERROR_INFINITE_LOOP;
+    }
+
+    error = utf8lex_lex(lex->lex_rules,
+                        state,
+                        &token);
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    if (lex->space.id == token.rule->id)
+    {
+      continue;
+    }
+    else if (lex->newline.id == token.rule->id)
+    {
+      break;
+    }
+    else if (lex->id.id != token.rule->id)
+    {
+      return utf8lex_generate_token_error(
+          state,
+          &token,
+          "Expected mode names after %s or %x");
+    }
+
+    uint32_t m = lex->db.num_modes;
+    if (m >= (uint32_t) UTF8LEX_MODES_MAX)
+    {
+      fprintf(stderr, "ERROR 277 in utf8lex_generate_declare_modes(): UTF8LEX_ERROR_MAX_LENGTH\n");
+      return UTF8LEX_ERROR_MAX_LENGTH;
+    }
+
+    error = utf8lex_token_copy_string(&token,  // self
+                                      lex->db.mode_names[m],  // str
+                                      UTF8LEX_NAME_LENGTH_MAX);  // max_bytes
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    for (uint32_t other = (uint32_t) 0; other < m; other ++)
+    {
+      if (strcmp(lex->db.mode_names[other], lex->db.mode_names[m]) == 0)
+      {
+        return utf8lex_generate_token_error(
+            state,
+            &token,
+            "Mode declared more than once");
+      }
+    }
+
+    lex->db.is_mode_exclusive[m] = is_exclusive;
+    lex->db.num_modes ++;
+    num_declared ++;
+  }
+
+  if (num_declared == (uint32_t) 0)
+  {
+    return utf8lex_generate_token_error(
+        state,
+        &token,
+        "Expected mode names after %s or %x");
+  }
+
+  return UTF8LEX_OK;
+}
+
+// Reads the modes (start conditions) at the start of a rule,
+// <NAME1,NAME2,...> or <*> (all modes), after the < has been lexed.
+static utf8lex_error_t utf8lex_generate_rule_modes(
+        utf8lex_generate_lexicon_t *lex,
+        utf8lex_state_t *state,
+        uint32_t *modes_pointer  // Gets set to the mask of modes.
+        )
+{
+  if (lex == NULL
+      || state == NULL
+      || modes_pointer == NULL)
+  {
+    fprintf(stderr, "ERROR 278 in utf8lex_generate_rule_modes(): UTF8LEX_ERROR_NULL_POINTER\n");
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  utf8lex_error_t error = UTF8LEX_OK;
+  utf8lex_token_t token;
+  uint32_t modes = (uint32_t) 0;
+  bool is_name_expected = true;
+  int infinite_loop_protector = 0;
+  while (true)
+  {
+    infinite_loop_protector ++;
+    if (infinite_loop_protector > UTF8LEX_LEX_FILE_NUM_LINES_MAX)
+    {
+      fprintf(stderr, "ERROR 279 in utf8lex_generate_rule_modes(): UTF8LEX_ERROR_INFINITE_LOOP\n");
+      return UTF8LEX_ERROR_INFINITE_LOOP;
+    }
+
+    error = utf8lex_lex(lex->lex_rules,
+                        state,
+                        &token);
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    if (is_name_expected == true
+        && lex->id.id == token.rule->id)
+    {
+      unsigned char mode_name[UTF8LEX_NAME_LENGTH_MAX];
+      error = utf8lex_token_copy_string(&token,  // self
+                                        mode_name,  // str
+                                        UTF8LEX_NAME_LENGTH_MAX);  // max_bytes
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+
+      uint32_t m = (uint32_t) 0;
+      for (m = (uint32_t) 0; m < lex->db.num_modes; m ++)
+      {
+        if (strcmp(lex->db.mode_names[m], mode_name) == 0)
+        {
+          break;
+        }
+      }
+
+      if (m >= lex->db.num_modes)
+      {
+        return utf8lex_generate_token_error(
+            state,
+            &token,
+            "Mode was not declared with %s or %x");
+      }
+
+      modes |= (uint32_t) 1 << m;
+      is_name_expected = false;
+    }
+    else if (is_name_expected == true
+             && lex->star.id == token.rule->id)
+    {
+      // <*> All modes, inclusive and exclusive.
+      for (uint32_t m = (uint32_t) 0; m < lex->db.num_modes; m ++)
+      {
+        modes |= (uint32_t) 1 << m;
+      }
+      is_name_expected = false;
+    }
+    else if (is_name_expected == false
+             && lex->comma.id == token.rule->id)
+    {
+      is_name_expected = true;
+    }
+    else if (is_name_expected == false
+             && lex->modes_close.id == token.rule->id)
+    {
+      break;
+    }
+    else
+    {
+      return utf8lex_generate_token_error(
+          state,
+          &token,
+          "Expected <MODE,...> before rule");
+    }
+  }
+
+  *modes_pointer = modes;
+
+  return UTF8LEX_OK;
+}
+
 enum _ENUM_utf8lex_lex_state
 {
   UTF8LEX_LEX_STATE_NONE = -1,
@@ -876,6 +1218,8 @@ static utf8lex_error_t utf8lex_generate_definition(
           .to = UTF8LEX_LEX_STATE_MULTI_ID_SPACE },
         { .rule = &(lex->or),
           .to = UTF8LEX_LEX_STATE_MULTI_OR },
+        { .rule = &(lex->or_longest),
+          .to = UTF8LEX_LEX_STATE_MULTI_OR },
         { .rule = &(lex->rule_open),
           .to = UTF8LEX_LEX_STATE_RULE },  // DEF1 REF1 {rule}
         { .rule = &(lex->newline),
@@ -891,6 +1235,8 @@ static utf8lex_error_t utf8lex_generate_definition(
           .to = UTF8LEX_LEX_STATE_MULTI_SEQUENCE_ID },
         { .rule = &(lex->or),
           .to = UTF8LEX_LEX_STATE_MULTI_OR },
+        { .rule = &(lex->or_longest),
+          .to = UTF8LEX_LEX_STATE_MULTI_OR },
         { .rule = &(lex->rule_open),
           .to = UTF8LEX_LEX_STATE_RULE },  // DEF1 REF1 {rule}
         { .rule = &(lex->newline),
@@ -979,6 +1325,8 @@ static utf8lex_error_t utf8lex_generate_definition(
           .to = UTF8LEX_LEX_STATE_MULTI_OR_ID_PLUS },  // DEF1 REF1 | REF2+
         { .rule = &(lex->or),
           .to = UTF8LEX_LEX_STATE_MULTI_OR },
+        { .rule = &(lex->or_longest),
+          .to = UTF8LEX_LEX_STATE_MULTI_OR },
         { .rule = &(lex->rule_open),
           .to = UTF8LEX_LEX_STATE_RULE },  // DEF1 REF1 | REF2 {rule}
         { .rule = &(lex->newline),
@@ -992,6 +1340,8 @@ static utf8lex_error_t utf8lex_generate_definition(
           .to = UTF8LEX_LEX_STATE_MULTI_OR_ID_STAR },
         { .rule = &(lex->or),
           .to = UTF8LEX_LEX_STATE_MULTI_OR },
+        { .rule = &(lex->or_longest),
+          .to = UTF8LEX_LEX_STATE_MULTI_OR },
         { .rule = &(lex->rule_open),
           .to = UTF8LEX_LEX_STATE_RULE },  // DEF1 REF1 | REF2* {rule}
         { .rule = &(lex->newline),
@@ -1005,6 +1355,8 @@ static utf8lex_error_t utf8lex_generate_definition(
           .to = UTF8LEX_LEX_STATE_MULTI_OR_ID_PLUS },
         { .rule = &(lex->or),
           .to = UTF8LEX_LEX_STATE_MULTI_OR },
+        { .rule = &(lex->or_longest),
+          .to = UTF8LEX_LEX_STATE_MULTI_OR },
         { .rule = &(lex->rule_open),
           .to = UTF8LEX_LEX_STATE_RULE },  // DEF1 REF1 | REF2+ {rule}
         { .rule = &(lex->newline),
@@ -1100,7 +1452,8 @@ static utf8lex_error_t utf8lex_generate_definition(
               lex->db.last_definition,  // prev
               lex->db.definition_names[dn],  // name
               NULL,  // parent
-              UTF8LEX_MULTI_TYPE_SEQUENCE);  // multi_type
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
   if (error != UTF8LEX_OK) { return error; }
   lex->db.num_multi_definitions ++;
   if (lex->db.num_multi_definitions >= UTF8LEX_DEFINITIONS_DB_LENGTH_MAX)
@@ -1126,6 +1479,8 @@ static utf8lex_error_t utf8lex_generate_definition(
   unsigned char regex_space[256];
   regex_space[0] = 0;
   utf8lex_multi_type_t multi_type = UTF8LEX_MULTI_TYPE_NONE;
+  // Either "|" (first match) or "||" (longest match) separates ORs:
+  utf8lex_rule_t *or_separator = NULL;
   utf8lex_reference_t *last_reference = NULL;
   utf8lex_token_t token;
   int num_nested_rules = 0;
@@ -1148,7 +1503,7 @@ static utf8lex_error_t utf8lex_generate_definition(
           (size_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex: Aborting \"%s\", possible infinite loop %d.%d: \"%s\"\n",
+              "ERROR utf8lex: Aborting \"%s\", possible infinite loop %" PRId64 ".%" PRId64 ": \"%s\"\n",
               name,
               state->loc[UTF8LEX_UNIT_LINE].start + 1,
               state->loc[UTF8LEX_UNIT_CHAR].start,
@@ -1232,6 +1587,24 @@ static utf8lex_error_t utf8lex_generate_definition(
       if (error != UTF8LEX_OK) { return error; }
       break;
 
+    case UTF8LEX_LEX_STATE_MULTI_OR:
+      if (token.rule->id == lex->or.id
+          || token.rule->id == lex->or_longest.id)
+      {
+        // DEF1 REF1 | REF2 | ... or DEF1 REF1 || REF2 || ...
+        // but not DEF1 REF1 | REF2 || ...
+        if (or_separator == NULL)
+        {
+          or_separator = token.rule;
+        }
+        else if (or_separator != token.rule)
+        {
+          fprintf(stderr, "ERROR 264 in utf8lex_generate_definition(): UTF8LEX_ERROR_TOKEN mixed | and ||\n");
+          return UTF8LEX_ERROR_TOKEN;
+        }
+      }
+      break;
+
     case UTF8LEX_LEX_STATE_MULTI_ID:
     case UTF8LEX_LEX_STATE_MULTI_ID_SPACE:
     case UTF8LEX_LEX_STATE_MULTI_SEQUENCE_ID:
@@ -1418,6 +1791,11 @@ static utf8lex_error_t utf8lex_generate_definition(
   else if (definition_type == UTF8LEX_DEFINITION_TYPE_MULTI)
   {
     lex->db.multi_definitions[md].multi_type = multi_type;
+    if (multi_type == UTF8LEX_MULTI_TYPE_OR
+        && or_separator == &(lex->or_longest))
+    {
+      lex->db.multi_definitions[md].is_longest = true;
+    }
   }
   else
   {
@@ -1463,6 +1841,48 @@ static utf8lex_error_t utf8lex_generate_write_rules(
 
   utf8lex_error_t error;
 
+  line_bytes = snprintf(line, max_bytes,
+                        "// Modes (start conditions):\n");
+  if (line_bytes >= max_bytes) {
+    fprintf(stderr, "ERROR 280 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  bytes_written = write(fd_out, line, line_bytes);
+  if (bytes_written != line_bytes) {
+    fprintf(stderr, "ERROR 281 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+
+  for (uint32_t m = (uint32_t) 0; m < db->num_modes; m ++)
+  {
+    line_bytes = snprintf(line, max_bytes,
+                          "#define %s %u\n",
+                          db->mode_names[m],
+                          (unsigned int) m);
+    if (line_bytes >= max_bytes) {
+      fprintf(stderr, "ERROR 282 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+      return UTF8LEX_ERROR_BAD_LENGTH;
+    }
+    bytes_written = write(fd_out, line, line_bytes);
+    if (bytes_written != line_bytes) {
+      fprintf(stderr, "ERROR 283 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+      return UTF8LEX_ERROR_FILE_WRITE;
+    }
+  }
+
+  line_bytes = snprintf(line, max_bytes,
+                        "#define YY_NUM_MODES %u\n\n",
+                        (unsigned int) db->num_modes);
+  if (line_bytes >= max_bytes) {
+    fprintf(stderr, "ERROR 284 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  bytes_written = write(fd_out, line, line_bytes);
+  if (bytes_written != line_bytes) {
+    fprintf(stderr, "ERROR 285 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+
   line_bytes = snprintf(line, max_bytes,
                         "static utf8lex_cat_definition_t YY_CAT_DEFINITIONS[%d];\n",
                         UTF8LEX_NUM_CATEGORIES);
@@ -2023,12 +2443,12 @@ static utf8lex_error_t utf8lex_generate_write_rules(
       if (db->multi_definitions[md].multi_type == UTF8LEX_MULTI_TYPE_SEQUENCE)
       {
         line_bytes = snprintf(line, max_bytes,
-                              "                UTF8LEX_MULTI_TYPE_SEQUENCE);  // multi_type\n");
+                              "                UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type\n");
       }
       else if (db->multi_definitions[md].multi_type == UTF8LEX_MULTI_TYPE_OR)
       {
         line_bytes = snprintf(line, max_bytes,
-                              "                UTF8LEX_MULTI_TYPE_OR);  // multi_type\n");
+                              "                UTF8LEX_MULTI_TYPE_OR,  // multi_type\n");
       }
       else
       {
@@ -2045,6 +2465,21 @@ static utf8lex_error_t utf8lex_generate_write_rules(
         return UTF8LEX_ERROR_FILE_WRITE;
       }
 
+      line_bytes = snprintf(line, max_bytes,
+                            "                %s);  // is_longest\n",
+                            (db->multi_definitions[md].is_longest == true)
+                            ? "true"
+                            : "false");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 265 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 266 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
       line_bytes = snprintf(line, max_bytes,
                             "    if (error != UTF8LEX_OK) { return error; }\n");
       if (line_bytes >= max_bytes) {
@@ -2686,6 +3121,111 @@ static utf8lex_error_t utf8lex_generate_write_rules(
       return UTF8LEX_ERROR_FILE_WRITE;
     }
 
+    if (rule->is_skip == true)
+    {
+      line_bytes = snprintf(line, max_bytes,
+                            "    error = utf8lex_rule_set_skip(\n");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 267 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 268 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "                &(YY_RULES[%d]),  // self\n",
+                            rn);
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 269 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 270 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "                true);  // is_skip\n");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 271 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 272 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "    if (error != UTF8LEX_OK) { return error; }\n");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 273 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 274 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+    }
+
+    if (db->num_modes > (uint32_t) 1)
+    {
+      line_bytes = snprintf(line, max_bytes,
+                            "    error = utf8lex_rule_set_modes(\n");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 286 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 287 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "                &(YY_RULES[%d]),  // self\n",
+                            rn);
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 288 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 289 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "                (uint32_t) 0x%08x);  // modes\n",
+                            (unsigned int) rule->modes);
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 290 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 291 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+
+      line_bytes = snprintf(line, max_bytes,
+                            "    if (error != UTF8LEX_OK) { return error; }\n");
+      if (line_bytes >= max_bytes) {
+        fprintf(stderr, "ERROR 292 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_BAD_LENGTH\n");
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+      bytes_written = write(fd_out, line, line_bytes);
+      if (bytes_written != line_bytes) {
+        fprintf(stderr, "ERROR 293 in utf8lex_generate_write_rules(): UTF8LEX_ERROR_FILE_WRITE\n");
+        return UTF8LEX_ERROR_FILE_WRITE;
+      }
+    }
+
     line_bytes = snprintf(previous, UTF8LEX_NAME_LENGTH_MAX + 16,
                           "&(YY_RULES[%d])",
                           rn);
@@ -3143,7 +3683,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex: Aborting, possible infinite loop %d.%d: \"%s\"\n",
+              "ERROR utf8lex: Aborting, possible infinite loop %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
@@ -3177,7 +3717,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex_file_parse() failed to parse %d.%d: \"%s\"\n",
+              "ERROR utf8lex_file_parse() failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
@@ -3190,6 +3730,8 @@ static utf8lex_error_t utf8lex_generate_parse(
     //   %}           End enclosed code section.
     //   (space) ...  Indented code line.
     //   (id) ...     Definition.
+    //   %s (id) ...  Inclusive mode(s) (start conditions).
+    //   %x (id) ...  Exclusive mode(s) (start conditions).
     //   %%           Section divider, move on to next section.
     error = UTF8LEX_ERROR_TOKEN;  // Default to invalid token.
     if (lex.newline.id == token.rule->id)
@@ -3259,6 +3801,19 @@ static utf8lex_error_t utf8lex_generate_parse(
 
       error = UTF8LEX_OK;
     }
+    else if (lex.start_inclusive.id == token.rule->id
+             || lex.start_exclusive.id == token.rule->id)
+    {
+      // %s (id) ... or %x (id) ...
+      error = utf8lex_generate_declare_modes(
+                  &lex,  // lex
+                  state_pointer,  // state
+                  (lex.start_exclusive.id == token.rule->id));  // is_exclusive
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+    }
     else if (lex.section_divider.id == token.rule->id)
     {
       // %%
@@ -3275,7 +3830,7 @@ static utf8lex_error_t utf8lex_generate_parse(
             (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
             (size_t) 32);
         fprintf(stderr,
-                "ERROR utf8lex_file_parse() failed to parse %d.%d: \"%s\"\n",
+                "ERROR utf8lex_file_parse() failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
                 state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
                 state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
                 some_of_remaining_buffer);
@@ -3336,6 +3891,10 @@ static utf8lex_error_t utf8lex_generate_parse(
   // -------------------------------------------------------------------
   is_enclosed = false;
   is_end_of_section = false;
+  // %skip (rule): the next rule's tokens are consumed, never returned.
+  bool is_skip = false;
+  // <MODE,...>(rule): the modes the next rule is active in (0 = default).
+  uint32_t rule_modes = (uint32_t) 0;
   infinite_loop_protector = 0;
   while (true)
   {
@@ -3349,7 +3908,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex: Aborting, possible infinite loop %d.%d: \"%s\"\n",
+              "ERROR utf8lex: Aborting, possible infinite loop %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
@@ -3383,7 +3942,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex_file_parse() failed to parse %d.%d: \"%s\"\n",
+              "ERROR utf8lex_file_parse() failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
@@ -3396,8 +3955,27 @@ static utf8lex_error_t utf8lex_generate_parse(
     //   %}                        End enclosed code section.
     //   (space)                   Indented code line.
     //   (definition) { ...code... }  Rule.
+    //   %skip (definition) { ...code... }  Rule with skipped tokens.
+    //   <MODE,...>(definition) { ...code... }  Rule for specific modes.
     error = UTF8LEX_ERROR_TOKEN;  // Default to invalid token.
-    if (lex.newline.id == token.rule->id)
+    if ((is_skip == true
+         || rule_modes != (uint32_t) 0)
+        && (lex.newline.id == token.rule->id
+            || lex.enclosed_open.id == token.rule->id
+            || lex.enclosed_close.id == token.rule->id
+            || lex.space.id == token.rule->id
+            || lex.section_divider.id == token.rule->id
+            || (is_skip == true
+                && lex.skip.id == token.rule->id)
+            || (rule_modes != (uint32_t) 0
+                && lex.modes_open.id == token.rule->id)))
+    {
+      return utf8lex_generate_token_error(
+          state_pointer,
+          &token,
+          "Expected a rule after %skip or <MODE,...>");
+    }
+    else if (lex.newline.id == token.rule->id)
     {
       error = UTF8LEX_OK;
     }
@@ -3436,6 +4014,38 @@ static utf8lex_error_t utf8lex_generate_parse(
                                   state_pointer);
       error = UTF8LEX_OK;
     }
+    else if (lex.skip.id == token.rule->id)
+    {
+      // %skip must be followed by space, then the rule:
+      error = utf8lex_lex(lex.lex_rules,
+                          state_pointer,
+                          &token);
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+      else if (lex.space.id != token.rule->id)
+      {
+        return utf8lex_generate_token_error(
+            state_pointer,
+            &token,
+            "Expected space after %skip");
+      }
+
+      is_skip = true;
+      error = UTF8LEX_OK;
+    }
+    else if (lex.modes_open.id == token.rule->id)
+    {
+      // <MODE,...> then the rule:
+      error = utf8lex_generate_rule_modes(&lex,  // lex
+                                          state_pointer,  // state
+                                          &rule_modes);  // modes_pointer
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+    }
     else if (lex.section_divider.id == token.rule->id)
     {
       error = utf8lex_lex(lex.lex_rules,
@@ -3451,7 +4061,7 @@ static utf8lex_error_t utf8lex_generate_parse(
             (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
             (size_t) 32);
         fprintf(stderr,
-                "ERROR utf8lex_file_parse() failed to parse %d.%d: \"%s\"\n",
+                "ERROR utf8lex_file_parse() failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
                 state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
                 state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
                 some_of_remaining_buffer);
@@ -3482,7 +4092,7 @@ static utf8lex_error_t utf8lex_generate_parse(
       {
         if (token.loc[unit].after == -1)
         {
-          int length_units = token.loc[unit].length;
+          int64_t length_units = token.loc[unit].length;
           state_pointer->buffer->loc[unit].start -= token.loc[unit].length;
           state_pointer->loc[unit].start -= token.loc[unit].length;
         }
@@ -3526,6 +4136,33 @@ static utf8lex_error_t utf8lex_generate_parse(
         return error;
       }
 
+      error = utf8lex_rule_set_skip(&(lex.db.rules[r]),  // self
+                                    is_skip);  // is_skip
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+      is_skip = false;
+
+      if (rule_modes == (uint32_t) 0)
+      {
+        // No <MODE,...>: active in INITIAL and in every inclusive mode.
+        for (uint32_t m = (uint32_t) 0; m < lex.db.num_modes; m ++)
+        {
+          if (lex.db.is_mode_exclusive[m] == false)
+          {
+            rule_modes |= (uint32_t) 1 << m;
+          }
+        }
+      }
+      error = utf8lex_rule_set_modes(&(lex.db.rules[r]),  // self
+                                     rule_modes);  // modes
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+      rule_modes = (uint32_t) 0;
+
       if (r == 0)
       {
         lex.db.rules_db = &(lex.db.rules[r]);
@@ -3582,7 +4219,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex: Aborting, possible infinite loop %d.%d: \"%s\"\n",
+              "ERROR utf8lex: Aborting, possible infinite loop %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
@@ -3607,7 +4244,7 @@ static utf8lex_error_t utf8lex_generate_parse(
           (size_t) state_pointer->buffer->loc[UTF8LEX_UNIT_BYTE].length,
           (size_t) 32);
       fprintf(stderr,
-              "ERROR utf8lex_file_parse() failed to parse %d.%d: \"%s\"\n",
+              "ERROR utf8lex_file_parse() failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
               state_pointer->loc[UTF8LEX_UNIT_LINE].start + 1,
               state_pointer->loc[UTF8LEX_UNIT_CHAR].start,
               some_of_remaining_buffer);
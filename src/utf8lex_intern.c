@@ -0,0 +1,226 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For uint32_t, uint64_t.
+#include <stdbool.h>  // For bool, true, false.
+#include <string.h>  // For memcmp(), memcpy().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                         utf8lex_hash_concat()
+// ---------------------------------------------------------------------
+
+uint64_t utf8lex_hash_concat(
+        uint64_t hash1,
+        uint64_t hash2,
+        uint64_t length2_bytes
+        )
+{
+  // hash1 * P^length2_bytes + hash2, by repeated squaring of P
+  // (length2_bytes is usually just 1 to 4 bytes, one grapheme).
+  uint64_t power = (uint64_t) 1;
+  uint64_t square = UTF8LEX_HASH_PRIME;
+  for (uint64_t exponent = length2_bytes;
+       exponent > (uint64_t) 0;
+       exponent >>= 1)
+  {
+    if ((exponent & (uint64_t) 1) != (uint64_t) 0)
+    {
+      power *= square;
+    }
+    square *= square;
+  }
+
+  return (hash1 * power) + hash2;
+}
+
+
+// ---------------------------------------------------------------------
+//                        utf8lex_intern_table_t
+// ---------------------------------------------------------------------
+
+// The polynomial hash's low bits depend only on the last few bytes,
+// so they are mixed (as in MurmurHash3's fmix64) before picking a slot:
+static inline uint32_t utf8lex_intern_slot(
+        utf8lex_intern_table_t *self,
+        uint64_t hash
+        )
+{
+  hash ^= hash >> 33;
+  hash *= (uint64_t) 0xFF51AFD7ED558CCD;
+  hash ^= hash >> 33;
+  hash *= (uint64_t) 0xC4CEB9FE1A85EC53;
+  hash ^= hash >> 33;
+
+  return (uint32_t) hash & (self->num_slots - (uint32_t) 1);
+}
+
+utf8lex_error_t utf8lex_intern_table_init(
+        utf8lex_intern_table_t *self,
+        uint32_t *slots,  // Array of num_slots slots.
+        uint32_t num_slots,  // Power of 2, > max_symbols.
+        utf8lex_symbol_t *symbols,  // Array of (at least) max_symbols.
+        uint32_t max_symbols,
+        unsigned char *arena,  // Array of (at least) max_arena_bytes.
+        uint64_t max_arena_bytes
+        )
+{
+  if (self == NULL
+      || slots == NULL
+      || symbols == NULL
+      || arena == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (num_slots == (uint32_t) 0
+           || (num_slots & (num_slots - (uint32_t) 1)) != (uint32_t) 0
+           || num_slots <= max_symbols)
+  {
+    // There must always be an empty slot to stop probing at.
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  for (uint32_t slot = (uint32_t) 0; slot < num_slots; slot ++)
+  {
+    slots[slot] = (uint32_t) 0;
+  }
+
+  self->slots = slots;
+  self->num_slots = num_slots;
+  self->symbols = symbols;
+  self->max_symbols = max_symbols;
+  self->num_symbols = (uint32_t) 0;
+  self->arena = arena;
+  self->max_arena_bytes = max_arena_bytes;
+  self->arena_bytes = (uint64_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_intern_table_clear(
+        utf8lex_intern_table_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->slots = NULL;
+  self->num_slots = (uint32_t) 0;
+  self->symbols = NULL;
+  self->max_symbols = (uint32_t) 0;
+  self->num_symbols = (uint32_t) 0;
+  self->arena = NULL;
+  self->max_arena_bytes = (uint64_t) 0;
+  self->arena_bytes = (uint64_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_intern(
+        utf8lex_intern_table_t *self,
+        unsigned char *bytes,
+        uint64_t length_bytes,
+        uint64_t hash,  // Hash of the bytes, see utf8lex_hash_concat().
+        uint32_t *symbol_id_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || self->slots == NULL
+      || (bytes == NULL && length_bytes > (uint64_t) 0)
+      || symbol_id_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  // Linear probing, until we find the symbol or an empty slot:
+  uint32_t mask = self->num_slots - (uint32_t) 1;
+  uint32_t slot = utf8lex_intern_slot(self, hash);
+  while (self->slots[slot] != (uint32_t) 0)
+  {
+    uint32_t symbol_id = self->slots[slot] - (uint32_t) 1;
+    utf8lex_symbol_t *symbol = &(self->symbols[symbol_id]);
+    if (symbol->hash == hash
+        && symbol->length_bytes == length_bytes
+        && memcmp(&(self->arena[symbol->arena_offset]),
+                  bytes,
+                  (size_t) length_bytes) == 0)
+    {
+      // Seen it before.
+      *symbol_id_pointer = symbol_id;
+      return UTF8LEX_OK;
+    }
+
+    slot = (slot + (uint32_t) 1) & mask;
+  }
+
+  // A new symbol.  Copy its bytes into the arena, this one time only.
+  if (self->num_symbols >= self->max_symbols
+      || length_bytes > (self->max_arena_bytes - self->arena_bytes))
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  uint32_t symbol_id = self->num_symbols;
+  utf8lex_symbol_t *symbol = &(self->symbols[symbol_id]);
+  symbol->hash = hash;
+  symbol->arena_offset = self->arena_bytes;
+  symbol->length_bytes = length_bytes;
+  if (bytes != &(self->arena[self->arena_bytes]))
+  {
+    // (Unless the caller already copied the bytes there as scratch.)
+    memcpy(&(self->arena[self->arena_bytes]), bytes, (size_t) length_bytes);
+  }
+
+  self->arena_bytes += length_bytes;
+  self->num_symbols ++;
+  self->slots[slot] = symbol_id + (uint32_t) 1;
+
+  *symbol_id_pointer = symbol_id;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_intern_table_symbol(
+        utf8lex_intern_table_t *self,
+        uint32_t symbol_id,
+        unsigned char **bytes_pointer,  // Mutable.
+        uint64_t *length_bytes_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || bytes_pointer == NULL
+      || length_bytes_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (symbol_id >= self->num_symbols)
+  {
+    return UTF8LEX_ERROR_NOT_FOUND;
+  }
+
+  utf8lex_symbol_t *symbol = &(self->symbols[symbol_id]);
+  *bytes_pointer = &(self->arena[symbol->arena_offset]);
+  *length_bytes_pointer = symbol->length_bytes;
+
+  return UTF8LEX_OK;
+}
@@ -26,19 +26,13 @@
 //                            utf8lex_lex()
 // ---------------------------------------------------------------------
 
-utf8lex_error_t utf8lex_lex(
-        utf8lex_rule_t *first_rule,
-        utf8lex_state_t *state,
-        utf8lex_token_t *token_pointer
+// Initializes the state's locations on the first call (or the first
+// call after switching to an included source).  Called once per call
+// to utf8lex_lex(), utf8lex_lex_batch() etc., rather than per token.
+static inline void utf8lex_lex_begin(
+        utf8lex_state_t *state
         )
 {
-  if (first_rule == NULL
-      || state == NULL
-      || token_pointer == NULL)
-  {
-    return UTF8LEX_ERROR_NULL_POINTER;
-  }
-
   if (state->loc[UTF8LEX_UNIT_BYTE].start < 0)
   {
     for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
@@ -50,107 +44,812 @@ utf8lex_error_t utf8lex_lex(
       state->loc[unit].after = -1;
     }
   }
-  // EOF check:
-  else if (state->buffer->loc[UTF8LEX_UNIT_BYTE].start
-           >= state->buffer->str->length_bytes)
+}
+
+// Called once the current buffer has been lexed to the end: moves on
+// to the next buffer in the chain, if there is one, or back to the
+// source that the current one was included from.
+// Returns UTF8LEX_OK if there is something to lex.
+static utf8lex_error_t utf8lex_lex_next_buffer(
+        utf8lex_state_t *state
+        )
+{
+  while (state->buffer->loc[UTF8LEX_UNIT_BYTE].start
+         >= state->buffer->str->length_bytes)
   {
     // We've lexed to the end of the buffer.
-    if (state->buffer->next == NULL)
+    if (state->buffer->next != NULL)
     {
-      if (state->buffer->is_eof == true)
-      {
-        // Done lexing.
-        return UTF8LEX_EOF;
-      }
-      else
+      // Move on to the next buffer in the chain.
+      state->buffer = state->buffer->next;
+      break;
+    }
+    else if (state->buffer->is_eof == true
+             && state->num_includes > (uint32_t) 0)
+    {
+      // Done lexing an included source: back to the one it was
+      // included from.
+      utf8lex_error_t error = utf8lex_state_pop_buffer(state);
+      if (error != UTF8LEX_OK)
       {
-        // Please, sir, may I have some more?
-        return UTF8LEX_MORE;
+        return error;
       }
+      utf8lex_lex_begin(state);
     }
+    else if (state->buffer->is_eof == true)
+    {
+      // Done lexing.
+      return UTF8LEX_EOF;
+    }
+    else
+    {
+      // Please, sir, may I have some more?
+      return UTF8LEX_MORE;
+    }
+  }
+
+  return UTF8LEX_OK;
+}
+
+// Checks for the end of the current buffer before each token
+// (a stream's buffer starts out empty).
+// Returns UTF8LEX_OK if there is something to lex.
+static inline utf8lex_error_t utf8lex_lex_start(
+        utf8lex_state_t *state
+        )
+{
+  if (state->buffer->loc[UTF8LEX_UNIT_BYTE].start
+      < state->buffer->str->length_bytes)
+  {
+    // Still bytes left to lex in the current buffer.
+    return UTF8LEX_OK;
+  }
+
+  return utf8lex_lex_next_buffer(state);
+}
 
-    // Move on to the next buffer in the chain.
+// Refills the state's stream, maps the next window, or appends
+// the reader's next buffer (if it has any of them) after a definition
+// or utf8lex_lex_start() asked for MORE.
+// Returns UTF8LEX_OK if lexing can start over with more bytes, otherwise
+// an error (never UTF8LEX_OK without more bytes, or lexing would spin).
+static inline utf8lex_error_t utf8lex_lex_more(
+        utf8lex_state_t *state
+        )
+{
+  if (state->stream != NULL)
+  {
+    return utf8lex_stream_refill(state->stream,  // self
+                                 state);  // state
+  }
+  else if (state->window != NULL)
+  {
+    return utf8lex_window_advance(state->window,  // self
+                                  state);  // state
+  }
+  else if (state->reader != NULL)
+  {
+    return utf8lex_reader_next(state->reader,  // self
+                               state);  // state
+  }
+
+  return UTF8LEX_MORE;
+}
+
+// Sets the token's symbol id from the state's intern table, using
+// the hash that the lexer computed while matching the token's bytes.
+static inline utf8lex_error_t utf8lex_lex_intern(
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  // A token that straddles buffers is copied into the free end
+  // of the table's arena, which is where it would be stored anyway
+  // if it is a new symbol (see utf8lex_intern()).
+  utf8lex_intern_table_t *intern_table = state->intern_table;
+  unsigned char *bytes = NULL;
+  utf8lex_error_t error = utf8lex_token_contiguous(
+      token_pointer,  // self
+      &(intern_table->arena[intern_table->arena_bytes]),  // scratch
+      (size_t) (intern_table->max_arena_bytes
+                - intern_table->arena_bytes),  // max_scratch_bytes
+      &bytes);  // bytes_pointer
+  if (error == UTF8LEX_MORE)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+  else if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  return utf8lex_intern(
+      intern_table,  // self
+      bytes,  // bytes
+      (uint64_t) token_pointer->length_bytes,  // length_bytes
+      token_pointer->loc[UTF8LEX_UNIT_BYTE].hash,  // hash
+      &(token_pointer->symbol_id));  // symbol_id_pointer
+}
+
+// Adds the token's new lines to the state's line index, one buffer's
+// slice of the token at a time.
+static utf8lex_error_t utf8lex_lex_index_lines(
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  utf8lex_buffer_t *buffer = token_pointer->buffer;
+  utf8lex_string_t *str = token_pointer->str;
+  size_t offset = (size_t) token_pointer->start_byte;
+  size_t remaining_bytes = (size_t) token_pointer->length_bytes;
+  uint64_t start_byte = (uint64_t) token_pointer->loc[UTF8LEX_UNIT_BYTE].start;
+  while (true)
+  {
+    size_t slice_bytes = str->length_bytes - offset;
+    if (slice_bytes > remaining_bytes)
+    {
+      slice_bytes = remaining_bytes;
+    }
+
+    utf8lex_error_t error = utf8lex_line_index_add(
+        state->line_index,  // self
+        &(str->bytes[offset]),  // bytes
+        slice_bytes,  // length_bytes
+        start_byte);  // start_byte
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    remaining_bytes -= slice_bytes;
+    start_byte += (uint64_t) slice_bytes;
+    if (remaining_bytes == (size_t) 0)
+    {
+      return UTF8LEX_OK;
+    }
+    else if (buffer == NULL
+             || buffer->next == NULL
+             || buffer->next->str == NULL)
+    {
+      return UTF8LEX_ERROR_BAD_LENGTH;
+    }
+
+    // The token carries on into the next buffer:
+    buffer = buffer->next;
+    str = buffer->str;
+    offset = (size_t) 0;
+  }
+}
+
+// Moves the buffer and absolute state locations past the matched token,
+// and adds any new lines to the state's line index.
+static utf8lex_error_t utf8lex_lex_advance(
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  // Any progress saved before MORE was for a token that is done now:
+  state->resume.rule = NULL;
+
+  if (state->line_index != NULL
+      && (state->location_mode == UTF8LEX_LOCATION_MODE_LAZY
+          || token_pointer->loc[UTF8LEX_UNIT_LINE].length > 0))
+  {
+    utf8lex_error_t error = utf8lex_lex_index_lines(state,  // state
+                                                    token_pointer);
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+  }
+
+  // A token that straddles buffers ends in one of the next buffer(s)
+  // in the chain, which becomes the current buffer:
+  int64_t end_byte = state->buffer->loc[UTF8LEX_UNIT_BYTE].start
+    + token_pointer->length_bytes;
+  while (end_byte > (int64_t) state->buffer->str->length_bytes
+         && state->buffer->next != NULL)
+  {
+    end_byte -= (int64_t) state->buffer->str->length_bytes;
     state->buffer = state->buffer->next;
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      // Adding the token's lengths (below) moves the buffer's byte
+      // location to end_byte.  (Chars, graphemes and lines are counted
+      // from the start of the token, we don't know how many were
+      // in this buffer.)
+      state->buffer->loc[unit].start =
+        (unit == UTF8LEX_UNIT_BYTE)
+        ? end_byte - token_pointer->length_bytes
+        : 0;
+    }
+  }
+
+  if (state->location_mode == UTF8LEX_LOCATION_MODE_LAZY)
+  {
+    // Only bytes are tracked, see utf8lex_location_resolve().
+    int64_t length_bytes = token_pointer->length_bytes;
+    state->buffer->loc[UTF8LEX_UNIT_BYTE].start += length_bytes;
+    state->loc[UTF8LEX_UNIT_BYTE].start += length_bytes;
+    return UTF8LEX_OK;
+  }
+
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    // Update buffer and absolute state locations past end of this token:
+    if (token_pointer->loc[unit].after == -1)
+    {
+      int64_t length_units = token_pointer->loc[unit].length;
+      state->buffer->loc[unit].start += length_units;
+      state->loc[unit].start += length_units;
+    }
+    else
+    {
+      // Chars, graphemes reset at newline:
+      state->buffer->loc[unit].start = token_pointer->loc[unit].after;
+      state->loc[unit].start = token_pointer->loc[unit].after;
+    }
+    state->buffer->loc[unit].length = 0;
+    state->loc[unit].length = 0;
+    state->buffer->loc[unit].after = -1;
+    state->loc[unit].after = -1;
   }
 
-  utf8lex_rule_t *matched = NULL;
+  return UTF8LEX_OK;
+}
+
+// Tries each of the rules (that are active in the mode) in turn,
+// calling its definition_type's lexer.  Returns UTF8LEX_OK with
+// the matched rule's is_interned and is_skip, UTF8LEX_NO_MATCH,
+// UTF8LEX_MORE, or an error.
+static inline utf8lex_error_t utf8lex_lex_match_rules(
+        utf8lex_rule_t *first_rule,
+        uint32_t mode_mask,  // Only try the rules active in this mode.
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer,
+        bool *is_interned_pointer,
+        bool *is_skip_pointer
+        )
+{
   for (utf8lex_rule_t *rule = first_rule;
        rule != NULL;
        rule = rule->next)
   {
-    utf8lex_error_t error;
-    if (rule->definition == NULL
-        || rule->definition->definition_type == NULL
-        || rule->definition->definition_type->lex == NULL)
+    if ((rule->modes & mode_mask) == (uint32_t) 0)
     {
-      error = UTF8LEX_ERROR_NULL_POINTER;
-      break;
+      // The rule is not active in the current mode.
+      continue;
+    }
+    else if (rule->definition == NULL
+             || rule->definition->definition_type == NULL
+             || rule->definition->definition_type->lex == NULL)
+    {
+      return UTF8LEX_ERROR_NULL_POINTER;
     }
 
     // Call the definition_type's lexer.  On successful tokenization,
     // it will set the absolute offset and lengths of the token
     // (and optionally update the lengths stored in the buffer
     // and absolute state).
-    error = rule->definition->definition_type->lex(
+    utf8lex_error_t error = rule->definition->definition_type->lex(
         rule,
         state,
         token_pointer);
-
     if (error == UTF8LEX_NO_MATCH)
     {
       // Did not match this one rule.  Carry on with the loop.
       continue;
     }
-    else if (error == UTF8LEX_MORE)
+    else if (error == UTF8LEX_OK)
     {
-      // Need to read more bytes before trying again.
-      return error;
+      *is_interned_pointer = rule->is_interned;
+      *is_skip_pointer = rule->is_skip;
     }
-    else if (error == UTF8LEX_OK)
+
+    // Matched, need more bytes, or some other error.
+    return error;
+  }
+
+  return UTF8LEX_NO_MATCH;
+}
+
+
+// ---------------------------------------------------------------------
+//                          utf8lex_program_lex()
+// ---------------------------------------------------------------------
+
+// Matches a compiled literal instruction, comparing the bytes
+// that were copied into the instruction before touching the definition.
+static inline utf8lex_error_t utf8lex_program_lex_literal(
+        utf8lex_instruction_t *instruction,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  off_t offset = (off_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
+  size_t remaining_bytes = state->buffer->str->length_bytes - (size_t) offset;
+  unsigned char *bytes = &(state->buffer->str->bytes[offset]);
+  size_t token_length_bytes = (size_t) instruction->length_bytes;
+
+  utf8lex_literal_definition_t *literal =
+    (utf8lex_literal_definition_t *) instruction->definition;
+  for (size_t c = (size_t) 0;
+       c < remaining_bytes && c < token_length_bytes;
+       c ++)
+  {
+    unsigned char expected = (c < (size_t) UTF8LEX_INSTRUCTION_LITERAL_MAX)
+      ? instruction->literal[c]
+      : literal->str[c];
+    if (bytes[c] != expected)
     {
-      // Matched the rule.  Break out of the loop.
-      matched = rule;
-      break;
+      return UTF8LEX_NO_MATCH;
     }
-    else
+  }
+
+  if (remaining_bytes < token_length_bytes)
+  {
+    // The rest of the literal (if any) is in the next buffer(s).
+    utf8lex_error_t error = utf8lex_lex_literal_chain(
+        state,  // state
+        literal->str,  // literal_bytes
+        token_length_bytes);  // length_bytes
+    if (error != UTF8LEX_OK)
     {
-      // Some other error.  Return the error to the caller.
       return error;
     }
   }
 
-  // If we get this far, we've either 1) matched a rule,
-  // or 2) not matched any rule.
-  if (matched == NULL)
+  // Matched the literal exactly.
+  utf8lex_location_t codepoint_loc[UTF8LEX_UNIT_MAX];
+  utf8lex_location_t *literal_loc = NULL;
+  utf8lex_error_t error = utf8lex_literal_locations(
+      literal,  // self
+      state->granularity,  // granularity
+      codepoint_loc,  // scratch
+      &literal_loc);  // loc_pointer
+  if (error != UTF8LEX_OK)
   {
-    return UTF8LEX_NO_MATCH;
+    return error;
   }
-
-  // We have a match.
+  utf8lex_location_t token_loc[UTF8LEX_UNIT_MAX];
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
        unit < UTF8LEX_UNIT_MAX;
        unit ++)
   {
-    int after = token_pointer->loc[unit].after;
+    // The literal's optional units were all counted up front,
+    // but only the units that the state counts are kept:
+    bool is_counted = (state->units & ((uint32_t) 1 << unit))
+      ? true
+      : false;
+    token_loc[unit].start = state->loc[unit].start;
+    token_loc[unit].length = (is_counted == true)
+      ? literal_loc[unit].length
+      : (int64_t) 0;
+    token_loc[unit].after = (is_counted == true)
+      ? literal_loc[unit].after  // -1 or new location.
+      : (int64_t) -1;
+    token_loc[unit].hash = (is_counted == true)
+      ? literal_loc[unit].hash
+      : (uint64_t) 0;
+  }
 
-    // Update buffer and absolute state locations past end of this token:
-    if (token_pointer->loc[unit].after == -1)
+  return utf8lex_token_init(
+      token_pointer,  // self
+      instruction->rule,  // rule
+      instruction->definition,  // definition
+      token_loc,  // Resets for newlines, and lengths in bytes, chars, etc.
+      state);  // For buffer and absolute location.
+}
+
+// Tries each of the instructions from first_instruction up to
+// (but not including) end_instruction, i.e. the instructions
+// of the current mode, in turn.  Returns the same as
+// utf8lex_lex_match_rules().
+static inline utf8lex_error_t utf8lex_program_match(
+        utf8lex_instruction_t *first_instruction,
+        utf8lex_instruction_t *end_instruction,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer,
+        bool *is_interned_pointer,
+        bool *is_skip_pointer
+        )
+{
+  // The rules were all checked by utf8lex_program_compile(),
+  // so no NULL or definition_type checks in here.
+  for (utf8lex_instruction_t *instruction = first_instruction;
+       instruction < end_instruction;
+       instruction ++)
+  {
+    utf8lex_error_t error;
+    switch (instruction->opcode)
     {
-      int length_units = token_pointer->loc[unit].length;
-      state->buffer->loc[unit].start += length_units;
-      state->loc[unit].start += length_units;
+    case UTF8LEX_OPCODE_CAT:
+      error = utf8lex_lex_cat_unchecked(
+          instruction->rule,  // rule
+          instruction->cat,  // cat_mask
+          instruction->min,  // min
+          instruction->max,  // max
+          state,  // state
+          token_pointer);  // token_pointer
+      break;
+    case UTF8LEX_OPCODE_LITERAL:
+      error = utf8lex_program_lex_literal(
+          instruction,  // instruction
+          state,  // state
+          token_pointer);  // token_pointer
+      break;
+    case UTF8LEX_OPCODE_REGEX:
+      error = utf8lex_lex_regex_unchecked(
+          instruction->rule,  // rule
+          instruction->regex,  // regex
+          instruction->num_captures,  // num_captures
+          state,  // state
+          token_pointer);  // token_pointer
+      break;
+    case UTF8LEX_OPCODE_MULTI:
+      error = utf8lex_lex_multi_unchecked(
+          instruction->rule,  // rule
+          (utf8lex_multi_definition_t *) instruction->definition,  // multi
+          state,  // state
+          token_pointer);  // token_pointer
+      break;
+    case UTF8LEX_OPCODE_CUSTOM:
+      error = instruction->lex(
+          instruction->rule,  // rule
+          state,  // state
+          token_pointer);  // token_pointer
+      break;
+    default:
+      return UTF8LEX_ERROR_STATE;
     }
-    else
+
+    if (error == UTF8LEX_NO_MATCH)
     {
-      // Chars, graphemes reset at newline:
-      state->buffer->loc[unit].start = token_pointer->loc[unit].after;
-      state->loc[unit].start = token_pointer->loc[unit].after;
+      // Did not match this one rule.  Carry on with the loop.
+      continue;
     }
-    state->buffer->loc[unit].length = 0;
-    state->loc[unit].length = 0;
-    state->buffer->loc[unit].after = -1;
-    state->loc[unit].after = -1;
+    else if (error == UTF8LEX_OK)
+    {
+      *is_interned_pointer = instruction->is_interned;
+      *is_skip_pointer = instruction->is_skip;
+    }
+
+    // Matched, need more bytes, or some other error.
+    return error;
   }
 
-  return UTF8LEX_OK;
+  return UTF8LEX_NO_MATCH;
+}
+
+
+// ---------------------------------------------------------------------
+//                          utf8lex_lex_token()
+// ---------------------------------------------------------------------
+
+// Lexes one token, either with the rules db (first_instruction NULL)
+// or with the program's instructions for the current mode.
+// The one loop shared by utf8lex_lex(), utf8lex_program_lex()
+// and the batch lexers: start (or move on to the next buffer),
+// get more bytes when asked, match, intern, advance, and consume
+// skip tokens.  The caller checks the arguments and has already called
+// utf8lex_lex_begin(); both are done once per call, not per token.
+// If is_refillable is false, returns UTF8LEX_MORE instead of refilling
+// (see utf8lex_lex_batch()).
+static inline utf8lex_error_t utf8lex_lex_token(
+        utf8lex_rule_t *first_rule,  // Or NULL for a program.
+        uint32_t mode_mask,  // Rules db only: the current mode.
+        utf8lex_instruction_t *first_instruction,  // Or NULL for rules db.
+        utf8lex_instruction_t *end_instruction,
+        bool is_refillable,  // Can the stream / window / reader move on?
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  // Tokens matching skip rules are consumed inside this loop,
+  // instead of being returned to the caller.
+  while (true)
+  {
+    utf8lex_error_t error = utf8lex_lex_start(state);
+    if (error == UTF8LEX_OK)
+    {
+      bool is_interned = false;
+      bool is_skip = false;
+      if (first_instruction != NULL)
+      {
+        error = utf8lex_program_match(first_instruction,
+                                      end_instruction,
+                                      state,
+                                      token_pointer,
+                                      &is_interned,
+                                      &is_skip);
+      }
+      else
+      {
+        error = utf8lex_lex_match_rules(first_rule,
+                                        mode_mask,
+                                        state,
+                                        token_pointer,
+                                        &is_interned,
+                                        &is_skip);
+      }
+
+      if (error == UTF8LEX_OK)
+      {
+        // We have a match.
+        if (is_interned == true
+            && state->intern_table != NULL)
+        {
+          error = utf8lex_lex_intern(state, token_pointer);
+          if (error != UTF8LEX_OK)
+          {
+            return error;
+          }
+        }
+
+        error = utf8lex_lex_advance(state, token_pointer);
+        if (error != UTF8LEX_OK)
+        {
+          return error;
+        }
+
+        if (is_skip == false)
+        {
+          return UTF8LEX_OK;
+        }
+        else if (token_pointer->length_bytes == 0)
+        {
+          // An empty skip token would be skipped forever.
+          return UTF8LEX_ERROR_INFINITE_LOOP;
+        }
+        continue;
+      }
+    }
+
+    if (error == UTF8LEX_MORE
+        && is_refillable == true)
+    {
+      // Start the token over again, with more bytes (if we can get them).
+      error = utf8lex_lex_more(state);
+      if (error != UTF8LEX_OK)
+      {
+        return error;
+      }
+      continue;
+    }
+
+    // EOF, NO_MATCH or some other error.
+    return error;
+  }
+}
+
+utf8lex_error_t utf8lex_lex(
+        utf8lex_rule_t *first_rule,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  if (first_rule == NULL
+      || state == NULL
+      || token_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (state->mode >= (uint32_t) UTF8LEX_MODES_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  utf8lex_lex_begin(state);
+
+  // Only try the rules that are active in the current mode:
+  return utf8lex_lex_token(first_rule,  // first_rule
+                           (uint32_t) 1 << state->mode,  // mode_mask
+                           NULL,  // first_instruction
+                           NULL,  // end_instruction
+                           true,  // is_refillable
+                           state,  // state
+                           token_pointer);  // token_pointer
+}
+
+utf8lex_error_t utf8lex_program_lex(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_token_t *token_pointer
+        )
+{
+  if (program == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || state->buffer->str == NULL
+      || token_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (state->mode >= program->num_modes)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  // Only the instructions for the current mode:
+  utf8lex_instruction_t *first_instruction =
+    &(program->instructions[program->mode_first[state->mode]]);
+  utf8lex_instruction_t *end_instruction =
+    first_instruction + program->mode_length[state->mode];
+
+  utf8lex_lex_begin(state);
+
+  return utf8lex_lex_token(NULL,  // first_rule
+                           (uint32_t) 0,  // mode_mask
+                           first_instruction,  // first_instruction
+                           end_instruction,  // end_instruction
+                           true,  // is_refillable
+                           state,  // state
+                           token_pointer);  // token_pointer
+}
+
+
+// ---------------------------------------------------------------------
+//                        utf8lex_lex_batch()
+// ---------------------------------------------------------------------
+
+// Refilling the stream, advancing the window or recycling the reader's
+// buffers would move or unmap the bytes of the tokens already lexed
+// in the batch, so only the first token of a batch refills.  A batch
+// that stopped to refill returns its tokens with UTF8LEX_OK, and the
+// next call refills before lexing its first token.
+static inline utf8lex_error_t utf8lex_lex_batch_error(
+        utf8lex_state_t *state,
+        uint32_t num_tokens,
+        utf8lex_error_t error
+        )
+{
+  if (error == UTF8LEX_MORE
+      && num_tokens > (uint32_t) 0
+      && (state->stream != NULL
+          || state->window != NULL
+          || state->reader != NULL))
+  {
+    return UTF8LEX_OK;
+  }
+
+  return error;
+}
+
+utf8lex_error_t utf8lex_lex_batch(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_token_t *tokens,  // Array of (at least) max_tokens tokens.
+        uint32_t max_tokens,
+        uint32_t *num_tokens_pointer  // Number of tokens lexed.
+        )
+{
+  if (program == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || state->buffer->str == NULL
+      || tokens == NULL
+      || num_tokens_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  *num_tokens_pointer = (uint32_t) 0;
+
+  if (state->mode >= program->num_modes)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  // No rule code runs in between tokens, so the mode cannot change
+  // during the batch: look up its instructions once, up front.
+  utf8lex_instruction_t *first_instruction =
+    &(program->instructions[program->mode_first[state->mode]]);
+  utf8lex_instruction_t *end_instruction =
+    first_instruction + program->mode_length[state->mode];
+
+  // The state's locations are set up once for the whole batch,
+  // only the end of buffer check is done per token:
+  utf8lex_lex_begin(state);
+
+  uint32_t num_tokens = (uint32_t) 0;
+  utf8lex_error_t error = UTF8LEX_OK;
+  while (num_tokens < max_tokens)
+  {
+    error = utf8lex_lex_token(NULL,  // first_rule
+                              (uint32_t) 0,  // mode_mask
+                              first_instruction,  // first_instruction
+                              end_instruction,  // end_instruction
+                              (num_tokens == (uint32_t) 0)
+                              ? true
+                              : false,  // is_refillable
+                              state,  // state
+                              &(tokens[num_tokens]));  // token_pointer
+    if (error != UTF8LEX_OK)
+    {
+      // MORE, EOF, NO_MATCH or an error.  The tokens lexed
+      // so far are still good.
+      break;
+    }
+
+    num_tokens ++;
+  }
+
+  *num_tokens_pointer = num_tokens;
+
+  return utf8lex_lex_batch_error(state,  // state
+                                 num_tokens,  // num_tokens
+                                 error);  // error
+}
+
+utf8lex_error_t utf8lex_lex_batch_compact(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_compact_token_t *tokens,  // At least max_tokens tokens.
+        uint32_t max_tokens,
+        uint32_t *num_tokens_pointer  // Number of tokens lexed.
+        )
+{
+  if (program == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || state->buffer->str == NULL
+      || tokens == NULL
+      || num_tokens_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  *num_tokens_pointer = (uint32_t) 0;
+
+  if (state->mode >= program->num_modes)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  utf8lex_instruction_t *first_instruction =
+    &(program->instructions[program->mode_first[state->mode]]);
+  utf8lex_instruction_t *end_instruction =
+    first_instruction + program->mode_length[state->mode];
+
+  utf8lex_lex_begin(state);
+
+  // Each token is lexed into the same full token, then packed:
+  utf8lex_token_t token;
+  uint32_t num_tokens = (uint32_t) 0;
+  utf8lex_error_t error = UTF8LEX_OK;
+  while (num_tokens < max_tokens)
+  {
+    error = utf8lex_lex_token(NULL,  // first_rule
+                              (uint32_t) 0,  // mode_mask
+                              first_instruction,  // first_instruction
+                              end_instruction,  // end_instruction
+                              (num_tokens == (uint32_t) 0)
+                              ? true
+                              : false,  // is_refillable
+                              state,  // state
+                              &token);  // token_pointer
+    if (error != UTF8LEX_OK)
+    {
+      break;
+    }
+
+    error = utf8lex_compact_token_init(&(tokens[num_tokens]),  // self
+                                       &token);  // token
+    if (error != UTF8LEX_OK)
+    {
+      break;
+    }
+
+    num_tokens ++;
+  }
+
+  *num_tokens_pointer = num_tokens;
+
+  return utf8lex_lex_batch_error(state,  // state
+                                 num_tokens,  // num_tokens
+                                 error);  // error
 }
@@ -0,0 +1,568 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int32_t, int64_t, uint32_t, uint64_t.
+#include <stdbool.h>  // For bool, true, false.
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                         utf8lex_line_index_t
+// ---------------------------------------------------------------------
+
+utf8lex_error_t utf8lex_line_index_init(
+        utf8lex_line_index_t *self,
+        uint64_t *line_starts,  // Array of (at least) max_lines line starts.
+        uint32_t max_lines
+        )
+{
+  if (self == NULL
+      || line_starts == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->line_starts = line_starts;
+  self->max_lines = max_lines;
+  self->num_lines = (uint32_t) 0;
+  self->is_after_cr = false;
+  self->num_partial = (uint32_t) 0;
+  self->end_byte = (uint64_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_line_index_clear(
+        utf8lex_line_index_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->line_starts = NULL;
+  self->max_lines = (uint32_t) 0;
+  self->num_lines = (uint32_t) 0;
+  self->is_after_cr = false;
+  self->num_partial = (uint32_t) 0;
+  self->end_byte = (uint64_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+// The length of the multi-byte line separator (NEL, LINE SEPARATOR
+// or PARAGRAPH SEPARATOR) at the start of the specified bytes, 0 if
+// there is none, or -1 if the bytes end part way through one.
+static inline int utf8lex_line_index_separator(
+        unsigned char *bytes,
+        size_t length_bytes
+        )
+{
+  if (length_bytes < (size_t) 2)
+  {
+    return -1;
+  }
+  else if (bytes[0] == (unsigned char) 0xC2)
+  {
+    return (bytes[1] == (unsigned char) 0x85)
+      ? 2
+      : 0;
+  }
+  else if (bytes[1] != (unsigned char) 0x80)
+  {
+    return 0;
+  }
+  else if (length_bytes < (size_t) 3)
+  {
+    return -1;
+  }
+
+  return (bytes[2] == (unsigned char) 0xA8
+          || bytes[2] == (unsigned char) 0xA9)
+    ? 3
+    : 0;
+}
+
+utf8lex_error_t utf8lex_line_index_add(
+        utf8lex_line_index_t *self,
+        unsigned char *bytes,
+        size_t length_bytes,
+        uint64_t start_byte  // Absolute byte offset of bytes[0].
+        )
+{
+  if (self == NULL
+      || self->line_starts == NULL
+      || bytes == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (length_bytes == (size_t) 0)
+  {
+    return UTF8LEX_OK;
+  }
+
+  // The same line separators as utf8lex_read_grapheme() counts
+  // (see utf8lex_cat_codepoint()), straight from the UTF-8 bytes:
+  //
+  //     LF, VT, FF, CR (unless followed by LF):  0x0A - 0x0D
+  //     NEXT LINE (NEL) U+0085:                   0xC2 0x85
+  //     LINE SEPARATOR U+2028:                    0xE2 0x80 0xA8
+  //     PARAGRAPH SEPARATOR U+2029:               0xE2 0x80 0xA9
+  //
+  // Every other byte is skipped with a single comparison.
+  //
+  // A line separator can also be split between the last bytes added
+  // and these ones (a CR, LF split between tokens, or a multi-byte
+  // separator split between buffers).
+  bool is_after_cr = self->is_after_cr;
+  uint32_t num_partial = self->num_partial;
+  bool is_contiguous = (start_byte == self->end_byte)
+    ? true
+    : false;
+  self->is_after_cr = false;
+  self->num_partial = (uint32_t) 0;
+  self->end_byte = start_byte + (uint64_t) length_bytes;
+
+  size_t b = (size_t) 0;
+  if (is_contiguous == true
+      && is_after_cr == true
+      && bytes[0] == (unsigned char) 0x0A)
+  {
+    // The last bytes ended with a CR, and these start with its LF:
+    // the LF (below) ends the line, not the CR.
+    self->num_lines --;
+  }
+  else if (is_contiguous == true
+           && num_partial > (uint32_t) 0)
+  {
+    // Finish the separator that the last bytes started:
+    unsigned char joined[3];
+    size_t num_joined = (size_t) 0;
+    for (uint32_t p = (uint32_t) 0; p < num_partial; p ++)
+    {
+      joined[num_joined] = self->partial[p];
+      num_joined ++;
+    }
+    for (size_t j = (size_t) 0;
+         j < length_bytes && num_joined < (size_t) 3;
+         j ++)
+    {
+      joined[num_joined] = bytes[j];
+      num_joined ++;
+    }
+
+    int separator_bytes = utf8lex_line_index_separator(joined,  // bytes
+                                                       num_joined);
+    if (separator_bytes < 0)
+    {
+      // Still part way through the separator.
+      for (size_t j = (size_t) 0; j < num_joined; j ++)
+      {
+        self->partial[j] = joined[j];
+      }
+      self->num_partial = (uint32_t) num_joined;
+      return UTF8LEX_OK;
+    }
+    else if (separator_bytes > 0)
+    {
+      b = (size_t) separator_bytes - (size_t) num_partial;
+      if (self->num_lines >= self->max_lines)
+      {
+        return UTF8LEX_OK;
+      }
+      self->line_starts[self->num_lines] = start_byte + (uint64_t) b;
+      self->num_lines ++;
+    }
+  }
+
+  for (; b < length_bytes; b ++)
+  {
+    unsigned char byte = bytes[b];
+    size_t after = (size_t) 0;  // Relative offset of the new line, if any.
+    if (byte > (unsigned char) 0x0D
+        && byte != (unsigned char) 0xC2
+        && byte != (unsigned char) 0xE2)
+    {
+      continue;
+    }
+    else if (byte == (unsigned char) 0x0D)
+    {
+      if ((b + (size_t) 1) < length_bytes
+          && bytes[b + 1] == (unsigned char) 0x0A)
+      {
+        // CR, LF is one line separator; the LF ends the line.
+        continue;
+      }
+      after = b + (size_t) 1;
+      if (after == length_bytes
+          && self->num_lines < self->max_lines)
+      {
+        // Its LF, if any, is at the start of the next bytes added.
+        self->is_after_cr = true;
+      }
+    }
+    else if (byte >= (unsigned char) 0x0A
+             && byte <= (unsigned char) 0x0D)
+    {
+      after = b + (size_t) 1;
+    }
+    else if (byte == (unsigned char) 0xC2
+             || byte == (unsigned char) 0xE2)
+    {
+      int separator_bytes = utf8lex_line_index_separator(
+          &(bytes[b]),  // bytes
+          length_bytes - b);  // length_bytes
+      if (separator_bytes < 0)
+      {
+        // The rest of the separator (if it is one) is at the start
+        // of the next bytes added.
+        for (size_t p = b; p < length_bytes; p ++)
+        {
+          self->partial[p - b] = bytes[p];
+        }
+        self->num_partial = (uint32_t) (length_bytes - b);
+        return UTF8LEX_OK;
+      }
+      else if (separator_bytes == 0)
+      {
+        continue;
+      }
+      after = b + (size_t) separator_bytes;
+    }
+    else
+    {
+      continue;
+    }
+
+    if (self->num_lines >= self->max_lines)
+    {
+      // No room for more lines.  They'll be found by reading,
+      // from the last indexed line, when they are resolved.
+      return UTF8LEX_OK;
+    }
+
+    self->line_starts[self->num_lines] = start_byte + (uint64_t) after;
+    self->num_lines ++;
+    b = after - (size_t) 1;
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// ---------------------------------------------------------------------
+//                        utf8lex_location_read()
+// ---------------------------------------------------------------------
+
+utf8lex_error_t utf8lex_location_read(
+        utf8lex_state_t *state,
+        uint64_t start_byte,  // Absolute byte offset.
+        uint64_t end_byte,  // Absolute byte offset, >= start_byte.
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX],  // Mutable.
+        utf8lex_buffer_t **buffer_pointer,  // Mutable, or NULL.
+        off_t *offset_pointer  // Mutable, or NULL.
+        )
+{
+  if (state == NULL
+      || state->buffer == NULL
+      || loc == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (end_byte < start_byte)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  // Start reading at the start of the line, if it's in the line index,
+  // otherwise at absolute byte 0:
+  uint64_t line_start_byte = (uint64_t) 0;
+  uint32_t line = (uint32_t) 0;
+  if (state->line_index != NULL
+      && state->line_index->num_lines > (uint32_t) 0)
+  {
+    // Binary search for the last line start <= start_byte:
+    uint32_t low = (uint32_t) 0;
+    uint32_t high = state->line_index->num_lines;
+    while (low < high)
+    {
+      uint32_t middle = low + ((high - low) / (uint32_t) 2);
+      if (state->line_index->line_starts[middle] <= start_byte)
+      {
+        low = middle + (uint32_t) 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    // low lines start at or before start_byte.
+    line = low;
+    if (line > (uint32_t) 0)
+    {
+      line_start_byte = state->line_index->line_starts[line - 1];
+    }
+  }
+
+  // The first buffer in the chain starts at absolute byte 0.
+  // Skip whole buffers up to the one holding the start of the line.
+  utf8lex_buffer_t *buffer = state->buffer;
+  while (buffer->prev != NULL)
+  {
+    buffer = buffer->prev;
+  }
+  uint64_t buffer_start_byte = (uint64_t) 0;
+  while (buffer->next != NULL
+         && (buffer_start_byte + (uint64_t) buffer->str->length_bytes)
+            <= line_start_byte)
+  {
+    buffer_start_byte += (uint64_t) buffer->str->length_bytes;
+    buffer = buffer->next;
+  }
+  if ((buffer_start_byte + (uint64_t) buffer->str->length_bytes)
+      < line_start_byte)
+  {
+    return UTF8LEX_ERROR_BAD_START;
+  }
+
+  utf8lex_state_t read_state;
+  utf8lex_error_t error = utf8lex_state_init(&read_state,  // self
+                                             buffer);  // buffer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+  read_state.units = state->units;
+  read_state.granularity = state->granularity;
+
+  int64_t position[UTF8LEX_UNIT_MAX];
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    position[unit] = 0;  // Chars, graphemes start at 0 on every line.
+    loc[unit].start = -1;
+    loc[unit].length = 0;
+    loc[unit].after = -1;  // No reset.
+    loc[unit].hash = (uint64_t) 0;
+  }
+  position[UTF8LEX_UNIT_BYTE] = (int64_t) line_start_byte;
+  position[UTF8LEX_UNIT_LINE] = (int64_t) line;
+
+  // Read one grapheme at a time, from the start of the line
+  // to end_byte, keeping track of the absolute location in every unit.
+  uint64_t absolute_byte = line_start_byte;
+  off_t offset = (off_t) (line_start_byte - buffer_start_byte);
+  bool is_found = false;
+  while (true)
+  {
+    if ((size_t) offset >= read_state.buffer->str->length_bytes
+        && read_state.buffer->next != NULL)
+    {
+      read_state.buffer = read_state.buffer->next;
+      offset = (off_t) 0;
+      continue;
+    }
+
+    if (is_found == false
+        && absolute_byte == start_byte)
+    {
+      is_found = true;
+      for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+           unit < UTF8LEX_UNIT_MAX;
+           unit ++)
+      {
+        loc[unit].start = position[unit];
+      }
+      if (buffer_pointer != NULL)
+      {
+        *buffer_pointer = read_state.buffer;
+      }
+      if (offset_pointer != NULL)
+      {
+        *offset_pointer = offset;
+      }
+    }
+
+    if (absolute_byte >= end_byte)
+    {
+      break;
+    }
+    else if ((size_t) offset >= read_state.buffer->str->length_bytes)
+    {
+      // The bytes are not (or no longer) in the buffers.
+      return UTF8LEX_ERROR_BAD_START;
+    }
+
+    utf8lex_buffer_t *grapheme_buffer = read_state.buffer;
+    utf8lex_location_t grapheme_loc[UTF8LEX_UNIT_MAX];
+    int32_t codepoint = (int32_t) -1;
+    utf8lex_cat_t cat = UTF8LEX_CAT_NONE;
+    error = utf8lex_read_grapheme(
+        &read_state,  // state
+        &offset,  // offset_pointer
+        grapheme_loc,  // loc_pointer
+        &codepoint,  // codepoint_pointer
+        &cat);  // cat_pointer
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    // The grapheme might have straddled buffers in the chain:
+    for (utf8lex_buffer_t *skipped = grapheme_buffer;
+         skipped != read_state.buffer;
+         skipped = skipped->next)
+    {
+      offset -= (off_t) skipped->str->length_bytes;
+    }
+
+    uint64_t hash = (uint64_t) 0;
+    if (is_found == true)
+    {
+      hash = utf8lex_hash_concat(
+          loc[UTF8LEX_UNIT_BYTE].hash,  // hash1
+          grapheme_loc[UTF8LEX_UNIT_BYTE].hash,  // hash2
+          (uint64_t) grapheme_loc[UTF8LEX_UNIT_BYTE].length);  // length2_bytes
+    }
+
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      if (is_found == true)
+      {
+        // Same as the lexers: add up the lengths and hashes, the after
+        // location comes from the last grapheme.
+        loc[unit].length += grapheme_loc[unit].length;
+        loc[unit].after = grapheme_loc[unit].after;
+        loc[unit].hash = (unit == UTF8LEX_UNIT_LINE) ? (uint64_t) 0 : hash;
+      }
+
+      if (grapheme_loc[unit].after == -1)
+      {
+        position[unit] += grapheme_loc[unit].length;
+      }
+      else
+      {
+        // Chars, graphemes reset at newline:
+        position[unit] = grapheme_loc[unit].after;
+      }
+    }
+
+    absolute_byte += (uint64_t) grapheme_loc[UTF8LEX_UNIT_BYTE].length;
+    if (is_found == false
+        && absolute_byte > start_byte)
+    {
+      // start_byte is not on a grapheme boundary.
+      return UTF8LEX_ERROR_BAD_START;
+    }
+  }
+
+  if (absolute_byte != end_byte)
+  {
+    // end_byte is not on a grapheme boundary.
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  error = utf8lex_state_clear(&read_state);
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// ---------------------------------------------------------------------
+//                      utf8lex_location_resolve()
+// ---------------------------------------------------------------------
+
+utf8lex_error_t utf8lex_location_resolve(
+        utf8lex_state_t *state,
+        uint64_t byte_offset,  // Absolute byte offset.
+        utf8lex_unit_t unit,  // The unit to resolve to.
+        int64_t *location_pointer  // Mutable.
+        )
+{
+  if (state == NULL
+      || location_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (unit <= UTF8LEX_UNIT_NONE
+           || unit >= UTF8LEX_UNIT_MAX
+           || (state->units & ((uint32_t) 1 << unit)) == (uint32_t) 0)
+  {
+    // Optional units have to be enabled, see utf8lex_state_set_units().
+    return UTF8LEX_ERROR_UNIT;
+  }
+
+  if (unit == UTF8LEX_UNIT_BYTE)
+  {
+    *location_pointer = (int64_t) byte_offset;
+    return UTF8LEX_OK;
+  }
+  else if (unit == UTF8LEX_UNIT_LINE
+           && state->line_index != NULL
+           && state->line_index->num_lines < state->line_index->max_lines
+           && state->loc[UTF8LEX_UNIT_BYTE].start >= 0
+           && byte_offset <= (uint64_t) state->loc[UTF8LEX_UNIT_BYTE].start)
+  {
+    // Everything up to byte_offset has been lexed, and every line
+    // start fit in the index, so the index has the answer:
+    // the number of lines that start at or before byte_offset.
+    uint32_t low = (uint32_t) 0;
+    uint32_t high = state->line_index->num_lines;
+    while (low < high)
+    {
+      uint32_t middle = low + ((high - low) / (uint32_t) 2);
+      if (state->line_index->line_starts[middle] <= byte_offset)
+      {
+        low = middle + (uint32_t) 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    *location_pointer = (int64_t) low;
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];
+  utf8lex_error_t error = utf8lex_location_read(
+      state,  // state
+      byte_offset,  // start_byte
+      byte_offset,  // end_byte
+      loc,  // loc
+      NULL,  // buffer_pointer
+      NULL);  // offset_pointer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  *location_pointer = loc[unit].start;
+
+  return UTF8LEX_OK;
+}
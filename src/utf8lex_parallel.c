@@ -0,0 +1,612 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int64_t, uint32_t.
+#include <pthread.h>  // For pthread_create(), pthread_join().
+#include <stdbool.h>  // For bool, true, false.
+#include <string.h>  // For memchr(), memmove().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                        utf8lex_parallel_lex()
+// ---------------------------------------------------------------------
+
+// Where lexing has been checked up to, in order, chunk by chunk:
+// the start of the next token (or EOF, or an error), and its location.
+typedef struct _STRUCT_utf8lex_parallel_frontier
+{
+  int64_t byte;  // Absolute byte offset of the next token.
+  int64_t loc[UTF8LEX_UNIT_MAX];  // Absolute location of the next token.
+  utf8lex_error_t error;  // OK (more tokens), EOF, or an error.
+} utf8lex_parallel_frontier_t;
+
+// Units other than bytes and lines reset at every newline (columns).
+static inline bool utf8lex_parallel_is_column(
+        utf8lex_unit_t unit
+        )
+{
+  return (unit != UTF8LEX_UNIT_BYTE
+          && unit != UTF8LEX_UNIT_LINE)
+    ? true
+    : false;
+}
+
+// Points the chunk's state at the specified (absolute) location,
+// ready to lex the next token from there.
+static void utf8lex_parallel_chunk_seek(
+        utf8lex_chunk_t *chunk,
+        int64_t byte_delta,  // Absolute byte offset - buffer byte offset.
+        int64_t loc[UTF8LEX_UNIT_MAX]
+        )
+{
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    chunk->buffer.loc[unit].start = (unit == UTF8LEX_UNIT_BYTE)
+      ? loc[unit] - byte_delta
+      : loc[unit];
+    chunk->buffer.loc[unit].length = 0;
+    chunk->state.loc[unit].start = loc[unit];
+    chunk->state.loc[unit].length = 0;
+    chunk->state.loc[unit].after = -1;
+  }
+  chunk->state.buffer = &(chunk->buffer);
+  chunk->state.resume.rule = NULL;
+}
+
+// Lexes one chunk (in its own thread), from its start to the first token
+// that starts at or after its end, or to EOF, or to an error.
+static void utf8lex_parallel_chunk_lex(
+        utf8lex_chunk_t *chunk
+        )
+{
+  uint32_t num_tokens = (uint32_t) 0;
+  utf8lex_error_t error = UTF8LEX_OK;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    chunk->stop_loc[unit].start = chunk->state.loc[unit].start;
+    chunk->stop_loc[unit].length = 0;
+    chunk->stop_loc[unit].after = -1;
+    chunk->stop_loc[unit].hash = (uint64_t) 0;
+  }
+  chunk->stop_byte = chunk->start_byte;
+
+  while (true)
+  {
+    // Lex straight into the chunk's tokens, while there is room:
+    utf8lex_token_t overflow_token;
+    utf8lex_token_t *token = (num_tokens < chunk->max_tokens)
+      ? &(chunk->tokens[num_tokens])
+      : &overflow_token;
+    error = utf8lex_program_lex(chunk->program,  // program
+                                &(chunk->state),  // state
+                                token);  // token_pointer
+    if (error != UTF8LEX_OK)
+    {
+      // EOF, or an error wherever lexing stopped.
+      for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+           unit < UTF8LEX_UNIT_MAX;
+           unit ++)
+      {
+        chunk->stop_loc[unit].start = chunk->state.loc[unit].start;
+      }
+      chunk->stop_byte = chunk->state.loc[UTF8LEX_UNIT_BYTE].start;
+      break;
+    }
+
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      chunk->stop_loc[unit].start = token->loc[unit].start;
+    }
+    chunk->stop_byte = token->loc[UTF8LEX_UNIT_BYTE].start;
+    if (chunk->stop_byte >= chunk->end_byte)
+    {
+      // The next chunk's token.
+      break;
+    }
+    else if (num_tokens >= chunk->max_tokens)
+    {
+      error = UTF8LEX_ERROR_MAX_LENGTH;
+      break;
+    }
+
+    num_tokens ++;
+  }
+
+  chunk->first_token = (uint32_t) 0;
+  chunk->num_tokens = num_tokens;
+  chunk->error = error;
+}
+
+static void *utf8lex_parallel_thread(
+        void *chunk_pointer  // utf8lex_chunk_t *
+        )
+{
+  utf8lex_parallel_chunk_lex((utf8lex_chunk_t *) chunk_pointer);
+  return NULL;
+}
+
+// Takes the chunk's tokens from index first_token on, and its stop,
+// as lexed from the frontier (from where the chunk before it stopped),
+// fixing up the line numbers, which the chunk counted from its own start.
+static void utf8lex_parallel_adopt(
+        utf8lex_chunk_t *chunk,
+        utf8lex_buffer_t *buffer,  // The state's buffer.
+        uint32_t first_token,  // The chunk's token at the frontier.
+        int64_t line_offset,  // # of lines before the chunk's start.
+        utf8lex_parallel_frontier_t *frontier  // Mutable.
+        )
+{
+  for (uint32_t t = first_token; t < chunk->num_tokens; t ++)
+  {
+    chunk->tokens[t].loc[UTF8LEX_UNIT_LINE].start += line_offset;
+    chunk->tokens[t].buffer = buffer;
+  }
+
+  frontier->byte = chunk->stop_byte;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    frontier->loc[unit] = chunk->stop_loc[unit].start;
+  }
+  frontier->loc[UTF8LEX_UNIT_LINE] += line_offset;
+  frontier->error = chunk->error;
+}
+
+// Is the chunk's token at the frontier?  (Same start, and same columns,
+// since the chunk started right after a newline.)
+static bool utf8lex_parallel_is_sync(
+        utf8lex_token_t *token,
+        utf8lex_parallel_frontier_t *frontier
+        )
+{
+  if (token->loc[UTF8LEX_UNIT_BYTE].start != frontier->byte)
+  {
+    return false;
+  }
+
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    if (utf8lex_parallel_is_column(unit) == true
+        && token->loc[unit].start != frontier->loc[unit])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Re-lexes the chunk from the frontier (where the chunk before it
+// really stopped), only until reaching one of the chunk's own tokens
+// (from there on its tokens are good), or the end of the chunk.
+// The re-lexed tokens replace the chunk's tokens before that one.
+static utf8lex_error_t utf8lex_parallel_relex(
+        utf8lex_chunk_t *chunk,
+        utf8lex_buffer_t *buffer,  // The state's buffer.
+        int64_t byte_delta,  // Absolute byte offset - buffer byte offset.
+        utf8lex_parallel_frontier_t *frontier  // Mutable.
+        )
+{
+  // First count the re-lexed tokens, to make room for them:
+  utf8lex_parallel_chunk_seek(chunk,  // chunk
+                              byte_delta,  // byte_delta
+                              frontier->loc);  // loc
+  uint32_t num_relexed = (uint32_t) 0;
+  uint32_t sync_token = (uint32_t) 0;
+  bool is_sync = false;
+  utf8lex_token_t token;
+  utf8lex_error_t error = UTF8LEX_OK;
+  while (true)
+  {
+    error = utf8lex_program_lex(chunk->program,  // program
+                                &(chunk->state),  // state
+                                &token);  // token_pointer
+    if (error != UTF8LEX_OK
+        || token.loc[UTF8LEX_UNIT_BYTE].start >= chunk->end_byte)
+    {
+      break;
+    }
+
+    while (sync_token < chunk->num_tokens
+           && chunk->tokens[sync_token].loc[UTF8LEX_UNIT_BYTE].start
+              < token.loc[UTF8LEX_UNIT_BYTE].start)
+    {
+      sync_token ++;
+    }
+    if (sync_token < chunk->num_tokens
+        && chunk->tokens[sync_token].loc[UTF8LEX_UNIT_BYTE].start
+           == token.loc[UTF8LEX_UNIT_BYTE].start)
+    {
+      utf8lex_parallel_frontier_t sync_frontier;
+      sync_frontier.byte = token.loc[UTF8LEX_UNIT_BYTE].start;
+      for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+           unit < UTF8LEX_UNIT_MAX;
+           unit ++)
+      {
+        sync_frontier.loc[unit] = token.loc[unit].start;
+      }
+      if (utf8lex_parallel_is_sync(&(chunk->tokens[sync_token]),
+                                   &sync_frontier) == true)
+      {
+        is_sync = true;
+        break;
+      }
+    }
+
+    num_relexed ++;
+  }
+
+  // Where the re-lexing stopped: the token it is in sync at,
+  // the next chunk's token, or EOF / an error.
+  int64_t stop_loc[UTF8LEX_UNIT_MAX];
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    stop_loc[unit] = (error == UTF8LEX_OK)
+      ? token.loc[unit].start
+      : chunk->state.loc[unit].start;
+  }
+
+  // Where the re-lexed tokens go:  in place of the chunk's tokens
+  // before the one it is in sync with, if there are enough of them,
+  // otherwise the rest of the chunk's tokens move over.
+  uint32_t num_kept = (is_sync == true)
+    ? chunk->num_tokens - sync_token
+    : (uint32_t) 0;
+  uint32_t first_token = (uint32_t) 0;
+  if (num_relexed + num_kept > chunk->max_tokens)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+  else if (is_sync == true
+           && num_relexed <= sync_token)
+  {
+    first_token = sync_token - num_relexed;
+  }
+  else if (is_sync == true)
+  {
+    memmove(&(chunk->tokens[num_relexed]),
+            &(chunk->tokens[sync_token]),
+            (size_t) num_kept * sizeof(utf8lex_token_t));
+    sync_token = num_relexed;
+  }
+
+  // Then re-lex them again, this time into the chunk's tokens:
+  utf8lex_parallel_chunk_seek(chunk,  // chunk
+                              byte_delta,  // byte_delta
+                              frontier->loc);  // loc
+  for (uint32_t t = (uint32_t) 0; t < num_relexed; t ++)
+  {
+    utf8lex_token_t *relexed = &(chunk->tokens[first_token + t]);
+    utf8lex_error_t relex_error = utf8lex_program_lex(
+        chunk->program,  // program
+        &(chunk->state),  // state
+        relexed);  // token_pointer
+    if (relex_error != UTF8LEX_OK)
+    {
+      return relex_error;
+    }
+    relexed->buffer = buffer;
+  }
+
+  if (is_sync == true)
+  {
+    chunk->num_tokens = sync_token + num_kept;
+    utf8lex_parallel_adopt(
+        chunk,  // chunk
+        buffer,  // buffer
+        sync_token,  // first_token
+        stop_loc[UTF8LEX_UNIT_LINE]
+        - chunk->tokens[sync_token].loc[UTF8LEX_UNIT_LINE].start,
+        frontier);  // frontier
+    chunk->first_token = first_token;
+    chunk->num_tokens = num_relexed + num_kept;
+    return UTF8LEX_OK;
+  }
+
+  // Re-lexed the whole chunk.
+  chunk->first_token = (uint32_t) 0;
+  chunk->num_tokens = num_relexed;
+  frontier->byte = stop_loc[UTF8LEX_UNIT_BYTE];
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    frontier->loc[unit] = stop_loc[unit];
+  }
+  frontier->error = error;
+
+  return UTF8LEX_OK;
+}
+
+// Frees the chunks' match data.
+static void utf8lex_parallel_finish(
+        utf8lex_chunk_t *chunks,
+        uint32_t num_chunks
+        )
+{
+  for (uint32_t c = (uint32_t) 0; c < num_chunks; c ++)
+  {
+    if (chunks[c].state.match_data != NULL)
+    {
+      pcre2_match_data_free(chunks[c].state.match_data);
+      chunks[c].state.match_data = NULL;
+    }
+  }
+}
+
+utf8lex_error_t utf8lex_parallel_lex(
+        utf8lex_program_t *program,
+        utf8lex_state_t *state,
+        utf8lex_chunk_t *chunks,  // Array of num_chunks chunks.
+        uint32_t num_chunks  // >= 1.
+        )
+{
+  if (program == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || state->buffer->str == NULL
+      || chunks == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (num_chunks == (uint32_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  else if (state->buffer->next != NULL
+           || state->buffer->is_eof == false
+           || state->stream != NULL
+           || state->window != NULL
+           || state->reader != NULL
+           || state->line_index != NULL
+           || state->intern_table != NULL
+           || state->num_includes != (uint32_t) 0)
+  {
+    // Not one whole buffer, or not thread-safe.
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (state->mode >= program->num_modes)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  if (state->loc[UTF8LEX_UNIT_BYTE].start < 0)
+  {
+    // Same as the first call to utf8lex_lex().
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      state->loc[unit].start = 0;
+      state->loc[unit].length = 0;
+      state->loc[unit].after = -1;
+    }
+  }
+
+  utf8lex_buffer_t *buffer = state->buffer;
+  int64_t length_bytes = (int64_t) buffer->str->length_bytes;
+  int64_t first_byte = buffer->loc[UTF8LEX_UNIT_BYTE].start;
+  int64_t byte_delta = state->loc[UTF8LEX_UNIT_BYTE].start - first_byte;
+
+  // Every chunk but the first starts right after the first newline
+  // at or after an even split of the bytes:
+  for (uint32_t c = (uint32_t) 0; c < num_chunks; c ++)
+  {
+    utf8lex_chunk_t *chunk = &(chunks[c]);
+    int64_t start_byte = first_byte;
+    if (c > (uint32_t) 0)
+    {
+      int64_t split_byte = first_byte
+        + (((length_bytes - first_byte) * (int64_t) c)
+           / (int64_t) num_chunks);
+      start_byte = chunks[c - 1].start_byte - byte_delta;
+      if (split_byte > start_byte)
+      {
+        start_byte = split_byte;
+      }
+      unsigned char *newline = (start_byte < length_bytes)
+        ? (unsigned char *) memchr(&(buffer->str->bytes[start_byte]),
+                                   '\n',
+                                   (size_t) (length_bytes - start_byte))
+        : NULL;
+      start_byte = (newline == NULL)
+        ? length_bytes
+        : (int64_t) (newline - buffer->str->bytes) + (int64_t) 1;
+      chunks[c - 1].end_byte = start_byte + byte_delta;
+    }
+
+    chunk->program = program;
+    chunk->start_byte = start_byte + byte_delta;
+    chunk->end_byte = length_bytes + byte_delta;
+    chunk->first_token = (uint32_t) 0;
+    chunk->num_tokens = (uint32_t) 0;
+    chunk->error = UTF8LEX_OK;
+
+    // The chunk's own buffer and state, sharing the state's bytes:
+    chunk->buffer = *buffer;
+    chunk->buffer.next = NULL;
+    chunk->buffer.prev = NULL;
+    utf8lex_error_t error = utf8lex_state_init(&(chunk->state),  // self
+                                               &(chunk->buffer));  // buffer
+    if (error != UTF8LEX_OK)
+    {
+      utf8lex_parallel_finish(chunks, c);
+      return error;
+    }
+    chunk->state.mode = state->mode;
+    chunk->state.location_mode = state->location_mode;
+    chunk->state.units = state->units;
+    chunk->state.granularity = state->granularity;
+    chunk->state.match_data = pcre2_match_data_create(
+        (uint32_t) 1 + (uint32_t) UTF8LEX_CAPTURES_MAX,  // ovecsize
+        NULL);  // gcontext
+    if (chunk->state.match_data == NULL)
+    {
+      utf8lex_parallel_finish(chunks, c);
+      return UTF8LEX_ERROR_STATE;
+    }
+
+    // The first chunk carries on from the state's location.  The others
+    // start at column 0 (after a newline), counting lines from 0:
+    int64_t start_loc[UTF8LEX_UNIT_MAX];
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      start_loc[unit] = (c == (uint32_t) 0)
+        ? state->loc[unit].start
+        : 0;
+    }
+    start_loc[UTF8LEX_UNIT_BYTE] = chunk->start_byte;
+    utf8lex_parallel_chunk_seek(chunk,  // chunk
+                                byte_delta,  // byte_delta
+                                start_loc);  // loc
+  }
+
+  // Lex the first chunk in this thread, and the rest in their own:
+  uint32_t num_threads = (uint32_t) 0;
+  for (uint32_t c = (uint32_t) 1; c < num_chunks; c ++)
+  {
+    if (pthread_create(&(chunks[c].thread),
+                       (pthread_attr_t *) NULL,  // attr
+                       utf8lex_parallel_thread,  // start_routine
+                       (void *) &(chunks[c])) != 0)  // arg
+    {
+      // Lex the rest of the chunks in this thread, instead.
+      break;
+    }
+    num_threads ++;
+  }
+  utf8lex_parallel_chunk_lex(&(chunks[0]));
+  for (uint32_t c = num_threads + (uint32_t) 1; c < num_chunks; c ++)
+  {
+    utf8lex_parallel_chunk_lex(&(chunks[c]));
+  }
+  for (uint32_t c = (uint32_t) 1; c <= num_threads; c ++)
+  {
+    pthread_join(chunks[c].thread, (void **) NULL);
+  }
+
+  // Now check the chunks, in order.  The first one is good,
+  // and already has the right lines.
+  utf8lex_parallel_frontier_t frontier;
+  frontier.byte = chunks[0].start_byte;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    frontier.loc[unit] = state->loc[unit].start;
+  }
+  frontier.error = UTF8LEX_OK;
+  for (uint32_t c = (uint32_t) 0; c < num_chunks; c ++)
+  {
+    utf8lex_chunk_t *chunk = &(chunks[c]);
+    if (c == (uint32_t) 0)
+    {
+      utf8lex_parallel_adopt(chunk,  // chunk
+                             buffer,  // buffer
+                             (uint32_t) 0,  // first_token
+                             (int64_t) 0,  // line_offset
+                             &frontier);  // frontier
+      continue;
+    }
+    else if (frontier.error != UTF8LEX_OK
+             || frontier.byte >= chunk->end_byte)
+    {
+      // Past EOF or an error, or no tokens start in this chunk
+      // (including a chunk with no newline to start at).
+      chunk->first_token = (uint32_t) 0;
+      chunk->num_tokens = (uint32_t) 0;
+      continue;
+    }
+
+    // Is the chunk in sync with the one before it?
+    uint32_t sync_token = (uint32_t) 0;
+    while (sync_token < chunk->num_tokens
+           && chunk->tokens[sync_token].loc[UTF8LEX_UNIT_BYTE].start
+              < frontier.byte)
+    {
+      sync_token ++;
+    }
+    if (sync_token < chunk->num_tokens
+        && utf8lex_parallel_is_sync(&(chunk->tokens[sync_token]),
+                                    &frontier) == true)
+    {
+      utf8lex_parallel_adopt(
+          chunk,  // chunk
+          buffer,  // buffer
+          sync_token,  // first_token
+          frontier.loc[UTF8LEX_UNIT_LINE]
+          - chunk->tokens[sync_token].loc[UTF8LEX_UNIT_LINE].start,
+          &frontier);  // frontier
+      chunk->first_token = sync_token;
+      chunk->num_tokens -= sync_token;
+    }
+    else
+    {
+      utf8lex_error_t error = utf8lex_parallel_relex(
+          chunk,  // chunk
+          buffer,  // buffer
+          byte_delta,  // byte_delta
+          &frontier);  // frontier
+      if (error != UTF8LEX_OK)
+      {
+        utf8lex_parallel_finish(chunks, num_chunks);
+        return error;
+      }
+    }
+  }
+
+  utf8lex_parallel_finish(chunks, num_chunks);
+
+  // Leave the state where lexing stopped, same as utf8lex_lex() would:
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    buffer->loc[unit].start += frontier.loc[unit] - state->loc[unit].start;
+    buffer->loc[unit].length = 0;
+    state->loc[unit].start = frontier.loc[unit];
+    state->loc[unit].length = 0;
+    state->loc[unit].after = -1;
+  }
+  state->resume.rule = NULL;
+
+  if (frontier.error == UTF8LEX_OK)
+  {
+    // The last chunk ends at the end of the buffer, so it cannot stop
+    // at the next chunk's token.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  return frontier.error;
+}
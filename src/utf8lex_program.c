@@ -0,0 +1,234 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <inttypes.h>  // For uint32_t.
+#include <stdbool.h>  // For bool, true, false.
+#include <string.h>  // For memset(), memcpy().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                        utf8lex_program_t
+// ---------------------------------------------------------------------
+
+// Fills in one instruction from one rule.
+static utf8lex_error_t utf8lex_program_compile_rule(
+        utf8lex_instruction_t *instruction,
+        utf8lex_rule_t *rule
+        )
+{
+  if (rule->definition == NULL
+      || rule->definition->definition_type == NULL
+      || rule->definition->definition_type->lex == NULL
+      || rule->definition->name == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  memset(instruction, 0, sizeof(utf8lex_instruction_t));
+  instruction->opcode = UTF8LEX_OPCODE_NONE;
+  instruction->is_skip = rule->is_skip;
+  instruction->is_interned = rule->is_interned;
+  instruction->cat = UTF8LEX_CAT_NONE;
+  instruction->rule = rule;
+  instruction->definition = rule->definition;
+
+  utf8lex_definition_type_t *definition_type =
+    rule->definition->definition_type;
+  if (definition_type == UTF8LEX_DEFINITION_TYPE_CAT)
+  {
+    utf8lex_cat_definition_t *cat_definition =
+      (utf8lex_cat_definition_t *) rule->definition;
+    instruction->opcode = UTF8LEX_OPCODE_CAT;
+    instruction->cat = cat_definition->cat;
+    instruction->min = cat_definition->min;
+    instruction->max = cat_definition->max;
+  }
+  else if (definition_type == UTF8LEX_DEFINITION_TYPE_LITERAL)
+  {
+    utf8lex_literal_definition_t *literal_definition =
+      (utf8lex_literal_definition_t *) rule->definition;
+    if (literal_definition->str == NULL)
+    {
+      return UTF8LEX_ERROR_NULL_POINTER;
+    }
+
+    int length_bytes = (int) literal_definition->loc[UTF8LEX_UNIT_BYTE].length;
+    if (length_bytes <= 0)
+    {
+      return UTF8LEX_ERROR_EMPTY_DEFINITION;
+    }
+
+    instruction->opcode = UTF8LEX_OPCODE_LITERAL;
+    instruction->length_bytes = length_bytes;
+    size_t num_inline_bytes = (size_t) length_bytes;
+    if (num_inline_bytes > (size_t) UTF8LEX_INSTRUCTION_LITERAL_MAX)
+    {
+      num_inline_bytes = (size_t) UTF8LEX_INSTRUCTION_LITERAL_MAX;
+    }
+    memcpy(instruction->literal, literal_definition->str, num_inline_bytes);
+  }
+  else if (definition_type == UTF8LEX_DEFINITION_TYPE_REGEX)
+  {
+    utf8lex_regex_definition_t *regex_definition =
+      (utf8lex_regex_definition_t *) rule->definition;
+    if (regex_definition->regex == NULL)
+    {
+      return UTF8LEX_ERROR_NULL_POINTER;
+    }
+    else if (regex_definition->num_captures < 0
+             || regex_definition->num_captures > UTF8LEX_CAPTURES_MAX)
+    {
+      return UTF8LEX_ERROR_MAX_LENGTH;
+    }
+
+    instruction->opcode = UTF8LEX_OPCODE_REGEX;
+    instruction->regex = regex_definition->regex;
+    instruction->num_captures = regex_definition->num_captures;
+  }
+  else if (definition_type == UTF8LEX_DEFINITION_TYPE_MULTI)
+  {
+    utf8lex_multi_definition_t *multi_definition =
+      (utf8lex_multi_definition_t *) rule->definition;
+    if (multi_definition->references == NULL)
+    {
+      return UTF8LEX_ERROR_EMPTY_DEFINITION;
+    }
+
+    instruction->opcode = UTF8LEX_OPCODE_MULTI;
+  }
+  else
+  {
+    // User-defined definition_type: call its lexer through the vtable.
+    instruction->opcode = UTF8LEX_OPCODE_CUSTOM;
+    instruction->lex = definition_type->lex;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_program_compile(
+        utf8lex_program_t *self,
+        utf8lex_rule_t *first_rule  // The rules to compile, in order.
+        )
+{
+  return utf8lex_program_compile_modes(
+      self,  // self
+      first_rule,  // first_rule
+      (uint32_t) 1);  // num_modes
+}
+
+utf8lex_error_t utf8lex_program_compile_modes(
+        utf8lex_program_t *self,
+        utf8lex_rule_t *first_rule,  // The rules to compile, in order.
+        uint32_t num_modes  // 1 <= num_modes <= UTF8LEX_MODES_MAX.
+        )
+{
+  if (self == NULL
+      || first_rule == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (num_modes == (uint32_t) 0
+           || num_modes > (uint32_t) UTF8LEX_MODES_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  self->num_modes = (uint32_t) 0;
+  self->num_instructions = (uint32_t) 0;
+  memset(self->rules_by_id, 0, sizeof(self->rules_by_id));
+
+  for (uint32_t mode = (uint32_t) 0; mode < num_modes; mode ++)
+  {
+    uint32_t mode_mask = (uint32_t) 1 << mode;
+    self->mode_first[mode] = self->num_instructions;
+    self->mode_length[mode] = (uint32_t) 0;
+
+    uint32_t infinite_loop_protector = (uint32_t) 0;
+    for (utf8lex_rule_t *rule = first_rule;
+         rule != NULL;
+         rule = rule->next)
+    {
+      infinite_loop_protector ++;
+      if (infinite_loop_protector > (uint32_t) UTF8LEX_RULES_DB_LENGTH_MAX)
+      {
+        self->num_instructions = (uint32_t) 0;
+        return UTF8LEX_ERROR_INFINITE_LOOP;
+      }
+      else if ((rule->modes & mode_mask) == (uint32_t) 0)
+      {
+        // The rule is not active in this mode.
+        continue;
+      }
+      else if (self->num_instructions >= (uint32_t) UTF8LEX_PROGRAM_LENGTH_MAX)
+      {
+        self->num_instructions = (uint32_t) 0;
+        return UTF8LEX_ERROR_MAX_LENGTH;
+      }
+
+      utf8lex_error_t error = utf8lex_program_compile_rule(
+          &(self->instructions[self->num_instructions]),  // instruction
+          rule);  // rule
+      if (error != UTF8LEX_OK)
+      {
+        self->num_instructions = (uint32_t) 0;
+        return error;
+      }
+
+      if (rule->id < (uint32_t) UTF8LEX_RULES_DB_LENGTH_MAX
+          && self->rules_by_id[rule->id] == NULL)
+      {
+        self->rules_by_id[rule->id] = rule;
+      }
+
+      self->num_instructions ++;
+      self->mode_length[mode] ++;
+    }
+  }
+
+  self->num_modes = num_modes;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_program_clear(
+        utf8lex_program_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  for (uint32_t i = (uint32_t) 0; i < self->num_instructions; i ++)
+  {
+    utf8lex_instruction_t *instruction = &(self->instructions[i]);
+    memset(instruction, 0, sizeof(utf8lex_instruction_t));
+    instruction->opcode = UTF8LEX_OPCODE_NONE;
+    instruction->cat = UTF8LEX_CAT_NONE;
+  }
+  self->num_instructions = (uint32_t) 0;
+  self->num_modes = (uint32_t) 0;
+  memset(self->rules_by_id, 0, sizeof(self->rules_by_id));
+
+  return UTF8LEX_OK;
+}
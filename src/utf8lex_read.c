@@ -17,7 +17,7 @@
  */
 
 #include <stdio.h>
-#include <inttypes.h>  // For int32_t.
+#include <inttypes.h>  // For int32_t, uint64_t.
 #include <stdbool.h>  // For bool, true, false.
 
 #include <utf8proc.h>
@@ -32,13 +32,16 @@
 // since the 2 characters, combined in sequence, usually represent
 // one single line separator.
 // The state is used only for the string buffer to read from,
-// not for its location info.
+// not for its location info.  If the grapheme carries on into the next
+// buffer(s) in the chain, the state is moved on to the buffer it ends in
+// (and the offset keeps counting from the start of the original buffer).
 // The offset, lengths, codepoint and cat are all set upon
 // successfully reading one complete grapheme cluster.
 // loc[*].after will be -1 if no newlines were encountered, or 0
 // or more if the character / grapheme positions were reset to 0 at newline.
 // (Bytes and lines will never have their after locations reset, always -1.)
-utf8lex_error_t utf8lex_read_grapheme(
+// Always decodes the grapheme; see utf8lex_read_grapheme() for the cache.
+static utf8lex_error_t utf8lex_read_grapheme_decode(
         utf8lex_state_t *state,
         off_t *offset_pointer,  // Mutable.
         utf8lex_location_t loc_pointer[UTF8LEX_UNIT_MAX], // Mutable
@@ -71,7 +74,16 @@ utf8lex_error_t utf8lex_read_grapheme(
   size_t total_lines_read = (size_t) 0;
   off_t after_char = (off_t) -1;
   off_t after_grapheme = (off_t) -1;
-  unsigned long hash = (unsigned long) 0;
+  uint64_t hash = (uint64_t) 0;
+  // Optional units, only counted if the state enables them:
+  bool is_utf16 = (state->units & (1 << UTF8LEX_UNIT_UTF16)) ? true : false;
+  bool is_width = (state->units & (1 << UTF8LEX_UNIT_WIDTH)) ? true : false;
+  size_t total_utf16_read = (size_t) 0;
+  off_t after_utf16 = (off_t) -1;
+  int grapheme_width = 0;
+  bool is_codepoint = (state->granularity == UTF8LEX_GRANULARITY_CODEPOINT)
+    ? true
+    : false;
   for (int u8c = 0; ; u8c ++)
   {
     unsigned char *str_pointer = (unsigned char *)
@@ -114,6 +126,40 @@ utf8lex_error_t utf8lex_read_grapheme(
       break;
     }
 
+    // A character near the end of the buffer might carry on into
+    // the next buffer(s) in the chain, so piece its bytes together:
+    unsigned char straddle_bytes[UTF8LEX_MAX_BYTES_PER_CHAR];
+    bool is_eof = state->buffer->is_eof;
+    if (max_bytes < (size_t) UTF8LEX_MAX_BYTES_PER_CHAR
+        && state->buffer->next != NULL)
+    {
+      utf8lex_buffer_t *straddle_buffer = state->buffer;
+      off_t straddle_offset = curr_offset;
+      size_t num_straddle_bytes = (size_t) 0;
+      while (num_straddle_bytes < (size_t) UTF8LEX_MAX_BYTES_PER_CHAR)
+      {
+        if ((size_t) straddle_offset < straddle_buffer->str->length_bytes)
+        {
+          straddle_bytes[num_straddle_bytes] =
+            straddle_buffer->str->bytes[straddle_offset];
+          num_straddle_bytes ++;
+          straddle_offset ++;
+        }
+        else if (straddle_buffer->next != NULL)
+        {
+          straddle_buffer = straddle_buffer->next;
+          straddle_offset = (off_t) 0;
+        }
+        else
+        {
+          break;
+        }
+      }
+      str_pointer = straddle_bytes;
+      max_bytes = num_straddle_bytes;
+      is_eof = straddle_buffer->is_eof;
+    }
+
     utf8proc_int32_t utf8proc_codepoint;
     utf8proc_ssize_t utf8proc_num_bytes_read = utf8proc_iterate(
         (utf8proc_uint8_t *) str_pointer,
@@ -122,10 +168,9 @@ utf8lex_error_t utf8lex_read_grapheme(
     int num_lines_read = 0;
 
     if (utf8proc_num_bytes_read == UTF8PROC_ERROR_INVALIDUTF8
-        && (state->buffer->str->length_bytes - (size_t) curr_offset)
-           < UTF8LEX_MAX_BYTES_PER_CHAR)
+        && max_bytes < (size_t) UTF8LEX_MAX_BYTES_PER_CHAR)
     {
-      if (state->buffer->is_eof == true)
+      if (is_eof == true)
       {
         // No more bytes can be read in, we're at EOF.
         // Bad UTF-8 character at the end of the buffer.
@@ -177,6 +222,12 @@ utf8lex_error_t utf8lex_read_grapheme(
       // represent a special grapheme, 1 separator.
       num_lines_read = -1;
     }
+    else if (is_codepoint == true)
+    {
+      // CR followed by anything other than LF.
+      error = UTF8LEX_OK;
+      break;
+    }
     else  // Not the first UTF-8 character we've read in the grapheme.
     {
       // Check for grapheme break.  Keep reading until we find one.
@@ -205,6 +256,11 @@ utf8lex_error_t utf8lex_read_grapheme(
     {
       first_cat = cat;
     }
+    // Codepoints beyond the Basic Multilingual Plane are surrogate pairs
+    // in UTF-16:
+    off_t utf16_units = (utf8proc_codepoint >= 0x10000)
+      ? (off_t) 2
+      : (off_t) 1;
     if ((cat & UTF8LEX_CAT_SEP_LINE)
         || (cat & UTF8LEX_CAT_SEP_PARAGRAPH)
         || (cat & UTF8LEX_EXT_SEP_LINE))
@@ -212,29 +268,61 @@ utf8lex_error_t utf8lex_read_grapheme(
       num_lines_read ++;
       after_char = (off_t) 0;
       after_grapheme = (off_t) 0;
+      after_utf16 = (off_t) 0;
     }
     else if (after_char >= (off_t) 0)
     {
       after_char ++;
+      after_utf16 += utf16_units;
     }
 
+    if (is_utf16 == true)
+    {
+      total_utf16_read += (size_t) utf16_units;
+    }
+    if (is_width == true)
+    {
+      // The grapheme is as wide as its widest codepoint (combining marks
+      // are 0 wide, East Asian wide and fullwidth characters 2 wide):
+      int codepoint_width = utf8proc_charwidth(utf8proc_codepoint);
+      if (codepoint_width > grapheme_width)
+      {
+        grapheme_width = codepoint_width;
+      }
+    }
+
+    // Move past the character, maybe into the next buffer(s):
     curr_offset += (off_t) utf8proc_num_bytes_read;
+    while ((size_t) curr_offset > state->buffer->str->length_bytes)
+    {
+      curr_offset -= (off_t) state->buffer->str->length_bytes;
+      state->buffer = state->buffer->next;
+    }
     total_bytes_read += (size_t) utf8proc_num_bytes_read;
     total_chars_read += (size_t) 1;
     total_lines_read += (size_t) num_lines_read;
 
-    // Hash bytes and chars read in:
+    // Hash bytes and chars read in (see utf8lex_hash_concat()):
     for (off_t byte_offset = (off_t) 0;
          byte_offset < (off_t) utf8proc_num_bytes_read;
          byte_offset ++)
     {
-      hash <<= 8;
-      hash |= (unsigned long) str_pointer[byte_offset];
+      hash *= UTF8LEX_HASH_PRIME;
+      hash += (uint64_t) str_pointer[byte_offset];
     }
 
     // Keep reading more bytes until we find a grapheme boundary
     // (or run out of bytes).
     prev_codepoint = utf8proc_codepoint;
+
+    if (is_codepoint == true
+        && utf8proc_codepoint != 0x000D)
+    {
+      // Every codepoint is its own "grapheme", so no need to look ahead
+      // for a grapheme break (except for the LF in CR, LF).
+      error = UTF8LEX_OK;
+      break;
+    }
   }
 
   if (error != UTF8LEX_OK)
@@ -246,21 +334,40 @@ utf8lex_error_t utf8lex_read_grapheme(
   // Success.
   *offset_pointer += (off_t) total_bytes_read;
   // Do not change: loc_pointer[UTF8LEX_UNIT_BYTE].start
-  loc_pointer[UTF8LEX_UNIT_BYTE].length = (int) total_bytes_read;
-  loc_pointer[UTF8LEX_UNIT_BYTE].after = (int) -1;  // Never reset.
-  loc_pointer[UTF8LEX_UNIT_BYTE].hash = (unsigned long) hash;
+  loc_pointer[UTF8LEX_UNIT_BYTE].length = (int64_t) total_bytes_read;
+  loc_pointer[UTF8LEX_UNIT_BYTE].after = (int64_t) -1;  // Never reset.
+  loc_pointer[UTF8LEX_UNIT_BYTE].hash = hash;
   // Do not change: loc_pointer[UTF8LEX_UNIT_CHAR].start
-  loc_pointer[UTF8LEX_UNIT_CHAR].length = (int) total_chars_read;
-  loc_pointer[UTF8LEX_UNIT_CHAR].after = (int) after_char;
-  loc_pointer[UTF8LEX_UNIT_CHAR].hash = (unsigned long) hash;
+  loc_pointer[UTF8LEX_UNIT_CHAR].length = (int64_t) total_chars_read;
+  loc_pointer[UTF8LEX_UNIT_CHAR].after = (int64_t) after_char;
+  loc_pointer[UTF8LEX_UNIT_CHAR].hash = hash;
   // Do not change: loc_pointer[UTF8LEX_UNIT_GRAPHEME].start
-  loc_pointer[UTF8LEX_UNIT_GRAPHEME].length = (int) 1;
-  loc_pointer[UTF8LEX_UNIT_GRAPHEME].after = (int) after_grapheme;  // -1 or 0
-  loc_pointer[UTF8LEX_UNIT_GRAPHEME].hash = (unsigned long) hash;
+  loc_pointer[UTF8LEX_UNIT_GRAPHEME].length = (int64_t) 1;
+  loc_pointer[UTF8LEX_UNIT_GRAPHEME].after = (int64_t) after_grapheme;  // -1 or 0
+  loc_pointer[UTF8LEX_UNIT_GRAPHEME].hash = hash;
   // Do not change: loc_pointer[UTF8LEX_UNIT_LINE].start
-  loc_pointer[UTF8LEX_UNIT_LINE].length = (int) total_lines_read;
-  loc_pointer[UTF8LEX_UNIT_LINE].after = (int) -1;  // Never reset.
-  loc_pointer[UTF8LEX_UNIT_LINE].hash = (unsigned long) 0;  // Don't hash lines.
+  loc_pointer[UTF8LEX_UNIT_LINE].length = (int64_t) total_lines_read;
+  loc_pointer[UTF8LEX_UNIT_LINE].after = (int64_t) -1;  // Never reset.
+  loc_pointer[UTF8LEX_UNIT_LINE].hash = (uint64_t) 0;  // Don't hash lines.
+  // Do not change: loc_pointer[UTF8LEX_UNIT_UTF16].start
+  loc_pointer[UTF8LEX_UNIT_UTF16].length = (int64_t) total_utf16_read;
+  loc_pointer[UTF8LEX_UNIT_UTF16].after = (is_utf16 == true)
+    ? (int64_t) after_utf16
+    : (int64_t) -1;
+  loc_pointer[UTF8LEX_UNIT_UTF16].hash = (is_utf16 == true)
+    ? hash
+    : (uint64_t) 0;
+  // Do not change: loc_pointer[UTF8LEX_UNIT_WIDTH].start
+  // (A grapheme that ends a line resets the column to 0 after it.)
+  loc_pointer[UTF8LEX_UNIT_WIDTH].length = (after_grapheme >= (off_t) 0)
+    ? (int64_t) 0
+    : (int64_t) grapheme_width;
+  loc_pointer[UTF8LEX_UNIT_WIDTH].after = (is_width == true)
+    ? (int64_t) after_grapheme
+    : (int64_t) -1;
+  loc_pointer[UTF8LEX_UNIT_WIDTH].hash = (is_width == true)
+    ? hash
+    : (uint64_t) 0;
   *codepoint_pointer = first_codepoint;
   // We only set the category/ies according to the first codepoint
   // of the grapheme cluster.  The remainder of the characters
@@ -270,3 +377,128 @@ utf8lex_error_t utf8lex_read_grapheme(
 
   return UTF8LEX_OK;
 }
+
+utf8lex_error_t utf8lex_grapheme_cache_init(
+        utf8lex_grapheme_cache_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  // Empty slots are never looked up; the rest of each slot
+  // is filled in when a grapheme is put in it.
+  for (int g = 0; g < UTF8LEX_GRAPHEME_CACHE_LENGTH; g ++)
+  {
+    self->graphemes[g].str = NULL;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_grapheme_cache_clear(
+        utf8lex_grapheme_cache_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  for (int g = 0; g < UTF8LEX_GRAPHEME_CACHE_LENGTH; g ++)
+  {
+    self->graphemes[g].str = NULL;
+  }
+
+  return UTF8LEX_OK;
+}
+
+// Reads to the end of a grapheme, the same as
+// utf8lex_read_grapheme_decode(), except that if the state has a
+// grapheme cache, each grapheme is only decoded the first time
+// it is read at a given offset of a given string.
+utf8lex_error_t utf8lex_read_grapheme(
+        utf8lex_state_t *state,
+        off_t *offset_pointer,  // Mutable.
+        utf8lex_location_t loc_pointer[UTF8LEX_UNIT_MAX], // Mutable
+        int32_t *codepoint_pointer,  // Mutable.
+        utf8lex_cat_t *cat_pointer  // Mutable.
+        )
+{
+  if (state == NULL
+      || state->grapheme_cache == NULL
+      || state->buffer == NULL
+      || offset_pointer == NULL
+      || *offset_pointer < (off_t) 0)
+  {
+    // No cache (or bad arguments, which are checked when decoding).
+    return utf8lex_read_grapheme_decode(state,
+                                        offset_pointer,
+                                        loc_pointer,
+                                        codepoint_pointer,
+                                        cat_pointer);
+  }
+
+  utf8lex_string_t *str = state->buffer->str;
+  off_t offset = *offset_pointer;
+  utf8lex_grapheme_t *grapheme = &(state->grapheme_cache->graphemes[
+      (size_t) offset % (size_t) UTF8LEX_GRAPHEME_CACHE_LENGTH]);
+  if (grapheme->str == str
+      && grapheme->offset == offset
+      && loc_pointer != NULL
+      && codepoint_pointer != NULL
+      && cat_pointer != NULL)
+  {
+    // Already decoded, maybe by another alternative of the same token.
+    *offset_pointer = grapheme->end_offset;
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      // Do not change: loc_pointer[unit].start
+      loc_pointer[unit].length = grapheme->loc[unit].length;
+      loc_pointer[unit].after = grapheme->loc[unit].after;
+      loc_pointer[unit].hash = grapheme->loc[unit].hash;
+    }
+    *codepoint_pointer = grapheme->codepoint;
+    *cat_pointer = grapheme->cat;
+    if (grapheme->end_buffer != NULL)
+    {
+      state->buffer = grapheme->end_buffer;
+    }
+
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_buffer_t *start_buffer = state->buffer;
+  utf8lex_error_t error = utf8lex_read_grapheme_decode(state,
+                                                       offset_pointer,
+                                                       loc_pointer,
+                                                       codepoint_pointer,
+                                                       cat_pointer);
+  if (error != UTF8LEX_OK)
+  {
+    // MORE, bad UTF-8 and so on are not cached, they're rare enough.
+    return error;
+  }
+
+  grapheme->str = str;
+  grapheme->offset = offset;
+  grapheme->end_offset = *offset_pointer;
+  grapheme->end_buffer = (state->buffer != start_buffer)
+    ? state->buffer
+    : NULL;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    grapheme->loc[unit].length = loc_pointer[unit].length;
+    grapheme->loc[unit].after = loc_pointer[unit].after;
+    grapheme->loc[unit].hash = loc_pointer[unit].hash;
+  }
+  grapheme->codepoint = *codepoint_pointer;
+  grapheme->cat = *cat_pointer;
+
+  return UTF8LEX_OK;
+}
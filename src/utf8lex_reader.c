@@ -0,0 +1,567 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>  // For errno, EINTR.
+#include <fcntl.h>  // For posix_fadvise().
+#include <inttypes.h>  // For uint32_t, uint64_t.
+#include <pthread.h>  // For pthread_create(), pthread_join().
+#include <semaphore.h>  // For sem_init(), sem_post(), sem_wait().
+#include <stdatomic.h>  // For atomic_load(), atomic_store().
+#include <stdbool.h>  // For bool, true, false.
+#include <stdio.h>
+#include <unistd.h>  // For read(), sysconf().
+
+#include <sys/mman.h>  // For mmap(), munmap().
+
+#include <zlib.h>  // For inflate().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                           utf8lex_reader_t
+// ---------------------------------------------------------------------
+
+// zlib allocates its state and window once, from the reader's arena
+// (which is mapped up front, like the buffers), and never frees them
+// until the whole arena is unmapped:
+static voidpf utf8lex_reader_zalloc(
+        voidpf opaque,
+        uInt items,
+        uInt size
+        )
+{
+  utf8lex_reader_t *self = (utf8lex_reader_t *) opaque;
+  size_t num_bytes = (size_t) items * (size_t) size;
+  num_bytes = (num_bytes + (size_t) 15) & ~((size_t) 15);  // 16-aligned.
+  if ((self->arena_used + num_bytes) > (size_t) UTF8LEX_READER_ARENA_BYTES)
+  {
+    return Z_NULL;
+  }
+
+  voidpf allocated = (voidpf) &(self->arena[self->arena_used]);
+  self->arena_used += num_bytes;
+  return allocated;
+}
+
+static void utf8lex_reader_zfree(
+        voidpf opaque,
+        voidpf address
+        )
+{
+  // Nothing to do, the arena is unmapped all at once.
+}
+
+// Inflates gzip (or zlib) compressed bytes from the fd into the string,
+// reading more compressed bytes whenever inflate() runs out,
+// until the string is full, or the end of the (last) stream.
+// Tokens can straddle inflate blocks and buffers: the chain takes care
+// of that, so the string is always filled right up to the end.
+// Returns the # of bytes inflated (0 at the end of the file),
+// or -1 for a read error or bad compressed data.
+static ssize_t utf8lex_reader_inflate(
+        utf8lex_reader_t *self,
+        utf8lex_string_t *str
+        )
+{
+  z_stream *inflater = (z_stream *) self->inflater;
+  inflater->next_out = (Bytef *) str->bytes;
+  inflater->avail_out = (uInt) str->max_length_bytes;
+
+  while (inflater->avail_out > (uInt) 0)
+  {
+    if (inflater->avail_in == (uInt) 0)
+    {
+      ssize_t num_bytes_read = -1;
+      while (true)
+      {
+        num_bytes_read = read(self->fd,
+                              self->compressed,
+                              (size_t) UTF8LEX_READER_COMPRESSED_BYTES);
+        if (num_bytes_read >= (ssize_t) 0
+            || errno != EINTR)
+        {
+          break;
+        }
+      }
+
+      if (num_bytes_read < (ssize_t) 0)
+      {
+        return (ssize_t) -1;
+      }
+      else if (num_bytes_read == (ssize_t) 0)
+      {
+        if (self->is_inflating == true)
+        {
+          // The file ended in the middle of a compressed stream.
+          return (ssize_t) -1;
+        }
+
+        break;
+      }
+
+      inflater->next_in = (Bytef *) self->compressed;
+      inflater->avail_in = (uInt) num_bytes_read;
+    }
+
+    self->is_inflating = true;
+    int z_error = inflate(inflater, Z_NO_FLUSH);
+    if (z_error == Z_STREAM_END)
+    {
+      // One gzip member done.  There might be more after it
+      // (as with "cat a.gz b.gz"), so start over:
+      self->is_inflating = false;
+      if (inflateReset(inflater) != Z_OK)
+      {
+        return (ssize_t) -1;
+      }
+    }
+    else if (z_error != Z_OK)
+    {
+      return (ssize_t) -1;
+    }
+  }
+
+  return (ssize_t) (str->max_length_bytes - (size_t) inflater->avail_out);
+}
+
+// The read-ahead thread: fills each free buffer in turn (in the order
+// they were handed out, which is also the order they come back in),
+// until the end of the file, a read error, or utf8lex_reader_clear().
+static void *utf8lex_reader_run(
+        void *reader_pointer
+        )
+{
+  utf8lex_reader_t *self = (utf8lex_reader_t *) reader_pointer;
+
+  while (true)
+  {
+    // Wait for the lexer to be done with a buffer:
+    while (sem_wait(&(self->free_buffers)) != 0
+           && errno == EINTR)
+    {
+      // Interrupted by a signal, keep waiting.
+    }
+    if (atomic_load(&(self->is_stopping)) == true)
+    {
+      break;
+    }
+
+    uint64_t num_filled = atomic_load(&(self->num_filled));
+    uint32_t b = (uint32_t) (num_filled % (uint64_t) self->num_buffers);
+    utf8lex_string_t *str = &(self->strs[b]);
+
+    ssize_t num_bytes_read = -1;
+    if (self->inflater != NULL)
+    {
+      num_bytes_read = utf8lex_reader_inflate(self,  // self
+                                              str);  // str
+    }
+    else
+    {
+      while (true)
+      {
+        num_bytes_read = read(self->fd,
+                              str->bytes,
+                              str->max_length_bytes);
+        if (num_bytes_read >= (ssize_t) 0
+            || errno != EINTR)
+        {
+          break;
+        }
+      }
+    }
+
+    bool is_done = false;
+    if (num_bytes_read < (ssize_t) 0)
+    {
+      str->length_bytes = (size_t) 0;
+      self->errors[b] = UTF8LEX_ERROR_FILE_READ;
+      is_done = true;
+    }
+    else
+    {
+      str->length_bytes = (size_t) num_bytes_read;
+      self->errors[b] = (num_bytes_read == (ssize_t) 0)
+        ? UTF8LEX_EOF
+        : UTF8LEX_OK;
+      is_done = (num_bytes_read == (ssize_t) 0) ? true : false;
+    }
+
+    // Publish the buffer (the bytes, then the count), and wake the lexer:
+    atomic_store(&(self->num_filled), num_filled + (uint64_t) 1);
+    sem_post(&(self->filled_buffers));
+
+    if (is_done == true)
+    {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+// Unmaps the buffers and the arena (if any).  Returns 0 on success.
+static int utf8lex_reader_unmap(
+        utf8lex_reader_t *self
+        )
+{
+  int munmap_error = munmap(self->chunks,
+                            (size_t) self->num_buffers * self->buffer_size);
+  if (self->arena != NULL)
+  {
+    if (munmap(self->arena,
+               (size_t) UTF8LEX_READER_ARENA_BYTES
+               + (size_t) UTF8LEX_READER_COMPRESSED_BYTES) != 0)
+    {
+      munmap_error = -1;
+    }
+  }
+
+  self->arena = NULL;
+  self->arena_used = (size_t) 0;
+  self->compressed = NULL;
+  self->inflater = NULL;
+
+  return munmap_error;
+}
+
+// Maps the buffers (and, to decompress, the arena), then starts
+// the read-ahead thread.
+static utf8lex_error_t utf8lex_reader_start(
+        utf8lex_reader_t *self,
+        int fd,
+        size_t buffer_size,  // Multiple of the page size.
+        uint32_t num_buffers,  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+        bool is_gzip
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_DESCRIPTOR;
+  }
+  else if (num_buffers < (uint32_t) 2)
+  {
+    // One buffer being lexed, and at least one being read ahead.
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+  else if (num_buffers > (uint32_t) UTF8LEX_READER_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (buffer_size == (size_t) 0
+      || page_size <= 0L
+      || (buffer_size % (size_t) page_size) != (size_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  unsigned char *chunks = (unsigned char *) mmap(
+      (void *) NULL,  // addr
+      (size_t) num_buffers * buffer_size,  // length
+      PROT_READ | PROT_WRITE,  // prot
+      MAP_PRIVATE | MAP_ANONYMOUS,  // flags
+      -1,  // fd
+      (off_t) 0);  // offset
+  if ((void *) chunks == MAP_FAILED)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+  // Hint only (and not every fd can take it, pipes for example):
+  posix_fadvise(fd,
+                (off_t) 0,  // offset
+                (off_t) 0,  // len (0 means to the end of the file)
+                POSIX_FADV_SEQUENTIAL);
+#endif
+
+  self->arena = NULL;
+  self->arena_used = (size_t) 0;
+  self->compressed = NULL;
+  self->inflater = NULL;
+  self->is_inflating = false;
+  if (is_gzip == true)
+  {
+    unsigned char *arena = (unsigned char *) mmap(
+        (void *) NULL,  // addr
+        (size_t) UTF8LEX_READER_ARENA_BYTES
+        + (size_t) UTF8LEX_READER_COMPRESSED_BYTES,  // length
+        PROT_READ | PROT_WRITE,  // prot
+        MAP_PRIVATE | MAP_ANONYMOUS,  // flags
+        -1,  // fd
+        (off_t) 0);  // offset
+    if ((void *) arena == MAP_FAILED)
+    {
+      munmap(chunks, (size_t) num_buffers * buffer_size);
+      return UTF8LEX_ERROR_FILE_MMAP;
+    }
+    self->arena = arena;
+    self->compressed = &(arena[UTF8LEX_READER_ARENA_BYTES]);
+
+    // The z_stream itself comes from the arena, too:
+    z_stream *inflater = (z_stream *) utf8lex_reader_zalloc(
+        (voidpf) self,  // opaque
+        (uInt) 1,  // items
+        (uInt) sizeof(z_stream));  // size
+    if (inflater == NULL)
+    {
+      munmap(arena,
+             (size_t) UTF8LEX_READER_ARENA_BYTES
+             + (size_t) UTF8LEX_READER_COMPRESSED_BYTES);
+      munmap(chunks, (size_t) num_buffers * buffer_size);
+      self->arena = NULL;
+      self->compressed = NULL;
+      return UTF8LEX_ERROR_STATE;
+    }
+    inflater->zalloc = utf8lex_reader_zalloc;
+    inflater->zfree = utf8lex_reader_zfree;
+    inflater->opaque = (voidpf) self;
+    inflater->next_in = Z_NULL;
+    inflater->avail_in = (uInt) 0;
+    // 15 bits of window, + 32 to detect gzip or zlib headers:
+    if (inflateInit2(inflater, 15 + 32) != Z_OK)
+    {
+      munmap(arena,
+             (size_t) UTF8LEX_READER_ARENA_BYTES
+             + (size_t) UTF8LEX_READER_COMPRESSED_BYTES);
+      munmap(chunks, (size_t) num_buffers * buffer_size);
+      self->arena = NULL;
+      self->compressed = NULL;
+      return UTF8LEX_ERROR_STATE;
+    }
+    self->inflater = (void *) inflater;
+  }
+
+  self->fd = fd;
+  self->chunks = chunks;
+  self->buffer_size = buffer_size;
+  self->num_buffers = num_buffers;
+  for (uint32_t b = (uint32_t) 0; b < num_buffers; b ++)
+  {
+    utf8lex_error_t error = utf8lex_string_init(
+        &(self->strs[b]),  // self
+        buffer_size,  // max_length_bytes
+        (size_t) 0,  // length_bytes
+        &(chunks[(size_t) b * buffer_size]));  // bytes
+    if (error != UTF8LEX_OK)
+    {
+      munmap(chunks, (size_t) num_buffers * buffer_size);
+      return error;
+    }
+    self->errors[b] = UTF8LEX_OK;
+  }
+
+  atomic_store(&(self->num_filled), (uint64_t) 0);
+  atomic_store(&(self->is_stopping), false);
+  self->num_appended = (uint64_t) 0;
+  self->num_in_chain = (uint32_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+
+  if (sem_init(&(self->free_buffers), 0, (unsigned int) num_buffers) != 0)
+  {
+    utf8lex_reader_unmap(self);
+    return UTF8LEX_ERROR_STATE;
+  }
+  if (sem_init(&(self->filled_buffers), 0, 0U) != 0)
+  {
+    sem_destroy(&(self->free_buffers));
+    utf8lex_reader_unmap(self);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  if (pthread_create(&(self->thread),
+                     (pthread_attr_t *) NULL,  // attr
+                     utf8lex_reader_run,  // start_routine
+                     (void *) self) != 0)  // arg
+  {
+    sem_destroy(&(self->filled_buffers));
+    sem_destroy(&(self->free_buffers));
+    utf8lex_reader_unmap(self);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_reader_init(
+        utf8lex_reader_t *self,
+        int fd,
+        size_t buffer_size,  // Multiple of the page size.
+        uint32_t num_buffers  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+        )
+{
+  return utf8lex_reader_start(self,  // self
+                              fd,  // fd
+                              buffer_size,  // buffer_size
+                              num_buffers,  // num_buffers
+                              false);  // is_gzip
+}
+
+utf8lex_error_t utf8lex_reader_init_gzip(
+        utf8lex_reader_t *self,
+        int fd,
+        size_t buffer_size,  // Multiple of the page size.
+        uint32_t num_buffers  // 2 <= num_buffers <= UTF8LEX_READER_MAX.
+        )
+{
+  return utf8lex_reader_start(self,  // self
+                              fd,  // fd
+                              buffer_size,  // buffer_size
+                              num_buffers,  // num_buffers
+                              true);  // is_gzip
+}
+
+utf8lex_error_t utf8lex_reader_clear(
+        utf8lex_reader_t *self
+        )
+{
+  if (self == NULL
+      || self->chunks == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  // Wake the read-ahead thread (if it's waiting for a buffer) and stop it:
+  atomic_store(&(self->is_stopping), true);
+  sem_post(&(self->free_buffers));
+  pthread_join(self->thread, (void **) NULL);
+
+  sem_destroy(&(self->filled_buffers));
+  sem_destroy(&(self->free_buffers));
+
+  if (self->inflater != NULL)
+  {
+    inflateEnd((z_stream *) self->inflater);
+  }
+  int munmap_error = utf8lex_reader_unmap(self);
+
+  for (uint32_t b = (uint32_t) 0; b < self->num_buffers; b ++)
+  {
+    utf8lex_string_clear(&(self->strs[b]));
+  }
+
+  self->fd = -1;
+  self->chunks = NULL;
+  self->buffer_size = (size_t) 0;
+  self->num_buffers = (uint32_t) 0;
+  self->num_appended = (uint64_t) 0;
+  self->num_in_chain = (uint32_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+
+  if (munmap_error != 0)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_reader_next(
+        utf8lex_reader_t *self,
+        utf8lex_state_t *state  // Or NULL.
+        )
+{
+  if (self == NULL
+      || self->chunks == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->tail != NULL
+           && self->tail->is_eof == true)
+  {
+    // Nothing more to read, so nothing can be appended.
+    // (Definitions only ask for more bytes before EOF.)
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Hand the buffers at the head of the chain that the state
+  // has lexed past back to the read-ahead thread:
+  while (state != NULL
+         && self->head != NULL
+         && self->head != state->buffer
+         && self->head->next != NULL)
+  {
+    utf8lex_buffer_t *consumed = self->head;
+    self->head = consumed->next;
+    self->head->prev = NULL;
+    consumed->next = NULL;
+    self->num_in_chain --;
+    sem_post(&(self->free_buffers));
+  }
+
+  if (self->num_in_chain >= self->num_buffers)
+  {
+    // Every buffer is in the chain, and the token being lexed
+    // still needs all of them.  Waiting would never end.
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  // Wait for the read-ahead thread to fill the next buffer:
+  while (sem_wait(&(self->filled_buffers)) != 0
+         && errno == EINTR)
+  {
+    // Interrupted by a signal, keep waiting.
+  }
+
+  uint32_t b = (uint32_t) (self->num_appended
+                           % (uint64_t) self->num_buffers);
+  self->num_appended ++;
+  utf8lex_error_t read_error = self->errors[b];
+  if (read_error == UTF8LEX_ERROR_FILE_READ)
+  {
+    return read_error;
+  }
+  else if (read_error == UTF8LEX_EOF
+           && self->tail != NULL)
+  {
+    // End of file: no need for an empty buffer at the end of the chain.
+    self->tail->is_eof = true;
+    sem_post(&(self->free_buffers));
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_buffer_t *buffer = &(self->buffers[b]);
+  utf8lex_error_t error = utf8lex_buffer_init(
+      buffer,  // self
+      self->tail,  // prev
+      &(self->strs[b]),  // str
+      (read_error == UTF8LEX_EOF) ? true : false);  // is_eof
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+  buffer->fd = self->fd;
+
+  if (self->head == NULL)
+  {
+    self->head = buffer;
+  }
+  self->tail = buffer;
+  self->num_in_chain ++;
+
+  return UTF8LEX_OK;
+}
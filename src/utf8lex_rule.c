@@ -59,6 +59,9 @@ utf8lex_error_t utf8lex_rule_init(
   self->name = name;
   self->definition = definition;
   self->code = code;
+  self->is_skip = false;
+  self->is_interned = false;
+  self->modes = UTF8LEX_MODES_ALL;
   if (code_length_bytes < (size_t) 0)
   {
     self->code_length_bytes = strlen(self->code);
@@ -117,6 +120,59 @@ utf8lex_error_t utf8lex_rule_clear(
   self->definition = NULL;
   self->code = NULL;
   self->code_length_bytes = (size_t) -1;
+  self->is_skip = false;
+  self->is_interned = false;
+  self->modes = (uint32_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_rule_set_skip(
+        utf8lex_rule_t *self,
+        bool is_skip  // true = skip matching tokens, false = return them.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->is_skip = is_skip;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_rule_set_interned(
+        utf8lex_rule_t *self,
+        bool is_interned  // true = intern matching tokens, false = don't.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->is_interned = is_interned;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_rule_set_modes(
+        utf8lex_rule_t *self,
+        uint32_t modes  // Mask of (1 << mode) for each mode (not 0).
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (modes == (uint32_t) 0)
+  {
+    // A rule that is never active in any mode.
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  self->modes = modes;
 
   return UTF8LEX_OK;
 }
@@ -0,0 +1,199 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For uint32_t.
+#include <stdbool.h>  // For bool, true, false.
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                           utf8lex_session_t
+// ---------------------------------------------------------------------
+
+// What the session lexes until it is reset (nothing, then EOF):
+static unsigned char utf8lex_session_no_bytes[1] = { 0 };
+
+utf8lex_error_t utf8lex_session_init(
+        utf8lex_session_t *self,
+        utf8lex_program_t *program  // Compiled, and outliving the session.
+        )
+{
+  if (self == NULL
+      || program == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  utf8lex_error_t error = utf8lex_string_init(
+      &(self->str),  // self
+      (size_t) 0,  // max_length_bytes
+      (size_t) 0,  // length_bytes
+      utf8lex_session_no_bytes);  // bytes
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  error = utf8lex_buffer_init(&(self->buffer),  // self
+                              NULL,  // prev
+                              &(self->str),  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  error = utf8lex_state_init(&(self->state),  // self
+                             &(self->buffer));  // buffer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Room for every capture any regex can have, so that the same
+  // match data can be used for every regex, in every document:
+  self->state.match_data = pcre2_match_data_create(
+      (uint32_t) 1 + (uint32_t) UTF8LEX_CAPTURES_MAX,  // ovecsize
+      NULL);  // gcontext
+  if (self->state.match_data == NULL)
+  {
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  self->program = program;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_session_clear(
+        utf8lex_session_t *self
+        )
+{
+  if (self == NULL
+      || self->program == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  if (self->state.match_data != NULL)
+  {
+    pcre2_match_data_free(self->state.match_data);
+    self->state.match_data = NULL;
+  }
+
+  utf8lex_error_t error = utf8lex_state_clear(&(self->state));
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  error = utf8lex_buffer_clear(&(self->buffer));
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  self->str.bytes = NULL;
+  self->str.max_length_bytes = (size_t) 0;
+  self->str.length_bytes = (size_t) 0;
+
+  self->program = NULL;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_session_reset(
+        utf8lex_session_t *self,
+        unsigned char *bytes,  // Owned by the caller.
+        size_t length_bytes
+        )
+{
+  if (self == NULL
+      || self->program == NULL
+      || bytes == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->str.bytes = bytes;
+  self->str.max_length_bytes = length_bytes;
+  self->str.length_bytes = length_bytes;
+
+  // The whole document is in the one buffer:
+  self->buffer.next = NULL;
+  self->buffer.prev = NULL;
+  self->buffer.is_eof = true;
+
+  // Start over at location 0 (see utf8lex_lex()), in the initial mode,
+  // without touching the state's settings or its match data:
+  self->state.buffer = &(self->buffer);
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    self->buffer.loc[unit].start = 0;
+    self->buffer.loc[unit].length = 0;
+
+    self->state.loc[unit].start = -1;
+    self->state.loc[unit].length = -1;
+    self->state.loc[unit].after = -2;
+  }
+
+  self->state.mode = (uint32_t) UTF8LEX_MODE_INITIAL;
+  self->state.num_pushed_modes = (uint32_t) 0;
+  self->state.resume.rule = NULL;
+
+  if (self->state.num_includes > (uint32_t) 0)
+  {
+    // Abandon any included sources, back to the document's settings:
+    utf8lex_include_t *document_include = &(self->state.includes[0]);
+    self->state.line_index = document_include->line_index;
+    self->state.stream = document_include->stream;
+    self->state.window = document_include->window;
+    self->state.reader = document_include->reader;
+    self->state.num_includes = (uint32_t) 0;
+  }
+
+  if (self->state.line_index != NULL)
+  {
+    // The line starts of the last document don't apply to this one.
+    self->state.line_index->num_lines = (uint32_t) 0;
+    self->state.line_index->is_after_cr = false;
+    self->state.line_index->num_partial = (uint32_t) 0;
+    self->state.line_index->end_byte = (uint64_t) 0;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_session_lex(
+        utf8lex_session_t *self,
+        utf8lex_token_t *token_pointer
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  return utf8lex_program_lex(self->program,  // program
+                             &(self->state),  // state
+                             token_pointer);  // token_pointer
+}
@@ -17,6 +17,7 @@
  */
 
 #include <stdio.h>
+#include <inttypes.h>  // For PRId64.
 
 #include "utf8lex.h"
 
@@ -41,7 +42,8 @@ utf8lex_error_t utf8lex_state_string(
   size_t num_bytes_written = snprintf(
       str->bytes,
       str->max_length_bytes,
-      "(bytes@%d[%d], chars@%d[%d], graphemes@%d[%d], lines@%d[%d])",
+      "(bytes@%" PRId64 "[%" PRId64 "], chars@%" PRId64 "[%" PRId64 "],"
+      " graphemes@%" PRId64 "[%" PRId64 "], lines@%" PRId64 "[%" PRId64 "])",
       state->loc[UTF8LEX_UNIT_BYTE].start,
       state->loc[UTF8LEX_UNIT_BYTE].length,
       state->loc[UTF8LEX_UNIT_CHAR].start,
@@ -82,6 +84,22 @@ utf8lex_error_t utf8lex_state_init(
     self->loc[unit].after = -2;
   }
 
+  self->mode = (uint32_t) UTF8LEX_MODE_INITIAL;
+  self->num_pushed_modes = (uint32_t) 0;
+  self->num_includes = (uint32_t) 0;
+
+  self->location_mode = UTF8LEX_LOCATION_MODE_ALL;
+  self->units = UTF8LEX_UNITS_DEFAULT;
+  self->granularity = UTF8LEX_GRANULARITY_GRAPHEME;
+  self->line_index = NULL;
+  self->intern_table = NULL;
+  self->stream = NULL;
+  self->window = NULL;
+  self->reader = NULL;
+  self->resume.rule = NULL;
+  self->grapheme_cache = NULL;
+  self->match_data = NULL;
+
   return UTF8LEX_OK;
 }
 
@@ -104,5 +122,373 @@ utf8lex_error_t utf8lex_state_clear(
     self->loc[unit].after = -2;
   }
 
+  self->mode = (uint32_t) UTF8LEX_MODE_INITIAL;
+  self->num_pushed_modes = (uint32_t) 0;
+  self->num_includes = (uint32_t) 0;
+
+  self->location_mode = UTF8LEX_LOCATION_MODE_ALL;
+  self->units = UTF8LEX_UNITS_DEFAULT;
+  self->granularity = UTF8LEX_GRANULARITY_GRAPHEME;
+  self->line_index = NULL;
+  self->intern_table = NULL;
+  self->stream = NULL;
+  self->window = NULL;
+  self->reader = NULL;
+  self->resume.rule = NULL;
+  self->grapheme_cache = NULL;
+  self->match_data = NULL;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_mode(
+        utf8lex_state_t *self,
+        uint32_t mode  // 0 <= mode < UTF8LEX_MODES_MAX.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (mode >= (uint32_t) UTF8LEX_MODES_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  self->mode = mode;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_push_mode(
+        utf8lex_state_t *self,
+        uint32_t mode  // 0 <= mode < UTF8LEX_MODES_MAX.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (mode >= (uint32_t) UTF8LEX_MODES_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+  else if (self->num_pushed_modes >= (uint32_t) UTF8LEX_MODE_STACK_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  self->pushed_modes[self->num_pushed_modes] = self->mode;
+  self->num_pushed_modes ++;
+  self->mode = mode;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_pop_mode(
+        utf8lex_state_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->num_pushed_modes == (uint32_t) 0)
+  {
+    // Nothing to pop.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  self->num_pushed_modes --;
+  self->mode = self->pushed_modes[self->num_pushed_modes];
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_push_buffer(
+        utf8lex_state_t *self,
+        utf8lex_buffer_t *buffer  // Owned by the caller.
+        )
+{
+  if (self == NULL
+      || buffer == NULL
+      || buffer->str == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->num_includes >= (uint32_t) UTF8LEX_INCLUDE_STACK_MAX)
+  {
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  utf8lex_include_t *include = &(self->includes[self->num_includes]);
+  include->buffer = self->buffer;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    include->loc[unit].start = self->loc[unit].start;
+    include->loc[unit].length = self->loc[unit].length;
+    include->loc[unit].after = self->loc[unit].after;
+    include->loc[unit].hash = self->loc[unit].hash;
+
+    // Start over at location 0 (see utf8lex_lex()) in the new source:
+    self->loc[unit].start = -1;
+    self->loc[unit].length = -1;
+    self->loc[unit].after = -2;
+  }
+  include->line_index = self->line_index;
+  include->stream = self->stream;
+  include->window = self->window;
+  include->reader = self->reader;
+  self->num_includes ++;
+
+  self->buffer = buffer;
+  self->line_index = NULL;
+  self->stream = NULL;
+  self->window = NULL;
+  self->reader = NULL;
+  self->resume.rule = NULL;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_pop_buffer(
+        utf8lex_state_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->num_includes == (uint32_t) 0)
+  {
+    // Nothing to pop.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  self->num_includes --;
+  utf8lex_include_t *include = &(self->includes[self->num_includes]);
+  self->buffer = include->buffer;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    self->loc[unit].start = include->loc[unit].start;
+    self->loc[unit].length = include->loc[unit].length;
+    self->loc[unit].after = include->loc[unit].after;
+    self->loc[unit].hash = include->loc[unit].hash;
+  }
+  self->line_index = include->line_index;
+  self->stream = include->stream;
+  self->window = include->window;
+  self->reader = include->reader;
+  self->resume.rule = NULL;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_location_mode(
+        utf8lex_state_t *self,
+        utf8lex_location_mode_t location_mode
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (location_mode <= UTF8LEX_LOCATION_MODE_NONE
+           || location_mode >= UTF8LEX_LOCATION_MODE_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  self->location_mode = location_mode;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_units(
+        utf8lex_state_t *self,
+        uint32_t units  // Must include UTF8LEX_UNITS_DEFAULT.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if ((units & UTF8LEX_UNITS_DEFAULT) != UTF8LEX_UNITS_DEFAULT
+           || (units & ~UTF8LEX_UNITS_ALL) != (uint32_t) 0)
+  {
+    return UTF8LEX_ERROR_UNIT;
+  }
+
+  self->units = units;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_granularity(
+        utf8lex_state_t *self,
+        utf8lex_granularity_t granularity
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (granularity <= UTF8LEX_GRANULARITY_NONE
+           || granularity >= UTF8LEX_GRANULARITY_MAX)
+  {
+    return UTF8LEX_ERROR_BAD_MODE;
+  }
+
+  self->granularity = granularity;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_line_index(
+        utf8lex_state_t *self,
+        utf8lex_line_index_t *line_index  // Or NULL.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->line_index = line_index;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_intern_table(
+        utf8lex_state_t *self,
+        utf8lex_intern_table_t *intern_table  // Or NULL.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->intern_table = intern_table;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_save_resume(
+        utf8lex_state_t *self,
+        utf8lex_rule_t *rule,
+        uint32_t step,
+        int64_t count,
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX]  // Lengths matched so far.
+        )
+{
+  if (self == NULL
+      || rule == NULL
+      || loc == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->resume.rule = rule;
+  self->resume.start_byte = self->loc[UTF8LEX_UNIT_BYTE].start;
+  self->resume.step = step;
+  self->resume.count = count;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    self->resume.loc[unit].start = loc[unit].start;
+    self->resume.loc[unit].length = loc[unit].length;
+    self->resume.loc[unit].after = loc[unit].after;
+    self->resume.loc[unit].hash = loc[unit].hash;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_take_resume(
+        utf8lex_state_t *self,
+        utf8lex_rule_t *rule,
+        uint32_t *step_pointer,  // Mutable.
+        int64_t *count_pointer,  // Mutable.
+        utf8lex_location_t loc[UTF8LEX_UNIT_MAX]  // Mutable.
+        )
+{
+  if (self == NULL
+      || rule == NULL
+      || step_pointer == NULL
+      || count_pointer == NULL
+      || loc == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->resume.rule != rule
+           || self->resume.start_byte != self->loc[UTF8LEX_UNIT_BYTE].start)
+  {
+    return UTF8LEX_NO_MATCH;
+  }
+
+  *step_pointer = self->resume.step;
+  *count_pointer = self->resume.count;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    loc[unit].length = self->resume.loc[unit].length;
+    loc[unit].after = self->resume.loc[unit].after;
+    loc[unit].hash = self->resume.loc[unit].hash;
+  }
+
+  self->resume.rule = NULL;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_stream(
+        utf8lex_state_t *self,
+        utf8lex_stream_t *stream  // Or NULL.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->stream = stream;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_window(
+        utf8lex_state_t *self,
+        utf8lex_window_t *window  // Or NULL.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->window = window;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_state_set_reader(
+        utf8lex_state_t *self,
+        utf8lex_reader_t *reader  // Or NULL.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->reader = reader;
+
   return UTF8LEX_OK;
 }
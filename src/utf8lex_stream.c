@@ -0,0 +1,411 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE  // For memfd_create().
+
+#include <errno.h>  // For errno, EAGAIN, EINTR.
+#include <inttypes.h>  // For uint64_t.
+#include <poll.h>  // For poll().
+#include <stdbool.h>  // For bool, true, false.
+#include <stdio.h>  // For snprintf().
+#include <unistd.h>  // For close(), ftruncate(), read(), sysconf().
+
+#include <fcntl.h>  // For O_CREAT, O_EXCL, O_RDWR.
+#include <sys/mman.h>  // For mmap(), memfd_create(), shm_open().
+#if defined(__linux__)
+#include <sys/inotify.h>  // For inotify_init1(), inotify_add_watch().
+#endif
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                           utf8lex_stream_t
+// ---------------------------------------------------------------------
+
+// Opens an anonymous shared memory file descriptor to map the ring from:
+static int utf8lex_stream_memory_fd(
+        size_t capacity
+        )
+{
+  int memory_fd = -1;
+#if defined(__linux__)
+  memory_fd = memfd_create("utf8lex_stream", 0);
+#else
+  // No memfd_create(): open a uniquely named shared memory object,
+  // then unlink it right away, so it disappears when unmapped.
+  static unsigned int num_opened = 0;
+  char name[64];
+  snprintf(name, sizeof(name), "/utf8lex_stream_%ld_%u",
+           (long) getpid(),
+           num_opened);
+  num_opened ++;
+  memory_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (memory_fd >= 0)
+  {
+    shm_unlink(name);
+  }
+#endif
+  if (memory_fd < 0)
+  {
+    return -1;
+  }
+
+  if (ftruncate(memory_fd, (off_t) capacity) != 0)
+  {
+    close(memory_fd);
+    return -1;
+  }
+
+  return memory_fd;
+}
+
+utf8lex_error_t utf8lex_stream_init(
+        utf8lex_stream_t *self,
+        int fd,
+        size_t capacity  // Multiple of the page size.
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_DESCRIPTOR;
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (capacity == (size_t) 0
+      || page_size <= 0L
+      || (capacity % (size_t) page_size) != (size_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  int memory_fd = utf8lex_stream_memory_fd(capacity);
+  if (memory_fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  // Reserve 2 * capacity bytes of address space, then map the same
+  // capacity bytes of memory into both halves.  Byte ring[i + capacity]
+  // is byte ring[i], so any capacity bytes starting anywhere
+  // in the first half are contiguous, even when they wrap around.
+  unsigned char *ring = (unsigned char *) mmap(
+      (void *) NULL,  // addr
+      (size_t) 2 * capacity,  // length
+      PROT_NONE,  // prot
+      MAP_PRIVATE | MAP_ANONYMOUS,  // flags
+      -1,  // fd
+      (off_t) 0);  // offset
+  if ((void *) ring == MAP_FAILED)
+  {
+    close(memory_fd);
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  for (int half = 0; half < 2; half ++)
+  {
+    void *mapped = mmap(
+        (void *) (ring + ((size_t) half * capacity)),  // addr
+        capacity,  // length
+        PROT_READ | PROT_WRITE,  // prot
+        MAP_SHARED | MAP_FIXED,  // flags
+        memory_fd,  // fd
+        (off_t) 0);  // offset
+    if (mapped == MAP_FAILED)
+    {
+      munmap(ring, (size_t) 2 * capacity);
+      close(memory_fd);
+      return UTF8LEX_ERROR_FILE_MMAP;
+    }
+  }
+
+  close(memory_fd);  // The mappings keep the memory alive.
+
+  self->fd = fd;
+  self->ring = ring;
+  self->capacity = capacity;
+  self->released_bytes = (uint64_t) 0;
+  self->read_bytes = (uint64_t) 0;
+  self->is_following = false;
+  self->watch_fd = -1;
+
+  self->str.bytes = ring;
+  self->str.max_length_bytes = capacity;
+  self->str.length_bytes = (size_t) 0;
+
+  utf8lex_error_t error = utf8lex_buffer_init(&(self->buffer),  // self
+                                              NULL,  // prev
+                                              &(self->str),  // str
+                                              false);  // is_eof
+  if (error != UTF8LEX_OK)
+  {
+    munmap(ring, (size_t) 2 * capacity);
+    return error;
+  }
+  self->buffer.fd = fd;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_stream_clear(
+        utf8lex_stream_t *self
+        )
+{
+  if (self == NULL
+      || self->ring == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  int munmap_error = munmap(self->ring, (size_t) 2 * self->capacity);
+  if (munmap_error != 0)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  utf8lex_buffer_clear(&(self->buffer));
+
+  if (self->watch_fd >= 0)
+  {
+    close(self->watch_fd);
+  }
+  self->is_following = false;
+  self->watch_fd = -1;
+
+  self->fd = -1;
+  self->ring = NULL;
+  self->capacity = (size_t) 0;
+  self->released_bytes = (uint64_t) 0;
+  self->read_bytes = (uint64_t) 0;
+
+  self->str.bytes = NULL;
+  self->str.max_length_bytes = (size_t) 0;
+  self->str.length_bytes = (size_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_stream_refill(
+        utf8lex_stream_t *self,
+        utf8lex_state_t *state
+        )
+{
+  if (self == NULL
+      || self->ring == NULL
+      || state == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (state->buffer != &(self->buffer))
+  {
+    // The state is lexing some other buffer.
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (self->buffer.is_eof == true)
+  {
+    // Nothing more to read, so nothing can be refilled.
+    // (Definitions only ask for more bytes before EOF.)
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Release everything before the start of the token being lexed,
+  // so that the space can be read into again:
+  size_t consumed_bytes = (size_t) self->buffer.loc[UTF8LEX_UNIT_BYTE].start;
+  if (consumed_bytes > self->str.length_bytes)
+  {
+    return UTF8LEX_ERROR_BAD_START;
+  }
+  self->released_bytes += (uint64_t) consumed_bytes;
+  self->str.bytes += consumed_bytes;
+  if (self->str.bytes >= (self->ring + self->capacity))
+  {
+    // Back to the same bytes, in the first half of the ring.
+    self->str.bytes -= self->capacity;
+  }
+  self->str.length_bytes -= consumed_bytes;
+  self->buffer.loc[UTF8LEX_UNIT_BYTE].start = 0;
+
+  size_t free_bytes = self->capacity - self->str.length_bytes;
+  if (free_bytes == (size_t) 0)
+  {
+    // The token being lexed is longer than the whole ring.
+    return UTF8LEX_ERROR_MAX_LENGTH;
+  }
+
+  // The free space starts right after the unreleased bytes,
+  // and is contiguous thanks to the mirror:
+  unsigned char *free_start = self->str.bytes + self->str.length_bytes;
+  ssize_t num_bytes_read = -1;
+  while (true)
+  {
+    num_bytes_read = read(self->fd,
+                          free_start,
+                          free_bytes);
+    if (num_bytes_read >= (ssize_t) 0
+        || errno != EINTR)
+    {
+      break;
+    }
+  }
+
+  if (num_bytes_read < (ssize_t) 0)
+  {
+    if (errno == EAGAIN
+        || errno == EWOULDBLOCK)
+    {
+      // Non-blocking fd with nothing to read yet.  Try again later.
+      return UTF8LEX_MORE;
+    }
+
+    return UTF8LEX_ERROR_FILE_READ;
+  }
+  else if (num_bytes_read == (ssize_t) 0)
+  {
+    if (self->is_following == true)
+    {
+      // The end of the file, for now.  Wait for more to be appended.
+      return UTF8LEX_MORE;
+    }
+
+    self->buffer.is_eof = true;
+    return UTF8LEX_OK;
+  }
+
+  self->read_bytes += (uint64_t) num_bytes_read;
+  self->str.length_bytes += (size_t) num_bytes_read;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_stream_follow(
+        utf8lex_stream_t *self,
+        unsigned char *path  // Path of the fd's file, or NULL to poll.
+        )
+{
+  if (self == NULL
+      || self->ring == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->buffer.is_eof == true)
+  {
+    // Too late, the lexer has already been told there is no more.
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  if (self->watch_fd >= 0)
+  {
+    close(self->watch_fd);
+    self->watch_fd = -1;
+  }
+
+#if defined(__linux__)
+  if (path != NULL)
+  {
+    int watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0)
+    {
+      return UTF8LEX_ERROR_FILE_OPEN;
+    }
+    if (inotify_add_watch(watch_fd,
+                          path,
+                          IN_MODIFY | IN_CLOSE_WRITE) < 0)
+    {
+      close(watch_fd);
+      return UTF8LEX_ERROR_FILE_OPEN;
+    }
+    self->watch_fd = watch_fd;
+  }
+#endif
+
+  self->is_following = true;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_stream_unfollow(
+        utf8lex_stream_t *self
+        )
+{
+  if (self == NULL
+      || self->ring == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  if (self->watch_fd >= 0)
+  {
+    close(self->watch_fd);
+  }
+  self->is_following = false;
+  self->watch_fd = -1;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_stream_wait(
+        utf8lex_stream_t *self,
+        int timeout_milliseconds
+        )
+{
+  if (self == NULL
+      || self->ring == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  // With inotify, wake up as soon as the file is written to.
+  // Without it, just wait (poll() with no fds is a portable sleep),
+  // and let the next read find out whether anything was appended.
+  struct pollfd watch;
+  watch.fd = self->watch_fd;
+  watch.events = POLLIN;
+  watch.revents = 0;
+  int num_ready = -1;
+  while (true)
+  {
+    num_ready = poll((self->watch_fd >= 0) ? &watch : NULL,
+                     (self->watch_fd >= 0) ? (nfds_t) 1 : (nfds_t) 0,
+                     timeout_milliseconds);
+    if (num_ready >= 0
+        || errno != EINTR)
+    {
+      break;
+    }
+  }
+
+  if (num_ready < 0)
+  {
+    return UTF8LEX_ERROR_FILE_READ;
+  }
+  else if (num_ready > 0)
+  {
+    // Drain the events, only the wake up matters.
+    unsigned char events[4096];
+    while (read(self->watch_fd, events, sizeof(events)) > (ssize_t) 0)
+    {
+      // Keep draining.
+    }
+  }
+
+  return UTF8LEX_OK;
+}
@@ -17,7 +17,7 @@
  */
 
 #include <stdio.h>
-#include <inttypes.h>  // For uint32_t.
+#include <inttypes.h>  // For int64_t, uint32_t, uint64_t.
 #include <string.h>  // For memcpy().
 
 #include "utf8lex.h"
@@ -91,13 +91,23 @@ utf8lex_error_t utf8lex_token_init(
     }
     // We don't generate UTF8LEX_ERROR_BAD_HASH errors here.
   }
-  int start_byte = state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
-  int length_bytes = token_loc[UTF8LEX_UNIT_BYTE].length;
+  int64_t start_byte = state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
+  int64_t length_bytes = token_loc[UTF8LEX_UNIT_BYTE].length;
   if (length_bytes <= 0)
   {
     return UTF8LEX_ERROR_BAD_LENGTH;
   }
-  else if ((start_byte + length_bytes) > state->buffer->str->length_bytes)
+
+  // The token can carry on into the next buffer(s) in the chain:
+  int64_t available_bytes =
+    (int64_t) state->buffer->str->length_bytes - start_byte;
+  for (utf8lex_buffer_t *next = state->buffer->next;
+       next != NULL && available_bytes < length_bytes;
+       next = next->next)
+  {
+    available_bytes += (int64_t) next->str->length_bytes;
+  }
+  if (length_bytes > available_bytes)
   {
     return UTF8LEX_ERROR_BAD_LENGTH;
   }
@@ -107,6 +117,7 @@ utf8lex_error_t utf8lex_token_init(
 
   self->start_byte = start_byte;  // Bytes offset into str where token starts.
   self->length_bytes = length_bytes;  // # bytes in token.
+  self->buffer = state->buffer;  // The buffer the token starts in.
   self->str = state->buffer->str;  // The buffer's string.
   // Absolute locations:
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
@@ -120,10 +131,14 @@ utf8lex_error_t utf8lex_token_init(
     // Possible reset (both relative buffer and absolute state)
     // start locations (for chars, graphemes only) after this token:
     self->loc[unit].after = token_loc[unit].after;
-    // Hash of the token (unsigned long, can wrap to 0):
+    // Hash of the token (see utf8lex_hash_concat()):
     self->loc[unit].hash = token_loc[unit].hash;
   }
 
+  // No captures, unless the definition fills them in after init.
+  self->symbol_id = UTF8LEX_SYMBOL_NONE;
+  self->num_captures = 0;
+
   return UTF8LEX_OK;
 }
 
@@ -141,6 +156,7 @@ utf8lex_error_t utf8lex_token_clear(
 
   self->start_byte = -1;
   self->length_bytes = -1;
+  self->buffer = NULL;
   self->str = NULL;
 
   for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
@@ -152,10 +168,58 @@ utf8lex_error_t utf8lex_token_clear(
     self->loc[unit].after = -2;
   }
 
+  self->symbol_id = UTF8LEX_SYMBOL_NONE;
+  self->num_captures = 0;
+
   return UTF8LEX_OK;
 }
 
 
+// Copies the first num_bytes bytes of the token (no more than
+// its length_bytes), carrying on into the next buffer(s) in the chain
+// if the token straddles buffers.  The caller checks the arguments.
+static utf8lex_error_t utf8lex_token_copy_bytes(
+        utf8lex_token_t *self,
+        unsigned char *destination,
+        size_t num_bytes
+        )
+{
+  utf8lex_buffer_t *buffer = self->buffer;
+  utf8lex_string_t *str = self->str;
+  size_t offset = (size_t) self->start_byte;
+  size_t copied_bytes = (size_t) 0;
+  while (copied_bytes < num_bytes)
+  {
+    if (offset >= str->length_bytes)
+    {
+      if (buffer == NULL
+          || buffer->next == NULL
+          || buffer->next->str == NULL)
+      {
+        // The rest of the token is no longer in the chain.
+        return UTF8LEX_ERROR_BAD_LENGTH;
+      }
+
+      buffer = buffer->next;
+      str = buffer->str;
+      offset = (size_t) 0;
+      continue;
+    }
+
+    size_t slice_bytes = str->length_bytes - offset;
+    if (slice_bytes > (num_bytes - copied_bytes))
+    {
+      slice_bytes = num_bytes - copied_bytes;
+    }
+
+    memcpy(&(destination[copied_bytes]), &(str->bytes[offset]), slice_bytes);
+    copied_bytes += slice_bytes;
+    offset += slice_bytes;
+  }
+
+  return UTF8LEX_OK;
+}
+
 // Returns UTF8LEX_MORE if the destination string truncates the token:
 extern utf8lex_error_t utf8lex_token_copy_string(
         utf8lex_token_t *self,
@@ -163,14 +227,16 @@ extern utf8lex_error_t utf8lex_token_copy_string(
         size_t max_bytes)
 {
   if (self == NULL
+      || self->str == NULL
       || str == NULL)
   {
     return UTF8LEX_ERROR_NULL_POINTER;
   }
 
-  int start_byte = self->start_byte;
-  int length_bytes = self->length_bytes;
-  if (start_byte < 0)
+  int64_t start_byte = self->start_byte;
+  int64_t length_bytes = self->length_bytes;
+  if (start_byte < 0
+      || (size_t) start_byte > self->str->length_bytes)
   {
     return UTF8LEX_ERROR_BAD_START;
   }
@@ -178,9 +244,9 @@ extern utf8lex_error_t utf8lex_token_copy_string(
   {
     return UTF8LEX_ERROR_BAD_LENGTH;
   }
-  else if ((size_t) (start_byte + length_bytes) > self->str->length_bytes)
+  else if (max_bytes == (size_t) 0)
   {
-    return UTF8LEX_ERROR_BAD_LENGTH;
+    return UTF8LEX_MORE;
   }
 
   size_t num_bytes = length_bytes;
@@ -189,8 +255,13 @@ extern utf8lex_error_t utf8lex_token_copy_string(
     num_bytes = max_bytes - 1;
   }
 
-  void *source = &self->str->bytes[start_byte];
-  memcpy(str, source, num_bytes);
+  utf8lex_error_t error = utf8lex_token_copy_bytes(self,  // self
+                                                   str,  // destination
+                                                   num_bytes);  // num_bytes
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
   str[num_bytes] = 0;
 
   if (num_bytes != length_bytes)
@@ -229,3 +300,306 @@ utf8lex_error_t utf8lex_token_cat_string(
 
   return error;
 }
+
+
+// Retains (or releases) every buffer that the token's bytes are in.
+// The caller checks the arguments.
+static utf8lex_error_t utf8lex_token_hold(
+        utf8lex_token_t *self,
+        bool is_retain
+        )
+{
+  utf8lex_buffer_t *buffer = self->buffer;
+  int64_t end_byte = self->start_byte + self->length_bytes;
+  while (buffer != NULL)
+  {
+    utf8lex_error_t error = (is_retain == true)
+      ? utf8lex_buffer_retain(buffer)
+      : utf8lex_buffer_release(buffer);
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    if (end_byte <= (int64_t) buffer->str->length_bytes)
+    {
+      break;
+    }
+
+    // The token carries on into the next buffer:
+    end_byte -= (int64_t) buffer->str->length_bytes;
+    buffer = buffer->next;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_token_retain(
+        utf8lex_token_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  return utf8lex_token_hold(self,  // self
+                            true);  // is_retain
+}
+
+utf8lex_error_t utf8lex_token_release(
+        utf8lex_token_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  return utf8lex_token_hold(self,  // self
+                            false);  // is_retain
+}
+
+
+utf8lex_error_t utf8lex_token_view(
+        utf8lex_token_t *self,
+        utf8lex_slice_t *slices,  // Array of (at least) max_slices slices.
+        uint32_t max_slices,
+        uint32_t *num_slices_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || self->str == NULL
+      || slices == NULL
+      || num_slices_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->start_byte < 0
+           || (size_t) self->start_byte > self->str->length_bytes)
+  {
+    return UTF8LEX_ERROR_BAD_START;
+  }
+  else if (self->length_bytes < 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  // Tokens that were not lexed from a chain of buffers
+  // (self->buffer == NULL) are all in self->str.
+  utf8lex_buffer_t *buffer = self->buffer;
+  utf8lex_string_t *str = self->str;
+  size_t offset = (size_t) self->start_byte;
+  size_t remaining_bytes = (size_t) self->length_bytes;
+  uint32_t num_slices = (uint32_t) 0;
+  while (true)
+  {
+    size_t slice_bytes = str->length_bytes - offset;
+    if (slice_bytes > remaining_bytes)
+    {
+      slice_bytes = remaining_bytes;
+    }
+
+    if (num_slices < max_slices)
+    {
+      slices[num_slices].bytes = &(str->bytes[offset]);
+      slices[num_slices].length_bytes = slice_bytes;
+    }
+    num_slices ++;
+    remaining_bytes -= slice_bytes;
+
+    if (remaining_bytes == (size_t) 0)
+    {
+      break;
+    }
+    else if (buffer == NULL
+             || buffer->next == NULL
+             || buffer->next->str == NULL)
+    {
+      // The rest of the token is no longer in the chain.
+      return UTF8LEX_ERROR_BAD_LENGTH;
+    }
+
+    // The token carries on into the next buffer:
+    buffer = buffer->next;
+    str = buffer->str;
+    offset = (size_t) 0;
+  }
+
+  *num_slices_pointer = num_slices;
+
+  if (num_slices > max_slices)
+  {
+    return UTF8LEX_MORE;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_token_contiguous(
+        utf8lex_token_t *self,
+        unsigned char *scratch,  // Only used when the token is in 2+ buffers.
+        size_t max_scratch_bytes,
+        unsigned char **bytes_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || self->str == NULL
+      || bytes_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->start_byte < 0)
+  {
+    return UTF8LEX_ERROR_BAD_START;
+  }
+  else if (self->length_bytes < 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  if ((size_t) (self->start_byte + self->length_bytes)
+      <= self->str->length_bytes)
+  {
+    // The usual case: the whole token is in one buffer.  No copying.
+    *bytes_pointer = &(self->str->bytes[self->start_byte]);
+    return UTF8LEX_OK;
+  }
+  else if (scratch == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if ((size_t) self->length_bytes > max_scratch_bytes)
+  {
+    return UTF8LEX_MORE;
+  }
+
+  // The token straddles buffers, so the caller gets a copy.
+  utf8lex_error_t error = utf8lex_token_copy_bytes(
+      self,  // self
+      scratch,  // destination
+      (size_t) self->length_bytes);  // num_bytes
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  *bytes_pointer = scratch;
+
+  return UTF8LEX_OK;
+}
+
+// ---------------------------------------------------------------------
+//                       utf8lex_compact_token_t
+// ---------------------------------------------------------------------
+
+utf8lex_error_t utf8lex_compact_token_init(
+        utf8lex_compact_token_t *self,
+        utf8lex_token_t *token  // The token to pack.
+        )
+{
+  if (self == NULL
+      || token == NULL
+      || token->rule == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (token->loc[UTF8LEX_UNIT_BYTE].start < 0)
+  {
+    return UTF8LEX_ERROR_BAD_START;
+  }
+  else if (token->length_bytes <= 0
+           || token->length_bytes > (int64_t) UINT32_MAX)
+  {
+    // Compact tokens hold no more than 4 GiB - 1 bytes.
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  self->start_byte = (uint64_t) token->loc[UTF8LEX_UNIT_BYTE].start;
+  self->length_bytes = (uint32_t) token->length_bytes;
+  self->rule_id = token->rule->id;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_compact_token_clear(
+        utf8lex_compact_token_t *self
+        )
+{
+  if (self == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  self->start_byte = (uint64_t) 0;
+  self->length_bytes = (uint32_t) 0;
+  self->rule_id = (uint32_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_compact_token_expand(
+        utf8lex_compact_token_t *self,
+        utf8lex_program_t *program,  // The program the token was lexed with.
+        utf8lex_state_t *state,  // The state the token was lexed with.
+        utf8lex_token_t *token_pointer  // Mutable.
+        )
+{
+  if (self == NULL
+      || program == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || token_pointer == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->length_bytes == (uint32_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  else if (self->rule_id >= (uint32_t) UTF8LEX_RULES_DB_LENGTH_MAX
+           || program->rules_by_id[self->rule_id] == NULL)
+  {
+    return UTF8LEX_ERROR_NOT_FOUND;
+  }
+
+  utf8lex_rule_t *rule = program->rules_by_id[self->rule_id];
+
+  // Read the token's line up to the end of the token:
+  utf8lex_location_t token_loc[UTF8LEX_UNIT_MAX];
+  utf8lex_buffer_t *token_buffer = NULL;
+  off_t token_offset = (off_t) -1;
+  utf8lex_error_t error = utf8lex_location_read(
+      state,  // state
+      self->start_byte,  // start_byte
+      self->start_byte + (uint64_t) self->length_bytes,  // end_byte
+      token_loc,  // loc
+      &token_buffer,  // buffer_pointer
+      &token_offset);  // offset_pointer
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  token_pointer->rule = rule;
+  token_pointer->definition = rule->definition;
+  token_pointer->start_byte = (int64_t) token_offset;
+  token_pointer->length_bytes = (int64_t) self->length_bytes;
+  token_pointer->buffer = token_buffer;
+  token_pointer->str = token_buffer->str;
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    token_pointer->loc[unit].start = token_loc[unit].start;
+    token_pointer->loc[unit].length = token_loc[unit].length;
+    token_pointer->loc[unit].after = token_loc[unit].after;
+    token_pointer->loc[unit].hash = token_loc[unit].hash;
+  }
+  // Capture groups are not kept by compact tokens.
+  token_pointer->symbol_id = UTF8LEX_SYMBOL_NONE;
+  token_pointer->num_captures = 0;
+
+  return UTF8LEX_OK;
+}
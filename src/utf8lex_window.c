@@ -0,0 +1,294 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>  // For open(), posix_fadvise().
+#include <inttypes.h>  // For uint32_t, uint64_t.
+#include <stdbool.h>  // For bool, true, false.
+#include <unistd.h>  // For close(), sysconf().
+
+#include <sys/stat.h>  // For fstat().
+#include <sys/mman.h>  // For madvise(), mmap(), munmap().
+
+#include "utf8lex.h"
+
+
+// ---------------------------------------------------------------------
+//                           utf8lex_window_t
+// ---------------------------------------------------------------------
+
+// Maps the next window of the file into the specified buffer
+// (which is not in the chain):
+static utf8lex_error_t utf8lex_window_map(
+        utf8lex_window_t *self,
+        int w  // Index of the buffer to map into, 0 or 1.
+        )
+{
+  uint64_t offset = self->next_offset;
+  size_t length_bytes = self->window_size;
+  if ((offset + (uint64_t) length_bytes) > self->file_size)
+  {
+    length_bytes = (size_t) (self->file_size - offset);
+  }
+
+  int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+  if ((self->flags & UTF8LEX_WINDOW_POPULATE) != (uint32_t) 0)
+  {
+    // Fault the whole window in up front, instead of page by page.
+    flags |= MAP_POPULATE;
+  }
+#endif
+
+  void *mapped = mmap((void *) NULL,  // addr
+                      length_bytes,  // length
+                      PROT_READ,  // prot
+                      flags,  // flags
+                      self->fd,  // Open fd
+                      (off_t) offset);  // offset
+  if (mapped == MAP_FAILED
+      || mapped == NULL)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+
+  // Hints only: lexing reads each window once, front to back.
+  madvise(mapped, length_bytes, MADV_SEQUENTIAL);
+#if defined(MADV_HUGEPAGE)
+  if ((self->flags & UTF8LEX_WINDOW_HUGE_PAGES) != (uint32_t) 0)
+  {
+    madvise(mapped, length_bytes, MADV_HUGEPAGE);
+  }
+#endif
+
+  self->offsets[w] = offset;
+  self->strs[w].bytes = (unsigned char *) mapped;
+  self->strs[w].max_length_bytes = length_bytes;
+  self->strs[w].length_bytes = length_bytes;
+
+  self->next_offset += (uint64_t) length_bytes;
+  bool is_eof = (self->next_offset >= self->file_size)
+    ? true
+    : false;
+
+  utf8lex_error_t error = utf8lex_buffer_init(&(self->buffers[w]),  // self
+                                              self->tail,  // prev
+                                              &(self->strs[w]),  // str
+                                              is_eof);  // is_eof
+  if (error != UTF8LEX_OK)
+  {
+    munmap(mapped, length_bytes);
+    return error;
+  }
+  self->buffers[w].fd = self->fd;
+
+  if (self->head == NULL)
+  {
+    self->head = &(self->buffers[w]);
+  }
+  self->tail = &(self->buffers[w]);
+
+  return UTF8LEX_OK;
+}
+
+// Unmaps the specified buffer's window, and tells the kernel
+// it can drop the window's pages (they will not be read again):
+static utf8lex_error_t utf8lex_window_unmap(
+        utf8lex_window_t *self,
+        int w  // Index of the buffer to unmap, 0 or 1.
+        )
+{
+  utf8lex_string_t *str = &(self->strs[w]);
+  if (str->bytes == NULL)
+  {
+    return UTF8LEX_OK;
+  }
+
+  madvise(str->bytes, str->length_bytes, MADV_DONTNEED);
+  int munmap_error = munmap(str->bytes, str->length_bytes);
+  if (munmap_error != 0)
+  {
+    return UTF8LEX_ERROR_FILE_MMAP;
+  }
+#if defined(POSIX_FADV_DONTNEED)
+  // Unmapping leaves the pages in the page cache, so drop them, too:
+  posix_fadvise(self->fd,
+                (off_t) self->offsets[w],
+                (off_t) str->length_bytes,
+                POSIX_FADV_DONTNEED);
+#endif
+
+  str->bytes = NULL;
+  str->max_length_bytes = (size_t) 0;
+  str->length_bytes = (size_t) 0;
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_window_init(
+        utf8lex_window_t *self,
+        unsigned char *path,
+        size_t window_size,  // Multiple of the page size.
+        uint32_t flags  // UTF8LEX_WINDOW_POPULATE, ... or 0.
+        )
+{
+  if (self == NULL
+      || path == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (window_size == (size_t) 0
+      || page_size <= 0L
+      || (window_size % (size_t) page_size) != (size_t) 0)
+  {
+    // mmap() offsets have to be page-aligned.
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+
+  struct stat file_statistics;
+  int error_code = fstat(fd, &file_statistics);
+  if (error_code != 0)
+  {
+    close(fd);
+    return UTF8LEX_ERROR_FILE_SIZE;
+  }
+  else if (file_statistics.st_size <= (off_t) 0)  // mmap() needs length > 0.
+  {
+    close(fd);
+    return UTF8LEX_ERROR_FILE_EMPTY;
+  }
+
+  self->fd = fd;
+  self->file_size = (uint64_t) file_statistics.st_size;
+  self->window_size = window_size;
+  self->flags = flags;
+  self->next_offset = (uint64_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+  for (int w = 0; w < 2; w ++)
+  {
+    self->offsets[w] = (uint64_t) 0;
+    self->strs[w].bytes = NULL;
+    self->strs[w].max_length_bytes = (size_t) 0;
+    self->strs[w].length_bytes = (size_t) 0;
+  }
+
+  utf8lex_error_t error = utf8lex_window_map(self,  // self
+                                             0);  // w
+  if (error != UTF8LEX_OK)
+  {
+    close(fd);
+    self->fd = -1;
+    return error;
+  }
+
+  return UTF8LEX_OK;
+}
+
+utf8lex_error_t utf8lex_window_clear(
+        utf8lex_window_t *self
+        )
+{
+  if (self == NULL
+      || self->fd < 0)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  utf8lex_error_t error = UTF8LEX_OK;
+  for (int w = 0; w < 2; w ++)
+  {
+    utf8lex_error_t unmap_error = utf8lex_window_unmap(self,  // self
+                                                       w);  // w
+    if (unmap_error != UTF8LEX_OK)
+    {
+      error = unmap_error;
+    }
+  }
+
+  close(self->fd);
+
+  self->fd = -1;
+  self->file_size = (uint64_t) 0;
+  self->window_size = (size_t) 0;
+  self->flags = (uint32_t) 0;
+  self->next_offset = (uint64_t) 0;
+  self->head = NULL;
+  self->tail = NULL;
+
+  return error;
+}
+
+utf8lex_error_t utf8lex_window_advance(
+        utf8lex_window_t *self,
+        utf8lex_state_t *state
+        )
+{
+  if (self == NULL
+      || self->fd < 0
+      || state == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (self->tail->is_eof == true)
+  {
+    // The whole file has been mapped already, there is nothing more
+    // to append.  (Definitions only ask for more bytes before EOF.)
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  if (self->head != self->tail)
+  {
+    if (state->buffer != self->tail)
+    {
+      // The token being lexed started in the head window, and has
+      // already run through the whole tail window.
+      return UTF8LEX_ERROR_MAX_LENGTH;
+    }
+
+    // The state has moved on into the tail window, so the head window
+    // can go, and be mapped again after the tail:
+    utf8lex_buffer_t *consumed = self->head;
+    int w = (consumed == &(self->buffers[0])) ? 0 : 1;
+    self->head = self->tail;
+    self->head->prev = NULL;
+    consumed->next = NULL;
+    utf8lex_error_t error = utf8lex_window_unmap(self,  // self
+                                                 w);  // w
+    if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    return utf8lex_window_map(self,  // self
+                              w);  // w
+  }
+
+  // Only one window so far: map the next one into the other buffer.
+  int w = (self->head == &(self->buffers[0])) ? 1 : 0;
+  return utf8lex_window_map(self,  // self
+                            w);  // w
+}
@@ -27,10 +27,53 @@
 // Static lexicon:
 static utf8lex_definition_t *YY_FIRST_DEFINITION = NULL;
 static utf8lex_rule_t *YY_FIRST_RULE = NULL;
+// The rules, compiled for faster lexing:
+static utf8lex_program_t YY_PROGRAM;
 
-// Runtime variables (non-thread-safe, of course):
-static utf8lex_state_t YY_STATE;
-static utf8lex_buffer_t YY_BUFFER;
-static utf8lex_string_t YY_STRING;
+// Runtime variables (non-thread-safe, of course).  The session holds
+// the state, buffer and string, and is reused by every yylex_start()
+// and yylex_start_bytes() until yylex_end():
+static utf8lex_session_t YY_SESSION;
+#define YY_STATE (YY_SESSION.state)
+#define YY_BUFFER (YY_SESSION.buffer)
+#define YY_STRING (YY_SESSION.str)
+// Have the rules been compiled (and the session initialized) yet?
+static bool YY_IS_STARTED = false;
+// Did yylex_start() mmap the bytes being lexed?
+static bool YY_IS_MAPPED = false;
+
+// Modes (start conditions), flex-style, for use in rule code:
+//     BEGIN COMMENT;  or  BEGIN(COMMENT);
+//     yy_push_state(COMMENT);  ...  yy_pop_state();
+// BEGIN stores the mode, then (in the for loop's increment) switches
+// to it with yy_begin(), so that a mode with no compiled rules is
+// reported by the rule that asked for it, not by the next yylex().
+static utf8lex_error_t yylex_print_error(
+        utf8lex_error_t error
+        );
+static uint32_t YY_BEGIN_MODE = (uint32_t) UTF8LEX_MODE_INITIAL;
+static int yy_begin(
+        uint32_t mode
+        )
+{
+  utf8lex_error_t error = UTF8LEX_ERROR_BAD_MODE;
+  if (mode < YY_PROGRAM.num_modes)
+  {
+    error = utf8lex_state_set_mode(&YY_STATE,  // self
+                                   mode);  // mode
+  }
+  yylex_print_error(error);
+  return 1;
+}
+#define BEGIN \
+  for (int yy_is_begun = 0; \
+       yy_is_begun == 0; \
+       yy_is_begun = yy_begin(YY_BEGIN_MODE)) \
+    YY_BEGIN_MODE = (uint32_t)
+#define YY_START ((int) YY_STATE.mode)
+#define yy_push_state(mode) \
+  utf8lex_state_push_mode(&YY_STATE, (uint32_t) (mode))
+#define yy_pop_state() \
+  utf8lex_state_pop_mode(&YY_STATE)
 
 static utf8lex_error_t yy_rules_init();
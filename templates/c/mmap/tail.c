@@ -140,7 +140,7 @@ static utf8lex_error_t yylex_print_error(
   if (fill_error == UTF8LEX_OK)
   {
     fprintf(stderr,
-            "ERROR (%s) yylex failed to parse %d.%d: \"%s\"\n",
+            "ERROR (%s) yylex failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
             error_name,
             YY_STATE.loc[UTF8LEX_UNIT_LINE].start + 1,
             YY_STATE.loc[UTF8LEX_UNIT_CHAR].start,
@@ -151,6 +151,68 @@ static utf8lex_error_t yylex_print_error(
 }
 
 
+// =====================================================================
+// Compiles the rules and initializes the session, the first time only.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_start_session()
+{
+  if (YY_IS_STARTED == true)
+  {
+    return UTF8LEX_OK;
+  }
+
+  // Initialize YY_FIRST_RULE, and the database of definitions and rules:
+  utf8lex_error_t error = yy_rules_init();
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Compile the rules into a program, with the rules for each mode:
+  error = utf8lex_program_compile_modes(&YY_PROGRAM,  // self
+                                        YY_FIRST_RULE,  // first_rule
+                                        (uint32_t) YY_NUM_MODES);  // num_modes
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Initialize the lexing session (and its state):
+  error = utf8lex_session_init(&YY_SESSION,  // self
+                               &YY_PROGRAM);  // program
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  YY_IS_STARTED = true;
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Unmaps the file mmapped by yylex_start(), if any.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_unmap()
+{
+  if (YY_IS_MAPPED == false)
+  {
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_error_t error = utf8lex_buffer_munmap(&YY_BUFFER);
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  YY_IS_MAPPED = false;
+
+  return UTF8LEX_OK;
+}
+
+
 // =====================================================================
 // Begin lexing.
 // ---------------------------------------------------------------------
@@ -163,22 +225,23 @@ utf8lex_error_t yylex_start(
     return yylex_print_error(UTF8LEX_ERROR_NULL_POINTER);
   }
 
-  // Initialize YY_FIRST_RULE, and the database of definitions and rules:
-  utf8lex_error_t error = yy_rules_init();
+  utf8lex_error_t error = yylex_start_session();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = yylex_unmap();
   if (error != UTF8LEX_OK)
   {
     return yylex_print_error(error);
   }
 
-  // Minimally initialize the string and buffer contents:
+  // Minimally initialize the string contents:
   YY_STRING.max_length_bytes = -1;
   YY_STRING.length_bytes = -1;
   YY_STRING.bytes = NULL;
 
-  YY_BUFFER.next = NULL;
-  YY_BUFFER.prev = NULL;
-  YY_BUFFER.str = &YY_STRING;
-
   // mmap the file to be lexed:
   error = utf8lex_buffer_mmap(&YY_BUFFER,
                               path);  // path
@@ -186,10 +249,52 @@ utf8lex_error_t yylex_start(
   {
     return yylex_print_error(error);
   }
+  YY_IS_MAPPED = true;
 
-  // Initialize the lexing state:
-  error = utf8lex_state_init(&YY_STATE,  // self
-                             &YY_BUFFER);  // buffer
+  // Start lexing the mmapped file from the beginning:
+  error = utf8lex_session_reset(&YY_SESSION,  // self
+                                YY_STRING.bytes,  // bytes
+                                YY_STRING.length_bytes);  // length_bytes
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Begin lexing bytes in memory (owned by the caller, and unchanged
+// until the next yylex_start...() or yylex_end()).  The rules are only
+// compiled the first time, so this can be called once per document
+// to lex many documents, one after another.
+// ---------------------------------------------------------------------
+utf8lex_error_t yylex_start_bytes(
+        unsigned char *bytes,
+        size_t length_bytes
+        )
+{
+  if (bytes == NULL)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_NULL_POINTER);
+  }
+
+  utf8lex_error_t error = yylex_start_session();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = yylex_unmap();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = utf8lex_session_reset(&YY_SESSION,  // self
+                                bytes,  // bytes
+                                length_bytes);  // length_bytes
   if (error != UTF8LEX_OK)
   {
     return yylex_print_error(error);
@@ -218,9 +323,9 @@ int yyutf8lex(
     token_pointer = token_or_null;
   }
 
-  utf8lex_error_t error = utf8lex_lex(YY_FIRST_RULE,  // first_rule
-                                      &YY_STATE,  // state
-                                      token_pointer);  // token
+  utf8lex_error_t error = utf8lex_program_lex(&YY_PROGRAM,  // program
+                                              &YY_STATE,  // state
+                                              token_pointer);  // token
   if (error == UTF8LEX_EOF)
   {
     // Nothing more to lex.
@@ -292,15 +397,26 @@ int yylex()
 // ---------------------------------------------------------------------
 utf8lex_error_t yylex_end()
 {
-  // Unmap the mmap'ed file:
-  utf8lex_error_t error = utf8lex_buffer_munmap(YY_STATE.buffer);
+  if (YY_IS_STARTED == false)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_STATE);
+  }
+
+  // Unmap the mmap'ed file (if lexing a file):
+  utf8lex_error_t error = yylex_unmap();
   if (error != UTF8LEX_OK)
   {
     return yylex_print_error(error);
   }
 
   // Teardown:
-  error = utf8lex_state_clear(&YY_STATE);
+  error = utf8lex_session_clear(&YY_SESSION);
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = utf8lex_program_clear(&YY_PROGRAM);
   if (error != UTF8LEX_OK)
   {
     return yylex_print_error(error);
@@ -359,6 +475,8 @@ utf8lex_error_t yylex_end()
     return yylex_print_error(UTF8LEX_ERROR_INFINITE_LOOP);
   }
 
+  YY_IS_STARTED = false;
+
   return UTF8LEX_OK;
 }
 
@@ -0,0 +1,1579 @@
+/*
+ * Generated by utf8lex.
+ *
+ * Requires at runtime:
+ *
+ *     utf8lex
+ *       https://github.com/jtienhaara/utf8lex
+ *       Apache 2.0 license
+ *
+ *     utf8proc
+ *       https://juliastrings.github.io/utf8proc
+ *       MIT license
+ *       Unicode data license
+ *
+ *     pcre2
+ *       https://github.com/PCRE2Project/pcre2
+ *       BSD license
+ *
+ * This generated file is licensed according to the source code with which
+ * it is distributed.
+ */
+#include <stdio.h>
+#include <string.h>  // For strlen(), strcpy(), strcat, strncpy
+
+#include "utf8lex.h"
+
+// Static lexicon:
+static utf8lex_definition_t *YY_FIRST_DEFINITION = NULL;
+static utf8lex_rule_t *YY_FIRST_RULE = NULL;
+// The rules, compiled for faster lexing:
+static utf8lex_program_t YY_PROGRAM;
+
+// Runtime variables (non-thread-safe, of course).  The session holds
+// the state, buffer and string, and is reused by every yylex_start()
+// and yylex_start_bytes() until yylex_end():
+static utf8lex_session_t YY_SESSION;
+#define YY_STATE (YY_SESSION.state)
+#define YY_BUFFER (YY_SESSION.buffer)
+#define YY_STRING (YY_SESSION.str)
+// Have the rules been compiled (and the session initialized) yet?
+static bool YY_IS_STARTED = false;
+// Did yylex_start() mmap the bytes being lexed?
+static bool YY_IS_MAPPED = false;
+
+// Modes (start conditions), flex-style, for use in rule code:
+//     BEGIN COMMENT;  or  BEGIN(COMMENT);
+//     yy_push_state(COMMENT);  ...  yy_pop_state();
+// BEGIN stores the mode, then (in the for loop's increment) switches
+// to it with yy_begin(), so that a mode with no compiled rules is
+// reported by the rule that asked for it, not by the next yylex().
+static utf8lex_error_t yylex_print_error(
+        utf8lex_error_t error
+        );
+static uint32_t YY_BEGIN_MODE = (uint32_t) UTF8LEX_MODE_INITIAL;
+static int yy_begin(
+        uint32_t mode
+        )
+{
+  utf8lex_error_t error = UTF8LEX_ERROR_BAD_MODE;
+  if (mode < YY_PROGRAM.num_modes)
+  {
+    error = utf8lex_state_set_mode(&YY_STATE,  // self
+                                   mode);  // mode
+  }
+  yylex_print_error(error);
+  return 1;
+}
+#define BEGIN \
+  for (int yy_is_begun = 0; \
+       yy_is_begun == 0; \
+       yy_is_begun = yy_begin(YY_BEGIN_MODE)) \
+    YY_BEGIN_MODE = (uint32_t)
+#define YY_START ((int) YY_STATE.mode)
+#define yy_push_state(mode) \
+  utf8lex_state_push_mode(&YY_STATE, (uint32_t) (mode))
+#define yy_pop_state() \
+  utf8lex_state_pop_mode(&YY_STATE)
+
+static utf8lex_error_t yy_rules_init();
+#define EXCLAMATION "Woohoo!"
+#define QUESTION "What sort of exclamation should we cry?"
+
+// Modes (start conditions):
+#define INITIAL 0
+#define COMMENT 1
+#define YY_NUM_MODES 2
+
+static utf8lex_cat_definition_t YY_CAT_DEFINITIONS[50];
+static utf8lex_literal_definition_t YY_LITERAL_DEFINITIONS[6];
+static utf8lex_multi_definition_t YY_MULTI_DEFINITIONS[6];
+static utf8lex_reference_t YY_REFERENCES[9];
+static utf8lex_regex_definition_t YY_REGEX_DEFINITIONS[4];
+
+static utf8lex_rule_t YY_RULES[9];
+
+
+static utf8lex_error_t yy_rules_init()
+{
+    utf8lex_error_t error;
+    utf8lex_definition_t *rule_definition;
+
+    // Definitions:
+    // =================================================================
+
+    // Definition # 0: NA (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[0]),  // self
+                (utf8lex_definition_t *) NULL,  // prev
+                "NA",  // name
+                (utf8lex_cat_t) 1,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+    YY_FIRST_DEFINITION = (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[0]);
+
+    // Definition # 1: UPPER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[1]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[0]),  // prev
+                "UPPER",  // name
+                (utf8lex_cat_t) 2,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 2: LOWER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[2]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[1]),  // prev
+                "LOWER",  // name
+                (utf8lex_cat_t) 4,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 3: TITLE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[3]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[2]),  // prev
+                "TITLE",  // name
+                (utf8lex_cat_t) 8,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 4: MODIFIER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[4]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[3]),  // prev
+                "MODIFIER",  // name
+                (utf8lex_cat_t) 16,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 5: LETTER_OTHER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[5]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[4]),  // prev
+                "LETTER_OTHER",  // name
+                (utf8lex_cat_t) 32,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 6: MARK_NS (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[6]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[5]),  // prev
+                "MARK_NS",  // name
+                (utf8lex_cat_t) 64,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 7: MARK_SC (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[7]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[6]),  // prev
+                "MARK_SC",  // name
+                (utf8lex_cat_t) 128,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 8: MARK_E (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[8]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[7]),  // prev
+                "MARK_E",  // name
+                (utf8lex_cat_t) 256,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 9: DECIMAL (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[9]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[8]),  // prev
+                "DECIMAL",  // name
+                (utf8lex_cat_t) 512,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 10: NUM_LETTER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[10]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[9]),  // prev
+                "NUM_LETTER",  // name
+                (utf8lex_cat_t) 1024,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 11: NUM_OTHER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[11]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[10]),  // prev
+                "NUM_OTHER",  // name
+                (utf8lex_cat_t) 2048,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 12: CONNECTOR (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[12]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[11]),  // prev
+                "CONNECTOR",  // name
+                (utf8lex_cat_t) 4096,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 13: DASH (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[13]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[12]),  // prev
+                "DASH",  // name
+                (utf8lex_cat_t) 8192,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 14: PUNCT_OPEN (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[14]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[13]),  // prev
+                "PUNCT_OPEN",  // name
+                (utf8lex_cat_t) 16384,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 15: PUNCT_CLOSE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[15]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[14]),  // prev
+                "PUNCT_CLOSE",  // name
+                (utf8lex_cat_t) 32768,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 16: QUOTE_OPEN (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[16]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[15]),  // prev
+                "QUOTE_OPEN",  // name
+                (utf8lex_cat_t) 65536,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 17: QUOTE_CLOSE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[17]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[16]),  // prev
+                "QUOTE_CLOSE",  // name
+                (utf8lex_cat_t) 131072,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 18: PUNCT_OTHER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[18]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[17]),  // prev
+                "PUNCT_OTHER",  // name
+                (utf8lex_cat_t) 262144,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 19: MATH (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[19]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[18]),  // prev
+                "MATH",  // name
+                (utf8lex_cat_t) 524288,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 20: CURRENCY (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[20]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[19]),  // prev
+                "CURRENCY",  // name
+                (utf8lex_cat_t) 1048576,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 21: SYM_MODIFIER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[21]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[20]),  // prev
+                "SYM_MODIFIER",  // name
+                (utf8lex_cat_t) 2097152,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 22: SYM_OTHER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[22]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[21]),  // prev
+                "SYM_OTHER",  // name
+                (utf8lex_cat_t) 4194304,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 23: HSPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[23]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[22]),  // prev
+                "HSPACE",  // name
+                (utf8lex_cat_t) 8388608,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 24: LINE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[24]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[23]),  // prev
+                "LINE",  // name
+                (utf8lex_cat_t) 16777216,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 25: PARAGRAPH (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[25]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[24]),  // prev
+                "PARAGRAPH",  // name
+                (utf8lex_cat_t) 33554432,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 26: CONTROL (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[26]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[25]),  // prev
+                "CONTROL",  // name
+                (utf8lex_cat_t) 67108864,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 27: FORMAT (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[27]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[26]),  // prev
+                "FORMAT",  // name
+                (utf8lex_cat_t) 134217728,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 28: SURROGATE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[28]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[27]),  // prev
+                "SURROGATE",  // name
+                (utf8lex_cat_t) 268435456,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 29: PRIVATE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[29]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[28]),  // prev
+                "PRIVATE",  // name
+                (utf8lex_cat_t) 536870912,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 30: NEWLINE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[30]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[29]),  // prev
+                "NEWLINE",  // name
+                (utf8lex_cat_t) 1073741824,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 31: OTHER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[31]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[30]),  // prev
+                "OTHER",  // name
+                (utf8lex_cat_t) 1006632961,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 32: LETTER | MARK | NUM | PUNCT | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[32]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[31]),  // prev
+                "LETTER | MARK | NUM | PUNCT | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 1140850686,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 33: LETTER (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[33]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[32]),  // prev
+                "LETTER",  // name
+                (utf8lex_cat_t) 62,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 34: OTHER | MARK | NUM | PUNCT | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[34]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[33]),  // prev
+                "OTHER | MARK | NUM | PUNCT | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 2147483585,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 35: MARK (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[35]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[34]),  // prev
+                "MARK",  // name
+                (utf8lex_cat_t) 448,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 36: OTHER | LETTER | NUM | PUNCT | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[36]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[35]),  // prev
+                "OTHER | LETTER | NUM | PUNCT | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 2147483199,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 37: NUM (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[37]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[36]),  // prev
+                "NUM",  // name
+                (utf8lex_cat_t) 3584,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 38: OTHER | LETTER | MARK | PUNCT | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[38]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[37]),  // prev
+                "OTHER | LETTER | MARK | PUNCT | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 2147480063,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 39: PUNCT (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[39]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[38]),  // prev
+                "PUNCT",  // name
+                (utf8lex_cat_t) 520192,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 40: OTHER | LETTER | MARK | NUM | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[40]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[39]),  // prev
+                "OTHER | LETTER | MARK | NUM | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 2146963455,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 41: SYM (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[41]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[40]),  // prev
+                "SYM",  // name
+                (utf8lex_cat_t) 7864320,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 42: OTHER | LETTER | MARK | NUM | PUNCT | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[42]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[41]),  // prev
+                "OTHER | LETTER | MARK | NUM | PUNCT | WHITESPACE",  // name
+                (utf8lex_cat_t) 2139619327,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 43: WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[43]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[42]),  // prev
+                "WHITESPACE",  // name
+                (utf8lex_cat_t) 1132462080,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 44: LETTER | MARK | NUM | PUNCT | SYM | NA | FORMAT | SURROGATE | PRIVATE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[44]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[43]),  // prev
+                "LETTER | MARK | NUM | PUNCT | SYM | NA | FORMAT | SURROGATE | PRIVATE",  // name
+                (utf8lex_cat_t) 947912703,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 45: HSPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[45]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[44]),  // prev
+                "HSPACE",  // name
+                (utf8lex_cat_t) 8388608,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 46: OTHER | LETTER | MARK | NUM | PUNCT | SYM | VSPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[46]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[45]),  // prev
+                "OTHER | LETTER | MARK | NUM | PUNCT | SYM | VSPACE",  // name
+                (utf8lex_cat_t) 2139095039,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 47: VSPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[47]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[46]),  // prev
+                "VSPACE",  // name
+                (utf8lex_cat_t) 1124073472,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 48: LETTER | MARK | NUM | PUNCT | SYM | HSPACE | NA | FORMAT | SURROGATE | PRIVATE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[48]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[47]),  // prev
+                "LETTER | MARK | NUM | PUNCT | SYM | HSPACE | NA | FORMAT | SURROGATE | PRIVATE",  // name
+                (utf8lex_cat_t) 956301311,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 49: OTHER | LETTER | MARK | NUM | PUNCT | SYM | WHITESPACE (cat)
+    error = utf8lex_cat_definition_init(
+                &(YY_CAT_DEFINITIONS[49]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[48]),  // prev
+                "OTHER | LETTER | MARK | NUM | PUNCT | SYM | WHITESPACE",  // name
+                (utf8lex_cat_t) 2147483647,  // cat
+                1,  // min
+                1);  // max
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 50: ID (regex)
+    error = utf8lex_regex_definition_init(
+                &(YY_REGEX_DEFINITIONS[0]),  // self
+                (utf8lex_definition_t *) &(YY_CAT_DEFINITIONS[49]),  // prev
+                "ID",  // name
+                "[_\\p{L}][_\\p{L}\\p{N}]*");  // pattern
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 51: LINE_BREAK (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[0]),  // self
+                (utf8lex_definition_t *) &(YY_REGEX_DEFINITIONS[0]),  // prev
+                "LINE_BREAK",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_OR,  // multi_type
+                false);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[0]),  // self
+                NULL,  // prev
+                "VSPACE",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[0]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[1]),  // self
+                &(YY_REFERENCES[0]),  // prev
+                "PARAGRAPH",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[0]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[2]),  // self
+                &(YY_REFERENCES[1]),  // prev
+                "NEWLINE",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[0]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 52: EQ (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[0]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[0]),  // prev
+                "EQ",  // name
+                "=");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 53: EQ3 (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[1]),  // self
+                (utf8lex_definition_t *) &(YY_LITERAL_DEFINITIONS[0]),  // prev
+                "EQ3",  // name
+                "===");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 54: EQUALITY (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[1]),  // self
+                (utf8lex_definition_t *) &(YY_LITERAL_DEFINITIONS[1]),  // prev
+                "EQUALITY",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_OR,  // multi_type
+                true);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[3]),  // self
+                NULL,  // prev
+                "EQ",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[1]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[4]),  // self
+                &(YY_REFERENCES[3]),  // prev
+                "EQ3",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[1]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 55: BACKIE (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[2]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[1]),  // prev
+                "BACKIE",  // name
+                "\\");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 56: BLANKS (regex)
+    error = utf8lex_regex_definition_init(
+                &(YY_REGEX_DEFINITIONS[1]),  // self
+                (utf8lex_definition_t *) &(YY_LITERAL_DEFINITIONS[2]),  // prev
+                "BLANKS",  // name
+                "[\\h]+");  // pattern
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 57: rule_1 (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[2]),  // self
+                (utf8lex_definition_t *) &(YY_REGEX_DEFINITIONS[1]),  // prev
+                "rule_1",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+                false);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[5]),  // self
+                NULL,  // prev
+                "ID",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[2]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 58: rule_2 (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[3]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[2]),  // prev
+                "rule_2",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+                false);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[6]),  // self
+                NULL,  // prev
+                "LINE_BREAK",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[3]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 59: rule_3 (regex)
+    error = utf8lex_regex_definition_init(
+                &(YY_REGEX_DEFINITIONS[2]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[3]),  // prev
+                "rule_3",  // name
+                "[\\+\\-]?[1-9][0-9]*(\\.[1-9][0-9]*)?(e[\\+\\-][1-9][0-9]*)?");  // pattern
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 60: rule_4 (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[4]),  // self
+                (utf8lex_definition_t *) &(YY_REGEX_DEFINITIONS[2]),  // prev
+                "rule_4",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+                false);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[7]),  // self
+                NULL,  // prev
+                "BACKIE",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[4]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 61: rule_5 (multi)
+    error = utf8lex_multi_definition_init(
+                &(YY_MULTI_DEFINITIONS[5]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[4]),  // prev
+                "rule_5",  // name
+                NULL,  // parent
+                UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+                false);  // is_longest
+    if (error != UTF8LEX_OK) { return error; }
+
+    error = utf8lex_reference_init(
+                &(YY_REFERENCES[8]),  // self
+                NULL,  // prev
+                "BLANKS",  // name
+                1,  // min
+                1,  // max
+                &(YY_MULTI_DEFINITIONS[5]));  // parent
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 62: rule_6 (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[3]),  // self
+                (utf8lex_definition_t *) &(YY_MULTI_DEFINITIONS[5]),  // prev
+                "rule_6",  // name
+                "/*");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 63: rule_7 (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[4]),  // self
+                (utf8lex_definition_t *) &(YY_LITERAL_DEFINITIONS[3]),  // prev
+                "rule_7",  // name
+                "*/");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 64: rule_8 (regex)
+    error = utf8lex_regex_definition_init(
+                &(YY_REGEX_DEFINITIONS[3]),  // self
+                (utf8lex_definition_t *) &(YY_LITERAL_DEFINITIONS[4]),  // prev
+                "rule_8",  // name
+                "[^*]+");  // pattern
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Definition # 65: rule_9 (literal)
+    error = utf8lex_literal_definition_init(
+                &(YY_LITERAL_DEFINITIONS[5]),  // self
+                (utf8lex_definition_t *) &(YY_REGEX_DEFINITIONS[3]),  // prev
+                "rule_9",  // name
+                "*");  // str
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Resolve multi-definitions:
+    // # 0 LINE_BREAK:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[0]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+    // # 1 EQUALITY:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[1]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+    // # 2 rule_1:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[2]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+    // # 3 rule_2:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[3]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+    // # 4 rule_4:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[4]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+    // # 5 rule_5:
+    error = utf8lex_multi_definition_resolve(
+        &(YY_MULTI_DEFINITIONS[5]),  // self
+        YY_FIRST_DEFINITION);  // db
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rules:
+    // =================================================================
+
+    // Rule # 0: rule_1
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 57,  // id ("rule_1")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[0]),  // self
+                NULL,  // prev
+                "rule_1",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[0]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+    YY_FIRST_RULE = &(YY_RULES[0]);
+
+    // Rule # 1: rule_2
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 58,  // id ("rule_2")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[1]),  // self
+                &(YY_RULES[0]),  // prev
+                "rule_2",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[1]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 2: rule_3
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 59,  // id ("rule_3")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[2]),  // self
+                &(YY_RULES[1]),  // prev
+                "rule_3",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[2]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 3: rule_4
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 60,  // id ("rule_4")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[3]),  // self
+                &(YY_RULES[2]),  // prev
+                "rule_4",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[3]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 4: rule_5
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 61,  // id ("rule_5")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[4]),  // self
+                &(YY_RULES[3]),  // prev
+                "rule_5",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_skip(
+                &(YY_RULES[4]),  // self
+                true);  // is_skip
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[4]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 5: rule_6
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 62,  // id ("rule_6")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[5]),  // self
+                &(YY_RULES[4]),  // prev
+                "rule_6",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[5]),  // self
+                (uint32_t) 0x00000001);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 6: rule_7
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 63,  // id ("rule_7")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[6]),  // self
+                &(YY_RULES[5]),  // prev
+                "rule_7",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[6]),  // self
+                (uint32_t) 0x00000002);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 7: rule_8
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 64,  // id ("rule_8")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[7]),  // self
+                &(YY_RULES[6]),  // prev
+                "rule_8",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[7]),  // self
+                (uint32_t) 0x00000002);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    // Rule # 8: rule_9
+    error = utf8lex_definition_find_by_id(
+                YY_FIRST_DEFINITION,  // first_definition
+                (uint32_t) 65,  // id ("rule_9")
+                &rule_definition);  // found_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_init(
+                &(YY_RULES[8]),  // self
+                &(YY_RULES[7]),  // prev
+                "rule_9",  // name
+                rule_definition,  // definition
+                "",  // code
+                (size_t) 0);  // code_length_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_rule_set_modes(
+                &(YY_RULES[8]),  // self
+                (uint32_t) 0x00000002);  // modes
+    if (error != UTF8LEX_OK) { return error; }
+
+    return UTF8LEX_OK;
+}
+
+static int yy_rule_callback(
+        utf8lex_token_t *token
+        )
+{
+    if (token == NULL
+        || token->rule == NULL
+        || token->rule->code == NULL)
+    {
+        return YYerror;
+    }
+
+    switch (token->rule->id)
+    {
+        case (uint32_t) 0:  // # 0 rule_1
+ printf("Hello, ID world\n");             break;
+        case (uint32_t) 1:  // # 1 rule_2
+            break;
+        case (uint32_t) 2:  // # 2 rule_3
+
+    printf("That was quite the number.\n");
+            break;
+        case (uint32_t) 3:  // # 3 rule_4
+ BEGIN INITIAL;             break;
+        case (uint32_t) 4:  // # 4 rule_5
+            break;
+        case (uint32_t) 5:  // # 5 rule_6
+ yy_push_state(COMMENT);             break;
+        case (uint32_t) 6:  // # 6 rule_7
+ yy_pop_state();             break;
+        case (uint32_t) 7:  // # 7 rule_8
+            break;
+        case (uint32_t) 8:  // # 8 rule_9
+ BEGIN(COMMENT);             break;
+        default:
+            return YYerror;
+    }
+    return (int) token->rule->id;
+}
+const int FOO = 0x0042;
+// =====================================================================
+// Since an entire source file can be mmapped in, when we print an error
+// message, we only want to grab some of it.  The yylex_print_error()
+// procedure uses this to pull in some context.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_fill_some_of_remaining_buffer(
+        unsigned char *some_of_remaining_buffer,
+        utf8lex_state_t *state,
+        size_t buffer_bytes,
+        size_t max_bytes
+        )
+{
+  if (some_of_remaining_buffer == NULL
+      || state == NULL
+      || state->buffer == NULL
+      || state->buffer->loc == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+  else if (buffer_bytes <= (size_t) 0
+           || max_bytes <= (size_t) 0)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  off_t start_byte = (off_t) state->buffer->loc[UTF8LEX_UNIT_BYTE].start;
+
+  size_t num_bytes;
+  if (buffer_bytes < max_bytes)
+  {
+    num_bytes = buffer_bytes;
+  }
+  else
+  {
+    num_bytes = max_bytes - 1;
+  }
+  strncpy(some_of_remaining_buffer,
+          &(state->buffer->str->bytes[start_byte]),
+          num_bytes);
+  some_of_remaining_buffer[num_bytes] = 0;
+
+  bool is_first_eof = true;
+  off_t c = (off_t) 0;
+  for (c = (off_t) 0; c <= (off_t) (max_bytes - 4); c ++)
+  {
+    if (some_of_remaining_buffer[c] == 0)
+    {
+      break;
+    }
+    else if (some_of_remaining_buffer[c] == '\r'
+             || some_of_remaining_buffer[c] == '\n')
+    {
+      if (is_first_eof == false
+          || c >= (max_bytes - 6))
+      {
+        some_of_remaining_buffer[c] = 0;
+      }
+      else
+      {
+        // We have enough room to shift everything,
+        // and insert an extra character, so we'll put in
+        // "\\r" or "\\n".
+        for (int d = num_bytes; d > c; d --)
+        {
+          some_of_remaining_buffer[d] = some_of_remaining_buffer[d - 1];
+        }
+        if (some_of_remaining_buffer[c] == '\r')
+        {
+          some_of_remaining_buffer[c + 1] = 'r';
+        }
+        else if (some_of_remaining_buffer[c] == '\n')
+        {
+          some_of_remaining_buffer[c + 1] = 'n';
+        }
+        else
+        {
+          some_of_remaining_buffer[c + 1] = '?';
+        }
+        some_of_remaining_buffer[c] = '\\';
+        if ((num_bytes + 1) < max_bytes)
+        {
+          some_of_remaining_buffer[num_bytes + 1] = 0;
+        }
+        else
+        {
+          some_of_remaining_buffer[num_bytes] = 0;
+        }
+        is_first_eof = false;
+        c += 2;
+      }
+    }
+  }
+  if (c >= (off_t) max_bytes)
+  {
+    some_of_remaining_buffer[max_bytes - 4] = '.';
+    some_of_remaining_buffer[max_bytes - 3] = '.';
+    some_of_remaining_buffer[max_bytes - 2] = '.';
+    some_of_remaining_buffer[max_bytes - 1] = 0;
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Prints an error message to stderr, then returns the error code.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_print_error(
+        utf8lex_error_t error
+        )
+{
+  if (error == UTF8LEX_OK)
+  {
+    return UTF8LEX_OK;
+  }
+  else if (YY_STATE.buffer == NULL)
+  {
+    return error;
+  }
+
+  size_t max_length_bytes;  // How many bytes have been allocated.
+  size_t length_bytes;  // How many bytes have been written.
+  unsigned char *bytes;
+
+  unsigned char error_name[256];
+  utf8lex_string_t error_string;
+  utf8lex_error_t string_error = utf8lex_string(&error_string, 256, error_name);
+  string_error = utf8lex_error_string(&error_string, error);
+  if (string_error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  unsigned char some_of_remaining_buffer[32];
+  utf8lex_error_t fill_error = yylex_fill_some_of_remaining_buffer(
+      some_of_remaining_buffer,
+      &YY_STATE,
+      (size_t) YY_STATE.buffer->str->length_bytes,
+      (size_t) 32);
+  if (fill_error == UTF8LEX_OK)
+  {
+    fprintf(stderr,
+            "ERROR (%s) yylex failed to parse %" PRId64 ".%" PRId64 ": \"%s\"\n",
+            error_name,
+            YY_STATE.loc[UTF8LEX_UNIT_LINE].start + 1,
+            YY_STATE.loc[UTF8LEX_UNIT_CHAR].start,
+            some_of_remaining_buffer);
+  }
+
+  return error;
+}
+
+
+// =====================================================================
+// Compiles the rules and initializes the session, the first time only.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_start_session()
+{
+  if (YY_IS_STARTED == true)
+  {
+    return UTF8LEX_OK;
+  }
+
+  // Initialize YY_FIRST_RULE, and the database of definitions and rules:
+  utf8lex_error_t error = yy_rules_init();
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Compile the rules into a program, with the rules for each mode:
+  error = utf8lex_program_compile_modes(&YY_PROGRAM,  // self
+                                        YY_FIRST_RULE,  // first_rule
+                                        (uint32_t) YY_NUM_MODES);  // num_modes
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Initialize the lexing session (and its state):
+  error = utf8lex_session_init(&YY_SESSION,  // self
+                               &YY_PROGRAM);  // program
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  YY_IS_STARTED = true;
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Unmaps the file mmapped by yylex_start(), if any.
+// ---------------------------------------------------------------------
+static utf8lex_error_t yylex_unmap()
+{
+  if (YY_IS_MAPPED == false)
+  {
+    return UTF8LEX_OK;
+  }
+
+  utf8lex_error_t error = utf8lex_buffer_munmap(&YY_BUFFER);
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  YY_IS_MAPPED = false;
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Begin lexing.
+// ---------------------------------------------------------------------
+utf8lex_error_t yylex_start(
+        unsigned char *path
+        )
+{
+  if (path == NULL)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_NULL_POINTER);
+  }
+
+  utf8lex_error_t error = yylex_start_session();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = yylex_unmap();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  // Minimally initialize the string contents:
+  YY_STRING.max_length_bytes = -1;
+  YY_STRING.length_bytes = -1;
+  YY_STRING.bytes = NULL;
+
+  // mmap the file to be lexed:
+  error = utf8lex_buffer_mmap(&YY_BUFFER,
+                              path);  // path
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+  YY_IS_MAPPED = true;
+
+  // Start lexing the mmapped file from the beginning:
+  error = utf8lex_session_reset(&YY_SESSION,  // self
+                                YY_STRING.bytes,  // bytes
+                                YY_STRING.length_bytes);  // length_bytes
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Begin lexing bytes in memory (owned by the caller, and unchanged
+// until the next yylex_start...() or yylex_end()).  The rules are only
+// compiled the first time, so this can be called once per document
+// to lex many documents, one after another.
+// ---------------------------------------------------------------------
+utf8lex_error_t yylex_start_bytes(
+        unsigned char *bytes,
+        size_t length_bytes
+        )
+{
+  if (bytes == NULL)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_NULL_POINTER);
+  }
+
+  utf8lex_error_t error = yylex_start_session();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = yylex_unmap();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = utf8lex_session_reset(&YY_SESSION,  // self
+                                bytes,  // bytes
+                                length_bytes);  // length_bytes
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// =====================================================================
+// Lex with utf8 locations (including grapheme # etc).
+// ---------------------------------------------------------------------
+int yyutf8lex(
+        utf8lex_token_t *token_or_null,
+        utf8lex_lloc_t *location_or_null
+        )
+{
+  utf8lex_token_t token;
+  utf8lex_token_t *token_pointer;
+  if (token_or_null == NULL)
+  {
+    token_pointer = &token;
+  }
+  else
+  {
+    token_pointer = token_or_null;
+  }
+
+  utf8lex_error_t error = utf8lex_program_lex(&YY_PROGRAM,  // program
+                                              &YY_STATE,  // state
+                                              token_pointer);  // token
+  if (error == UTF8LEX_EOF)
+  {
+    // Nothing more to lex.
+    return YYEOF;
+  }
+  else if (error != UTF8LEX_OK)
+  {
+    yylex_print_error(error);
+    return YYerror;
+  }
+
+  int token_code = (int) token_pointer->rule->id;
+
+  // Execute the rule callback for matched rule:
+  token_code = yy_rule_callback(token_pointer);
+  if (token_code < 0)
+  {
+    return token_code;
+  }
+
+  if (location_or_null != NULL)
+  {
+    location_or_null->first_line =
+      token_pointer->loc[UTF8LEX_UNIT_LINE].start;
+    location_or_null->first_column =
+      token_pointer->loc[UTF8LEX_UNIT_BYTE].start;
+
+    location_or_null->last_line =
+      token_pointer->loc[UTF8LEX_UNIT_LINE].start
+      + token_pointer->loc[UTF8LEX_UNIT_LINE].length;
+    location_or_null->last_column =
+      token_pointer->loc[UTF8LEX_UNIT_BYTE].start
+      + token_pointer->loc[UTF8LEX_UNIT_BYTE].length;
+
+    location_or_null->start_byte =
+      token_pointer->loc[UTF8LEX_UNIT_BYTE].start;
+    location_or_null->length_bytes =
+      token_pointer->loc[UTF8LEX_UNIT_BYTE].length;
+    location_or_null->start_char =
+      token_pointer->loc[UTF8LEX_UNIT_CHAR].start;
+    location_or_null->length_chars =
+      token_pointer->loc[UTF8LEX_UNIT_CHAR].length;
+    location_or_null->start_grapheme =
+      token_pointer->loc[UTF8LEX_UNIT_GRAPHEME].start;
+    location_or_null->length_graphemes =
+      token_pointer->loc[UTF8LEX_UNIT_GRAPHEME].length;
+    location_or_null->start_line =
+      token_pointer->loc[UTF8LEX_UNIT_LINE].start;
+    location_or_null->length_lines =
+      token_pointer->loc[UTF8LEX_UNIT_LINE].length;
+  }
+
+  return token_code;
+}
+
+
+// =====================================================================
+// Traditional yylex(), with no location tracking.
+// ---------------------------------------------------------------------
+int yylex()
+{
+  return yyutf8lex(NULL,  // token_or_null
+                   NULL);  // location_or_null
+}
+
+
+// =====================================================================
+// Finish lexing.
+// ---------------------------------------------------------------------
+utf8lex_error_t yylex_end()
+{
+  if (YY_IS_STARTED == false)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_STATE);
+  }
+
+  // Unmap the mmap'ed file (if lexing a file):
+  utf8lex_error_t error = yylex_unmap();
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  // Teardown:
+  error = utf8lex_session_clear(&YY_SESSION);
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  error = utf8lex_program_clear(&YY_PROGRAM);
+  if (error != UTF8LEX_OK)
+  {
+    return yylex_print_error(error);
+  }
+
+  utf8lex_rule_t *rule = YY_FIRST_RULE;
+  for (int infinite_loop_protector = 0;
+       infinite_loop_protector < UTF8LEX_RULES_DB_LENGTH_MAX;
+       infinite_loop_protector ++)
+  {
+    if (rule == NULL)
+    {
+      break;
+    }
+
+    error = utf8lex_rule_clear(rule);
+    if (error != UTF8LEX_OK)
+    {
+      return yylex_print_error(error);
+    }
+    rule = rule->next;
+  }
+
+  if (rule != NULL)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_INFINITE_LOOP);
+  }
+
+  utf8lex_definition_t *definition = YY_FIRST_DEFINITION;
+  for (int infinite_loop_protector = 0;
+       infinite_loop_protector < UTF8LEX_DEFINITIONS_DB_LENGTH_MAX;
+       infinite_loop_protector ++)
+  {
+    if (definition == NULL)
+    {
+      break;
+    }
+
+    if (definition->definition_type == NULL
+        || definition->definition_type->clear == NULL)
+    {
+      // Already cleared by clearing a rule.
+      definition = definition->next;
+      continue;
+    }
+    error = definition->definition_type->clear(definition);
+    if (error != UTF8LEX_OK)
+    {
+      return yylex_print_error(error);
+    }
+    definition = definition->next;
+  }
+
+  if (definition != NULL)
+  {
+    return yylex_print_error(UTF8LEX_ERROR_INFINITE_LOOP);
+  }
+
+  YY_IS_STARTED = false;
+
+  return UTF8LEX_OK;
+}
+
+/*
+ * Generated by utf8lex.
+ *
+ * Requires at runtime:
+ *
+ *     utf8lex
+ *       https://github.com/jtienhaara/utf8lex
+ *       Apache 2.0 license
+ *
+ *     utf8proc
+ *       https://juliastrings.github.io/utf8proc
+ *       MIT license
+ *       Unicode data license
+ *
+ *     pcre2
+ *       https://github.com/PCRE2Project/pcre2
+ *       BSD license
+ *
+ * This generated file is licensed according to the source code with which
+ * it is distributed.
+ */
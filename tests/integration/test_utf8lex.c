@@ -293,7 +293,7 @@ static utf8lex_error_t test_utf8lex(
     utf8lex_token_copy_string(&token,
                               token_bytes,
                               (size_t) 256);
-    printf("        test_utf8lex: %s (%s) \"%s\" @(%d/%d/%d/%d)[%d/%d/%d/%d] hash(%ul/%ul/%ul/%ul)\n",
+    printf("        test_utf8lex: %s (%s) \"%s\" @(%" PRId64 "/%" PRId64 "/%" PRId64 "/%" PRId64 ")[%" PRId64 "/%" PRId64 "/%" PRId64 "/%" PRId64 "] hash(%" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64 ")\n",
            token.rule->name,
            token.rule->definition->definition_type->name,
            token_bytes,
@@ -304,7 +304,7 @@ static utf8lex_error_t test_utf8lex(
            token.loc[UTF8LEX_UNIT_BYTE].length,
            token.loc[UTF8LEX_UNIT_CHAR].length,
            token.loc[UTF8LEX_UNIT_GRAPHEME].length,
-           token.loc[UTF8LEX_UNIT_LINE].hash,
+           token.loc[UTF8LEX_UNIT_LINE].length,
            token.loc[UTF8LEX_UNIT_BYTE].hash,
            token.loc[UTF8LEX_UNIT_CHAR].hash,
            token.loc[UTF8LEX_UNIT_GRAPHEME].hash,
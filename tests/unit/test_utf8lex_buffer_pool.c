@@ -0,0 +1,403 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int64_t, uint32_t, PRId64.
+#include <string.h>  // For memcmp()
+#include <unistd.h>  // For close(), pipe(), sysconf(), write()
+
+#include "utf8lex.h"
+
+
+// Several times the pool's memory, but small enough to fit
+// in the pipe, so the whole input can be written up front:
+#define TEST_UTF8LEX_NUM_WORDS 3000
+#define TEST_UTF8LEX_INPUT_MAX 32768
+#define TEST_UTF8LEX_NUM_CHUNKS 3
+
+
+// Lexes words through a pool of 3 one page chunks, fed by a pipe,
+// holding on to the first word for a while along the way.
+static utf8lex_error_t test_utf8lex_buffer_pool_pipe()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Words such as "w123\xc3\xa9" (w123é), separated by spaces:
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  size_t input_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_NUM_WORDS; w ++)
+  {
+    input_length_bytes += (size_t) snprintf(
+        &(input[input_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - input_length_bytes,
+        "w%d\xc3\xa9 ",
+        w);
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(pipe_fds[1], input, input_length_bytes)
+      != (ssize_t) input_length_bytes)
+  {
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+  close(pipe_fds[1]);
+
+  size_t chunk_size = (size_t) sysconf(_SC_PAGESIZE);
+  printf("  Lexing %d bytes through %d chunks of %d bytes:",
+         (int) input_length_bytes,
+         TEST_UTF8LEX_NUM_CHUNKS,
+         (int) chunk_size);  fflush(stdout);
+
+  utf8lex_buffer_pool_t pool;
+  error = utf8lex_buffer_pool_init(&pool,  // self
+                                   chunk_size,  // chunk_size
+                                   (uint32_t) TEST_UTF8LEX_NUM_CHUNKS);
+  if (error != UTF8LEX_OK) { close(pipe_fds[0]); return error; }
+
+  error = utf8lex_buffer_pool_read(&pool,  // self
+                                   NULL,  // state
+                                   pipe_fds[0]);  // fd
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             pool.head);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_token_t first_token;
+  bool is_first_retained = false;
+  bool is_pool_full = false;
+  int num_words = 0;
+  while (true)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error == UTF8LEX_MORE)
+    {
+      error = utf8lex_buffer_pool_read(&pool,  // self
+                                       &state,  // state
+                                       pipe_fds[0]);  // fd
+      if (error == UTF8LEX_ERROR_MAX_LENGTH
+          && is_first_retained == true)
+      {
+        // The first word is still holding on to the first chunk,
+        // so none of the chunks after it can be recycled either.
+        // Make sure the first word is still intact, then let it go:
+        unsigned char scratch[32];
+        unsigned char *bytes = NULL;
+        error = utf8lex_token_contiguous(&first_token,  // self
+                                         scratch,  // scratch
+                                         (size_t) 32,  // max_scratch_bytes
+                                         &bytes);  // bytes_pointer
+        if (error != UTF8LEX_OK) { return error; }
+        if (memcmp(bytes, "w0\xc3\xa9", (size_t) 4) != 0)
+        {
+          printf(" FAILED - first word was recycled\n");  fflush(stdout);
+          return UTF8LEX_ERROR_TOKEN;
+        }
+        error = utf8lex_token_release(&first_token);
+        if (error != UTF8LEX_OK) { return error; }
+        is_first_retained = false;
+        is_pool_full = true;
+        continue;
+      }
+      else if (error != UTF8LEX_OK)
+      {
+        printf(" FAILED reading at word %d\n", num_words);  fflush(stdout);
+        return error;
+      }
+
+      continue;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED at word %d\n", num_words);  fflush(stdout);
+      return error;
+    }
+
+    unsigned char expected[32];
+    int expected_length_bytes = snprintf(expected,
+                                         32,
+                                         "w%d\xc3\xa9",
+                                         num_words);
+    unsigned char scratch[32];
+    unsigned char *bytes = NULL;
+    error = utf8lex_token_contiguous(&token,  // self
+                                     scratch,  // scratch
+                                     (size_t) 32,  // max_scratch_bytes
+                                     &bytes);  // bytes_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    if (token.length_bytes != (int64_t) expected_length_bytes
+        || memcmp(bytes,
+                  expected,
+                  (size_t) expected_length_bytes) != 0)
+    {
+      printf(" FAILED - word %d: %" PRId64 " bytes at %" PRId64 "\n",
+             num_words,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    if (num_words == 0)
+    {
+      first_token = token;
+      error = utf8lex_token_retain(&first_token);
+      if (error != UTF8LEX_OK) { return error; }
+      is_first_retained = true;
+    }
+
+    num_words ++;
+  }
+
+  if (num_words != TEST_UTF8LEX_NUM_WORDS
+      || is_pool_full != true
+      || is_first_retained == true)
+  {
+    printf(" FAILED - %d words\n", num_words);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d words OK\n", num_words);  fflush(stdout);
+
+  error = utf8lex_buffer_pool_clear(&pool);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(pipe_fds[0]);
+
+  // Chunks have to be a whole number of pages:
+  printf("  Making sure an odd chunk size is rejected:");  fflush(stdout);
+  error = utf8lex_buffer_pool_init(&pool,  // self
+                                   chunk_size + (size_t) 1,  // chunk_size
+                                   (uint32_t) TEST_UTF8LEX_NUM_CHUNKS);
+  if (error != UTF8LEX_ERROR_BAD_LENGTH)
+  {
+    printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
+// Adds pooled buffers to the chain with utf8lex_buffer_add(),
+// making sure the pool still knows where its chain begins and ends,
+// and can recycle it.
+static utf8lex_error_t test_utf8lex_buffer_pool_add()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  size_t chunk_size = (size_t) sysconf(_SC_PAGESIZE);
+  printf("  Adding pooled buffers to the chain:");  fflush(stdout);
+
+  utf8lex_buffer_pool_t pool;
+  error = utf8lex_buffer_pool_init(&pool,  // self
+                                   chunk_size,  // chunk_size
+                                   (uint32_t) TEST_UTF8LEX_NUM_CHUNKS);
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_buffer_t *first = NULL;
+  utf8lex_buffer_t *second = NULL;
+  error = utf8lex_buffer_pool_acquire(&pool,  // self
+                                      NULL,  // state
+                                      &first);  // buffer_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_pool_acquire(&pool,  // self
+                                      NULL,  // state
+                                      &second);  // buffer_pointer
+  if (error != UTF8LEX_OK) { return error; }
+
+  // The pool's chain is empty, so the first buffer starts it:
+  error = utf8lex_buffer_add(first,  // self
+                             second);  // tail
+  if (error != UTF8LEX_OK) { return error; }
+  if (pool.head != first
+      || pool.tail != second
+      || first->next != second)
+  {
+    printf(" FAILED - head and tail not set\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Already in the chain:
+  error = utf8lex_buffer_add(first,  // self
+                             second);  // tail
+  if (error != UTF8LEX_ERROR_CHAIN_INSERT)
+  {
+    printf(" FAILED - added twice: error %d\n", (int) error);
+      fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Not pooled:
+  unsigned char unpooled_bytes[1] = { 0 };
+  utf8lex_string_t unpooled_str;
+  error = utf8lex_string_init(&unpooled_str,  // self
+                              (size_t) 1,  // max_length_bytes
+                              (size_t) 0,  // length_bytes
+                              unpooled_bytes);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_buffer_t unpooled;
+  error = utf8lex_buffer_init(&unpooled,  // self
+                              NULL,  // prev
+                              &unpooled_str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_add(first,  // self
+                             &unpooled);  // tail
+  if (error != UTF8LEX_ERROR_CHAIN_INSERT
+      || pool.tail != second)
+  {
+    printf(" FAILED - added an unpooled buffer: error %d\n", (int) error);
+      fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Once lexing has moved on to the second buffer, the first one
+  // is recycled, and the third buffer is appended after the second,
+  // even though it is added to the head of the chain:
+  utf8lex_state_t state;
+  state.buffer = second;
+  utf8lex_buffer_t *third = NULL;
+  error = utf8lex_buffer_pool_acquire(&pool,  // self
+                                      &state,  // state
+                                      &third);  // buffer_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (pool.head != second
+      || pool.num_free != (uint32_t) 1)
+  {
+    printf(" FAILED - first buffer not recycled (%d free)\n",
+           (int) pool.num_free);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  error = utf8lex_buffer_add(second,  // self
+                             third);  // tail
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_buffer_t *fourth = NULL;
+  error = utf8lex_buffer_pool_acquire(&pool,  // self
+                                      NULL,  // state
+                                      &fourth);  // buffer_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_add(second,  // self
+                             fourth);  // tail
+  if (error != UTF8LEX_OK) { return error; }
+  if (pool.head != second
+      || pool.tail != fourth
+      || third->next != fourth
+      || fourth->prev != third)
+  {
+    printf(" FAILED - fourth buffer not at the tail\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_buffer_pool_clear(&pool);  // self
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_buffer_pool...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_buffer_pool_pipe();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_buffer_pool_add();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_buffer_pool.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_buffer_pool: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
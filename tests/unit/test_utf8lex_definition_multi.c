@@ -345,7 +345,8 @@ static utf8lex_error_t test_utf8lex_create_operator(
               prev_definition,  // prev
               "operator",  // name
               parent,  // parent
-              UTF8LEX_MULTI_TYPE_OR);  // multi_type
+              UTF8LEX_MULTI_TYPE_OR,  // multi_type
+              false);  // is_longest
   if (error != UTF8LEX_OK) { return error; }
   prev_definition = (utf8lex_definition_t *)
     &(operator->operator_definition);
@@ -412,6 +413,92 @@ static utf8lex_error_t test_utf8lex_create_operator(
 }
 
 
+// LONGEST_OPERATOR = EQUALS || EQUALS3 || PLUS || MINUS
+static utf8lex_error_t test_utf8lex_create_longest_operator(
+        utf8lex_test_db_t *db,
+        utf8lex_multi_definition_t *parent,  // Or NULL for toplevel definition.
+        utf8lex_test_operator_t *operator
+        )
+{
+  if (db == NULL
+      || operator == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  utf8lex_definition_t *prev_definition = NULL;
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  error = test_utf8lex_find_prev(db, parent, &prev_definition);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Building multi-definition 'longest_operator':\n");  fflush(stdout);
+  error = utf8lex_multi_definition_init(
+              &(operator->operator_definition),  // self
+              prev_definition,  // prev
+              "longest_operator",  // name
+              parent,  // parent
+              UTF8LEX_MULTI_TYPE_OR,  // multi_type
+              true);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  prev_definition = (utf8lex_definition_t *)
+    &(operator->operator_definition);
+  if (parent == NULL)
+  {
+    db->last_definition = prev_definition;
+  }
+
+  // EQUALS comes before EQUALS3, so a first-match OR would
+  // never match "===".
+  printf("    Adding EQUALS || EQUALS3 || PLUS || MINUS:\n");  fflush(stdout);
+  utf8lex_reference_t *prev_ref = NULL;
+  error = utf8lex_reference_init(
+              &(operator->ref_equals),  // self
+              prev_ref,  // prev
+              db->equals_definition.base.name,  // name
+              1,  // min
+              1,  // max
+              &(operator->operator_definition));  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  prev_ref = &(operator->ref_equals);
+  error = utf8lex_reference_init(
+              &(operator->ref_equals3),  // self
+              prev_ref,  // prev
+              db->equals3_definition.base.name,  // name
+              1,  // min
+              1,  // max
+              &(operator->operator_definition));  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  prev_ref = &(operator->ref_equals3);
+  error = utf8lex_reference_init(
+              &(operator->ref_plus),  // self
+              prev_ref,  // prev
+              db->plus_definition.base.name,  // name
+              1,  // min
+              1,  // max
+              &(operator->operator_definition));  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  prev_ref = &(operator->ref_plus);
+  error = utf8lex_reference_init(
+              &(operator->ref_minus),  // self
+              prev_ref,  // prev
+              db->minus_definition.base.name,  // name
+              1,  // min
+              1,  // max
+              &(operator->operator_definition));  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  prev_ref = &(operator->ref_minus);
+
+  printf("  Resolving multi-definition 'longest_operator':\n");  fflush(stdout);
+  error = utf8lex_multi_definition_resolve(
+              &(operator->operator_definition),  // self
+              db->definitions_db);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
 // DECLARATION = ID SPACE ID
 static utf8lex_error_t test_utf8lex_create_declaration(
         utf8lex_test_db_t *db,
@@ -437,7 +524,8 @@ static utf8lex_error_t test_utf8lex_create_declaration(
               prev_definition,  // prev
               "declaration",  // name
               parent,  // parent
-              UTF8LEX_MULTI_TYPE_SEQUENCE);  // multi_type
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
   if (error != UTF8LEX_OK) { return error; }
   prev_definition = (utf8lex_definition_t *)
     &(declaration->declaration_definition);
@@ -520,7 +608,8 @@ static utf8lex_error_t test_utf8lex_create_operand(
               prev_definition,  // prev
               "operand",  // name
               parent,  // parent
-              UTF8LEX_MULTI_TYPE_OR);  // multi_type
+              UTF8LEX_MULTI_TYPE_OR,  // multi_type
+              false);  // is_longest
   if (error != UTF8LEX_OK) { return error; }
   prev_definition = (utf8lex_definition_t *)
     &(operand->operand_definition);
@@ -832,6 +921,171 @@ static utf8lex_error_t test_utf8lex_operator()
 }
 
 
+// LONGEST_OPERATOR = EQUALS || EQUALS3 || PLUS || MINUS
+static utf8lex_error_t test_utf8lex_longest_operator()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_test_db_t db;
+  error = test_utf8lex_create_db(&db);
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  utf8lex_test_operator_t operator;
+  error = test_utf8lex_create_longest_operator(
+              &db,  // db
+              NULL,  // parent
+              &operator);  // operator
+  if (error != UTF8LEX_OK)
+  {
+    return error;
+  }
+
+  // Now we'll try lexing with the 'longest_operator' definition.
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  unsigned char *to_lex;
+
+  utf8lex_rule_t lex_rule;
+  utf8lex_token_t token;
+
+  printf("  Setting up rule for 'longest_operator' definition:\n");
+  error = utf8lex_rule_init(&lex_rule,  // self
+                            NULL,  // prev
+                            "longest_operator",  // name
+                            (utf8lex_definition_t *)
+                            &(operator.operator_definition),  // definition
+                            "return $$;",  // code
+                            (size_t) -1);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  to_lex = "===";  // EQUALS3, even though EQUALS also matches.
+  printf("  Lexing '%s' with 'longest_operator' definition:",
+         to_lex);
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_lex(&lex_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error == UTF8LEX_OK
+      && token.length_bytes == 3
+      && token.definition
+         == (utf8lex_definition_t *) &(db.equals3_definition)) {
+    printf(" OK\n");
+    fflush(stdout);
+  }
+  else if (error == UTF8LEX_OK) {
+    printf(" FAILED - matched %" PRId64 " bytes of %s instead of 3 bytes of %s\n",
+           token.length_bytes,
+           token.definition->name,
+           db.equals3_definition.base.name);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (error == UTF8LEX_NO_MATCH) {
+    printf(" FAILED - no match\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else
+  {
+    printf(" FAILED\n");
+    fflush(stdout);
+    return error;
+  }
+
+  error = test_utf8lex_clear_state(&state);  // state
+  if (error != UTF8LEX_OK) { return error; }
+
+  to_lex = "==+";  // EQUALS (EQUALS3 only partly matches).
+  printf("  Lexing '%s' with 'longest_operator' definition:",
+         to_lex);
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_lex(&lex_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error == UTF8LEX_OK
+      && token.length_bytes == 1
+      && token.definition
+         == (utf8lex_definition_t *) &(db.equals_definition)) {
+    printf(" OK\n");
+    fflush(stdout);
+  }
+  else if (error == UTF8LEX_OK) {
+    printf(" FAILED - matched %" PRId64 " bytes of %s instead of 1 byte of %s\n",
+           token.length_bytes,
+           token.definition->name,
+           db.equals_definition.base.name);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (error == UTF8LEX_NO_MATCH) {
+    printf(" FAILED - no match\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else
+  {
+    printf(" FAILED\n");
+    fflush(stdout);
+    return error;
+  }
+
+  error = test_utf8lex_clear_state(&state);  // state
+  if (error != UTF8LEX_OK) { return error; }
+
+  to_lex = "foobar";  // no match.
+  printf("  Lexing '%s' with 'longest_operator' definition:",
+         to_lex);
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_lex(&lex_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error == UTF8LEX_OK) {
+    printf(" FAILED - should not match but did\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (error == UTF8LEX_NO_MATCH) {
+    printf(" OK - unmatched as expected\n");
+    fflush(stdout);
+  }
+  else
+  {
+    printf(" FAILED\n");
+    fflush(stdout);
+    return error;
+  }
+
+  error = test_utf8lex_clear_state(&state);  // state
+  if (error != UTF8LEX_OK) { return error; }
+
+
+  printf("  Tearing down 'longest_operator' rule and definition:\n");
+  error = utf8lex_rule_clear(&lex_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
 // DECLARATION = ID SPACE ID
 static utf8lex_error_t test_utf8lex_declaration()
 {
@@ -1108,7 +1362,8 @@ static utf8lex_error_t test_utf8lex_expression()
               db.last_definition,  // prev
               "expression",  // name
               NULL,  // parent
-              UTF8LEX_MULTI_TYPE_SEQUENCE);  // multi_type
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
   if (error != UTF8LEX_OK) { return error; }
   db.last_definition = (utf8lex_definition_t *)
     &(expression.expression_definition);
@@ -1307,6 +1562,13 @@ int main(
   // OPERATOR = EQUALS3 | EQUALS | PLUS | MINUS
   utf8lex_error_t error = test_utf8lex_operator();
 
+  // Test a longest-match logical "OR" multi-definition:
+  // LONGEST_OPERATOR = EQUALS || EQUALS3 || PLUS || MINUS
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_longest_operator();
+  } // else if (error != UTF8LEX_OK) then fall through, below.
+
   // Test a sequence multi-definition:
   // DECLARATION = ID SPACE ID
   if (error == UTF8LEX_OK)
@@ -0,0 +1,505 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>  // For memcmp(), strlen(), strncmp()
+
+#include "utf8lex.h"
+
+
+static utf8lex_error_t test_utf8lex_init_state(
+        utf8lex_state_t *state,
+        utf8lex_buffer_t *buffer,
+        utf8lex_string_t *str,
+        unsigned char *bytes
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  size_t length_bytes = strlen(bytes);
+  error = utf8lex_string_init(str,  // self
+                              length_bytes,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              bytes);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_buffer_init(buffer,  // self
+                              NULL,  // prev
+                              str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_init(state,  // self
+                             buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_capture(
+        utf8lex_token_t *token,
+        int capture,  // 0 for the 1st capture group (1), and so on.
+        unsigned char *expected  // NULL if the group should be unset.
+        )
+{
+  if (token == NULL)
+  {
+    return UTF8LEX_ERROR_NULL_POINTER;
+  }
+
+  printf("    Capture %d:", capture + 1);  fflush(stdout);
+  if (capture >= token->num_captures)
+  {
+    printf(" FAILED - only %d captures in token\n",
+           token->num_captures);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  utf8lex_capture_t *sub = &(token->captures[capture]);
+  if (expected == NULL)
+  {
+    if (sub->start_byte != -1
+        || sub->length_bytes != 0)
+    {
+      printf(" FAILED - expected unset but found %" PRId64 " bytes at %" PRId64 "\n",
+             sub->length_bytes,
+             sub->start_byte);  fflush(stdout);
+      return UTF8LEX_ERROR_STATE;
+    }
+
+    printf(" OK (unset)\n");  fflush(stdout);
+    return UTF8LEX_OK;
+  }
+
+  int expected_length_bytes = (int) strlen(expected);
+  if (sub->start_byte < token->start_byte
+      || sub->length_bytes != expected_length_bytes
+      || (sub->start_byte + sub->length_bytes)
+         > (token->start_byte + token->length_bytes)
+      || strncmp(&(token->str->bytes[sub->start_byte]),
+                 expected,
+                 (size_t) expected_length_bytes) != 0)
+  {
+    printf(" FAILED - expected '%s' but found %" PRId64 " bytes at %" PRId64 "\n",
+           expected,
+           sub->length_bytes,
+           sub->start_byte);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  printf(" OK '%s'\n", expected);  fflush(stdout);
+  return UTF8LEX_OK;
+}
+
+
+// NUMBER = [\+\-]?[1-9][0-9]*(\.[1-9][0-9]*)?(e[\+\-][1-9][0-9]*)?
+// with 2 captures: (1) fraction, (2) exponent.
+static utf8lex_error_t test_utf8lex_regex_captures()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t number_definition;
+  error = utf8lex_regex_definition_init(
+              &number_definition,  // self
+              NULL,  // prev
+              "NUMBER",  // name
+              "[\\+\\-]?[1-9][0-9]*(\\.[1-9][0-9]*)?(e[\\+\\-][1-9][0-9]*)?");
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Making sure too many captures is rejected:");  fflush(stdout);
+  error = utf8lex_regex_definition_set_captures(
+              &number_definition,  // self
+              UTF8LEX_CAPTURES_MAX + 1);  // num_captures
+  if (error != UTF8LEX_ERROR_MAX_LENGTH)
+  {
+    printf(" FAILED\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_regex_definition_set_captures(
+              &number_definition,  // self
+              2);  // num_captures
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t number_rule;
+  error = utf8lex_rule_init(&number_rule,  // self
+                            NULL,  // prev
+                            "number",  // name
+                            (utf8lex_definition_t *)
+                            &number_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  utf8lex_token_t token;
+
+  unsigned char *to_lex = "-123.45e+6 42";
+  printf("  Lexing '%s' with 'number' rule:\n", to_lex);  fflush(stdout);
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_lex(&number_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = test_utf8lex_capture(&token, 0, ".45");
+  if (error != UTF8LEX_OK) { return error; }
+  error = test_utf8lex_capture(&token, 1, "e+6");
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Skip past the " " by hand (no rule for it):
+  state.loc[UTF8LEX_UNIT_BYTE].start ++;
+  state.loc[UTF8LEX_UNIT_CHAR].start ++;
+  state.loc[UTF8LEX_UNIT_GRAPHEME].start ++;
+  buffer.loc[UTF8LEX_UNIT_BYTE].start ++;
+  buffer.loc[UTF8LEX_UNIT_CHAR].start ++;
+  buffer.loc[UTF8LEX_UNIT_GRAPHEME].start ++;
+
+  error = utf8lex_lex(&number_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = test_utf8lex_capture(&token, 0, NULL);
+  if (error != UTF8LEX_OK) { return error; }
+  error = test_utf8lex_capture(&token, 1, NULL);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Tearing down 'number' rule and definition:\n");  fflush(stdout);
+  error = utf8lex_rule_clear(&number_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// The same NUMBER regex, matching a token that straddles 3 buffers,
+// with the (1) fraction capture group straddling the last 2:
+#define TEST_UTF8LEX_NUM_CHAINED 3
+static unsigned char *TEST_CHAINED[TEST_UTF8LEX_NUM_CHAINED] =
+  {
+    "-12",
+    "3.4",
+    "5e+6 42"
+  };
+
+static utf8lex_error_t test_utf8lex_regex_chained()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t number_definition;
+  error = utf8lex_regex_definition_init(
+              &number_definition,  // self
+              NULL,  // prev
+              "NUMBER",  // name
+              "[\\+\\-]?[1-9][0-9]*(\\.[1-9][0-9]*)?(e[\\+\\-][1-9][0-9]*)?");
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_regex_definition_set_captures(
+              &number_definition,  // self
+              2);  // num_captures
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t number_rule;
+  error = utf8lex_rule_init(&number_rule,  // self
+                            NULL,  // prev
+                            "number",  // name
+                            (utf8lex_definition_t *)
+                            &number_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_CHAINED];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_CHAINED];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_CHAINED; b ++)
+  {
+    size_t length_bytes = strlen(TEST_CHAINED[b]);
+    error = utf8lex_string_init(&(strs[b]),  // self
+                                length_bytes,  // max_length_bytes
+                                length_bytes,  // length_bytes
+                                TEST_CHAINED[b]);  // bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_buffer_init(&(buffers[b]),  // self
+                                (b == 0)
+                                ? NULL
+                                : &(buffers[b - 1]),  // prev
+                                &(strs[b]),  // str
+                                (b == (TEST_UTF8LEX_NUM_CHAINED - 1)));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing '-12' + '3.4' + '5e+6 42' with 'number' rule:");
+  fflush(stdout);
+  utf8lex_token_t token;
+  error = utf8lex_lex(&number_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char scratch[16];
+  unsigned char *bytes = NULL;
+  error = utf8lex_token_contiguous(&token,  // self
+                                   scratch,  // scratch
+                                   (size_t) 16,  // max_scratch_bytes
+                                   &bytes);  // bytes_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (token.length_bytes != (int64_t) 10
+      || token.loc[UTF8LEX_UNIT_GRAPHEME].length != (int64_t) 10
+      || memcmp(bytes, "-123.45e+6", (size_t) 10) != 0)
+  {
+    printf(" FAILED - %" PRId64 " bytes\n",
+           token.length_bytes);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  // Captures are relative to the str of the buffer the token starts in,
+  // so check them against the contiguous bytes:
+  unsigned char *expected[2] = { ".45", "e+6" };
+  for (int c = 0; c < 2; c ++)
+  {
+    utf8lex_capture_t *sub = &(token.captures[c]);
+    int64_t capture_offset = sub->start_byte - token.start_byte;
+    printf("    Capture %d:", c + 1);  fflush(stdout);
+    if (sub->length_bytes != (int64_t) strlen(expected[c])
+        || capture_offset < (int64_t) 0
+        || (capture_offset + sub->length_bytes) > token.length_bytes
+        || memcmp(&(bytes[capture_offset]),
+                  expected[c],
+                  (size_t) sub->length_bytes) != 0)
+    {
+      printf(" FAILED - expected '%s' but found %" PRId64 " bytes at %" PRId64 "\n",
+             expected[c],
+             sub->length_bytes,
+             sub->start_byte);  fflush(stdout);
+      return UTF8LEX_ERROR_STATE;
+    }
+    printf(" OK '%s'\n", expected[c]);  fflush(stdout);
+  }
+
+  // The lexer carries on from inside the last buffer:
+  if (state.buffer != &(buffers[2])
+      || buffers[2].loc[UTF8LEX_UNIT_BYTE].start != (int64_t) 4)
+  {
+    printf("  FAILED - lexer did not move on to the last buffer\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int b = 0; b < TEST_UTF8LEX_NUM_CHAINED; b ++)
+  {
+    error = utf8lex_buffer_clear(&(buffers[b]));
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_string_clear(&(strs[b]));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  error = utf8lex_rule_clear(&number_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// A string literal several times longer than the regex window,
+// straddling 4 buffers: first with only half of the buffers in the chain
+// (so the regex asks for MORE), then with all of them.
+#define TEST_UTF8LEX_NUM_LONG 4
+#define TEST_UTF8LEX_LONG_BYTES (UTF8LEX_REGEX_WINDOW_MAX + 100)
+
+static utf8lex_error_t test_utf8lex_regex_long()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t string_definition;
+  error = utf8lex_regex_definition_init(
+              &string_definition,  // self
+              NULL,  // prev
+              "STRING",  // name
+              "\"[^\"]*\"");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t string_rule;
+  error = utf8lex_rule_init(&string_rule,  // self
+                            NULL,  // prev
+                            "string",  // name
+                            (utf8lex_definition_t *)
+                            &string_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  // "aaa...aaa" followed by " 42", split evenly across the buffers:
+  static unsigned char bytes[TEST_UTF8LEX_NUM_LONG][TEST_UTF8LEX_LONG_BYTES];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_LONG; b ++)
+  {
+    memset(bytes[b], 'a', (size_t) TEST_UTF8LEX_LONG_BYTES);
+  }
+  bytes[0][0] = '"';
+  memcpy(&(bytes[TEST_UTF8LEX_NUM_LONG - 1][TEST_UTF8LEX_LONG_BYTES - 4]),
+         "\" 42",
+         (size_t) 4);
+  int64_t expected_length_bytes =
+    (int64_t) (TEST_UTF8LEX_NUM_LONG * TEST_UTF8LEX_LONG_BYTES) - (int64_t) 3;
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_LONG];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_LONG];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_LONG; b ++)
+  {
+    error = utf8lex_string_init(&(strs[b]),  // self
+                                (size_t) TEST_UTF8LEX_LONG_BYTES,
+                                (size_t) TEST_UTF8LEX_LONG_BYTES,
+                                bytes[b]);  // bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_buffer_init(&(buffers[b]),  // self
+                                NULL,  // prev
+                                &(strs[b]),  // str
+                                (b == (TEST_UTF8LEX_NUM_LONG - 1)));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+  error = utf8lex_buffer_add(&(buffers[0]),  // self
+                             &(buffers[1]));  // tail
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing a %d byte string across %d buffers of %d bytes:",
+         (int) expected_length_bytes,
+         TEST_UTF8LEX_NUM_LONG,
+         TEST_UTF8LEX_LONG_BYTES);  fflush(stdout);
+  utf8lex_token_t token;
+  error = utf8lex_lex(&string_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error != UTF8LEX_MORE)
+  {
+    printf(" FAILED - expected MORE from half the buffers, not %d\n",
+           (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  for (int b = 2; b < TEST_UTF8LEX_NUM_LONG; b ++)
+  {
+    error = utf8lex_buffer_add(&(buffers[0]),  // self
+                               &(buffers[b]));  // tail
+    if (error != UTF8LEX_OK) { return error; }
+  }
+  error = utf8lex_lex(&string_rule,  // first_rule
+                      &state,  // state
+                      &token);
+  if (error != UTF8LEX_OK)
+  {
+    printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+    return error;
+  }
+  if (token.length_bytes != expected_length_bytes
+      || token.loc[UTF8LEX_UNIT_GRAPHEME].length != expected_length_bytes
+      || token.buffer != &(buffers[0])
+      || state.buffer != &(buffers[TEST_UTF8LEX_NUM_LONG - 1])
+      || buffers[TEST_UTF8LEX_NUM_LONG - 1].loc[UTF8LEX_UNIT_BYTE].start
+         != (int64_t) (TEST_UTF8LEX_LONG_BYTES - 3))
+  {
+    printf(" FAILED - %" PRId64 " bytes\n",
+           token.length_bytes);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int b = 0; b < TEST_UTF8LEX_NUM_LONG; b ++)
+  {
+    error = utf8lex_buffer_clear(&(buffers[b]));
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_string_clear(&(strs[b]));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  error = utf8lex_rule_clear(&string_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_definition_regex...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_regex_captures();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_regex_chained();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_regex_long();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_definition_regex.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_definition_regex: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
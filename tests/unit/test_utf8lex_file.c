@@ -0,0 +1,1065 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>  // For mkstemp()
+#include <inttypes.h>  // For int64_t, uint32_t, uint64_t, PRId64.
+#include <string.h>  // For memcmp(), strlen()
+#include <unistd.h>  // For ftruncate(), pwrite(), close(), unlink(), write()
+
+#include "utf8lex.h"
+
+
+// The synthetic file is mostly 2 big holes (NUL bytes, which take up
+// no disk space), each one more than 2 GiB long, so that token lengths
+// overflow 31 bits and byte offsets overflow 32 bits.
+// (Each hole is less than 4 GiB, since pcre2 does not match more than
+// 4 GiB - 1 repeats of one character.)
+#define TEST_UTF8LEX_HOLE_BYTES \
+  (((int64_t) 2 * (int64_t) 1024 * (int64_t) 1024 * (int64_t) 1024) \
+   + (int64_t) 3)
+
+static unsigned char *TEST_HEAD = "first\n";
+static unsigned char *TEST_MIDDLE = "\n";
+static unsigned char *TEST_TAIL = "\nlast word\n";
+
+#define TEST_UTF8LEX_NUM_TOKENS 10
+
+
+// Creates the sparse file: TEST_HEAD, a hole, TEST_MIDDLE, another hole,
+// then TEST_TAIL.
+static utf8lex_error_t test_utf8lex_file_create(
+        unsigned char *path  // Template for mkstemp(), overwritten.
+        )
+{
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+
+  int64_t head_bytes = (int64_t) strlen(TEST_HEAD);
+  int64_t middle_bytes = (int64_t) strlen(TEST_MIDDLE);
+  int64_t tail_bytes = (int64_t) strlen(TEST_TAIL);
+  int64_t middle_start = head_bytes + TEST_UTF8LEX_HOLE_BYTES;
+  int64_t tail_start = middle_start + middle_bytes + TEST_UTF8LEX_HOLE_BYTES;
+  if (ftruncate(fd, (off_t) (tail_start + tail_bytes)) != 0
+      || pwrite(fd, TEST_HEAD, (size_t) head_bytes, (off_t) 0)
+         != (ssize_t) head_bytes
+      || pwrite(fd, TEST_MIDDLE, (size_t) middle_bytes, (off_t) middle_start)
+         != (ssize_t) middle_bytes
+      || pwrite(fd, TEST_TAIL, (size_t) tail_bytes, (off_t) tail_start)
+         != (ssize_t) tail_bytes)
+  {
+    close(fd);
+    unlink(path);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+
+  close(fd);
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes the file lazily (bytes only, see utf8lex_location_mode_t),
+// and checks the byte offsets and lengths past 4 GiB, then resolves
+// the line and char of the last word.
+static utf8lex_error_t test_utf8lex_file_lex(
+        unsigned char *path
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t word_definition;
+  error = utf8lex_regex_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              "[a-z]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_regex_definition_t space_definition;
+  error = utf8lex_regex_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              "[ \\n]");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_regex_definition_t hole_definition;
+  error = utf8lex_regex_definition_init(
+              &hole_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "HOLE",  // name
+              "\\x00+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t hole_rule;
+  error = utf8lex_rule_init(&hole_rule,  // self
+                            &space_rule,  // prev
+                            "hole",  // name
+                            (utf8lex_definition_t *)
+                            &hole_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  mmapping %s:", path);  fflush(stdout);
+  utf8lex_string_t str;
+  str.max_length_bytes = (size_t) 0;
+  str.length_bytes = (size_t) 0;
+  str.bytes = NULL;
+  utf8lex_buffer_t buffer;
+  buffer.next = NULL;
+  buffer.prev = NULL;
+  buffer.str = &str;
+  error = utf8lex_buffer_mmap(&buffer,  // self
+                              path);  // path
+  if (error != UTF8LEX_OK) { return error; }
+  printf(" %zu bytes OK\n", str.length_bytes);  fflush(stdout);
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_location_mode(&state,  // self
+                                          UTF8LEX_LOCATION_MODE_LAZY);
+  if (error != UTF8LEX_OK) { return error; }
+  uint64_t line_starts[4];
+  utf8lex_line_index_t line_index;
+  error = utf8lex_line_index_init(&line_index,  // self
+                                  line_starts,  // line_starts
+                                  (uint32_t) 4);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_line_index(&state,  // self
+                                       &line_index);  // line_index
+  if (error != UTF8LEX_OK) { return error; }
+
+  int64_t middle_start = (int64_t) strlen(TEST_HEAD) + TEST_UTF8LEX_HOLE_BYTES;
+  int64_t tail_start = middle_start + (int64_t) strlen(TEST_MIDDLE)
+    + TEST_UTF8LEX_HOLE_BYTES;
+  utf8lex_rule_t *expected_rules[TEST_UTF8LEX_NUM_TOKENS] =
+    {
+      &word_rule, &space_rule, &hole_rule, &space_rule, &hole_rule,
+      &space_rule, &word_rule, &space_rule, &word_rule, &space_rule
+    };
+  int64_t expected_starts[TEST_UTF8LEX_NUM_TOKENS] =
+    {
+      0, 5, 6, middle_start, middle_start + 1,
+      tail_start, tail_start + 1, tail_start + 5, tail_start + 6,
+      tail_start + 10
+    };
+  int64_t expected_lengths[TEST_UTF8LEX_NUM_TOKENS] =
+    {
+      5, 1, TEST_UTF8LEX_HOLE_BYTES, 1, TEST_UTF8LEX_HOLE_BYTES,
+      1, 4, 1, 4, 1
+    };
+
+  for (int t = 0; t < TEST_UTF8LEX_NUM_TOKENS; t ++)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error != UTF8LEX_OK) { return error; }
+
+    printf("    %s token %d (%" PRId64 " bytes at %" PRId64 "):",
+           token.rule->name,
+           t,
+           token.length_bytes,
+           token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+    if (token.rule != expected_rules[t]
+        || token.loc[UTF8LEX_UNIT_BYTE].start != expected_starts[t]
+        || token.start_byte != expected_starts[t]
+        || token.length_bytes != expected_lengths[t]
+        || token.loc[UTF8LEX_UNIT_BYTE].length != expected_lengths[t])
+    {
+      printf(" FAILED - expected %s token %" PRId64 " bytes at %" PRId64 "\n",
+             expected_rules[t]->name,
+             expected_lengths[t],
+             expected_starts[t]);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  utf8lex_token_t eof_token;
+  error = utf8lex_lex(&word_rule,  // first_rule
+                      &state,  // state
+                      &eof_token);  // token_pointer
+  if (error != UTF8LEX_EOF)
+  {
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  printf("  Resolving the last word's line and char:");  fflush(stdout);
+  int64_t line = -1;
+  error = utf8lex_location_resolve(&state,  // state
+                                   (uint64_t) (tail_start + 6),  // byte_offset
+                                   UTF8LEX_UNIT_LINE,  // unit
+                                   &line);  // location_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  int64_t char_in_line = -1;
+  error = utf8lex_location_resolve(&state,  // state
+                                   (uint64_t) (tail_start + 6),  // byte_offset
+                                   UTF8LEX_UNIT_CHAR,  // unit
+                                   &char_in_line);  // location_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (line != (int64_t) 3
+      || char_in_line != (int64_t) 5)
+  {
+    printf(" FAILED - line %" PRId64 ", char %" PRId64 "\n",
+           line,
+           char_in_line);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" line %" PRId64 ", char %" PRId64 " OK\n",
+         line,
+         char_in_line);  fflush(stdout);
+
+  error = utf8lex_buffer_munmap(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_clear(&line_index);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&hole_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_file()
+{
+  unsigned char path[64];
+  strcpy(path, "/tmp/test_utf8lex_file_XXXXXX");
+
+  printf("  Creating a sparse file larger than 4 GiB:");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_file_create(path);
+  if (error != UTF8LEX_OK) { return error; }
+  printf(" OK\n");  fflush(stdout);
+
+  error = test_utf8lex_file_lex(path);
+
+  unlink(path);
+
+  return error;
+}
+
+
+// Words such as "w123\xc3\xa9" (w123é), separated by spaces,
+// lexed one page-sized window at a time, one token at a time
+// or in batches of more tokens than fit in 2 windows (which stop
+// before each new window is mapped):
+#define TEST_UTF8LEX_NUM_WORDS 3000
+#define TEST_UTF8LEX_INPUT_MAX 32768
+#define TEST_UTF8LEX_BATCH_MAX 1024
+
+static utf8lex_program_t TEST_PROGRAM;
+
+static utf8lex_error_t test_utf8lex_window_lex(
+        unsigned char *path,
+        size_t window_size,
+        uint32_t batch_size,  // 0 to lex one token at a time.
+        int expected_num_words,
+        utf8lex_error_t expected_error
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &word_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_window_t window;
+  error = utf8lex_window_init(&window,  // self
+                              path,  // path
+                              window_size,  // window_size
+                              UTF8LEX_WINDOW_POPULATE);  // flags
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             window.head);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_window(&state,  // self
+                                   &window);  // window
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_words = 0;
+  int num_batches = 0;
+  static utf8lex_token_t tokens[TEST_UTF8LEX_BATCH_MAX];
+  while (error == UTF8LEX_OK)
+  {
+    uint32_t num_tokens = (uint32_t) 0;
+    if (batch_size == (uint32_t) 0)
+    {
+      error = utf8lex_lex(&word_rule,  // first_rule
+                          &state,  // state
+                          &(tokens[0]));  // token_pointer
+      num_tokens = (error == UTF8LEX_OK)
+        ? (uint32_t) 1
+        : (uint32_t) 0;
+    }
+    else
+    {
+      error = utf8lex_lex_batch(&TEST_PROGRAM,  // program
+                                &state,  // state
+                                tokens,  // tokens
+                                batch_size,  // max_tokens
+                                &num_tokens);  // num_tokens_pointer
+      num_batches ++;
+    }
+
+    // Every token in the batch must still be good after the batch:
+    for (uint32_t t = (uint32_t) 0; t < num_tokens; t ++)
+    {
+      utf8lex_token_t token = tokens[t];
+      unsigned char expected[32];
+      int expected_length_bytes = snprintf(expected,
+                                           32,
+                                           "w%d\xc3\xa9",
+                                           num_words);
+      unsigned char scratch[32];
+      unsigned char *bytes = NULL;
+      utf8lex_error_t contiguous_error = utf8lex_token_contiguous(
+          &token,  // self
+          scratch,  // scratch
+          (size_t) 32,  // max_scratch_bytes
+          &bytes);  // bytes_pointer
+      if (contiguous_error != UTF8LEX_OK) { return contiguous_error; }
+      if (token.length_bytes != (int64_t) expected_length_bytes
+          || memcmp(bytes,
+                    expected,
+                    (size_t) expected_length_bytes) != 0)
+      {
+        printf(" FAILED - word %d: %" PRId64 " bytes at %" PRId64 "\n",
+               num_words,
+               token.length_bytes,
+               token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+
+      num_words ++;
+    }
+  }
+
+  if (error != expected_error
+      || num_words != expected_num_words
+      || window.tail->is_eof != (expected_error == UTF8LEX_EOF))
+  {
+    printf(" FAILED - error %d after %d words\n",
+           (int) error,
+           num_words);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  else if (batch_size > (uint32_t) 0)
+  {
+    printf(" %d words in %d batches OK\n", num_words, num_batches);
+      fflush(stdout);
+  }
+  else
+  {
+    printf(" %d words OK\n", num_words);  fflush(stdout);
+  }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_window_clear(&window);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes a literal ("ab") and a multi-definition ("x=y") that straddle
+// the windows, with the whitespace between them skipped:
+static utf8lex_error_t test_utf8lex_window_match(
+        unsigned char *path,
+        size_t window_size,
+        unsigned char **expected_tokens,
+        int expected_num_tokens
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  // ASSIGN = WORD EQUALS WORD
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_literal_definition_t equals_definition;
+  error = utf8lex_literal_definition_init(
+              &equals_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "EQUALS",  // name
+              "=");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_literal_definition_t ab_definition;
+  error = utf8lex_literal_definition_init(
+              &ab_definition,  // self
+              (utf8lex_definition_t *) &equals_definition,  // prev
+              "AB",  // name
+              "ab");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &ab_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_multi_definition_t assign_definition;
+  error = utf8lex_multi_definition_init(
+              &assign_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "ASSIGN",  // name
+              NULL,  // parent
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t lhs_reference;
+  error = utf8lex_reference_init(&lhs_reference,  // self
+                                 NULL,  // prev
+                                 "WORD",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &assign_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t equals_reference;
+  error = utf8lex_reference_init(&equals_reference,  // self
+                                 &lhs_reference,  // prev
+                                 "EQUALS",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &assign_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t rhs_reference;
+  error = utf8lex_reference_init(&rhs_reference,  // self
+                                 &equals_reference,  // prev
+                                 "WORD",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &assign_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_multi_definition_resolve(
+              &assign_definition,  // self
+              (utf8lex_definition_t *) &word_definition);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t ab_rule;
+  error = utf8lex_rule_init(&ab_rule,  // self
+                            NULL,  // prev
+                            "ab",  // name
+                            (utf8lex_definition_t *)
+                            &ab_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t assign_rule;
+  error = utf8lex_rule_init(&assign_rule,  // self
+                            &ab_rule,  // prev
+                            "assign",  // name
+                            (utf8lex_definition_t *)
+                            &assign_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &assign_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_window_t window;
+  error = utf8lex_window_init(&window,  // self
+                              path,  // path
+                              window_size,  // window_size
+                              (uint32_t) 0);  // flags
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             window.head);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_window(&state,  // self
+                                   &window);  // window
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_tokens = 0;
+  while (true)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&ab_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error != UTF8LEX_OK)
+    {
+      break;
+    }
+
+    unsigned char copy[8];
+    error = utf8lex_token_copy_string(&token,  // self
+                                      copy,  // str
+                                      (size_t) 8);  // max_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    if (num_tokens >= expected_num_tokens
+        || strcmp(copy, expected_tokens[num_tokens]) != 0)
+    {
+      printf(" FAILED - token %d \"%s\" at %" PRId64 "\n",
+             num_tokens,
+             copy,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    num_tokens ++;
+  }
+
+  if (error != UTF8LEX_EOF
+      || num_tokens != expected_num_tokens)
+  {
+    printf(" FAILED - error %d after %d tokens\n",
+           (int) error,
+           num_tokens);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d tokens OK\n", num_tokens);  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_window_clear(&window);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&assign_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&ab_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_literal_definition_clear(
+              (utf8lex_definition_t *) &equals_definition);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_cat_definition_clear(
+              (utf8lex_definition_t *) &word_definition);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_window()
+{
+  size_t window_size = (size_t) sysconf(_SC_PAGESIZE);
+
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  size_t input_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_NUM_WORDS; w ++)
+  {
+    input_length_bytes += (size_t) snprintf(
+        &(input[input_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - input_length_bytes,
+        "w%d\xc3\xa9 ",
+        w);
+  }
+
+  unsigned char path[64];
+  strcpy(path, "/tmp/test_utf8lex_window_XXXXXX");
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(fd, input, input_length_bytes)
+      != (ssize_t) input_length_bytes)
+  {
+    close(fd);
+    unlink(path);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+
+  printf("  Lexing %d bytes %d bytes at a time:",
+         (int) input_length_bytes,
+         (int) window_size);  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_window_lex(
+      path,  // path
+      window_size,  // window_size
+      (uint32_t) 0,  // batch_size
+      TEST_UTF8LEX_NUM_WORDS,  // expected_num_words
+      UTF8LEX_EOF);  // expected_error
+
+  // Batches that would run into the next window stop early,
+  // rather than unmapping the bytes of the tokens they already lexed:
+  if (error == UTF8LEX_OK)
+  {
+    printf("  Lexing %d bytes %d bytes at a time, in batches of %d:",
+           (int) input_length_bytes,
+           (int) window_size,
+           TEST_UTF8LEX_BATCH_MAX);  fflush(stdout);
+    error = test_utf8lex_window_lex(
+        path,  // path
+        window_size,  // window_size
+        (uint32_t) TEST_UTF8LEX_BATCH_MAX,  // batch_size
+        TEST_UTF8LEX_NUM_WORDS,  // expected_num_words
+        UTF8LEX_EOF);  // expected_error
+  }
+
+  // One word that is longer than 2 windows:
+  if (error == UTF8LEX_OK)
+  {
+    printf("  Making sure a word longer than 2 windows is rejected:");
+    fflush(stdout);
+    ftruncate(fd, (off_t) 0);
+    for (size_t b = (size_t) 0; b < TEST_UTF8LEX_INPUT_MAX; b ++)
+    {
+      input[b] = 'w';
+    }
+    if (pwrite(fd, input, 3 * window_size, (off_t) 0)
+        != (ssize_t) (3 * window_size))
+    {
+      error = UTF8LEX_ERROR_FILE_WRITE;
+    }
+    else
+    {
+      error = test_utf8lex_window_lex(
+          path,  // path
+          window_size,  // window_size
+          (uint32_t) 0,  // batch_size
+          0,  // expected_num_words
+          UTF8LEX_ERROR_MAX_LENGTH);  // expected_error
+    }
+  }
+
+  // "ab" straddling the first and last windows:
+  if (error == UTF8LEX_OK)
+  {
+    printf("  Lexing a literal across the last 2 windows:");  fflush(stdout);
+    ftruncate(fd, (off_t) 0);
+    for (size_t b = (size_t) 0; b < TEST_UTF8LEX_INPUT_MAX; b ++)
+    {
+      input[b] = ' ';
+    }
+    memcpy(&(input[window_size - 1]), "ab  ab\n", (size_t) 7);
+    unsigned char *expected_tokens[] = { "ab", "ab" };
+    if (pwrite(fd, input, window_size + 6, (off_t) 0)
+        != (ssize_t) (window_size + 6))
+    {
+      error = UTF8LEX_ERROR_FILE_WRITE;
+    }
+    else
+    {
+      error = test_utf8lex_window_match(path,  // path
+                                        window_size,  // window_size
+                                        expected_tokens,  // expected_tokens
+                                        2);  // expected_num_tokens
+    }
+  }
+
+  // "ab" straddling the first 2 windows, "x=y" the next 2:
+  if (error == UTF8LEX_OK)
+  {
+    printf("  Lexing a literal and a sequence across 3 windows:");
+    fflush(stdout);
+    ftruncate(fd, (off_t) 0);
+    for (size_t b = (size_t) 0; b < TEST_UTF8LEX_INPUT_MAX; b ++)
+    {
+      input[b] = ' ';
+    }
+    memcpy(&(input[window_size - 1]), "ab", (size_t) 2);
+    memcpy(&(input[(2 * window_size) - 2]), "x=y\n", (size_t) 4);
+    unsigned char *expected_tokens[] = { "ab", "x=y" };
+    if (pwrite(fd, input, (2 * window_size) + 2, (off_t) 0)
+        != (ssize_t) ((2 * window_size) + 2))
+    {
+      error = UTF8LEX_ERROR_FILE_WRITE;
+    }
+    else
+    {
+      error = test_utf8lex_window_match(path,  // path
+                                        window_size,  // window_size
+                                        expected_tokens,  // expected_tokens
+                                        2);  // expected_num_tokens
+    }
+  }
+
+  // Windows have to be a whole number of pages:
+  if (error == UTF8LEX_OK)
+  {
+    printf("  Making sure an odd window size is rejected:");  fflush(stdout);
+    utf8lex_window_t window;
+    error = utf8lex_window_init(&window,  // self
+                                path,  // path
+                                window_size + (size_t) 1,  // window_size
+                                (uint32_t) 0);  // flags
+    if (error != UTF8LEX_ERROR_BAD_LENGTH)
+    {
+      printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+      error = UTF8LEX_ERROR_STATE;
+    }
+    else
+    {
+      printf(" OK\n");  fflush(stdout);
+      error = UTF8LEX_OK;
+    }
+  }
+
+  close(fd);
+  unlink(path);
+
+  return error;
+}
+
+
+// Each source is an mmapped file:  the main file includes the first
+// file, which includes the second, wherever there is an "@".
+#define TEST_UTF8LEX_NUM_SOURCES 3
+
+// Lexes the main file, pushing the next file at each "@", and checks
+// that each file is lexed from its own location 0, and that lexing
+// pops back to the including file (right after the "@") at each EOF.
+static utf8lex_error_t test_utf8lex_include()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  unsigned char *sources[TEST_UTF8LEX_NUM_SOURCES] =
+    {
+      "alpha @ omega",
+      "beta @\ngamma",
+      "delta"
+    };
+  unsigned char paths[TEST_UTF8LEX_NUM_SOURCES][64];
+  for (int s = 0; s < TEST_UTF8LEX_NUM_SOURCES; s ++)
+  {
+    strcpy(paths[s], "/tmp/test_utf8lex_include_XXXXXX");
+    int fd = mkstemp(paths[s]);
+    if (fd < 0)
+    {
+      return UTF8LEX_ERROR_FILE_OPEN;
+    }
+    size_t length_bytes = strlen(sources[s]);
+    if (write(fd, sources[s], length_bytes) != (ssize_t) length_bytes)
+    {
+      close(fd);
+      return UTF8LEX_ERROR_FILE_WRITE;
+    }
+    close(fd);
+  }
+
+  utf8lex_regex_definition_t word_definition;
+  error = utf8lex_regex_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              "[a-z]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_regex_definition_t space_definition;
+  error = utf8lex_regex_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              "[ \\n]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_regex_definition_t include_definition;
+  error = utf8lex_regex_definition_init(
+              &include_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "INCLUDE",  // name
+              "@");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t include_rule;
+  error = utf8lex_rule_init(&include_rule,  // self
+                            &space_rule,  // prev
+                            "include",  // name
+                            (utf8lex_definition_t *)
+                            &include_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_SOURCES];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_SOURCES];
+  for (int s = 0; s < TEST_UTF8LEX_NUM_SOURCES; s ++)
+  {
+    strs[s].bytes = NULL;
+    strs[s].max_length_bytes = (size_t) 0;
+    strs[s].length_bytes = (size_t) 0;
+    buffers[s].next = NULL;
+    buffers[s].prev = NULL;
+    buffers[s].str = &(strs[s]);
+    error = utf8lex_buffer_mmap(&(buffers[s]),  // self
+                                paths[s]);  // path
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  // { word, byte, line, # of sources included when the word is lexed }:
+  unsigned char *expected_words[5] =
+    {
+      "alpha", "beta", "delta", "gamma", "omega"
+    };
+  int64_t expected_bytes[5] = { 0, 0, 0, 7, 8 };
+  int64_t expected_lines[5] = { 0, 0, 0, 1, 0 };
+  uint32_t expected_includes[5] = { 0, 1, 2, 1, 0 };
+
+  printf("  Including files:");  fflush(stdout);
+  int num_words = 0;
+  int num_sources = 1;
+  while (true)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+      return error;
+    }
+
+    if (token.rule == &include_rule)
+    {
+      // The rule code for "@" would do this:
+      if (num_sources >= TEST_UTF8LEX_NUM_SOURCES)
+      {
+        printf(" FAILED - too many includes\n");  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+      error = utf8lex_state_push_buffer(&state,  // self
+                                        &(buffers[num_sources]));  // buffer
+      if (error != UTF8LEX_OK) { return error; }
+      num_sources ++;
+      printf(" @");  fflush(stdout);
+      continue;
+    }
+
+    size_t expected_length_bytes = strlen(expected_words[num_words]);
+    if (num_words >= 5
+        || token.length_bytes != (int64_t) expected_length_bytes
+        || memcmp(&(token.str->bytes[token.start_byte]),
+                  expected_words[num_words],
+                  expected_length_bytes) != 0
+        || token.loc[UTF8LEX_UNIT_BYTE].start != expected_bytes[num_words]
+        || token.loc[UTF8LEX_UNIT_LINE].start != expected_lines[num_words]
+        || state.num_includes != expected_includes[num_words])
+    {
+      printf(" FAILED - word %d: %" PRId64 " bytes at byte %" PRId64
+             ", line %" PRId64 ", %u includes\n",
+             num_words,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start,
+             token.loc[UTF8LEX_UNIT_LINE].start,
+             state.num_includes);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" %s", expected_words[num_words]);  fflush(stdout);
+    num_words ++;
+  }
+
+  if (num_words != 5
+      || state.buffer != &(buffers[0])
+      || state.loc[UTF8LEX_UNIT_BYTE].start != (int64_t) 13)
+  {
+    printf(" FAILED - %d words, EOF at byte %" PRId64 "\n",
+           num_words,
+           state.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  if (utf8lex_state_pop_buffer(&state) != UTF8LEX_ERROR_STATE)
+  {
+    printf(" FAILED - popped a source that was never pushed\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" EOF OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int s = 0; s < TEST_UTF8LEX_NUM_SOURCES; s ++)
+  {
+    error = utf8lex_buffer_munmap(&(buffers[s]));
+    if (error != UTF8LEX_OK) { return error; }
+    unlink(paths[s]);
+  }
+
+  error = utf8lex_rule_clear(&include_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_file...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_file();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_window();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_include();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_file.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_file: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
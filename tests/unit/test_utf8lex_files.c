@@ -0,0 +1,370 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>  // For mkstemp()
+#include <inttypes.h>  // For uint32_t.
+#include <string.h>  // For strcpy(), strlen(), strncmp()
+#include <unistd.h>  // For close(), unlink(), write()
+
+#include "utf8lex.h"
+
+
+#define TEST_UTF8LEX_FILES_NUM_FILES 24
+#define TEST_UTF8LEX_FILES_MAX_WORKERS 4
+#define TEST_UTF8LEX_FILES_MAX_TOKENS 8
+
+// No such file:
+#define TEST_UTF8LEX_FILES_MISSING 5
+// The callback stops lexing this file after its first batch:
+#define TEST_UTF8LEX_FILES_STOPPED 7
+
+// Too big for the stack:
+static utf8lex_program_t TEST_PROGRAM;
+static utf8lex_token_t TEST_TOKENS[TEST_UTF8LEX_FILES_MAX_WORKERS]
+                                  [TEST_UTF8LEX_FILES_MAX_TOKENS];
+
+
+// What the callback saw, file by file (each file is only ever lexed
+// by one worker, so no locks are needed):
+typedef struct _STRUCT_test_utf8lex_files_seen
+{
+  uint32_t num_tokens[TEST_UTF8LEX_FILES_NUM_FILES];
+  uint32_t num_batches[TEST_UTF8LEX_FILES_NUM_FILES];
+  uint32_t num_eofs[TEST_UTF8LEX_FILES_NUM_FILES];
+  uint32_t num_mismatches[TEST_UTF8LEX_FILES_NUM_FILES];
+  uint32_t num_stop;  // The number of files to stop (0 or 1).
+} test_utf8lex_files_seen_t;
+
+
+// File number f has (f * 13) words, "w<f>", one to five per line,
+// so file 0 is empty.
+static uint32_t test_utf8lex_files_num_words(
+        uint32_t f
+        )
+{
+  return f * (uint32_t) 13;
+}
+
+static utf8lex_error_t test_utf8lex_files_create(
+        unsigned char *path,  // Template for mkstemp(), overwritten.
+        uint32_t f
+        )
+{
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+
+  for (uint32_t w = (uint32_t) 0; w < test_utf8lex_files_num_words(f); w ++)
+  {
+    unsigned char word[32];
+    int length = snprintf(word, sizeof(word), "w%u%s",
+                          f,
+                          (w % (uint32_t) 5 == (uint32_t) 4) ? "\n" : " ");
+    if (write(fd, word, (size_t) length) != (ssize_t) length)
+    {
+      close(fd);
+      unlink(path);
+      return UTF8LEX_ERROR_FILE_WRITE;
+    }
+  }
+
+  close(fd);
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_files_on_tokens(
+        utf8lex_files_t *self,
+        uint32_t file_index,
+        utf8lex_token_t *tokens,
+        uint32_t num_tokens,
+        utf8lex_error_t error
+        )
+{
+  test_utf8lex_files_seen_t *seen =
+    (test_utf8lex_files_seen_t *) self->context;
+
+  unsigned char word[32];
+  int length = snprintf(word, sizeof(word), "w%u", file_index);
+  for (uint32_t t = (uint32_t) 0; t < num_tokens; t ++)
+  {
+    if (tokens[t].length_bytes != (int64_t) length
+        || strncmp(&(tokens[t].str->bytes[tokens[t].start_byte]),
+                   word,
+                   (size_t) length) != 0)
+    {
+      seen->num_mismatches[file_index] ++;
+    }
+  }
+
+  seen->num_tokens[file_index] += num_tokens;
+  seen->num_batches[file_index] ++;
+  if (error == UTF8LEX_EOF)
+  {
+    seen->num_eofs[file_index] ++;
+  }
+
+  if (seen->num_stop > (uint32_t) 0
+      && file_index == (uint32_t) TEST_UTF8LEX_FILES_STOPPED)
+  {
+    return UTF8LEX_ERROR_TOKEN;
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes all the files with num_workers workers, making sure every file
+// was lexed exactly once, all of its words and then EOF (except the
+// missing file, and the file the callback stops).
+static utf8lex_error_t test_utf8lex_files_lex(
+        unsigned char **paths,
+        uint32_t num_workers,
+        uint32_t num_stop  // 0 or 1.
+        )
+{
+  printf("  Lexing %d files with %u workers%s:",
+         TEST_UTF8LEX_FILES_NUM_FILES,
+         num_workers,
+         (num_stop > (uint32_t) 0) ? ", stopping one" : "");
+  fflush(stdout);
+
+  test_utf8lex_files_seen_t seen;
+  memset(&seen, 0, sizeof(seen));
+  seen.num_stop = num_stop;
+
+  utf8lex_error_t errors[TEST_UTF8LEX_FILES_NUM_FILES];
+  utf8lex_files_t files;
+  utf8lex_error_t error = utf8lex_files_init(
+      &files,  // self
+      &TEST_PROGRAM,  // program
+      paths,  // paths
+      (uint32_t) TEST_UTF8LEX_FILES_NUM_FILES,  // num_files
+      errors,  // errors
+      test_utf8lex_files_on_tokens,  // on_tokens
+      &seen);  // context
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_worker_t workers[TEST_UTF8LEX_FILES_MAX_WORKERS];
+  for (uint32_t w = (uint32_t) 0; w < num_workers; w ++)
+  {
+    workers[w].tokens = &(TEST_TOKENS[w][0]);
+    workers[w].max_tokens = (uint32_t) TEST_UTF8LEX_FILES_MAX_TOKENS;
+  }
+
+  error = utf8lex_files_lex(&files,  // self
+                            workers,  // workers
+                            num_workers);  // num_workers
+  if (error != UTF8LEX_ERROR_FILE_OPEN)
+  {
+    printf(" FAILED - error %d instead of FILE_OPEN\n", (int) error);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  for (uint32_t f = (uint32_t) 0;
+       f < (uint32_t) TEST_UTF8LEX_FILES_NUM_FILES;
+       f ++)
+  {
+    uint32_t num_words = test_utf8lex_files_num_words(f);
+    utf8lex_error_t expected_error = UTF8LEX_EOF;
+    uint32_t expected_tokens = num_words;
+    uint32_t expected_eofs = (uint32_t) 1;
+    if (f == (uint32_t) TEST_UTF8LEX_FILES_MISSING)
+    {
+      expected_error = UTF8LEX_ERROR_FILE_OPEN;
+      expected_tokens = (uint32_t) 0;
+      expected_eofs = (uint32_t) 0;
+    }
+    else if (f == (uint32_t) TEST_UTF8LEX_FILES_STOPPED
+             && num_stop > (uint32_t) 0)
+    {
+      expected_error = UTF8LEX_ERROR_TOKEN;
+      expected_tokens = (uint32_t) TEST_UTF8LEX_FILES_MAX_TOKENS;
+      expected_eofs = (uint32_t) 0;
+    }
+
+    if (errors[f] != expected_error
+        || seen.num_tokens[f] != expected_tokens
+        || seen.num_eofs[f] != expected_eofs
+        || seen.num_mismatches[f] != (uint32_t) 0)
+    {
+      printf(" FAILED - file %u: error %d, %u tokens (%u mismatched),"
+             " %u EOFs\n",
+             f,
+             (int) errors[f],
+             seen.num_tokens[f],
+             seen.num_mismatches[f],
+             seen.num_eofs[f]);  fflush(stdout);
+      return UTF8LEX_ERROR_STATE;
+    }
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_files_clear(&files);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Creates a couple dozen small files (one of them empty, one missing),
+// then lexes them all with one, two and four workers.
+static utf8lex_error_t test_utf8lex_files()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              NULL,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_regex_definition_t word_definition;
+  error = utf8lex_regex_definition_init(
+              &word_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "WORD",  // name
+              "w[0-9]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            NULL,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            &space_rule,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &space_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char path_bytes[TEST_UTF8LEX_FILES_NUM_FILES][64];
+  unsigned char *paths[TEST_UTF8LEX_FILES_NUM_FILES];
+  uint32_t num_created = (uint32_t) 0;
+  for (uint32_t f = (uint32_t) 0;
+       f < (uint32_t) TEST_UTF8LEX_FILES_NUM_FILES;
+       f ++)
+  {
+    paths[f] = &(path_bytes[f][0]);
+    if (f == (uint32_t) TEST_UTF8LEX_FILES_MISSING)
+    {
+      strcpy(paths[f], "/tmp/test_utf8lex_files_no_such_file");
+      continue;
+    }
+
+    strcpy(paths[f], "/tmp/test_utf8lex_files_XXXXXX");
+    error = test_utf8lex_files_create(paths[f],  // path
+                                      f);  // f
+    if (error != UTF8LEX_OK) { break; }
+    num_created = f + (uint32_t) 1;
+  }
+
+  uint32_t num_workers[] = { 1, 2, 4 };
+  for (int n = 0;
+       error == UTF8LEX_OK
+         && n < (int) (sizeof(num_workers) / sizeof(num_workers[0]));
+       n ++)
+  {
+    error = test_utf8lex_files_lex(paths,  // paths
+                                   num_workers[n],  // num_workers
+                                   (uint32_t) 0);  // num_stop
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_files_lex(paths,  // paths
+                                   (uint32_t) 3,  // num_workers
+                                   (uint32_t) 1);  // num_stop
+  }
+
+  for (uint32_t f = (uint32_t) 0; f < num_created; f ++)
+  {
+    if (f != (uint32_t) TEST_UTF8LEX_FILES_MISSING)
+    {
+      unlink(paths[f]);
+    }
+  }
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_files...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_files();
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_files.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_files: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
@@ -0,0 +1,325 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For uint32_t, uint64_t, PRIu64.
+#include <string.h>  // For strlen()
+
+#include "utf8lex.h"
+
+
+#define TEST_UTF8LEX_TOKENS_MAX 16
+
+// The identifiers all end in the same 8 bytes, so a hash of only
+// the last 8 bytes would not tell them apart.
+static unsigned char *TEST_TO_LEX =
+  "alpha_identifier beta_identifier alpha_identifier"
+  " gamma_identifier beta_identifier";
+
+static int TEST_EXPECTED_SYMBOL_IDS[] = { 0, -1, 1, -1, 0, -1, 2, -1, 1 };
+#define TEST_NUM_EXPECTED_TOKENS 9
+
+
+// The hash of the specified bytes, one byte at a time:
+static uint64_t test_utf8lex_hash(
+        unsigned char *bytes,
+        int64_t length_bytes
+        )
+{
+  uint64_t hash = (uint64_t) 0;
+  for (int64_t b = (int64_t) 0; b < length_bytes; b ++)
+  {
+    hash = utf8lex_hash_concat(hash,  // hash1
+                               (uint64_t) bytes[b],  // hash2
+                               (uint64_t) 1);  // length2_bytes
+  }
+
+  return hash;
+}
+
+// Lexes TEST_TO_LEX with the specified location mode, interning
+// the identifiers, and checks the symbol ids and hashes.
+static utf8lex_error_t test_utf8lex_intern_lex(
+        utf8lex_rule_t *first_rule,
+        utf8lex_location_mode_t location_mode
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  uint32_t slots[8];
+  utf8lex_symbol_t symbols[4];
+  unsigned char arena[64];
+  utf8lex_intern_table_t intern_table;
+  error = utf8lex_intern_table_init(&intern_table,  // self
+                                    slots,  // slots
+                                    (uint32_t) 8,  // num_slots
+                                    symbols,  // symbols
+                                    (uint32_t) 4,  // max_symbols
+                                    arena,  // arena
+                                    (uint64_t) 64);  // max_arena_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  size_t length_bytes = strlen(TEST_TO_LEX);
+  utf8lex_string_t str;
+  error = utf8lex_string_init(&str,  // self
+                              length_bytes,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              TEST_TO_LEX);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_buffer_t buffer;
+  error = utf8lex_buffer_init(&buffer,  // self
+                              NULL,  // prev
+                              &str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_location_mode(&state,  // self
+                                          location_mode);  // location_mode
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_intern_table(&state,  // self
+                                         &intern_table);  // intern_table
+  if (error != UTF8LEX_OK) { return error; }
+
+  for (int t = 0; t < TEST_NUM_EXPECTED_TOKENS; t ++)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(first_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error != UTF8LEX_OK) { return error; }
+
+    unsigned char *token_bytes = &(str.bytes[token.start_byte]);
+    uint64_t expected_hash = test_utf8lex_hash(token_bytes,
+                                               token.length_bytes);
+    uint32_t expected_symbol_id = (TEST_EXPECTED_SYMBOL_IDS[t] < 0)
+      ? UTF8LEX_SYMBOL_NONE
+      : (uint32_t) TEST_EXPECTED_SYMBOL_IDS[t];
+    printf("    %s token %d symbol %d hash %" PRIu64 ":",
+           token.rule->name,
+           t,
+           TEST_EXPECTED_SYMBOL_IDS[t],
+           expected_hash);  fflush(stdout);
+    if (token.symbol_id != expected_symbol_id
+        || token.loc[UTF8LEX_UNIT_BYTE].hash != expected_hash
+        || token.loc[UTF8LEX_UNIT_CHAR].hash != expected_hash
+        || token.loc[UTF8LEX_UNIT_GRAPHEME].hash != expected_hash)
+    {
+      printf(" FAILED - symbol %u hash %" PRIu64 "\n",
+             token.symbol_id,
+             token.loc[UTF8LEX_UNIT_BYTE].hash);  fflush(stdout);
+      return UTF8LEX_ERROR_BAD_HASH;
+    }
+
+    if (token.symbol_id != UTF8LEX_SYMBOL_NONE)
+    {
+      // The symbol's bytes were copied into the arena.
+      unsigned char *symbol_bytes = NULL;
+      uint64_t symbol_length_bytes = (uint64_t) 0;
+      error = utf8lex_intern_table_symbol(&intern_table,  // self
+                                          token.symbol_id,  // symbol_id
+                                          &symbol_bytes,  // bytes_pointer
+                                          &symbol_length_bytes);
+      if (error != UTF8LEX_OK) { return error; }
+      if (symbol_length_bytes != (uint64_t) token.length_bytes
+          || symbol_bytes == token_bytes
+          || memcmp(symbol_bytes, token_bytes, (size_t) symbol_length_bytes)
+             != 0)
+      {
+        printf(" FAILED - symbol bytes\n");  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  // Each distinct identifier was copied once:
+  printf("    %u symbols, %" PRIu64 " arena bytes:",
+         intern_table.num_symbols,
+         intern_table.arena_bytes);  fflush(stdout);
+  if (intern_table.num_symbols != (uint32_t) 3
+      || intern_table.arena_bytes != (uint64_t) (16 + 15 + 16))
+  {
+    printf(" FAILED\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_intern_table_clear(&intern_table);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+static utf8lex_error_t test_utf8lex_intern()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t identifier_definition;
+  error = utf8lex_regex_definition_init(
+              &identifier_definition,  // self
+              NULL,  // prev
+              "IDENTIFIER",  // name
+              "[a-z_]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &identifier_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t identifier_rule;
+  error = utf8lex_rule_init(&identifier_rule,  // self
+                            NULL,  // prev
+                            "identifier",  // name
+                            (utf8lex_definition_t *)
+                            &identifier_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_interned(&identifier_rule,  // self
+                                    true);  // is_interned
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &identifier_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Interning with all locations:\n");  fflush(stdout);
+  error = test_utf8lex_intern_lex(&identifier_rule,  // first_rule
+                                  UTF8LEX_LOCATION_MODE_ALL);  // location_mode
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Interning with lazy locations:\n");  fflush(stdout);
+  error = test_utf8lex_intern_lex(&identifier_rule,  // first_rule
+                                  UTF8LEX_LOCATION_MODE_LAZY);  // location_mode
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Interning into a full table:");  fflush(stdout);
+  uint32_t slots[4];
+  utf8lex_symbol_t symbols[1];
+  unsigned char arena[64];
+  utf8lex_intern_table_t intern_table;
+  error = utf8lex_intern_table_init(&intern_table,  // self
+                                    slots,  // slots
+                                    (uint32_t) 3,  // num_slots
+                                    symbols,  // symbols
+                                    (uint32_t) 1,  // max_symbols
+                                    arena,  // arena
+                                    (uint64_t) 64);  // max_arena_bytes
+  if (error != UTF8LEX_ERROR_BAD_LENGTH)
+  {
+    printf(" FAILED - %u slots accepted\n", 3);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  error = utf8lex_intern_table_init(&intern_table,  // self
+                                    slots,  // slots
+                                    (uint32_t) 4,  // num_slots
+                                    symbols,  // symbols
+                                    (uint32_t) 1,  // max_symbols
+                                    arena,  // arena
+                                    (uint64_t) 64);  // max_arena_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  uint32_t symbol_ids[3];
+  error = utf8lex_intern(&intern_table,  // self
+                         "one",  // bytes
+                         (uint64_t) 3,  // length_bytes
+                         test_utf8lex_hash("one", 3),  // hash
+                         &(symbol_ids[0]));  // symbol_id_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_intern(&intern_table,  // self
+                         "one",  // bytes
+                         (uint64_t) 3,  // length_bytes
+                         test_utf8lex_hash("one", 3),  // hash
+                         &(symbol_ids[1]));  // symbol_id_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_intern(&intern_table,  // self
+                         "two",  // bytes
+                         (uint64_t) 3,  // length_bytes
+                         test_utf8lex_hash("two", 3),  // hash
+                         &(symbol_ids[2]));  // symbol_id_pointer
+  if (error != UTF8LEX_ERROR_MAX_LENGTH
+      || symbol_ids[0] != (uint32_t) 0
+      || symbol_ids[1] != (uint32_t) 0)
+  {
+    printf(" FAILED\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+  error = utf8lex_intern_table_clear(&intern_table);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&identifier_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_intern...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_intern();
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_intern.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_intern: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
@@ -0,0 +1,411 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int64_t, uint32_t, uint64_t, PRId64.
+#include <string.h>  // For strlen()
+
+#include "utf8lex.h"
+
+
+#define TEST_UTF8LEX_TOKENS_MAX 32
+
+// 5 lines: CR LF, LF, LF, and U+2028 LINE SEPARATOR between them.
+static unsigned char *TEST_TO_LEX =
+  "h\xc3\xa9llo w\xc3\xb6rld\r\nline two\n\n\xc3\xbc" "ber alles\xe2\x80\xa8last";
+
+
+// Lexes all of TEST_TO_LEX with the specified location mode
+// and line index (or NULL).
+static utf8lex_error_t test_utf8lex_lex_all(
+        utf8lex_rule_t *first_rule,
+        utf8lex_state_t *state,
+        utf8lex_buffer_t *buffer,
+        utf8lex_string_t *str,
+        utf8lex_location_mode_t location_mode,
+        utf8lex_line_index_t *line_index,
+        utf8lex_token_t tokens[TEST_UTF8LEX_TOKENS_MAX],
+        int *num_tokens_pointer
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  size_t length_bytes = strlen(TEST_TO_LEX);
+  error = utf8lex_string_init(str,  // self
+                              length_bytes,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              TEST_TO_LEX);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_init(buffer,  // self
+                              NULL,  // prev
+                              str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_init(state,  // self
+                             buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_location_mode(state,  // self
+                                          location_mode);  // location_mode
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_line_index(state,  // self
+                                       line_index);  // line_index
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_units(state,  // self
+                                  UTF8LEX_UNITS_ALL);  // units
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_tokens = 0;
+  while (true)
+  {
+    if (num_tokens >= TEST_UTF8LEX_TOKENS_MAX)
+    {
+      return UTF8LEX_ERROR_MAX_LENGTH;
+    }
+
+    error = utf8lex_lex(first_rule,  // first_rule
+                        state,  // state
+                        &(tokens[num_tokens]));  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+
+    num_tokens ++;
+  }
+
+  *num_tokens_pointer = num_tokens;
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes the same text with all locations, and lazily, and makes sure
+// the lazy locations resolve to the same locations.
+static utf8lex_error_t test_utf8lex_location_resolve()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t word_definition;
+  error = utf8lex_regex_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              "(*UTF)[\\p{L}\\p{N}]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing with all locations:");  fflush(stdout);
+  utf8lex_state_t all_state;
+  utf8lex_buffer_t all_buffer;
+  utf8lex_string_t all_str;
+  utf8lex_token_t all_tokens[TEST_UTF8LEX_TOKENS_MAX];
+  int num_all_tokens = 0;
+  error = test_utf8lex_lex_all(&word_rule,  // first_rule
+                               &all_state,  // state
+                               &all_buffer,  // buffer
+                               &all_str,  // str
+                               UTF8LEX_LOCATION_MODE_ALL,  // location_mode
+                               NULL,  // line_index
+                               all_tokens,  // tokens
+                               &num_all_tokens);  // num_tokens_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  printf(" %d tokens OK\n", num_all_tokens);  fflush(stdout);
+
+  printf("  Lexing lazily, with a line index:");  fflush(stdout);
+  uint64_t line_starts[8];
+  utf8lex_line_index_t line_index;
+  error = utf8lex_line_index_init(&line_index,  // self
+                                  line_starts,  // line_starts
+                                  (uint32_t) 8);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_state_t lazy_state;
+  utf8lex_buffer_t lazy_buffer;
+  utf8lex_string_t lazy_str;
+  utf8lex_token_t lazy_tokens[TEST_UTF8LEX_TOKENS_MAX];
+  int num_lazy_tokens = 0;
+  error = test_utf8lex_lex_all(&word_rule,  // first_rule
+                               &lazy_state,  // state
+                               &lazy_buffer,  // buffer
+                               &lazy_str,  // str
+                               UTF8LEX_LOCATION_MODE_LAZY,  // location_mode
+                               &line_index,  // line_index
+                               lazy_tokens,  // tokens
+                               &num_lazy_tokens);  // num_tokens_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (num_lazy_tokens != num_all_tokens
+      || line_index.num_lines != (uint32_t) 4
+      || line_starts[0] != (uint64_t) 15
+      || line_starts[1] != (uint64_t) 24
+      || line_starts[2] != (uint64_t) 25)
+  {
+    printf(" FAILED - %d tokens, %u lines\n",
+           num_lazy_tokens,
+           line_index.num_lines);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d tokens, %u lines OK\n",
+         num_lazy_tokens,
+         line_index.num_lines);  fflush(stdout);
+
+  // A line index too small for all the lines: the rest are read.
+  uint64_t small_line_starts[2];
+  utf8lex_line_index_t small_line_index;
+  error = utf8lex_line_index_init(&small_line_index,  // self
+                                  small_line_starts,  // line_starts
+                                  (uint32_t) 2);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_state_t small_state;
+  utf8lex_buffer_t small_buffer;
+  utf8lex_string_t small_str;
+  utf8lex_token_t small_tokens[TEST_UTF8LEX_TOKENS_MAX];
+  int num_small_tokens = 0;
+  error = test_utf8lex_lex_all(&word_rule,  // first_rule
+                               &small_state,  // state
+                               &small_buffer,  // buffer
+                               &small_str,  // str
+                               UTF8LEX_LOCATION_MODE_LAZY,  // location_mode
+                               &small_line_index,  // line_index
+                               small_tokens,  // tokens
+                               &num_small_tokens);  // num_tokens_pointer
+  if (error != UTF8LEX_OK) { return error; }
+
+  for (int t = 0; t < num_all_tokens; t ++)
+  {
+    utf8lex_token_t *all_token = &(all_tokens[t]);
+    utf8lex_token_t *lazy_token = &(lazy_tokens[t]);
+    printf("    %s token %d (byte %" PRId64 "):",
+           all_token->rule->name,
+           t,
+           all_token->loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+    if (lazy_token->rule != all_token->rule
+        || lazy_token->loc[UTF8LEX_UNIT_BYTE].start
+           != all_token->loc[UTF8LEX_UNIT_BYTE].start
+        || lazy_token->length_bytes != all_token->length_bytes
+        || lazy_token->loc[UTF8LEX_UNIT_LINE].start != 0)
+    {
+      printf(" FAILED - lazy token %s %" PRId64 " bytes at %" PRId64 ", line %" PRId64 "\n",
+             lazy_token->rule->name,
+             lazy_token->length_bytes,
+             lazy_token->loc[UTF8LEX_UNIT_BYTE].start,
+             lazy_token->loc[UTF8LEX_UNIT_LINE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      uint64_t byte_offset =
+        (uint64_t) lazy_token->loc[UTF8LEX_UNIT_BYTE].start;
+      int64_t lazy_location = -1;
+      error = utf8lex_location_resolve(&lazy_state,  // state
+                                       byte_offset,  // byte_offset
+                                       unit,  // unit
+                                       &lazy_location);  // location_pointer
+      if (error != UTF8LEX_OK) { return error; }
+      int64_t small_location = -1;
+      error = utf8lex_location_resolve(&small_state,  // state
+                                       byte_offset,  // byte_offset
+                                       unit,  // unit
+                                       &small_location);  // location_pointer
+      if (error != UTF8LEX_OK) { return error; }
+
+      if (lazy_location != all_token->loc[unit].start
+          || small_location != all_token->loc[unit].start)
+      {
+        printf(" FAILED - unit %d resolved to %" PRId64
+               " (small index %" PRId64 ") instead of %" PRId64 "\n",
+               (int) unit,
+               lazy_location,
+               small_location,
+               all_token->loc[unit].start);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+    }
+    printf(" line %" PRId64 ", char %" PRId64 " OK\n",
+           all_token->loc[UTF8LEX_UNIT_LINE].start,
+           all_token->loc[UTF8LEX_UNIT_CHAR].start);  fflush(stdout);
+  }
+
+  printf("  Resolving a byte in the middle of a grapheme:");  fflush(stdout);
+  int64_t bad_location = -1;
+  if (utf8lex_location_resolve(&lazy_state,  // state
+                               (uint64_t) 2,  // byte_offset
+                               UTF8LEX_UNIT_CHAR,  // unit
+                               &bad_location)  // location_pointer
+      != UTF8LEX_ERROR_BAD_START)
+  {
+    printf(" FAILED\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&small_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&small_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&small_str);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_clear(&small_line_index);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_clear(&lazy_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&lazy_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&lazy_str);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_clear(&line_index);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_clear(&all_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&all_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&all_str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+// Adds a CR LF split across two calls (as when one token ends with
+// the CR and the next starts with the LF), which is one line separator.
+static utf8lex_error_t test_utf8lex_location_split_crlf()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  printf("  Line index, CR LF split across tokens:");  fflush(stdout);
+  uint64_t line_starts[8];
+  utf8lex_line_index_t line_index;
+  error = utf8lex_line_index_init(&line_index,  // self
+                                  line_starts,  // line_starts
+                                  (uint32_t) 8);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char first_bytes[] = "ab\r";
+  unsigned char second_bytes[] = "\ncd\r";
+  unsigned char third_bytes[] = "x\n";
+  error = utf8lex_line_index_add(&line_index,  // self
+                                 first_bytes,  // bytes
+                                 (size_t) 3,  // length_bytes
+                                 (uint64_t) 0);  // start_byte
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_add(&line_index,  // self
+                                 second_bytes,  // bytes
+                                 (size_t) 4,  // length_bytes
+                                 (uint64_t) 3);  // start_byte
+  if (error != UTF8LEX_OK) { return error; }
+  // Not a LF after the CR, so the CR ends its line:
+  error = utf8lex_line_index_add(&line_index,  // self
+                                 third_bytes,  // bytes
+                                 (size_t) 2,  // length_bytes
+                                 (uint64_t) 7);  // start_byte
+  if (error != UTF8LEX_OK) { return error; }
+
+  if (line_index.num_lines != (uint32_t) 3
+      || line_starts[0] != (uint64_t) 4
+      || line_starts[1] != (uint64_t) 7
+      || line_starts[2] != (uint64_t) 9)
+  {
+    printf(" FAILED - %u lines\n",
+           line_index.num_lines);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %u lines OK\n",
+         line_index.num_lines);  fflush(stdout);
+
+  error = utf8lex_line_index_clear(&line_index);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_location...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_location_resolve();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_location_split_crlf();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_location.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_location: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
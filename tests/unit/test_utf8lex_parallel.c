@@ -0,0 +1,544 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>  // For strlen()
+
+#include "utf8lex.h"
+
+
+#define TEST_UTF8LEX_PARALLEL_CHUNKS_MAX 8
+#define TEST_UTF8LEX_PARALLEL_TOKENS_MAX 1024
+
+// Too big for the stack:
+static utf8lex_program_t TEST_PROGRAM;
+static unsigned char TEST_BYTES[8192];
+static utf8lex_token_t TEST_TOKENS[TEST_UTF8LEX_PARALLEL_TOKENS_MAX];
+static utf8lex_token_t TEST_CHUNK_TOKENS[TEST_UTF8LEX_PARALLEL_CHUNKS_MAX]
+                                        [TEST_UTF8LEX_PARALLEL_TOKENS_MAX];
+static utf8lex_chunk_t TEST_CHUNKS[TEST_UTF8LEX_PARALLEL_CHUNKS_MAX];
+
+
+static utf8lex_error_t test_utf8lex_init_state(
+        utf8lex_state_t *state,
+        utf8lex_buffer_t *buffer,
+        utf8lex_string_t *str,
+        unsigned char *bytes
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  size_t length_bytes = strlen(bytes);
+  error = utf8lex_string_init(str,  // self
+                              length_bytes,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              bytes);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_buffer_init(buffer,  // self
+                              NULL,  // prev
+                              str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_init(state,  // self
+                             buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes the bytes in num_chunks chunks, making sure the tokens
+// are exactly the same as the expected tokens, lexed one at a time,
+// and that the state ends up at EOF.
+static utf8lex_error_t test_utf8lex_parallel_chunks(
+        unsigned char *to_lex,
+        uint32_t num_chunks,
+        uint32_t max_tokens,  // Per chunk.
+        utf8lex_token_t *expected,
+        uint32_t num_expected,
+        utf8lex_buffer_t *expected_buffer
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing %zu bytes in %u chunks:",
+         str.length_bytes, num_chunks);  fflush(stdout);
+  for (uint32_t c = (uint32_t) 0; c < num_chunks; c ++)
+  {
+    TEST_CHUNKS[c].tokens = &(TEST_CHUNK_TOKENS[c][0]);
+    TEST_CHUNKS[c].max_tokens = max_tokens;
+  }
+  error = utf8lex_parallel_lex(&TEST_PROGRAM,  // program
+                               &state,  // state
+                               TEST_CHUNKS,  // chunks
+                               num_chunks);  // num_chunks
+  if (error != UTF8LEX_EOF)
+  {
+    printf(" FAILED - error %d instead of EOF\n", (int) error);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  uint32_t t = (uint32_t) 0;
+  for (uint32_t c = (uint32_t) 0; c < num_chunks; c ++)
+  {
+    utf8lex_chunk_t *chunk = &(TEST_CHUNKS[c]);
+    printf(" %u", chunk->num_tokens);  fflush(stdout);
+    for (uint32_t n = (uint32_t) 0; n < chunk->num_tokens; n ++)
+    {
+      utf8lex_token_t *token = &(chunk->tokens[chunk->first_token + n]);
+      if (t >= num_expected)
+      {
+        printf(" FAILED - more than %u tokens\n", num_expected);
+        fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+
+      utf8lex_token_t *expected_token = &(expected[t]);
+      if (token->rule != expected_token->rule
+          || token->str != &str
+          || expected_token->str->bytes != str.bytes
+          || token->start_byte != expected_token->start_byte
+          || token->length_bytes != expected_token->length_bytes
+          || token->buffer != &buffer
+          || expected_token->buffer != expected_buffer)
+      {
+        printf(" FAILED - token %u is %s (%" PRId64 " bytes at %" PRId64 ")"
+               " instead of %s (%" PRId64 " bytes at %" PRId64 ")\n",
+               t,
+               token->rule->name,
+               token->length_bytes,
+               token->start_byte,
+               expected_token->rule->name,
+               expected_token->length_bytes,
+               expected_token->start_byte);  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+
+      for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+           unit < UTF8LEX_UNIT_MAX;
+           unit ++)
+      {
+        utf8lex_location_t *loc = &(token->loc[unit]);
+        utf8lex_location_t *expected_loc = &(expected_token->loc[unit]);
+        if (loc->start != expected_loc->start
+            || loc->length != expected_loc->length
+            || loc->after != expected_loc->after
+            || loc->hash != expected_loc->hash)
+        {
+          printf(" FAILED - token %u unit %d is"
+                 " %" PRId64 ", %" PRId64 ", %" PRId64
+                 " instead of %" PRId64 ", %" PRId64 ", %" PRId64 "\n",
+                 t,
+                 (int) unit,
+                 loc->start,
+                 loc->length,
+                 loc->after,
+                 expected_loc->start,
+                 expected_loc->length,
+                 expected_loc->after);  fflush(stdout);
+          return UTF8LEX_ERROR_TOKEN;
+        }
+      }
+
+      t ++;
+    }
+  }
+
+  if (t != num_expected)
+  {
+    printf(" FAILED - lexed %u tokens, expected %u\n",
+           t, num_expected);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // The state carries on at EOF:
+  utf8lex_token_t token;
+  error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                              &state,  // state
+                              &token);  // token_pointer
+  if (error != UTF8LEX_EOF
+      || state.loc[UTF8LEX_UNIT_BYTE].start != (int64_t) str.length_bytes)
+  {
+    printf(" FAILED - error %d at byte %" PRId64 " after the chunks\n",
+           (int) error,
+           state.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" tokens OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes a few dozen lines of words, multi-line comments and multi-line
+// strings, one token at a time and then in parallel chunks (whose
+// speculative starts land inside comments and strings), making sure
+// the chunks add up to exactly the same tokens.
+static utf8lex_error_t test_utf8lex_parallel()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_regex_definition_t comment_definition;
+  error = utf8lex_regex_definition_init(
+              &comment_definition,  // self
+              NULL,  // prev
+              "COMMENT",  // name
+              "/\\*[^*]*\\*+([^/*][^*]*\\*+)*/");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_regex_definition_t string_definition;
+  error = utf8lex_regex_definition_init(
+              &string_definition,  // self
+              (utf8lex_definition_t *) &comment_definition,  // prev
+              "STRING",  // name
+              "\"[^\"]*\"");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              (utf8lex_definition_t *) &string_definition,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_cat_definition_t other_definition;
+  error = utf8lex_cat_definition_init(
+              &other_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "OTHER",  // name
+              UTF8LEX_GROUP_NOT_WHITESPACE,  // cat
+              1,  // min
+              1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t comment_rule;
+  error = utf8lex_rule_init(&comment_rule,  // self
+                            NULL,  // prev
+                            "comment",  // name
+                            (utf8lex_definition_t *)
+                            &comment_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t string_rule;
+  error = utf8lex_rule_init(&string_rule,  // self
+                            &comment_rule,  // prev
+                            "string",  // name
+                            (utf8lex_definition_t *)
+                            &string_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            &string_rule,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t other_rule;
+  error = utf8lex_rule_init(&other_rule,  // self
+                            &space_rule,  // prev
+                            "other",  // name
+                            (utf8lex_definition_t *)
+                            &other_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &comment_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Lines of words, with comments and strings spanning several lines
+  // (so that some chunks start inside them), and multi-byte characters:
+  size_t length_bytes = (size_t) 0;
+  for (int line = 0; line < 48; line ++)
+  {
+    length_bytes += (size_t) snprintf(
+        (char *) &(TEST_BYTES[length_bytes]),
+        sizeof(TEST_BYTES) - length_bytes,
+        (line % 5 == 0)
+        ? "x%d = \"héllo\n  wörld \"; /* 日本語\n\n  x = 1; */\n"
+        : (line % 3 == 0)
+        ? "/* x%d\n \"\n*/ y = \"a /* b\n c */\";\n"
+        : "x%d = y + z;  // ünïcödé\n",
+        line);
+  }
+
+  // First one token at a time:
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  TEST_BYTES);
+  if (error != UTF8LEX_OK) { return error; }
+
+  uint32_t num_tokens = (uint32_t) 0;
+  while (true)
+  {
+    if (num_tokens >= (uint32_t) TEST_UTF8LEX_PARALLEL_TOKENS_MAX)
+    {
+      return UTF8LEX_ERROR_MAX_LENGTH;
+    }
+    error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                                &state,  // state
+                                &(TEST_TOKENS[num_tokens]));  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      return error;
+    }
+    num_tokens ++;
+  }
+  printf("  Lexed %zu bytes into %u tokens\n",
+         length_bytes, num_tokens);  fflush(stdout);
+
+  uint32_t num_chunks[] = { 1, 2, 3, 5, 8 };
+  for (int n = 0; n < (int) (sizeof(num_chunks) / sizeof(num_chunks[0])); n ++)
+  {
+    error = test_utf8lex_parallel_chunks(
+                TEST_BYTES,  // to_lex
+                num_chunks[n],  // num_chunks
+                (uint32_t) TEST_UTF8LEX_PARALLEL_TOKENS_MAX,  // max_tokens
+                TEST_TOKENS,  // expected
+                num_tokens,  // num_expected
+                &buffer);  // expected_buffer
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  // Starting part way through the buffer:
+  printf("  Lexing the rest after %u tokens:", (uint32_t) 7);
+  fflush(stdout);
+  utf8lex_state_t rest_state;
+  utf8lex_buffer_t rest_buffer;
+  utf8lex_string_t rest_str;
+  error = test_utf8lex_init_state(&rest_state,  // state
+                                  &rest_buffer,  // buffer
+                                  &rest_str,  // str
+                                  TEST_BYTES);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int t = 0; t < 7; t ++)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                                &rest_state,  // state
+                                &token);  // token_pointer
+    if (error != UTF8LEX_OK) { return error; }
+  }
+  for (uint32_t c = (uint32_t) 0; c < (uint32_t) 4; c ++)
+  {
+    TEST_CHUNKS[c].tokens = &(TEST_CHUNK_TOKENS[c][0]);
+    TEST_CHUNKS[c].max_tokens = (uint32_t) TEST_UTF8LEX_PARALLEL_TOKENS_MAX;
+  }
+  error = utf8lex_parallel_lex(&TEST_PROGRAM,  // program
+                               &rest_state,  // state
+                               TEST_CHUNKS,  // chunks
+                               (uint32_t) 4);  // num_chunks
+  if (error != UTF8LEX_EOF)
+  {
+    printf(" FAILED - error %d instead of EOF\n", (int) error);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  uint32_t t = (uint32_t) 7;
+  for (uint32_t c = (uint32_t) 0; c < (uint32_t) 4; c ++)
+  {
+    for (uint32_t n = (uint32_t) 0; n < TEST_CHUNKS[c].num_tokens; n ++)
+    {
+      utf8lex_token_t *token =
+        &(TEST_CHUNKS[c].tokens[TEST_CHUNKS[c].first_token + n]);
+      if (t >= num_tokens
+          || token->rule != TEST_TOKENS[t].rule
+          || token->loc[UTF8LEX_UNIT_BYTE].start
+             != TEST_TOKENS[t].loc[UTF8LEX_UNIT_BYTE].start
+          || token->loc[UTF8LEX_UNIT_LINE].start
+             != TEST_TOKENS[t].loc[UTF8LEX_UNIT_LINE].start
+          || token->loc[UTF8LEX_UNIT_CHAR].start
+             != TEST_TOKENS[t].loc[UTF8LEX_UNIT_CHAR].start)
+      {
+        printf(" FAILED - token %u\n", t);  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+      t ++;
+    }
+  }
+  if (t != num_tokens)
+  {
+    printf(" FAILED - lexed %u tokens, expected %u\n",
+           t, num_tokens);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  // Too little room for the tokens:
+  printf("  Lexing in 2 chunks of 16 tokens:");  fflush(stdout);
+  utf8lex_state_t small_state;
+  utf8lex_buffer_t small_buffer;
+  utf8lex_string_t small_str;
+  error = test_utf8lex_init_state(&small_state,  // state
+                                  &small_buffer,  // buffer
+                                  &small_str,  // str
+                                  TEST_BYTES);
+  if (error != UTF8LEX_OK) { return error; }
+  for (uint32_t c = (uint32_t) 0; c < (uint32_t) 2; c ++)
+  {
+    TEST_CHUNKS[c].tokens = &(TEST_CHUNK_TOKENS[c][0]);
+    TEST_CHUNKS[c].max_tokens = (uint32_t) 16;
+  }
+  error = utf8lex_parallel_lex(&TEST_PROGRAM,  // program
+                               &small_state,  // state
+                               TEST_CHUNKS,  // chunks
+                               (uint32_t) 2);  // num_chunks
+  if (error != UTF8LEX_ERROR_MAX_LENGTH
+      || TEST_CHUNKS[0].num_tokens != (uint32_t) 16
+      || TEST_CHUNKS[1].num_tokens != (uint32_t) 0
+      || small_state.loc[UTF8LEX_UNIT_BYTE].start
+         != TEST_TOKENS[16].loc[UTF8LEX_UNIT_BYTE].start)
+  {
+    printf(" FAILED - error %d, %u + %u tokens\n",
+           (int) error,
+           TEST_CHUNKS[0].num_tokens,
+           TEST_CHUNKS[1].num_tokens);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" MAX_LENGTH OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&small_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&small_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&small_str);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_clear(&rest_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&rest_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&rest_str);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&other_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&string_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&comment_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_parallel...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_parallel();
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_parallel.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_parallel: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
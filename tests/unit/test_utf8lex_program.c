@@ -0,0 +1,735 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>  // For strlen(), strncmp()
+
+#include "utf8lex.h"
+
+
+// Too big for the stack:
+static utf8lex_program_t TEST_PROGRAM;
+
+
+static utf8lex_error_t test_utf8lex_init_state(
+        utf8lex_state_t *state,
+        utf8lex_buffer_t *buffer,
+        utf8lex_string_t *str,
+        unsigned char *bytes
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  size_t length_bytes = strlen(bytes);
+  error = utf8lex_string_init(str,  // self
+                              length_bytes,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              bytes);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_buffer_init(buffer,  // self
+                              NULL,  // prev
+                              str,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_init(state,  // self
+                             buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_expect_token(
+        utf8lex_token_t *token,
+        unsigned char *expected_rule,
+        unsigned char *expected_text
+        )
+{
+  int expected_length_bytes = (int) strlen(expected_text);
+  if (strcmp(token->rule->name, expected_rule) != 0
+      || token->length_bytes != expected_length_bytes
+      || strncmp(&(token->str->bytes[token->start_byte]),
+                 expected_text,
+                 (size_t) expected_length_bytes) != 0)
+  {
+    printf(" FAILED - expected %s '%s' but found %s (%" PRId64 " bytes at %" PRId64 ")\n",
+           expected_rule,
+           expected_text,
+           token->rule->name,
+           token->length_bytes,
+           token->start_byte);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes the same text with utf8lex_lex() and with utf8lex_program_lex(),
+// making sure both produce the same (expected) tokens.
+static utf8lex_error_t test_utf8lex_compare(
+        utf8lex_rule_t *first_rule,
+        uint32_t mode,  // The mode (start condition) to lex in.
+        unsigned char *to_lex,
+        unsigned char *expected[][2],  // { rule name, token text }.
+        int num_expected
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_state_t rules_state;
+  utf8lex_buffer_t rules_buffer;
+  utf8lex_string_t rules_str;
+  error = test_utf8lex_init_state(&rules_state,  // state
+                                  &rules_buffer,  // buffer
+                                  &rules_str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t program_state;
+  utf8lex_buffer_t program_buffer;
+  utf8lex_string_t program_str;
+  error = test_utf8lex_init_state(&program_state,  // state
+                                  &program_buffer,  // buffer
+                                  &program_str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_set_mode(&rules_state,  // self
+                                 mode);  // mode
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_mode(&program_state,  // self
+                                 mode);  // mode
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing '%s':\n", to_lex);  fflush(stdout);
+  for (int t = 0; t <= num_expected; t ++)
+  {
+    utf8lex_token_t rules_token;
+    utf8lex_error_t rules_error = utf8lex_lex(first_rule,  // first_rule
+                                              &rules_state,  // state
+                                              &rules_token);  // token
+    utf8lex_token_t program_token;
+    utf8lex_error_t program_error = utf8lex_program_lex(
+        &TEST_PROGRAM,  // program
+        &program_state,  // state
+        &program_token);  // token
+
+    if (t == num_expected)
+    {
+      printf("    EOF:");  fflush(stdout);
+      if (rules_error != UTF8LEX_EOF
+          || program_error != UTF8LEX_EOF)
+      {
+        printf(" FAILED - utf8lex_lex %d, utf8lex_program_lex %d\n",
+               (int) rules_error,
+               (int) program_error);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+      printf(" OK\n");  fflush(stdout);
+      break;
+    }
+
+    printf("    %s '%s':", expected[t][0], expected[t][1]);  fflush(stdout);
+    if (rules_error != UTF8LEX_OK) { return rules_error; }
+    if (program_error != UTF8LEX_OK) { return program_error; }
+
+    error = test_utf8lex_expect_token(&rules_token,  // token
+                                      expected[t][0],  // expected_rule
+                                      expected[t][1]);  // expected_text
+    if (error != UTF8LEX_OK) { return error; }
+    error = test_utf8lex_expect_token(&program_token,  // token
+                                      expected[t][0],  // expected_rule
+                                      expected[t][1]);  // expected_text
+    if (error != UTF8LEX_OK) { return error; }
+
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      if (rules_token.loc[unit].start != program_token.loc[unit].start
+          || rules_token.loc[unit].length != program_token.loc[unit].length)
+      {
+        printf(" FAILED - unit %d locations differ\n",
+               (int) unit);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  error = utf8lex_state_clear(&program_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&program_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&program_str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_clear(&rules_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&rules_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&rules_str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Packs the token into a compact token, then expands it again,
+// making sure nothing (but the captures) was lost.
+static utf8lex_error_t test_utf8lex_compact(
+        utf8lex_token_t *token,
+        utf8lex_program_t *program,
+        utf8lex_state_t *state
+        )
+{
+  utf8lex_compact_token_t compact;
+  utf8lex_error_t error = utf8lex_compact_token_init(&compact,  // self
+                                                     token);  // token
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_token_t expanded;
+  error = utf8lex_compact_token_expand(&compact,  // self
+                                       program,  // program
+                                       state,  // state
+                                       &expanded);  // token_pointer
+  if (error != UTF8LEX_OK) { return error; }
+
+  if (expanded.rule != token->rule
+      || expanded.str != token->str
+      || expanded.start_byte != token->start_byte
+      || expanded.length_bytes != token->length_bytes)
+  {
+    printf(" FAILED - compact token expanded to %s (%" PRId64 " bytes at %" PRId64 ")\n",
+           expanded.rule->name,
+           expanded.length_bytes,
+           expanded.start_byte);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    if (expanded.loc[unit].start != token->loc[unit].start
+        || expanded.loc[unit].length != token->loc[unit].length
+        || expanded.loc[unit].after != token->loc[unit].after)
+    {
+      printf(" FAILED - compact token unit %d expanded to"
+             " %" PRId64 ", %" PRId64 ", %" PRId64
+             " instead of %" PRId64 ", %" PRId64 ", %" PRId64 "\n",
+             (int) unit,
+             expanded.loc[unit].start,
+             expanded.loc[unit].length,
+             expanded.loc[unit].after,
+             token->loc[unit].start,
+             token->loc[unit].length,
+             token->loc[unit].after);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+  }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes the text with utf8lex_lex_batch(), a few tokens at a time,
+// making sure the batches add up to the expected tokens,
+// and that each token survives being packed into a compact token.
+static utf8lex_error_t test_utf8lex_batch(
+        unsigned char *to_lex,
+        uint32_t max_tokens,  // Tokens per batch.
+        unsigned char *expected[][2],  // { rule name, token text }.
+        int num_expected
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_lex);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing '%s' in batches of %u:\n",
+         to_lex, max_tokens);  fflush(stdout);
+  utf8lex_token_t tokens[4];
+  if (max_tokens > (uint32_t) 4)
+  {
+    return UTF8LEX_ERROR_BAD_LENGTH;
+  }
+
+  int t = 0;
+  utf8lex_error_t batch_error = UTF8LEX_OK;
+  while (batch_error == UTF8LEX_OK)
+  {
+    uint32_t num_tokens = (uint32_t) 0;
+    batch_error = utf8lex_lex_batch(&TEST_PROGRAM,  // program
+                                    &state,  // state
+                                    tokens,  // tokens
+                                    max_tokens,  // max_tokens
+                                    &num_tokens);  // num_tokens_pointer
+    printf("    Batch of %u tokens, error %d:",
+           num_tokens, (int) batch_error);  fflush(stdout);
+    if ((batch_error == UTF8LEX_OK && num_tokens != max_tokens)
+        || (batch_error != UTF8LEX_OK && batch_error != UTF8LEX_EOF)
+        || t + (int) num_tokens > num_expected)
+    {
+      printf(" FAILED\n");  fflush(stdout);
+      return UTF8LEX_ERROR_STATE;
+    }
+
+    for (uint32_t n = (uint32_t) 0; n < num_tokens; n ++)
+    {
+      error = test_utf8lex_expect_token(&(tokens[n]),  // token
+                                        expected[t][0],  // expected_rule
+                                        expected[t][1]);  // expected_text
+      if (error != UTF8LEX_OK) { return error; }
+      error = test_utf8lex_compact(&(tokens[n]),  // token
+                                   &TEST_PROGRAM,  // program
+                                   &state);  // state
+      if (error != UTF8LEX_OK) { return error; }
+      t ++;
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  if (t != num_expected)
+  {
+    printf("    FAILED - lexed %d tokens, expected %d\n",
+           t, num_expected);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Compiles a program of literal, cat and regex rules, and lexes with it,
+// with and without skipping the space tokens, in batches (full and compact),
+// and in different modes.
+static utf8lex_error_t test_utf8lex_program_lex()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  // LONG is longer than the bytes inlined into an instruction,
+  // so matching it also has to check the rest of the literal.
+  utf8lex_literal_definition_t long_definition;
+  error = utf8lex_literal_definition_init(
+              &long_definition,  // self
+              NULL,  // prev
+              "LONG",  // name
+              "abcdefghijklmnopqrstuvwxyz0123");  // str
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_literal_definition_t short_definition;
+  error = utf8lex_literal_definition_init(
+              &short_definition,  // self
+              (utf8lex_definition_t *) &long_definition,  // prev
+              "SHORT",  // name
+              "abc");  // str
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &short_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_regex_definition_t id_definition;
+  error = utf8lex_regex_definition_init(
+              &id_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "ID",  // name
+              "[a-z0-9]+");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t long_rule;
+  error = utf8lex_rule_init(&long_rule,  // self
+                            NULL,  // prev
+                            "long",  // name
+                            (utf8lex_definition_t *)
+                            &long_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t short_rule;
+  error = utf8lex_rule_init(&short_rule,  // self
+                            &long_rule,  // prev
+                            "short",  // name
+                            (utf8lex_definition_t *)
+                            &short_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &short_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t id_rule;
+  error = utf8lex_rule_init(&id_rule,  // self
+                            &space_rule,  // prev
+                            "id",  // name
+                            (utf8lex_definition_t *)
+                            &id_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Compiling program:");  fflush(stdout);
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &long_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+  if (TEST_PROGRAM.num_instructions != (uint32_t) 4
+      || TEST_PROGRAM.instructions[0].opcode != UTF8LEX_OPCODE_LITERAL
+      || TEST_PROGRAM.instructions[1].opcode != UTF8LEX_OPCODE_LITERAL
+      || TEST_PROGRAM.instructions[2].opcode != UTF8LEX_OPCODE_CAT
+      || TEST_PROGRAM.instructions[3].opcode != UTF8LEX_OPCODE_REGEX)
+  {
+    printf(" FAILED - %u instructions\n",
+           TEST_PROGRAM.num_instructions);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  unsigned char *to_lex =
+    "abc abcdefghijklmnopqrstuvwxyz0123 xyz abcdefghijklmnopqrstuvwxyz0124";
+  unsigned char *expected[][2] =
+    {
+      { "short", "abc" },
+      { "space", " " },
+      { "long", "abcdefghijklmnopqrstuvwxyz0123" },
+      { "space", " " },
+      { "id", "xyz" },
+      { "space", " " },
+      { "short", "abc" },
+      { "id", "defghijklmnopqrstuvwxyz0124" }
+    };
+  error = test_utf8lex_compare(
+              &long_rule,  // first_rule
+              UTF8LEX_MODE_INITIAL,  // mode
+              to_lex,  // to_lex
+              expected,  // expected
+              (int) (sizeof(expected) / sizeof(expected[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Skipping spaces, re-compiling program:");  fflush(stdout);
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &long_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+  if (TEST_PROGRAM.instructions[2].is_skip != true)
+  {
+    printf(" FAILED - space instruction is not skip\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  unsigned char *expected_skip[][2] =
+    {
+      { "short", "abc" },
+      { "long", "abcdefghijklmnopqrstuvwxyz0123" },
+      { "id", "xyz" },
+      { "short", "abc" },
+      { "id", "defghijklmnopqrstuvwxyz0124" }
+    };
+  error = test_utf8lex_compare(
+              &long_rule,  // first_rule
+              UTF8LEX_MODE_INITIAL,  // mode
+              to_lex,  // to_lex
+              expected_skip,  // expected
+              (int) (sizeof(expected_skip) / sizeof(expected_skip[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char *to_lex_lines =
+    "abc abcdefghijklmnopqrstuvwxyz0123 \nxyz\nabc\ndefghijklmnopqrstuvwxyz0124";
+  unsigned char *expected_lines[][2] =
+    {
+      { "short", "abc" },
+      { "long", "abcdefghijklmnopqrstuvwxyz0123" },
+      { "id", "xyz" },
+      { "short", "abc" },
+      { "id", "defghijklmnopqrstuvwxyz0124" }
+    };
+  error = test_utf8lex_batch(
+              to_lex_lines,  // to_lex
+              (uint32_t) 2,  // max_tokens
+              expected_lines,  // expected
+              (int) (sizeof(expected_lines) / sizeof(expected_lines[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Lexing compact tokens:");  fflush(stdout);
+  if (sizeof(utf8lex_compact_token_t) != (size_t) 16)
+  {
+    printf(" FAILED - %d bytes per compact token\n",
+           (int) sizeof(utf8lex_compact_token_t));  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  utf8lex_state_t compact_state;
+  utf8lex_buffer_t compact_buffer;
+  utf8lex_string_t compact_str;
+  error = test_utf8lex_init_state(&compact_state,  // state
+                                  &compact_buffer,  // buffer
+                                  &compact_str,  // str
+                                  to_lex_lines);
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_compact_token_t compact_tokens[8];
+  uint32_t num_compact_tokens = (uint32_t) 0;
+  error = utf8lex_lex_batch_compact(&TEST_PROGRAM,  // program
+                                    &compact_state,  // state
+                                    compact_tokens,  // tokens
+                                    (uint32_t) 8,  // max_tokens
+                                    &num_compact_tokens);  // num_tokens
+  if (error != UTF8LEX_EOF
+      || num_compact_tokens != (uint32_t) 5
+      || compact_tokens[2].start_byte != (uint64_t) 36
+      || compact_tokens[2].length_bytes != (uint32_t) 3
+      || compact_tokens[2].rule_id != id_rule.id)
+  {
+    printf(" FAILED - error %d, %u compact tokens\n",
+           (int) error,
+           num_compact_tokens);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  utf8lex_token_t expanded_token;
+  error = utf8lex_compact_token_expand(&(compact_tokens[4]),  // self
+                                       &TEST_PROGRAM,  // program
+                                       &compact_state,  // state
+                                       &expanded_token);  // token_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (expanded_token.loc[UTF8LEX_UNIT_LINE].start != 3
+      || expanded_token.loc[UTF8LEX_UNIT_CHAR].start != 0
+      || expanded_token.loc[UTF8LEX_UNIT_CHAR].length != 27)
+  {
+    printf(" FAILED - expanded to line %" PRId64 ", char %" PRId64 "\n",
+           expanded_token.loc[UTF8LEX_UNIT_LINE].start,
+           expanded_token.loc[UTF8LEX_UNIT_CHAR].start);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  // No rule was compiled with this id:
+  compact_tokens[4].rule_id = (uint32_t) 99;
+  error = utf8lex_compact_token_expand(&(compact_tokens[4]),  // self
+                                       &TEST_PROGRAM,  // program
+                                       &compact_state,  // state
+                                       &expanded_token);  // token_pointer
+  if (error != UTF8LEX_ERROR_NOT_FOUND)
+  {
+    printf(" FAILED - expanded rule id 99: error %d\n",
+           (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  error = utf8lex_state_clear(&compact_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&compact_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&compact_str);
+  if (error != UTF8LEX_OK) { return error; }
+  printf(" OK\n");  fflush(stdout);
+
+  // Mode 1 is exclusive: only the long rule and the (skipped) space rule.
+  // The long rule is only tried in mode 1.
+  printf("  Compiling program with 2 modes:");  fflush(stdout);
+  error = utf8lex_rule_set_modes(&long_rule,  // self
+                                 (uint32_t) 0x00000002);  // modes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_modes(&short_rule,  // self
+                                 (uint32_t) 0x00000001);  // modes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_modes(&id_rule,  // self
+                                 (uint32_t) 0x00000001);  // modes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_compile_modes(&TEST_PROGRAM,  // self
+                                        &long_rule,  // first_rule
+                                        (uint32_t) 2);  // num_modes
+  if (error != UTF8LEX_OK) { return error; }
+  if (TEST_PROGRAM.num_modes != (uint32_t) 2
+      || TEST_PROGRAM.mode_length[0] != (uint32_t) 3
+      || TEST_PROGRAM.mode_length[1] != (uint32_t) 2
+      || TEST_PROGRAM.rules_by_id[long_rule.id] != &long_rule
+      || TEST_PROGRAM.rules_by_id[id_rule.id] != &id_rule)
+  {
+    printf(" FAILED - %u modes, %u + %u instructions\n",
+           TEST_PROGRAM.num_modes,
+           TEST_PROGRAM.mode_length[0],
+           TEST_PROGRAM.mode_length[1]);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  unsigned char *to_lex_modes = "abcdefghijklmnopqrstuvwxyz0123 abc";
+  unsigned char *expected_initial[][2] =
+    {
+      { "short", "abc" },
+      { "id", "defghijklmnopqrstuvwxyz0123" },
+      { "short", "abc" }
+    };
+  error = test_utf8lex_compare(
+              &long_rule,  // first_rule
+              UTF8LEX_MODE_INITIAL,  // mode
+              to_lex_modes,  // to_lex
+              expected_initial,  // expected
+              (int) (sizeof(expected_initial) / sizeof(expected_initial[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char *to_lex_mode_1 =
+    "abcdefghijklmnopqrstuvwxyz0123 abcdefghijklmnopqrstuvwxyz0123";
+  unsigned char *expected_mode_1[][2] =
+    {
+      { "long", "abcdefghijklmnopqrstuvwxyz0123" },
+      { "long", "abcdefghijklmnopqrstuvwxyz0123" }
+    };
+  error = test_utf8lex_compare(
+              &long_rule,  // first_rule
+              (uint32_t) 1,  // mode
+              to_lex_mode_1,  // to_lex
+              expected_mode_1,  // expected
+              (int) (sizeof(expected_mode_1) / sizeof(expected_mode_1[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Pushing and popping modes:");  fflush(stdout);
+  utf8lex_state_t mode_state;
+  utf8lex_buffer_t mode_buffer;
+  utf8lex_string_t mode_str;
+  error = test_utf8lex_init_state(&mode_state,  // state
+                                  &mode_buffer,  // buffer
+                                  &mode_str,  // str
+                                  to_lex_modes);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_push_mode(&mode_state,  // self
+                                  (uint32_t) 1);  // mode
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_token_t mode_token;
+  error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                              &mode_state,  // state
+                              &mode_token);  // token
+  if (error != UTF8LEX_OK) { return error; }
+  error = test_utf8lex_expect_token(&mode_token,  // token
+                                    "long",  // expected_rule
+                                    "abcdefghijklmnopqrstuvwxyz0123");
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_pop_mode(&mode_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                              &mode_state,  // state
+                              &mode_token);  // token
+  if (error != UTF8LEX_OK) { return error; }
+  error = test_utf8lex_expect_token(&mode_token,  // token
+                                    "short",  // expected_rule
+                                    "abc");  // expected_text
+  if (error != UTF8LEX_OK) { return error; }
+  if (utf8lex_state_pop_mode(&mode_state) != UTF8LEX_ERROR_STATE)
+  {
+    printf(" FAILED - popped a mode that was never pushed\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  error = utf8lex_state_set_mode(&mode_state,  // self
+                                 (uint32_t) 2);  // mode
+  if (error != UTF8LEX_OK) { return error; }
+  if (utf8lex_program_lex(&TEST_PROGRAM,  // program
+                          &mode_state,  // state
+                          &mode_token)  // token
+      != UTF8LEX_ERROR_BAD_MODE)
+  {
+    printf(" FAILED - lexed in a mode that was never compiled\n");
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  error = utf8lex_state_clear(&mode_state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&mode_buffer);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&mode_str);
+  if (error != UTF8LEX_OK) { return error; }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Tearing down rules (and their definitions):\n");  fflush(stdout);
+  error = utf8lex_rule_clear(&id_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&short_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&long_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_program...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_program_lex();
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_program.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_program: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
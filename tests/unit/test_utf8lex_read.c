@@ -17,7 +17,7 @@
  */
 
 #include <stdio.h>
-#include <inttypes.h>  // For int32_t.
+#include <inttypes.h>  // For int32_t, uint64_t, PRIu64.
 #include <string.h>  // For strcpy()
 
 #include "utf8lex.h"
@@ -110,16 +110,16 @@ static utf8lex_error_t test_setup_loc(
         utf8lex_location_t loc_pointer[UTF8LEX_UNIT_MAX], // Mutable
         int byte_length, // # of bytes of a token.
         int byte_after,  // Either -1, or reset the start, if >= 0.
-        unsigned long byte_hash,  // The sum of bytes.
+        uint64_t byte_hash,  // The sum of bytes.
         int char_length, // # of chars of a token.
         int char_after,  // Either -1, or reset the start, if >= 0.
-        unsigned long char_hash,  // The sum of chars.
+        uint64_t char_hash,  // The sum of chars.
         int grapheme_length, // # of graphemes of a token.
         int grapheme_after,  // Either -1, or reset the start, if >= 0.
-        unsigned long grapheme_hash,  // The sum of graphemes.
+        uint64_t grapheme_hash,  // The sum of graphemes.
         int line_length, // # of lines of a token.
         int line_after,  // Either -1, or reset the start, if >= 0.
-        unsigned long line_hash  // The sum of lines.
+        uint64_t line_hash  // The sum of lines.
         )
 {
   loc_pointer[UTF8LEX_UNIT_BYTE].length = byte_length;
@@ -138,6 +138,17 @@ static utf8lex_error_t test_setup_loc(
   loc_pointer[UTF8LEX_UNIT_LINE].after = line_after;
   loc_pointer[UTF8LEX_UNIT_LINE].hash = line_hash;
 
+  // UTF-16 and display width are not counted by default.
+  for (utf8lex_unit_t unit = UTF8LEX_UNIT_UTF16;
+       unit < UTF8LEX_UNIT_MAX;
+       unit ++)
+  {
+    loc_pointer[unit].start = 0;
+    loc_pointer[unit].length = 0;
+    loc_pointer[unit].after = -1;
+    loc_pointer[unit].hash = (uint64_t) 0;
+  }
+
   return UTF8LEX_OK;
 }
 
@@ -146,7 +157,9 @@ static char * unit_strings[UTF8LEX_UNIT_MAX] = {
   "byte",
   "char",
   "grapheme",
-  "line"
+  "line",
+  "utf16",
+  "width"
 };
 
 
@@ -177,7 +190,7 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
     loc[unit].start = 0;
     loc[unit].length = 0;
     loc[unit].after = 0;
-    loc[unit].hash = (unsigned long) 0;
+    loc[unit].hash = (uint64_t) 0;
   }
   printf("  Reading graphemes from '%s', and checking\n", to_read);
   printf("  (start, length, after, hash) (byte, char, grapheme, line):\n");
@@ -194,19 +207,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 72,  // byte
-                         1, -1, (unsigned long) 72,  // char
-                         1, -1, (unsigned long) 72,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 72,  // byte
+                         1, -1, (uint64_t) 72,  // char
+                         1, -1, (uint64_t) 72,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -231,28 +244,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -285,19 +298,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 101,  // byte
-                         1, -1, (unsigned long) 101,  // char
-                         1, -1, (unsigned long) 101,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 101,  // byte
+                         1, -1, (uint64_t) 101,  // char
+                         1, -1, (uint64_t) 101,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -322,28 +335,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -376,19 +389,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 108,  // byte
-                         1, -1, (unsigned long) 108,  // char
-                         1, -1, (unsigned long) 108,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 108,  // byte
+                         1, -1, (uint64_t) 108,  // char
+                         1, -1, (uint64_t) 108,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -413,28 +426,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -467,19 +480,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 108,  // byte
-                         1, -1, (unsigned long) 108,  // char
-                         1, -1, (unsigned long) 108,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 108,  // byte
+                         1, -1, (uint64_t) 108,  // char
+                         1, -1, (uint64_t) 108,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -504,28 +517,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -558,19 +571,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 111,  // byte
-                         1, -1, (unsigned long) 111,  // char
-                         1, -1, (unsigned long) 111,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 111,  // byte
+                         1, -1, (uint64_t) 111,  // char
+                         1, -1, (uint64_t) 111,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -595,28 +608,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -649,19 +662,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 44,  // byte
-                         1, -1, (unsigned long) 44,  // char
-                         1, -1, (unsigned long) 44,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 44,  // byte
+                         1, -1, (uint64_t) 44,  // char
+                         1, -1, (uint64_t) 44,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -686,28 +699,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -740,19 +753,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 32,  // byte
-                         1, -1, (unsigned long) 32,  // char
-                         1, -1, (unsigned long) 32,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 32,  // byte
+                         1, -1, (uint64_t) 32,  // char
+                         1, -1, (uint64_t) 32,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -777,28 +790,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -831,19 +844,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 119,  // byte
-                         1, -1, (unsigned long) 119,  // char
-                         1, -1, (unsigned long) 119,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 119,  // byte
+                         1, -1, (uint64_t) 119,  // char
+                         1, -1, (uint64_t) 119,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -868,28 +881,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -922,19 +935,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 111,  // byte
-                         1, -1, (unsigned long) 111,  // char
-                         1, -1, (unsigned long) 111,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 111,  // byte
+                         1, -1, (uint64_t) 111,  // char
+                         1, -1, (uint64_t) 111,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -959,28 +972,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1013,19 +1026,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 114,  // byte
-                         1, -1, (unsigned long) 114,  // char
-                         1, -1, (unsigned long) 114,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 114,  // byte
+                         1, -1, (uint64_t) 114,  // char
+                         1, -1, (uint64_t) 114,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1050,28 +1063,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1104,19 +1117,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 108,  // byte
-                         1, -1, (unsigned long) 108,  // char
-                         1, -1, (unsigned long) 108,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 108,  // byte
+                         1, -1, (uint64_t) 108,  // char
+                         1, -1, (uint64_t) 108,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1141,28 +1154,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1195,19 +1208,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 100,  // byte
-                         1, -1, (unsigned long) 100,  // char
-                         1, -1, (unsigned long) 100,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 100,  // byte
+                         1, -1, (uint64_t) 100,  // char
+                         1, -1, (uint64_t) 100,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1232,28 +1245,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1286,19 +1299,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 10,  // byte
-                         1, 0, (unsigned long) 10,  // char
-                         1, 0, (unsigned long) 10,  // grapheme
-                         1, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 10,  // byte
+                         1, 0, (uint64_t) 10,  // char
+                         1, 0, (uint64_t) 10,  // grapheme
+                         1, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1323,28 +1336,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1377,19 +1390,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 71,  // byte
-                         1, -1, (unsigned long) 71,  // char
-                         1, -1, (unsigned long) 71,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 71,  // byte
+                         1, -1, (uint64_t) 71,  // char
+                         1, -1, (uint64_t) 71,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1414,28 +1427,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1468,19 +1481,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 111,  // byte
-                         1, -1, (unsigned long) 111,  // char
-                         1, -1, (unsigned long) 111,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 111,  // byte
+                         1, -1, (uint64_t) 111,  // char
+                         1, -1, (uint64_t) 111,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1505,28 +1518,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1559,19 +1572,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 111,  // byte
-                         1, -1, (unsigned long) 111,  // char
-                         1, -1, (unsigned long) 111,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 111,  // byte
+                         1, -1, (uint64_t) 111,  // char
+                         1, -1, (uint64_t) 111,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1596,28 +1609,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1650,19 +1663,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 100,  // byte
-                         1, -1, (unsigned long) 100,  // char
-                         1, -1, (unsigned long) 100,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 100,  // byte
+                         1, -1, (uint64_t) 100,  // char
+                         1, -1, (uint64_t) 100,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1687,28 +1700,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1741,19 +1754,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 98,  // byte
-                         1, -1, (unsigned long) 98,  // char
-                         1, -1, (unsigned long) 98,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 98,  // byte
+                         1, -1, (uint64_t) 98,  // char
+                         1, -1, (uint64_t) 98,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1778,28 +1791,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1832,19 +1845,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 121,  // byte
-                         1, -1, (unsigned long) 121,  // char
-                         1, -1, (unsigned long) 121,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 121,  // byte
+                         1, -1, (uint64_t) 121,  // char
+                         1, -1, (uint64_t) 121,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1869,28 +1882,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -1923,19 +1936,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 101,  // byte
-                         1, -1, (unsigned long) 101,  // char
-                         1, -1, (unsigned long) 101,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 101,  // byte
+                         1, -1, (uint64_t) 101,  // char
+                         1, -1, (uint64_t) 101,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -1960,28 +1973,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2014,19 +2027,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         2, -1, (unsigned long) 3338,  // byte
-                         2, 0, (unsigned long) 3338,  // char
-                         1, 0, (unsigned long) 3338,  // grapheme
-                         1, -1, (unsigned long) 0);  // line
+                         2, -1, (uint64_t) 0xD0000001621,  // byte
+                         2, 0, (uint64_t) 0xD0000001621,  // char
+                         1, 0, (uint64_t) 0xD0000001621,  // grapheme
+                         1, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2051,28 +2064,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2105,19 +2118,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 101,  // byte
-                         1, -1, (unsigned long) 101,  // char
-                         1, -1, (unsigned long) 101,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 101,  // byte
+                         1, -1, (uint64_t) 101,  // char
+                         1, -1, (uint64_t) 101,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2142,28 +2155,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2196,19 +2209,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 110,  // byte
-                         1, -1, (unsigned long) 110,  // char
-                         1, -1, (unsigned long) 110,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 110,  // byte
+                         1, -1, (uint64_t) 110,  // char
+                         1, -1, (uint64_t) 110,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2233,28 +2246,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2287,19 +2300,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         1, -1, (unsigned long) 100,  // byte
-                         1, -1, (unsigned long) 100,  // char
-                         1, -1, (unsigned long) 100,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         1, -1, (uint64_t) 100,  // byte
+                         1, -1, (uint64_t) 100,  // char
+                         1, -1, (uint64_t) 100,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2324,28 +2337,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_ascii()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2406,7 +2419,7 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
     loc[unit].start = 0;
     loc[unit].length = 0;
     loc[unit].after = 0;
-    loc[unit].hash = (unsigned long) 0;
+    loc[unit].hash = (uint64_t) 0;
   }
   printf("  Reading graphemes from '%s', and checking\n", to_read);
   printf("  (start, length, after, hash) (byte, char, grapheme, line):\n");
@@ -2423,19 +2436,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         2, -1, (unsigned long) 49854,  // byte
-                         1, -1, (unsigned long) 49854,  // char
-                         1, -1, (unsigned long) 49854,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         2, -1, (uint64_t) 0xC20000014A64,  // byte
+                         1, -1, (uint64_t) 0xC20000014A64,  // char
+                         1, -1, (uint64_t) 0xC20000014A64,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2460,28 +2473,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2514,19 +2527,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         2, -1, (unsigned long) 49826,  // byte
-                         1, -1, (unsigned long) 49826,  // char
-                         1, -1, (unsigned long) 49826,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         2, -1, (uint64_t) 0xC20000014A48,  // byte
+                         1, -1, (uint64_t) 0xC20000014A48,  // char
+                         1, -1, (uint64_t) 0xC20000014A48,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2551,28 +2564,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2605,19 +2618,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         2, -1, (unsigned long) 50103,  // byte
-                         1, -1, (unsigned long) 50103,  // char
-                         1, -1, (unsigned long) 50103,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         2, -1, (uint64_t) 0xC30000014C10,  // byte
+                         1, -1, (uint64_t) 0xC30000014C10,  // char
+                         1, -1, (uint64_t) 0xC30000014C10,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2642,28 +2655,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2696,19 +2709,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         2, -1, (unsigned long) 50054,  // byte
-                         1, -1, (unsigned long) 50054,  // char
-                         1, -1, (unsigned long) 50054,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         2, -1, (uint64_t) 0xC30000014BDF,  // byte
+                         1, -1, (uint64_t) 0xC30000014BDF,  // char
+                         1, -1, (uint64_t) 0xC30000014BDF,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2733,28 +2746,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2798,7 +2811,7 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
     loc[unit].start = 0;
     loc[unit].length = 0;
     loc[unit].after = 0;
-    loc[unit].hash = (unsigned long) 0;
+    loc[unit].hash = (uint64_t) 0;
   }
   printf("  Reading graphemes from '%s', and checking\n", to_read);
   printf("  (start, length, after, hash) (byte, char, grapheme, line):\n");
@@ -2816,19 +2829,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         3, -1, (unsigned long) 14721664,  // byte
-                         1, -1, (unsigned long) 14721664,  // char
-                         1, -1, (unsigned long) 14721664,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         3, -1, (uint64_t) 0x2F9E2000287D7A6,  // byte
+                         1, -1, (uint64_t) 0x2F9E2000287D7A6,  // char
+                         1, -1, (uint64_t) 0x2F9E2000287D7A6,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2853,28 +2866,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -2907,19 +2920,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         4, -1, (unsigned long) 4036002952,  // byte
-                         1, -1, (unsigned long) 4036002952,  // char
-                         1, -1, (unsigned long) 4036002952,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         4, -1, (uint64_t) 0x20CD34049B1F6834,  // byte
+                         1, -1, (uint64_t) 0x20CD34049B1F6834,  // char
+                         1, -1, (uint64_t) 0x20CD34049B1F6834,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -2944,28 +2957,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -3007,19 +3020,19 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   expected_loc[UTF8LEX_UNIT_LINE].start = loc[UTF8LEX_UNIT_LINE].start;
   offset = (off_t) loc[UTF8LEX_UNIT_BYTE].start;
   error = test_setup_loc(loc,
-                         0, -1, (unsigned long) 0,  // byte
-                         0, -1, (unsigned long) 0,  // char
-                         0, -1, (unsigned long) 0,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         0, -1, (uint64_t) 0,  // byte
+                         0, -1, (uint64_t) 0,  // char
+                         0, -1, (uint64_t) 0,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
   error = test_setup_loc(expected_loc,
-                         6, -1, (unsigned long) 237034257503933,  // byte
-                         3, -1, (unsigned long) 237034257503933,  // char
-                         1, -1, (unsigned long) 237034257503933,  // grapheme
-                         0, -1, (unsigned long) 0);  // line
+                         6, -1, (uint64_t) 0x63E7CF8530C40E99,  // byte
+                         3, -1, (uint64_t) 0x63E7CF8530C40E99,  // char
+                         1, -1, (uint64_t) 0x63E7CF8530C40E99,  // grapheme
+                         0, -1, (uint64_t) 0);  // line
   if (error != UTF8LEX_OK) { return error; }
 
-  printf("    Reading grapheme # %d '%s':\n",
+  printf("    Reading grapheme # %" PRId64 " '%s':\n",
          loc[UTF8LEX_UNIT_GRAPHEME].start, grapheme, to_read);
   fflush(stdout);
   error == test_utf8lex_init_state(&state,  // state
@@ -3044,28 +3057,28 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
   {
     if (loc[unit].start != expected_loc[unit].start)
     {
-      printf("      ERROR Incorrect %s.start: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.start: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].start, loc[unit].start);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_START; }
     }
     if (loc[unit].length != expected_loc[unit].length)
     {
-      printf("      ERROR Incorrect %s.length: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.length: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].length, loc[unit].length);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_LENGTH; }
     }
     if (loc[unit].after != expected_loc[unit].after)
     {
-      printf("      ERROR Incorrect %s.after: expected %d but found: %d\n",
+      printf("      ERROR Incorrect %s.after: expected %" PRId64 " but found: %" PRId64 "\n",
              unit_strings[unit], expected_loc[unit].after, loc[unit].after);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_AFTER; }
     }
     if (loc[unit].hash != expected_loc[unit].hash)
     {
-      printf("      ERROR Incorrect %s.hash: expected %lu but found: %lu\n",
+      printf("      ERROR Incorrect %s.hash: expected %" PRIu64 " but found: %" PRIu64 "\n",
              unit_strings[unit], expected_loc[unit].hash, loc[unit].hash);
       fflush(stdout);
       if (error == UTF8LEX_OK) { error = UTF8LEX_ERROR_BAD_HASH; }
@@ -3099,6 +3112,406 @@ static utf8lex_error_t test_utf8lex_read_grapheme_unicode()
 }
 
 
+static utf8lex_error_t test_utf8lex_read_grapheme_units()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  unsigned char *to_read;
+
+  off_t offset;
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];
+  int32_t codepoint;
+  utf8lex_cat_t cat;
+
+  // 'a', U+1F600 (emoji, surrogate pair), U+6F22 (wide CJK),
+  // 'e' + U+0301 (combining acute accent), "\r\n", 'b':
+  to_read = "a\xF0\x9F\x98\x80\xE6\xBC\xA2" "e\xCC\x81\r\nb";
+
+  // Expected (utf16 length, utf16 after, width length, width after)
+  // for each grapheme:
+  int expected[6][4] = {
+    { 1, -1, 1, -1 },  // a
+    { 2, -1, 2, -1 },  // U+1F600
+    { 1, -1, 2, -1 },  // U+6F22
+    { 2, -1, 1, -1 },  // e + U+0301
+    { 2, 0, 0, 0 },  // \r\n
+    { 1, -1, 1, -1 }  // b
+  };
+
+  printf("  Reading graphemes from '%s', and checking\n", to_read);
+  printf("  (length, after) (utf16, width):\n");
+  fflush(stdout);
+
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_read);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_set_units(
+      &state,  // self
+      UTF8LEX_UNITS_DEFAULT
+      | (1 << UTF8LEX_UNIT_UTF16)
+      | (1 << UTF8LEX_UNIT_WIDTH));  // units
+  if (error != UTF8LEX_OK) { return error; }
+
+  offset = (off_t) 0;
+  for (int g = 0; g < 6; g ++)
+  {
+    for (utf8lex_unit_t unit = UTF8LEX_UNIT_NONE + (utf8lex_unit_t) 1;
+         unit < UTF8LEX_UNIT_MAX;
+         unit ++)
+    {
+      loc[unit].start = 0;
+      loc[unit].length = 0;
+      loc[unit].after = -1;
+      loc[unit].hash = (uint64_t) 0;
+    }
+
+    error = utf8lex_read_grapheme(
+                                  &state,  // state
+                                  &offset,  // offset_pointer, mutable
+                                  loc,  // loc_pointer, mutable
+                                  &codepoint,  // codepoint_pointer, mutable
+                                  &cat);  // cat_pointer, mutable
+    if (error != UTF8LEX_OK) { return error; }
+
+    printf("    Grapheme # %d: utf16 %" PRId64 "/%" PRId64
+           ", width %" PRId64 "/%" PRId64 "\n",
+           g,
+           loc[UTF8LEX_UNIT_UTF16].length,
+           loc[UTF8LEX_UNIT_UTF16].after,
+           loc[UTF8LEX_UNIT_WIDTH].length,
+           loc[UTF8LEX_UNIT_WIDTH].after);
+    fflush(stdout);
+
+    if (loc[UTF8LEX_UNIT_UTF16].length != (int64_t) expected[g][0]
+        || loc[UTF8LEX_UNIT_UTF16].after != (int64_t) expected[g][1]
+        || loc[UTF8LEX_UNIT_WIDTH].length != (int64_t) expected[g][2]
+        || loc[UTF8LEX_UNIT_WIDTH].after != (int64_t) expected[g][3])
+    {
+      fprintf(stderr,
+              "ERROR Grapheme # %d: expected utf16 %d/%d, width %d/%d\n",
+              g,
+              expected[g][0],
+              expected[g][1],
+              expected[g][2],
+              expected[g][3]);
+      return UTF8LEX_ERROR_UNIT;
+    }
+  }
+
+  error = test_utf8lex_clear_state(&state);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Units outside UTF8LEX_UNITS_ALL, or missing the defaults, are rejected:
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_read);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_units(&state,  // self
+                                  (uint32_t) (1 << UTF8LEX_UNIT_UTF16));
+  if (error != UTF8LEX_ERROR_UNIT) { return UTF8LEX_ERROR_STATE; }
+  error = utf8lex_state_set_units(&state,  // self
+                                  UTF8LEX_UNITS_ALL + (uint32_t) 1);
+  if (error != UTF8LEX_ERROR_UNIT) { return UTF8LEX_ERROR_STATE; }
+
+  error = test_utf8lex_clear_state(&state);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  SUCCESS reading UTF-16 and width units.\n");
+  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_read_grapheme_codepoints()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_state_t state;
+  utf8lex_buffer_t buffer;
+  utf8lex_string_t str;
+  unsigned char *to_read;
+
+  off_t offset;
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];
+  int32_t codepoint;
+  utf8lex_cat_t cat;
+
+  // 'e' + U+0301 (combining acute accent), "\r\n", 'x':
+  to_read = "e\xCC\x81\r\nx";
+
+  // Expected (bytes, chars, graphemes, lines, first codepoint)
+  // for each codepoint (CR LF is still read as one line separator):
+  int expected[4][5] = {
+    { 1, 1, 1, 0, 0x0065 },  // e
+    { 2, 1, 1, 0, 0x0301 },  // U+0301
+    { 2, 2, 1, 1, 0x000D },  // \r\n
+    { 1, 1, 1, 0, 0x0078 }  // x
+  };
+
+  printf("  Reading codepoints from '%s', and checking\n", to_read);
+  printf("  (length) (byte, char, grapheme, line):\n");
+  fflush(stdout);
+
+  error = test_utf8lex_init_state(&state,  // state
+                                  &buffer,  // buffer
+                                  &str,  // str
+                                  to_read);
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_state_set_granularity(
+      &state,  // self
+      UTF8LEX_GRANULARITY_CODEPOINT);  // granularity
+  if (error != UTF8LEX_OK) { return error; }
+
+  offset = (off_t) 0;
+  for (int c = 0; c < 4; c ++)
+  {
+    error = utf8lex_read_grapheme(
+                                  &state,  // state
+                                  &offset,  // offset_pointer, mutable
+                                  loc,  // loc_pointer, mutable
+                                  &codepoint,  // codepoint_pointer, mutable
+                                  &cat);  // cat_pointer, mutable
+    if (error != UTF8LEX_OK) { return error; }
+
+    printf("    Codepoint # %d U+%04X: %" PRId64 ", %" PRId64
+           ", %" PRId64 ", %" PRId64 "\n",
+           c,
+           (unsigned int) codepoint,
+           loc[UTF8LEX_UNIT_BYTE].length,
+           loc[UTF8LEX_UNIT_CHAR].length,
+           loc[UTF8LEX_UNIT_GRAPHEME].length,
+           loc[UTF8LEX_UNIT_LINE].length);
+    fflush(stdout);
+
+    if (loc[UTF8LEX_UNIT_BYTE].length != (int64_t) expected[c][0]
+        || loc[UTF8LEX_UNIT_CHAR].length != (int64_t) expected[c][1]
+        || loc[UTF8LEX_UNIT_GRAPHEME].length != (int64_t) expected[c][2]
+        || loc[UTF8LEX_UNIT_LINE].length != (int64_t) expected[c][3]
+        || codepoint != (int32_t) expected[c][4])
+    {
+      fprintf(stderr,
+              "ERROR Codepoint # %d: expected U+%04X %d, %d, %d, %d\n",
+              c,
+              (unsigned int) expected[c][4],
+              expected[c][0],
+              expected[c][1],
+              expected[c][2],
+              expected[c][3]);
+      return UTF8LEX_ERROR_STATE;
+    }
+  }
+
+  error = test_utf8lex_clear_state(&state);
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Literals are counted by grapheme up front, and again by codepoint
+  // only if they have graphemes of 2 or more codepoints:
+  utf8lex_literal_definition_t literal;
+  error = utf8lex_literal_definition_init(&literal,  // self
+                                          NULL,  // prev
+                                          "E_ACUTE",  // name
+                                          "e\xCC\x81");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_location_t scratch[UTF8LEX_UNIT_MAX];
+  utf8lex_location_t *grapheme_loc = NULL;
+  error = utf8lex_literal_locations(&literal,  // self
+                                    UTF8LEX_GRANULARITY_GRAPHEME,
+                                    scratch,  // scratch
+                                    &grapheme_loc);  // loc_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_location_t *codepoint_loc = NULL;
+  error = utf8lex_literal_locations(&literal,  // self
+                                    UTF8LEX_GRANULARITY_CODEPOINT,
+                                    scratch,  // scratch
+                                    &codepoint_loc);  // loc_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (grapheme_loc != literal.loc
+      || grapheme_loc[UTF8LEX_UNIT_GRAPHEME].length != (int64_t) 1
+      || codepoint_loc != scratch
+      || codepoint_loc[UTF8LEX_UNIT_GRAPHEME].length != (int64_t) 2
+      || codepoint_loc[UTF8LEX_UNIT_CHAR].length != (int64_t) 2)
+  {
+    fprintf(stderr,
+            "ERROR Literal E_ACUTE: %" PRId64 " graphemes"
+            " but %" PRId64 " codepoint graphemes\n",
+            grapheme_loc[UTF8LEX_UNIT_GRAPHEME].length,
+            codepoint_loc[UTF8LEX_UNIT_GRAPHEME].length);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  utf8lex_literal_definition_t ascii_literal;
+  error = utf8lex_literal_definition_init(&ascii_literal,  // self
+                                          NULL,  // prev
+                                          "EQUALS",  // name
+                                          "==");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_literal_locations(&ascii_literal,  // self
+                                    UTF8LEX_GRANULARITY_CODEPOINT,
+                                    scratch,  // scratch
+                                    &codepoint_loc);  // loc_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  if (codepoint_loc != ascii_literal.loc)
+  {
+    fprintf(stderr,
+            "ERROR Literal EQUALS: counted again by codepoint\n");
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  printf("  SUCCESS reading codepoints.\n");
+  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
+static utf8lex_error_t test_utf8lex_read_grapheme_cache()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  // "a\r" + "\nb": the CR, LF grapheme straddles the 2 buffers.
+  unsigned char bytes1[2] = { 'a', '\r' };
+  unsigned char bytes2[2] = { '\n', 'b' };
+  utf8lex_string_t str1;
+  utf8lex_string_t str2;
+  utf8lex_buffer_t buffer1;
+  utf8lex_buffer_t buffer2;
+  error = utf8lex_string_init(&str1,  // self
+                              (size_t) 2,  // max_length_bytes
+                              (size_t) 2,  // length_bytes
+                              bytes1);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_init(&str2,  // self
+                              (size_t) 2,  // max_length_bytes
+                              (size_t) 2,  // length_bytes
+                              bytes2);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_init(&buffer1,  // self
+                              NULL,  // prev
+                              &str1,  // str
+                              false);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_init(&buffer2,  // self
+                              &buffer1,  // prev
+                              &str2,  // str
+                              true);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &buffer1);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_grapheme_cache_t grapheme_cache;
+  error = utf8lex_grapheme_cache_init(&grapheme_cache);
+  if (error != UTF8LEX_OK) { return error; }
+  state.grapheme_cache = &grapheme_cache;
+
+  printf("  Reading graphemes twice through a grapheme cache:\n");
+  fflush(stdout);
+
+  off_t offset;
+  utf8lex_location_t loc[UTF8LEX_UNIT_MAX];
+  int32_t codepoint;
+  utf8lex_cat_t cat;
+  for (int pass = 0; pass < 3; pass ++)
+  {
+    if (pass == 1)
+    {
+      // Only the cache knows what used to be here now:
+      bytes1[0] = 'x';
+      bytes1[1] = 'x';
+    }
+    else if (pass == 2)
+    {
+      error = utf8lex_grapheme_cache_clear(&grapheme_cache);
+      if (error != UTF8LEX_OK) { return error; }
+      error = utf8lex_grapheme_cache_init(&grapheme_cache);
+      if (error != UTF8LEX_OK) { return error; }
+    }
+
+    state.buffer = &buffer1;
+    offset = (off_t) 0;
+    error = utf8lex_read_grapheme(&state,  // state
+                                  &offset,  // offset_pointer, mutable
+                                  loc,  // loc_pointer, mutable
+                                  &codepoint,  // codepoint_pointer, mutable
+                                  &cat);  // cat_pointer, mutable
+    if (error != UTF8LEX_OK) { return error; }
+    int32_t expected_codepoint = (pass == 2) ? (int32_t) 'x' : (int32_t) 'a';
+    if (codepoint != expected_codepoint
+        || offset != (off_t) 1
+        || state.buffer != &buffer1)
+    {
+      fprintf(stderr,
+              "ERROR Pass # %d: expected U+%04X at 0 but read U+%04X\n",
+              pass,
+              (unsigned int) expected_codepoint,
+              (unsigned int) codepoint);
+      return UTF8LEX_ERROR_STATE;
+    }
+
+    error = utf8lex_read_grapheme(&state,  // state
+                                  &offset,  // offset_pointer, mutable
+                                  loc,  // loc_pointer, mutable
+                                  &codepoint,  // codepoint_pointer, mutable
+                                  &cat);  // cat_pointer, mutable
+    if (error != UTF8LEX_OK) { return error; }
+    int64_t expected_lines = (pass == 2) ? (int64_t) 0 : (int64_t) 1;
+    expected_codepoint = (pass == 2) ? (int32_t) 'x' : (int32_t) 0x000D;
+    off_t expected_offset = (pass == 2) ? (off_t) 2 : (off_t) 3;
+    utf8lex_buffer_t *expected_buffer = &buffer2;  // Read up to "\n" either way.
+    if (codepoint != expected_codepoint
+        || offset != expected_offset
+        || state.buffer != expected_buffer
+        || loc[UTF8LEX_UNIT_LINE].length != expected_lines)
+    {
+      fprintf(stderr,
+              "ERROR Pass # %d: expected U+%04X ending at %d"
+              " but read U+%04X ending at %d\n",
+              pass,
+              (unsigned int) expected_codepoint,
+              (int) expected_offset,
+              (unsigned int) codepoint,
+              (int) offset);
+      return UTF8LEX_ERROR_STATE;
+    }
+
+    printf("    Pass # %d: U+%04X, %" PRId64 " bytes, %" PRId64 " lines\n",
+           pass,
+           (unsigned int) codepoint,
+           loc[UTF8LEX_UNIT_BYTE].length,
+           loc[UTF8LEX_UNIT_LINE].length);
+    fflush(stdout);
+  }
+
+  error = utf8lex_grapheme_cache_clear(&grapheme_cache);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer2);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_buffer_clear(&buffer1);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str2);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_string_clear(&str1);
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  SUCCESS reading graphemes through a cache.\n");
+  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
 int main(
         int argc,
         char *argv[]
@@ -3115,6 +3528,24 @@ int main(
     error = test_utf8lex_read_grapheme_unicode();
   } // else if (error != UTF8LEX_OK) then fall through, below.
 
+  // Test counting the optional UTF-16 code unit and display width units:
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_read_grapheme_units();
+  } // else if (error != UTF8LEX_OK) then fall through, below.
+
+  // Test reading one codepoint at a time, without grapheme segmentation:
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_read_grapheme_codepoints();
+  } // else if (error != UTF8LEX_OK) then fall through, below.
+
+  // Test reading graphemes that were already decoded out of a cache:
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_read_grapheme_cache();
+  } // else if (error != UTF8LEX_OK) then fall through, below.
+
   if (error == UTF8LEX_OK)
   {
     printf("SUCCESS Testing utf8lex_read.\n");  fflush(stdout);
@@ -0,0 +1,615 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int64_t, uint32_t, PRId64.
+#include <string.h>  // For memcmp(), memcpy(), memset(), strcpy()
+#include <unistd.h>  // For close(), pipe(), sysconf(), write()
+
+#include <zlib.h>  // For deflate()
+
+#include "utf8lex.h"
+
+
+// Several times the reader's memory, but small enough to fit
+// in the pipe, so the whole input can be written up front:
+#define TEST_UTF8LEX_NUM_WORDS 3000
+#define TEST_UTF8LEX_INPUT_MAX 32768
+#define TEST_UTF8LEX_NUM_BUFFERS 3
+// Fewer, longer "w123\xc3\xa9 := " matches:
+#define TEST_UTF8LEX_NUM_MATCHES 2000
+
+
+// Compresses the input into 2 gzip members, back to back (as with
+// "cat a.gz b.gz"), so that the reader has to inflate across members,
+// as well as across inflate blocks and buffers.
+static utf8lex_error_t test_utf8lex_reader_compress(
+        unsigned char *input,
+        size_t input_length_bytes,
+        unsigned char *compressed,
+        size_t max_compressed_bytes,
+        size_t *compressed_length_pointer
+        )
+{
+  size_t compressed_length_bytes = (size_t) 0;
+  size_t half = input_length_bytes / (size_t) 2;
+  for (int member = 0; member < 2; member ++)
+  {
+    z_stream deflater;
+    deflater.zalloc = Z_NULL;
+    deflater.zfree = Z_NULL;
+    deflater.opaque = Z_NULL;
+    // 15 bits of window, + 16 for a gzip header:
+    if (deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      return UTF8LEX_ERROR_STATE;
+    }
+    deflater.next_in = (Bytef *) &(input[(member == 0) ? 0 : half]);
+    deflater.avail_in = (uInt) ((member == 0)
+                                ? half
+                                : (input_length_bytes - half));
+    deflater.next_out = (Bytef *) &(compressed[compressed_length_bytes]);
+    deflater.avail_out = (uInt) (max_compressed_bytes
+                                 - compressed_length_bytes);
+    int z_error = deflate(&deflater, Z_FINISH);
+    compressed_length_bytes = max_compressed_bytes
+      - (size_t) deflater.avail_out;
+    deflateEnd(&deflater);
+    if (z_error != Z_STREAM_END)
+    {
+      return UTF8LEX_ERROR_STATE;
+    }
+  }
+
+  *compressed_length_pointer = compressed_length_bytes;
+  return UTF8LEX_OK;
+}
+
+// Lexes words read ahead into 3 one page buffers, fed by a pipe
+// (gzip compressed, or not).
+static utf8lex_error_t test_utf8lex_reader_pipe(
+        bool is_gzip
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Words such as "w123\xc3\xa9" (w123é), separated by spaces:
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  size_t input_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_NUM_WORDS; w ++)
+  {
+    input_length_bytes += (size_t) snprintf(
+        &(input[input_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - input_length_bytes,
+        "w%d\xc3\xa9 ",
+        w);
+  }
+
+  unsigned char *to_write = input;
+  size_t write_length_bytes = input_length_bytes;
+  static unsigned char compressed[TEST_UTF8LEX_INPUT_MAX];
+  if (is_gzip == true)
+  {
+    error = test_utf8lex_reader_compress(
+        input,  // input
+        input_length_bytes,  // input_length_bytes
+        compressed,  // compressed
+        (size_t) TEST_UTF8LEX_INPUT_MAX,  // max_compressed_bytes
+        &write_length_bytes);  // compressed_length_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    to_write = compressed;
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(pipe_fds[1], to_write, write_length_bytes)
+      != (ssize_t) write_length_bytes)
+  {
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+  close(pipe_fds[1]);
+
+  size_t buffer_size = (size_t) sysconf(_SC_PAGESIZE);
+  printf("  Reading ahead %d bytes (%d %s) into %d buffers of %d bytes:",
+         (int) input_length_bytes,
+         (int) write_length_bytes,
+         (is_gzip == true) ? "gzip" : "uncompressed",
+         TEST_UTF8LEX_NUM_BUFFERS,
+         (int) buffer_size);  fflush(stdout);
+
+  utf8lex_reader_t reader;
+  if (is_gzip == true)
+  {
+    error = utf8lex_reader_init_gzip(&reader,  // self
+                                     pipe_fds[0],  // fd
+                                     buffer_size,  // buffer_size
+                                     (uint32_t) TEST_UTF8LEX_NUM_BUFFERS);
+  }
+  else
+  {
+    error = utf8lex_reader_init(&reader,  // self
+                                pipe_fds[0],  // fd
+                                buffer_size,  // buffer_size
+                                (uint32_t) TEST_UTF8LEX_NUM_BUFFERS);
+  }
+  if (error != UTF8LEX_OK) { close(pipe_fds[0]); return error; }
+
+  error = utf8lex_reader_next(&reader,  // self
+                              NULL);  // state
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             reader.head);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_reader(&state,  // self
+                                   &reader);  // reader
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_words = 0;
+  while (true)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED at word %d\n", num_words);  fflush(stdout);
+      return error;
+    }
+
+    unsigned char expected[32];
+    int expected_length_bytes = snprintf(expected,
+                                         32,
+                                         "w%d\xc3\xa9",
+                                         num_words);
+    unsigned char scratch[32];
+    unsigned char *bytes = NULL;
+    error = utf8lex_token_contiguous(&token,  // self
+                                     scratch,  // scratch
+                                     (size_t) 32,  // max_scratch_bytes
+                                     &bytes);  // bytes_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    if (token.length_bytes != (int64_t) expected_length_bytes
+        || memcmp(bytes,
+                  expected,
+                  (size_t) expected_length_bytes) != 0)
+    {
+      printf(" FAILED - word %d: %" PRId64 " bytes at %" PRId64 "\n",
+             num_words,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    num_words ++;
+  }
+
+  if (num_words != TEST_UTF8LEX_NUM_WORDS
+      || reader.num_in_chain > (uint32_t) TEST_UTF8LEX_NUM_BUFFERS)
+  {
+    printf(" FAILED - %d words\n", num_words);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d words OK\n", num_words);  fflush(stdout);
+
+  error = utf8lex_reader_clear(&reader);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(pipe_fds[0]);
+
+  if (is_gzip == true)
+  {
+    return UTF8LEX_OK;
+  }
+
+  // Reading ahead needs at least 2 buffers:
+  printf("  Making sure 1 buffer is rejected:");  fflush(stdout);
+  error = utf8lex_reader_init(&reader,  // self
+                              0,  // fd
+                              buffer_size,  // buffer_size
+                              (uint32_t) 1);  // num_buffers
+  if (error != UTF8LEX_ERROR_BAD_LENGTH)
+  {
+    printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+// Reads "w123\xc3\xa9 := " (w123é := ) repeatedly, lexed as a SEQUENCE
+// (the word and its space) and a literal (":="), which straddle
+// the read-ahead buffers.
+static utf8lex_error_t test_utf8lex_reader_match(
+        bool is_gzip
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  // WORD_SPACE = WORD SPACE
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_literal_definition_t assign_definition;
+  error = utf8lex_literal_definition_init(
+              &assign_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "ASSIGN",  // name
+              ":=");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_multi_definition_t word_space_definition;
+  error = utf8lex_multi_definition_init(
+              &word_space_definition,  // self
+              (utf8lex_definition_t *) &assign_definition,  // prev
+              "WORD_SPACE",  // name
+              NULL,  // parent
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t word_reference;
+  error = utf8lex_reference_init(&word_reference,  // self
+                                 NULL,  // prev
+                                 "WORD",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &word_space_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t space_reference;
+  error = utf8lex_reference_init(&space_reference,  // self
+                                 &word_reference,  // prev
+                                 "SPACE",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &word_space_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_multi_definition_resolve(
+              &word_space_definition,  // self
+              (utf8lex_definition_t *) &word_definition);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_space_rule;
+  error = utf8lex_rule_init(&word_space_rule,  // self
+                            NULL,  // prev
+                            "word_space",  // name
+                            (utf8lex_definition_t *)
+                            &word_space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t assign_rule;
+  error = utf8lex_rule_init(&assign_rule,  // self
+                            &word_space_rule,  // prev
+                            "assign",  // name
+                            (utf8lex_definition_t *)
+                            &assign_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &assign_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  static unsigned char matches[TEST_UTF8LEX_INPUT_MAX];
+  size_t matches_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_NUM_MATCHES; w ++)
+  {
+    matches_length_bytes += (size_t) snprintf(
+        &(matches[matches_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - matches_length_bytes,
+        "w%d\xc3\xa9 := ",
+        w);
+  }
+
+  // Leading spaces, so that the first buffer ends between ":" and "=":
+  size_t buffer_size = (size_t) sysconf(_SC_PAGESIZE);
+  size_t padding_bytes = (size_t) 0;
+  for (size_t b = (size_t) 0; b < (buffer_size - 1); b ++)
+  {
+    if (matches[b] == ':')
+    {
+      padding_bytes = (buffer_size - 1) - b;
+    }
+  }
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  memset(input, ' ', padding_bytes);
+  memcpy(&(input[padding_bytes]), matches, matches_length_bytes);
+  size_t input_length_bytes = padding_bytes + matches_length_bytes;
+
+  unsigned char *to_write = input;
+  size_t write_length_bytes = input_length_bytes;
+  static unsigned char compressed[TEST_UTF8LEX_INPUT_MAX];
+  if (is_gzip == true)
+  {
+    error = test_utf8lex_reader_compress(
+        input,  // input
+        input_length_bytes,  // input_length_bytes
+        compressed,  // compressed
+        (size_t) TEST_UTF8LEX_INPUT_MAX,  // max_compressed_bytes
+        &write_length_bytes);  // compressed_length_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    to_write = compressed;
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(pipe_fds[1], to_write, write_length_bytes)
+      != (ssize_t) write_length_bytes)
+  {
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+  close(pipe_fds[1]);
+
+  printf("  Lexing sequences and literals across %s buffers:",
+         (is_gzip == true) ? "gzip" : "uncompressed");  fflush(stdout);
+
+  utf8lex_reader_t reader;
+  if (is_gzip == true)
+  {
+    error = utf8lex_reader_init_gzip(&reader,  // self
+                                     pipe_fds[0],  // fd
+                                     buffer_size,  // buffer_size
+                                     (uint32_t) TEST_UTF8LEX_NUM_BUFFERS);
+  }
+  else
+  {
+    error = utf8lex_reader_init(&reader,  // self
+                                pipe_fds[0],  // fd
+                                buffer_size,  // buffer_size
+                                (uint32_t) TEST_UTF8LEX_NUM_BUFFERS);
+  }
+  if (error != UTF8LEX_OK) { close(pipe_fds[0]); return error; }
+
+  error = utf8lex_reader_next(&reader,  // self
+                              NULL);  // state
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             reader.head);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_reader(&state,  // self
+                                   &reader);  // reader
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_tokens = 0;
+  int num_straddling[2] = { 0, 0 };  // word_space, assign.
+  while (true)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_space_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED at token %d\n", num_tokens);  fflush(stdout);
+      return error;
+    }
+
+    int is_assign = num_tokens % 2;
+    unsigned char expected[32];
+    if (is_assign == 1)
+    {
+      strcpy(expected, ":=");
+    }
+    else
+    {
+      snprintf(expected, 32, "w%d\xc3\xa9 ", num_tokens / 2);
+    }
+    size_t expected_length_bytes = strlen(expected);
+    unsigned char scratch[32];
+    unsigned char *bytes = NULL;
+    error = utf8lex_token_contiguous(&token,  // self
+                                     scratch,  // scratch
+                                     (size_t) 32,  // max_scratch_bytes
+                                     &bytes);  // bytes_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    if (token.rule != ((is_assign == 1) ? &assign_rule : &word_space_rule)
+        || token.length_bytes != (int64_t) expected_length_bytes
+        || memcmp(bytes, expected, expected_length_bytes) != 0)
+    {
+      printf(" FAILED - token %d: %" PRId64 " bytes at %" PRId64 "\n",
+             num_tokens,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    if (bytes == scratch)
+    {
+      num_straddling[is_assign] ++;
+    }
+
+    num_tokens ++;
+  }
+
+  if (num_tokens != (2 * TEST_UTF8LEX_NUM_MATCHES)
+      || num_straddling[0] == 0
+      || num_straddling[1] == 0)
+  {
+    printf(" FAILED - %d tokens, %d + %d straddling\n",
+           num_tokens,
+           num_straddling[0],
+           num_straddling[1]);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d tokens (%d + %d straddling) OK\n",
+         num_tokens,
+         num_straddling[0],
+         num_straddling[1]);  fflush(stdout);
+
+  // Lexing at EOF stays at EOF:
+  utf8lex_token_t eof_token;
+  error = utf8lex_lex(&word_space_rule,  // first_rule
+                      &state,  // state
+                      &eof_token);  // token_pointer
+  if (error != UTF8LEX_EOF)
+  {
+    printf(" FAILED - error %d after EOF\n", (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_reader_clear(&reader);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(pipe_fds[0]);
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&assign_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_cat_definition_clear(
+              (utf8lex_definition_t *) &word_definition);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_reader...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_reader_pipe(false);
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_reader_pipe(true);
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_reader_match(false);  // is_gzip
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_reader_match(true);  // is_gzip
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_reader.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_reader: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
@@ -0,0 +1,291 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>  // For strlen(), strncmp()
+
+#include "utf8lex.h"
+
+
+// Too big for the stack:
+static utf8lex_program_t TEST_PROGRAM;
+
+
+// Lexes one document with the session, making sure every token
+// is a key=value pair with the expected key and value (captures),
+// starting over at byte 0 of the document, and then EOF.
+static utf8lex_error_t test_utf8lex_session_document(
+        utf8lex_session_t *session,
+        unsigned char *document,
+        unsigned char *expected[][2],  // { key, value }.
+        int num_expected
+        )
+{
+  printf("  Lexing \"%s\":", document);  fflush(stdout);
+  utf8lex_error_t error = utf8lex_session_reset(
+      session,  // self
+      document,  // bytes
+      strlen(document));  // length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  int64_t expected_start_byte = (int64_t) 0;
+  for (int t = 0; t <= num_expected; t ++)
+  {
+    utf8lex_token_t token;
+    error = utf8lex_session_lex(session,  // self
+                                &token);  // token_pointer
+    if (t == num_expected)
+    {
+      if (error != UTF8LEX_EOF)
+      {
+        printf(" FAILED - error %d instead of EOF\n",
+               (int) error);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+      return error;
+    }
+
+    unsigned char *key = expected[t][0];
+    unsigned char *value = expected[t][1];
+    size_t key_length_bytes = strlen(key);
+    size_t value_length_bytes = strlen(value);
+    unsigned char *bytes = token.str->bytes;
+    if (token.loc[UTF8LEX_UNIT_BYTE].start != expected_start_byte
+        || token.captures[0].length_bytes != (int64_t) key_length_bytes
+        || strncmp(&(bytes[token.captures[0].start_byte]),
+                   key,
+                   key_length_bytes) != 0
+        || token.captures[1].length_bytes != (int64_t) value_length_bytes
+        || strncmp(&(bytes[token.captures[1].start_byte]),
+                   value,
+                   value_length_bytes) != 0)
+    {
+      printf(" FAILED - token %d: %" PRId64 " bytes at %" PRId64 "\n",
+             t,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" %s=%s", key, value);  fflush(stdout);
+
+    // Skip the key=value and the separator after it:
+    expected_start_byte += token.length_bytes + (int64_t) 1;
+  }
+  printf(" EOF OK\n");  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes several documents, one after another, with one session
+// and one compiled program.
+static utf8lex_error_t test_utf8lex_session()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              NULL,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_regex_definition_t pair_definition;
+  error = utf8lex_regex_definition_init(
+              &pair_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "PAIR",  // name
+              "([a-z]+)=([0-9]+)");  // pattern
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_regex_definition_set_captures(&pair_definition,  // self
+                                                2);  // num_captures
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            NULL,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t pair_rule;
+  error = utf8lex_rule_init(&pair_rule,  // self
+                            &space_rule,  // prev
+                            "pair",  // name
+                            (utf8lex_definition_t *)
+                            &pair_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &space_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_session_t session;
+  error = utf8lex_session_init(&session,  // self
+                               &TEST_PROGRAM);  // program
+  if (error != UTF8LEX_OK) { return error; }
+  pcre2_match_data *match_data = session.state.match_data;
+
+  printf("  Lexing before reset:");  fflush(stdout);
+  utf8lex_token_t token;
+  error = utf8lex_session_lex(&session,  // self
+                              &token);  // token_pointer
+  if (error != UTF8LEX_EOF)
+  {
+    printf(" FAILED - error %d instead of EOF\n", (int) error);
+    fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" EOF OK\n");  fflush(stdout);
+
+  // Lines are indexed per document:
+  uint64_t line_starts[4];
+  utf8lex_line_index_t line_index;
+  error = utf8lex_line_index_init(&line_index,  // self
+                                  line_starts,  // line_starts
+                                  (uint32_t) 4);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_line_index(&(session.state),  // self
+                                       &line_index);  // line_index
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char *expected_1[][2] =
+    {
+      { "a", "1" },
+      { "bb", "22" }
+    };
+  error = test_utf8lex_session_document(
+              &session,  // session
+              "a=1 bb=22",  // document
+              expected_1,  // expected
+              (int) (sizeof(expected_1) / sizeof(expected_1[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char *expected_2[][2] =
+    {
+      { "ccc", "333" },
+      { "d", "4" }
+    };
+  error = test_utf8lex_session_document(
+              &session,  // session
+              "ccc=333\nd=4",  // document
+              expected_2,  // expected
+              (int) (sizeof(expected_2) / sizeof(expected_2[0])));
+  if (error != UTF8LEX_OK) { return error; }
+  if (line_index.num_lines != (uint32_t) 1
+      || line_starts[0] != (uint64_t) 8)
+  {
+    printf("  FAILED - %u lines indexed\n",
+           line_index.num_lines);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // Starts over even in the middle of a document:
+  error = utf8lex_session_reset(&session,  // self
+                                "e=5 f=6",  // bytes
+                                (size_t) 7);  // length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_session_lex(&session,  // self
+                              &token);  // token_pointer
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char *expected_3[][2] =
+    {
+      { "g", "7" }
+    };
+  error = test_utf8lex_session_document(
+              &session,  // session
+              "g=7",  // document
+              expected_3,  // expected
+              (int) (sizeof(expected_3) / sizeof(expected_3[0])));
+  if (error != UTF8LEX_OK) { return error; }
+
+  printf("  Reusing match data:");  fflush(stdout);
+  if (session.state.match_data != match_data
+      || line_index.num_lines != (uint32_t) 0)
+  {
+    printf(" FAILED - match data %p, %u lines indexed\n",
+           (void *) session.state.match_data,
+           line_index.num_lines);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_session_clear(&session);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_clear(&line_index);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&pair_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_session...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_session();
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_session.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_session: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
@@ -0,0 +1,811 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>  // For open()
+#include <stdlib.h>  // For mkstemp()
+#include <inttypes.h>  // For int64_t, uint64_t, PRId64.
+#include <string.h>  // For strcpy(), strlen(), memcmp()
+#include <unistd.h>  // For close(), pipe(), sysconf(), unlink(), write()
+
+#include "utf8lex.h"
+
+
+// Several times the ring's capacity, but small enough to fit
+// in the pipe, so the whole input can be written up front:
+#define TEST_UTF8LEX_NUM_WORDS 3000
+#define TEST_UTF8LEX_INPUT_MAX 32768
+
+
+// Lexes words through a one page ring, fed by a pipe.
+static utf8lex_error_t test_utf8lex_stream_pipe()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Words such as "w123\xc3\xa9" (w123é), separated by spaces:
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  size_t input_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_NUM_WORDS; w ++)
+  {
+    input_length_bytes += (size_t) snprintf(
+        &(input[input_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - input_length_bytes,
+        "w%d\xc3\xa9 ",
+        w);
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(pipe_fds[1], input, input_length_bytes)
+      != (ssize_t) input_length_bytes)
+  {
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+  close(pipe_fds[1]);
+
+  size_t capacity = (size_t) sysconf(_SC_PAGESIZE);
+  printf("  Streaming %d bytes through a %d byte ring:",
+         (int) input_length_bytes,
+         (int) capacity);  fflush(stdout);
+
+  utf8lex_stream_t stream;
+  error = utf8lex_stream_init(&stream,  // self
+                              pipe_fds[0],  // fd
+                              capacity);  // capacity
+  if (error != UTF8LEX_OK) { close(pipe_fds[0]); return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(stream.buffer));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Without the stream, the empty buffer just asks for MORE:
+  utf8lex_token_t token;
+  error = utf8lex_lex(&word_rule,  // first_rule
+                      &state,  // state
+                      &token);  // token_pointer
+  if (error != UTF8LEX_MORE)
+  {
+    printf(" FAILED - expected MORE before refills\n");  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  error = utf8lex_state_set_stream(&state,  // self
+                                   &stream);  // stream
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_words = 0;
+  int64_t expected_start = (int64_t) 0;
+  while (true)
+  {
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error == UTF8LEX_EOF)
+    {
+      break;
+    }
+    else if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED at word %d\n", num_words);  fflush(stdout);
+      return error;
+    }
+
+    unsigned char expected[32];
+    int expected_length_bytes = snprintf(expected,
+                                         32,
+                                         "w%d\xc3\xa9",
+                                         num_words);
+    if (token.length_bytes != (int64_t) expected_length_bytes
+        || token.loc[UTF8LEX_UNIT_BYTE].start != expected_start
+        || memcmp(&(token.str->bytes[token.start_byte]),
+                  expected,
+                  (size_t) expected_length_bytes) != 0)
+    {
+      printf(" FAILED - word %d: %" PRId64 " bytes at %" PRId64 "\n",
+             num_words,
+             token.length_bytes,
+             token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    num_words ++;
+    expected_start += (int64_t) expected_length_bytes + (int64_t) 1;
+  }
+
+  if (num_words != TEST_UTF8LEX_NUM_WORDS
+      || stream.read_bytes != (uint64_t) input_length_bytes
+      || stream.released_bytes <= (uint64_t) 0)
+  {
+    printf(" FAILED - %d words, %" PRIu64 " bytes read\n",
+           num_words,
+           stream.read_bytes);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d words, %" PRIu64 " bytes released OK\n",
+         num_words,
+         stream.released_bytes);  fflush(stdout);
+
+  error = utf8lex_stream_clear(&stream);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(pipe_fds[0]);
+
+  // The ring has to be a whole number of pages:
+  printf("  Making sure an odd capacity is rejected:");  fflush(stdout);
+  error = utf8lex_stream_init(&stream,  // self
+                              0,  // fd
+                              capacity + (size_t) 1);  // capacity
+  if (error != UTF8LEX_ERROR_BAD_LENGTH)
+  {
+    printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes words through a one page ring in batches, making sure
+// that refilling the ring (which moves its bytes) never corrupts
+// the tokens that were already lexed in the same batch.
+#define TEST_UTF8LEX_BATCH_WORDS 2000
+#define TEST_UTF8LEX_BATCH_MAX 64
+
+static utf8lex_program_t TEST_PROGRAM;
+
+static utf8lex_error_t test_utf8lex_stream_batch()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                  &word_rule);  // first_rule
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Words such as "w123", separated by spaces:
+  static unsigned char input[TEST_UTF8LEX_INPUT_MAX];
+  size_t input_length_bytes = (size_t) 0;
+  for (int w = 0; w < TEST_UTF8LEX_BATCH_WORDS; w ++)
+  {
+    input_length_bytes += (size_t) snprintf(
+        &(input[input_length_bytes]),
+        TEST_UTF8LEX_INPUT_MAX - input_length_bytes,
+        "w%d ",
+        w);
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  if (write(pipe_fds[1], input, input_length_bytes)
+      != (ssize_t) input_length_bytes)
+  {
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return UTF8LEX_ERROR_FILE_WRITE;
+  }
+  close(pipe_fds[1]);
+
+  size_t capacity = (size_t) sysconf(_SC_PAGESIZE);
+  printf("  Streaming %d bytes through a %d byte ring, in batches of %d:",
+         (int) input_length_bytes,
+         (int) capacity,
+         TEST_UTF8LEX_BATCH_MAX);  fflush(stdout);
+
+  utf8lex_stream_t stream;
+  error = utf8lex_stream_init(&stream,  // self
+                              pipe_fds[0],  // fd
+                              capacity);  // capacity
+  if (error != UTF8LEX_OK) { close(pipe_fds[0]); return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(stream.buffer));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_stream(&state,  // self
+                                   &stream);  // stream
+  if (error != UTF8LEX_OK) { return error; }
+
+  int num_words = 0;
+  int num_short_batches = 0;
+  utf8lex_token_t tokens[TEST_UTF8LEX_BATCH_MAX];
+  while (error == UTF8LEX_OK)
+  {
+    uint32_t num_tokens = (uint32_t) 0;
+    error = utf8lex_lex_batch(&TEST_PROGRAM,  // program
+                              &state,  // state
+                              tokens,  // tokens
+                              (uint32_t) TEST_UTF8LEX_BATCH_MAX,
+                              &num_tokens);  // num_tokens_pointer
+    if (error != UTF8LEX_OK
+        && error != UTF8LEX_EOF)
+    {
+      printf(" FAILED at word %d\n", num_words);  fflush(stdout);
+      return error;
+    }
+    else if (error == UTF8LEX_OK
+             && num_tokens < (uint32_t) TEST_UTF8LEX_BATCH_MAX)
+    {
+      // Stopped to refill the ring.
+      num_short_batches ++;
+    }
+
+    // Every token in the batch must still be good after the batch:
+    for (uint32_t t = (uint32_t) 0; t < num_tokens; t ++)
+    {
+      unsigned char expected[32];
+      int expected_length_bytes = snprintf(expected,
+                                           32,
+                                           "w%d",
+                                           num_words);
+      if (tokens[t].length_bytes != (int64_t) expected_length_bytes
+          || memcmp(&(tokens[t].str->bytes[tokens[t].start_byte]),
+                    expected,
+                    (size_t) expected_length_bytes) != 0)
+      {
+        printf(" FAILED - word %d: %" PRId64 " bytes '%.*s'\n",
+               num_words,
+               tokens[t].length_bytes,
+               (int) tokens[t].length_bytes,
+               &(tokens[t].str->bytes[tokens[t].start_byte]));
+          fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+
+      num_words ++;
+    }
+  }
+
+  if (num_words != TEST_UTF8LEX_BATCH_WORDS
+      || num_short_batches == 0
+      || stream.released_bytes <= (uint64_t) 0)
+  {
+    printf(" FAILED - %d words, %d refills\n",
+           num_words,
+           num_short_batches);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" %d words, %d refills OK\n",
+         num_words,
+         num_short_batches);  fflush(stdout);
+
+  error = utf8lex_stream_clear(&stream);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(pipe_fds[0]);
+  error = utf8lex_program_clear(&TEST_PROGRAM);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Lexes a token that runs off the end of a buffer, then appends
+// the rest of the token to the buffer (as a refill would), and makes
+// sure the definition carried on from where it stopped.
+static utf8lex_error_t test_utf8lex_stream_resume_one(
+        utf8lex_rule_t *rule,
+        unsigned char *first_bytes,
+        unsigned char *more_bytes,
+        uint32_t expected_step,
+        int64_t expected_count,
+        int64_t expected_resume_bytes,
+        unsigned char *expected_token
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  printf("  Resuming %s \"%s\" + \"%s\":",
+         rule->name,
+         first_bytes,
+         more_bytes);  fflush(stdout);
+
+  unsigned char bytes[64];
+  size_t length_bytes = strlen(first_bytes);
+  memcpy(bytes, first_bytes, length_bytes);
+  utf8lex_string_t str;
+  error = utf8lex_string_init(&str,  // self
+                              (size_t) 64,  // max_length_bytes
+                              length_bytes,  // length_bytes
+                              bytes);  // bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_buffer_t buffer;
+  error = utf8lex_buffer_init(&buffer,  // self
+                              NULL,  // prev
+                              &str,  // str
+                              false);  // is_eof
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &buffer);  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_token_t token;
+  error = utf8lex_lex(rule,  // first_rule
+                      &state,  // state
+                      &token);  // token_pointer
+  if (error != UTF8LEX_MORE
+      || state.resume.rule != rule
+      || state.resume.step != expected_step
+      || state.resume.count != expected_count
+      || state.resume.loc[UTF8LEX_UNIT_BYTE].length != expected_resume_bytes)
+  {
+    printf(" FAILED - error %d, saved step %u count %" PRId64
+           " bytes %" PRId64 "\n",
+           (int) error,
+           state.resume.step,
+           state.resume.count,
+           state.resume.loc[UTF8LEX_UNIT_BYTE].length);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+
+  // The refill:
+  memcpy(&(bytes[length_bytes]), more_bytes, strlen(more_bytes));
+  str.length_bytes += strlen(more_bytes);
+  buffer.is_eof = true;
+
+  error = utf8lex_lex(rule,  // first_rule
+                      &state,  // state
+                      &token);  // token_pointer
+  if (error != UTF8LEX_OK) { return error; }
+  size_t expected_length_bytes = strlen(expected_token);
+  if (token.length_bytes != (int64_t) expected_length_bytes
+      || token.loc[UTF8LEX_UNIT_CHAR].length != (int64_t) expected_length_bytes
+      || memcmp(&(token.str->bytes[token.start_byte]),
+                expected_token,
+                expected_length_bytes) != 0
+      || state.resume.rule != NULL)
+  {
+    printf(" FAILED - %" PRId64 " bytes, %" PRId64 " chars\n",
+           token.length_bytes,
+           token.loc[UTF8LEX_UNIT_CHAR].length);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+  printf(" \"%s\" OK\n", expected_token);  fflush(stdout);
+
+  return UTF8LEX_OK;
+}
+
+static utf8lex_error_t test_utf8lex_stream_resume()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t letters_definition;
+  error = utf8lex_cat_definition_init(
+              &letters_definition,  // self
+              NULL,  // prev
+              "LETTERS",  // name
+              UTF8LEX_GROUP_LETTER,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t digits_definition;
+  error = utf8lex_cat_definition_init(
+              &digits_definition,  // self
+              (utf8lex_definition_t *) &letters_definition,  // prev
+              "DIGITS",  // name
+              UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  // ID = LETTERS DIGITS
+  utf8lex_multi_definition_t id_definition;
+  error = utf8lex_multi_definition_init(
+              &id_definition,  // self
+              (utf8lex_definition_t *) &digits_definition,  // prev
+              "ID",  // name
+              NULL,  // parent
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t ref_letters;
+  error = utf8lex_reference_init(
+              &ref_letters,  // self
+              NULL,  // prev
+              "LETTERS",  // name
+              1,  // min
+              1,  // max
+              &id_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t ref_digits;
+  error = utf8lex_reference_init(
+              &ref_digits,  // self
+              &ref_letters,  // prev
+              "DIGITS",  // name
+              1,  // min
+              1,  // max
+              &id_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_multi_definition_resolve(
+              &id_definition,  // self
+              (utf8lex_definition_t *) &letters_definition);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t letters_rule;
+  error = utf8lex_rule_init(&letters_rule,  // self
+                            NULL,  // prev
+                            "letters",  // name
+                            (utf8lex_definition_t *)
+                            &letters_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t id_rule;
+  error = utf8lex_rule_init(&id_rule,  // self
+                            NULL,  // prev
+                            "id",  // name
+                            (utf8lex_definition_t *)
+                            &id_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  // CAT: carries on from "d" (the last grapheme in a buffer that
+  // is not at EOF might not be complete yet).
+  error = test_utf8lex_stream_resume_one(&letters_rule,  // rule
+                                         "abcd",  // first_bytes
+                                         "ef gh",  // more_bytes
+                                         (uint32_t) 0,  // expected_step
+                                         (int64_t) 3,  // expected_count
+                                         (int64_t) 3,  // expected_resume_bytes
+                                         "abcdef");  // expected_token
+  if (error != UTF8LEX_OK) { return error; }
+
+  // SEQUENCE: carries on from DIGITS, after "abc".
+  error = test_utf8lex_stream_resume_one(&id_rule,  // rule
+                                         "abc12",  // first_bytes
+                                         "34 x",  // more_bytes
+                                         (uint32_t) 1,  // expected_step
+                                         (int64_t) 0,  // expected_count
+                                         (int64_t) 3,  // expected_resume_bytes
+                                         "abc1234");  // expected_token
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+// Follows a file that is appended to while it is being lexed,
+// with a word cut off at the end of the file each time.
+static utf8lex_error_t test_utf8lex_stream_follow()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER | UTF8LEX_GROUP_NUM,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_skip(&space_rule,  // self
+                                true);  // is_skip
+  if (error != UTF8LEX_OK) { return error; }
+
+  unsigned char path[64];
+  strcpy(path, "/tmp/test_utf8lex_follow_XXXXXX");
+  int write_fd = mkstemp(path);
+  if (write_fd < 0)
+  {
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+  int read_fd = open(path, O_RDONLY);
+  if (read_fd < 0)
+  {
+    close(write_fd);
+    unlink(path);
+    return UTF8LEX_ERROR_FILE_OPEN;
+  }
+
+  utf8lex_stream_t stream;
+  error = utf8lex_stream_init(&stream,  // self
+                              read_fd,  // fd
+                              (size_t) sysconf(_SC_PAGESIZE));  // capacity
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_stream_follow(&stream,  // self
+                                path);  // path
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(stream.buffer));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_stream(&state,  // self
+                                   &stream);  // stream
+  if (error != UTF8LEX_OK) { return error; }
+
+  // Each append finishes off the word cut off by the one before.
+  // "epsilon" is not lexed until unfollowing, since until then
+  // more bytes could still change the grapheme at the end of the file:
+  unsigned char *appends[3] =
+    {
+      "alpha beta ga",
+      "mma delta ep",
+      "silon "
+    };
+  unsigned char *expected_words[5] =
+    {
+      "alpha", "beta", "gamma", "delta", "epsilon"
+    };
+  int expected_num_words[3] = { 2, 4, 4 };
+  int num_words = 0;
+  for (int a = 0; a < 3; a ++)
+  {
+    printf("  Appending \"%s\":", appends[a]);  fflush(stdout);
+    size_t append_length_bytes = strlen(appends[a]);
+    if (write(write_fd, appends[a], append_length_bytes)
+        != (ssize_t) append_length_bytes)
+    {
+      return UTF8LEX_ERROR_FILE_WRITE;
+    }
+    error = utf8lex_stream_wait(&stream,  // self
+                                1000);  // timeout_milliseconds
+    if (error != UTF8LEX_OK) { return error; }
+
+    while (true)
+    {
+      utf8lex_token_t token;
+      error = utf8lex_lex(&word_rule,  // first_rule
+                          &state,  // state
+                          &token);  // token_pointer
+      if (error == UTF8LEX_MORE)
+      {
+        // Caught up with the end of the file (so far).
+        break;
+      }
+      else if (error != UTF8LEX_OK)
+      {
+        printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+        return error;
+      }
+
+      size_t expected_length_bytes = strlen(expected_words[num_words]);
+      if (num_words >= expected_num_words[a]
+          || token.length_bytes != (int64_t) expected_length_bytes
+          || memcmp(&(token.str->bytes[token.start_byte]),
+                    expected_words[num_words],
+                    expected_length_bytes) != 0)
+      {
+        printf(" FAILED - word %d: %" PRId64 " bytes at %" PRId64 "\n",
+               num_words,
+               token.length_bytes,
+               token.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+      printf(" %s", expected_words[num_words]);  fflush(stdout);
+      num_words ++;
+    }
+
+    if (num_words != expected_num_words[a])
+    {
+      printf(" FAILED - %d words\n", num_words);  fflush(stdout);
+      return UTF8LEX_ERROR_STATE;
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  printf("  Unfollowing:");  fflush(stdout);
+  error = utf8lex_stream_unfollow(&stream);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_token_t last_token;
+  error = utf8lex_lex(&word_rule,  // first_rule
+                      &state,  // state
+                      &last_token);  // token_pointer
+  if (error != UTF8LEX_OK
+      || last_token.length_bytes != (int64_t) 7
+      || memcmp(&(last_token.str->bytes[last_token.start_byte]),
+                "epsilon",
+                (size_t) 7) != 0)
+  {
+    printf(" FAILED - error %d lexing the last word\n",
+           (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_TOKEN;
+  }
+  printf(" %s", expected_words[4]);  fflush(stdout);
+
+  utf8lex_token_t eof_token;
+  error = utf8lex_lex(&word_rule,  // first_rule
+                      &state,  // state
+                      &eof_token);  // token_pointer
+  if (error != UTF8LEX_EOF
+      || state.loc[UTF8LEX_UNIT_BYTE].start != (int64_t) 31)
+  {
+    printf(" FAILED - error %d at byte %" PRId64 "\n",
+           (int) error,
+           state.loc[UTF8LEX_UNIT_BYTE].start);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" EOF OK\n");  fflush(stdout);
+
+  error = utf8lex_stream_clear(&stream);  // self
+  if (error != UTF8LEX_OK) { return error; }
+  close(read_fd);
+  close(write_fd);
+  unlink(path);
+
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_stream...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_stream_pipe();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_stream_batch();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_stream_resume();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_stream_follow();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_stream.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_stream: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}
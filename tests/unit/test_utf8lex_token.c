@@ -0,0 +1,758 @@
+/*
+ * utf8lex
+ * Copyright © 2023-2025 Johann Tienhaara
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>  // For int64_t, uint32_t, PRId64.
+#include <stdbool.h>  // For bool, true, false.
+#include <string.h>  // For strlen()
+
+#include "utf8lex.h"
+
+
+#define TEST_UTF8LEX_NUM_BUFFERS 4
+
+// "world" straddles 3 buffers, and "\xc3\xa9t\xc3\xa9" (été) has
+// a 2 byte character split across 2 buffers.
+static unsigned char *TEST_CHUNKS[TEST_UTF8LEX_NUM_BUFFERS] =
+  {
+    "hello wo",
+    "r",
+    "ld \xc3",
+    "\xa9t\xc3\xa9 end"
+  };
+
+static unsigned char *TEST_EXPECTED_TOKENS[] =
+  {
+    "hello", " ", "world", " ", "\xc3\xa9t\xc3\xa9", " ", "end"
+  };
+static uint32_t TEST_EXPECTED_NUM_SLICES[] = { 1, 1, 3, 1, 2, 1, 1 };
+#define TEST_NUM_EXPECTED_TOKENS 7
+
+// Interned words and line separators that straddle buffers: "abc",
+// CR | LF and LINE SEPARATOR U+2028 (0xE2 0x80 | 0xA8).
+static unsigned char *TEST_LINES_CHUNKS[TEST_UTF8LEX_NUM_BUFFERS] =
+  {
+    "ab",
+    "c ab\r",
+    "\ncd\xe2\x80",
+    "\xa8" "abc \n"
+  };
+
+static unsigned char *TEST_LINES_EXPECTED_TOKENS[] =
+  {
+    "abc", " ", "ab", "\r\n", "cd", "\xe2\x80\xa8", "abc", " \n"
+  };
+static uint32_t TEST_LINES_EXPECTED_SYMBOLS[] =
+  {
+    0, UTF8LEX_SYMBOL_NONE, 1, UTF8LEX_SYMBOL_NONE,
+    2, UTF8LEX_SYMBOL_NONE, 0, UTF8LEX_SYMBOL_NONE
+  };
+#define TEST_LINES_NUM_EXPECTED_TOKENS 8
+
+// Literal and multi-definition matches that straddle buffers.
+static unsigned char *TEST_MATCH_CHUNKS[TEST_UTF8LEX_NUM_BUFFERS] =
+  {
+    "ab",
+    "c d =",
+    "== =",
+    "= y "
+  };
+
+static unsigned char *TEST_MATCH_EXPECTED_TOKENS[][2] =
+  {
+    { "word_space", "abc " },
+    { "word_space", "d " },
+    { "equals3", "===" },
+    { "space", " " },
+    { "operator", "==" },
+    { "space", " " },
+    { "word_space", "y " }
+  };
+#define TEST_MATCH_NUM_EXPECTED_TOKENS 7
+
+static utf8lex_program_t TEST_PROGRAM;
+
+
+// Lexes tokens from a chain of small buffers, and checks their views.
+static utf8lex_error_t test_utf8lex_token_view()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_BUFFERS];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_BUFFERS];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_BUFFERS; b ++)
+  {
+    size_t length_bytes = strlen(TEST_CHUNKS[b]);
+    error = utf8lex_string_init(&(strs[b]),  // self
+                                length_bytes,  // max_length_bytes
+                                length_bytes,  // length_bytes
+                                TEST_CHUNKS[b]);  // bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_buffer_init(&(buffers[b]),  // self
+                                (b == 0)
+                                ? NULL
+                                : &(buffers[b - 1]),  // prev
+                                &(strs[b]),  // str
+                                (b == (TEST_UTF8LEX_NUM_BUFFERS - 1)));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  for (int t = 0; t < TEST_NUM_EXPECTED_TOKENS; t ++)
+  {
+    unsigned char *expected = TEST_EXPECTED_TOKENS[t];
+    size_t expected_length_bytes = strlen(expected);
+    printf("  Token %d \"%s\":", t, expected);  fflush(stdout);
+
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    if (token.length_bytes != (int64_t) expected_length_bytes)
+    {
+      printf(" FAILED - %" PRId64 " bytes\n",
+             token.length_bytes);  fflush(stdout);
+      return UTF8LEX_ERROR_BAD_LENGTH;
+    }
+
+    // The view, one slice per buffer:
+    utf8lex_slice_t slices[TEST_UTF8LEX_NUM_BUFFERS];
+    uint32_t num_slices = (uint32_t) 0;
+    error = utf8lex_token_view(&token,  // self
+                               slices,  // slices
+                               (uint32_t) TEST_UTF8LEX_NUM_BUFFERS,
+                               &num_slices);  // num_slices_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    size_t offset = (size_t) 0;
+    for (uint32_t s = (uint32_t) 0; s < num_slices; s ++)
+    {
+      if ((offset + slices[s].length_bytes) > expected_length_bytes
+          || memcmp(slices[s].bytes,
+                    &(expected[offset]),
+                    slices[s].length_bytes) != 0)
+      {
+        printf(" FAILED - slice %u\n", s);  fflush(stdout);
+        return UTF8LEX_ERROR_TOKEN;
+      }
+      offset += slices[s].length_bytes;
+    }
+    if (num_slices != TEST_EXPECTED_NUM_SLICES[t]
+        || offset != expected_length_bytes)
+    {
+      printf(" FAILED - %u slices, %d bytes\n",
+             num_slices,
+             (int) offset);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" %u slices", num_slices);  fflush(stdout);
+
+    // Too few slices for the view:
+    if (num_slices > (uint32_t) 1)
+    {
+      uint32_t needed_slices = (uint32_t) 0;
+      error = utf8lex_token_view(&token,  // self
+                                 slices,  // slices
+                                 (uint32_t) 1,  // max_slices
+                                 &needed_slices);  // num_slices_pointer
+      if (error != UTF8LEX_MORE
+          || needed_slices != num_slices)
+      {
+        printf(" FAILED - 1 slice: error %d\n", (int) error);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+    }
+
+    // Contiguous bytes: only copied when the token straddles buffers.
+    unsigned char scratch[16];
+    unsigned char *bytes = NULL;
+    error = utf8lex_token_contiguous(&token,  // self
+                                     scratch,  // scratch
+                                     (size_t) 16,  // max_scratch_bytes
+                                     &bytes);  // bytes_pointer
+    if (error != UTF8LEX_OK) { return error; }
+    if (memcmp(bytes, expected, expected_length_bytes) != 0
+        || (num_slices == (uint32_t) 1 && bytes == scratch)
+        || (num_slices > (uint32_t) 1 && bytes != scratch))
+    {
+      printf(" FAILED - contiguous bytes\n");  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    unsigned char copy[16];
+    error = utf8lex_token_copy_string(&token,  // self
+                                      copy,  // str
+                                      (size_t) 16);  // max_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    if (strcmp(copy, expected) != 0)
+    {
+      printf(" FAILED - copied \"%s\"\n", copy);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  printf("  EOF:");  fflush(stdout);
+  utf8lex_token_t eof_token;
+  error = utf8lex_lex(&word_rule,  // first_rule
+                      &state,  // state
+                      &eof_token);  // token_pointer
+  if (error != UTF8LEX_EOF)
+  {
+    printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int b = TEST_UTF8LEX_NUM_BUFFERS - 1; b >= 0; b --)
+  {
+    error = utf8lex_buffer_clear(&(buffers[b]));
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_string_clear(&(strs[b]));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+// Lexes interned tokens and line separators that straddle buffers,
+// with a line index.
+static utf8lex_error_t test_utf8lex_token_intern_lines()
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t word_rule;
+  error = utf8lex_rule_init(&word_rule,  // self
+                            NULL,  // prev
+                            "word",  // name
+                            (utf8lex_definition_t *)
+                            &word_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_set_interned(&word_rule,  // self
+                                    true);  // is_interned
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &word_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_BUFFERS];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_BUFFERS];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_BUFFERS; b ++)
+  {
+    size_t length_bytes = strlen(TEST_LINES_CHUNKS[b]);
+    error = utf8lex_string_init(&(strs[b]),  // self
+                                length_bytes,  // max_length_bytes
+                                length_bytes,  // length_bytes
+                                TEST_LINES_CHUNKS[b]);  // bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_buffer_init(&(buffers[b]),  // self
+                                (b == 0)
+                                ? NULL
+                                : &(buffers[b - 1]),  // prev
+                                &(strs[b]),  // str
+                                (b == (TEST_UTF8LEX_NUM_BUFFERS - 1)));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  uint32_t slots[8];
+  utf8lex_symbol_t symbols[4];
+  unsigned char arena[16];
+  utf8lex_intern_table_t intern_table;
+  error = utf8lex_intern_table_init(&intern_table,  // self
+                                    slots,  // slots
+                                    (uint32_t) 8,  // num_slots
+                                    symbols,  // symbols
+                                    (uint32_t) 4,  // max_symbols
+                                    arena,  // arena
+                                    (uint64_t) 16);  // max_arena_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  uint64_t line_starts[8];
+  utf8lex_line_index_t line_index;
+  error = utf8lex_line_index_init(&line_index,  // self
+                                  line_starts,  // line_starts
+                                  (uint32_t) 8);  // max_lines
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_intern_table(&state,  // self
+                                         &intern_table);  // intern_table
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_state_set_line_index(&state,  // self
+                                       &line_index);  // line_index
+  if (error != UTF8LEX_OK) { return error; }
+
+  for (int t = 0; t < TEST_LINES_NUM_EXPECTED_TOKENS; t ++)
+  {
+    printf("  Interned / line token %d:", t);  fflush(stdout);
+    utf8lex_token_t token;
+    error = utf8lex_lex(&word_rule,  // first_rule
+                        &state,  // state
+                        &token);  // token_pointer
+    if (error != UTF8LEX_OK) { return error; }
+
+    unsigned char copy[16];
+    error = utf8lex_token_copy_string(&token,  // self
+                                      copy,  // str
+                                      (size_t) 16);  // max_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    if (strcmp(copy, TEST_LINES_EXPECTED_TOKENS[t]) != 0
+        || token.symbol_id != TEST_LINES_EXPECTED_SYMBOLS[t])
+    {
+      printf(" FAILED - %" PRId64 " bytes, symbol %u\n",
+             token.length_bytes,
+             token.symbol_id);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" symbol %d OK\n", (int) token.symbol_id);  fflush(stdout);
+  }
+
+  // Interned once each, straddling or not:
+  printf("  Symbols and line starts:");  fflush(stdout);
+  if (intern_table.num_symbols != (uint32_t) 3
+      || intern_table.arena_bytes != (uint64_t) 7
+      || memcmp(arena, "abcabcd", (size_t) 7) != 0)
+  {
+    printf(" FAILED - %u symbols, %d arena bytes\n",
+           intern_table.num_symbols,
+           (int) intern_table.arena_bytes);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  // One line start after CR LF, one after U+2028, one after LF:
+  if (line_index.num_lines != (uint32_t) 3
+      || line_starts[0] != (uint64_t) 8
+      || line_starts[1] != (uint64_t) 13
+      || line_starts[2] != (uint64_t) 18)
+  {
+    printf(" FAILED - %u lines\n",
+           line_index.num_lines);  fflush(stdout);
+    return UTF8LEX_ERROR_STATE;
+  }
+  printf(" OK\n");  fflush(stdout);
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_line_index_clear(&line_index);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_intern_table_clear(&intern_table);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int b = TEST_UTF8LEX_NUM_BUFFERS - 1; b >= 0; b --)
+  {
+    error = utf8lex_buffer_clear(&(buffers[b]));
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_string_clear(&(strs[b]));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_rule);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+// Lexes literals, SEQUENCEs and longest ORs that straddle buffers,
+// with the rules' own lexers or with a compiled program.
+static utf8lex_error_t test_utf8lex_token_match(
+        bool is_compiled
+        )
+{
+  utf8lex_error_t error = UTF8LEX_OK;
+
+  // WORD_SPACE = WORD SPACE
+  // OPERATOR = EQUALS || EQUALS3
+  utf8lex_cat_definition_t word_definition;
+  error = utf8lex_cat_definition_init(
+              &word_definition,  // self
+              NULL,  // prev
+              "WORD",  // name
+              UTF8LEX_GROUP_LETTER,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_cat_definition_t space_definition;
+  error = utf8lex_cat_definition_init(
+              &space_definition,  // self
+              (utf8lex_definition_t *) &word_definition,  // prev
+              "SPACE",  // name
+              UTF8LEX_GROUP_WHITESPACE,  // cat
+              1,  // min
+              -1);  // max
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_literal_definition_t equals_definition;
+  error = utf8lex_literal_definition_init(
+              &equals_definition,  // self
+              (utf8lex_definition_t *) &space_definition,  // prev
+              "EQUALS",  // name
+              "==");  // str
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_literal_definition_t equals3_definition;
+  error = utf8lex_literal_definition_init(
+              &equals3_definition,  // self
+              (utf8lex_definition_t *) &equals_definition,  // prev
+              "EQUALS3",  // name
+              "===");  // str
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_multi_definition_t word_space_definition;
+  error = utf8lex_multi_definition_init(
+              &word_space_definition,  // self
+              (utf8lex_definition_t *) &equals3_definition,  // prev
+              "WORD_SPACE",  // name
+              NULL,  // parent
+              UTF8LEX_MULTI_TYPE_SEQUENCE,  // multi_type
+              false);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t word_reference;
+  error = utf8lex_reference_init(&word_reference,  // self
+                                 NULL,  // prev
+                                 "WORD",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &word_space_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t space_reference;
+  error = utf8lex_reference_init(&space_reference,  // self
+                                 &word_reference,  // prev
+                                 "SPACE",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &word_space_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_multi_definition_resolve(
+              &word_space_definition,  // self
+              (utf8lex_definition_t *) &word_definition);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_multi_definition_t operator_definition;
+  error = utf8lex_multi_definition_init(
+              &operator_definition,  // self
+              (utf8lex_definition_t *) &word_space_definition,  // prev
+              "OPERATOR",  // name
+              NULL,  // parent
+              UTF8LEX_MULTI_TYPE_OR,  // multi_type
+              true);  // is_longest
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t equals_reference;
+  error = utf8lex_reference_init(&equals_reference,  // self
+                                 NULL,  // prev
+                                 "EQUALS",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &operator_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_reference_t equals3_reference;
+  error = utf8lex_reference_init(&equals3_reference,  // self
+                                 &equals_reference,  // prev
+                                 "EQUALS3",  // name
+                                 1,  // min
+                                 1,  // max
+                                 &operator_definition);  // parent
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_multi_definition_resolve(
+              &operator_definition,  // self
+              (utf8lex_definition_t *) &word_definition);  // db
+  if (error != UTF8LEX_OK) { return error; }
+
+  utf8lex_rule_t equals3_rule;
+  error = utf8lex_rule_init(&equals3_rule,  // self
+                            NULL,  // prev
+                            "equals3",  // name
+                            (utf8lex_definition_t *)
+                            &equals3_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t word_space_rule;
+  error = utf8lex_rule_init(&word_space_rule,  // self
+                            &equals3_rule,  // prev
+                            "word_space",  // name
+                            (utf8lex_definition_t *)
+                            &word_space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t operator_rule;
+  error = utf8lex_rule_init(&operator_rule,  // self
+                            &word_space_rule,  // prev
+                            "operator",  // name
+                            (utf8lex_definition_t *)
+                            &operator_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+  utf8lex_rule_t space_rule;
+  error = utf8lex_rule_init(&space_rule,  // self
+                            &operator_rule,  // prev
+                            "space",  // name
+                            (utf8lex_definition_t *)
+                            &space_definition,  // definition
+                            "",  // code
+                            (size_t) 0);  // code_length_bytes
+  if (error != UTF8LEX_OK) { return error; }
+
+  if (is_compiled == true)
+  {
+    error = utf8lex_program_compile(&TEST_PROGRAM,  // self
+                                    &equals3_rule);  // first_rule
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  utf8lex_string_t strs[TEST_UTF8LEX_NUM_BUFFERS];
+  utf8lex_buffer_t buffers[TEST_UTF8LEX_NUM_BUFFERS];
+  for (int b = 0; b < TEST_UTF8LEX_NUM_BUFFERS; b ++)
+  {
+    size_t length_bytes = strlen(TEST_MATCH_CHUNKS[b]);
+    error = utf8lex_string_init(&(strs[b]),  // self
+                                length_bytes,  // max_length_bytes
+                                length_bytes,  // length_bytes
+                                TEST_MATCH_CHUNKS[b]);  // bytes
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_buffer_init(&(buffers[b]),  // self
+                                (b == 0)
+                                ? NULL
+                                : &(buffers[b - 1]),  // prev
+                                &(strs[b]),  // str
+                                (b == (TEST_UTF8LEX_NUM_BUFFERS - 1)));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  utf8lex_state_t state;
+  error = utf8lex_state_init(&state,  // self
+                             &(buffers[0]));  // buffer
+  if (error != UTF8LEX_OK) { return error; }
+
+  for (int t = 0; t <= TEST_MATCH_NUM_EXPECTED_TOKENS; t ++)
+  {
+    utf8lex_token_t token;
+    if (is_compiled == true)
+    {
+      error = utf8lex_program_lex(&TEST_PROGRAM,  // program
+                                  &state,  // state
+                                  &token);  // token_pointer
+    }
+    else
+    {
+      error = utf8lex_lex(&equals3_rule,  // first_rule
+                          &state,  // state
+                          &token);  // token_pointer
+    }
+
+    if (t == TEST_MATCH_NUM_EXPECTED_TOKENS)
+    {
+      printf("  %s EOF:",
+             (is_compiled == true) ? "Compiled" : "Rules");  fflush(stdout);
+      if (error != UTF8LEX_EOF)
+      {
+        printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+        return UTF8LEX_ERROR_STATE;
+      }
+      printf(" OK\n");  fflush(stdout);
+      break;
+    }
+
+    unsigned char *expected_rule = TEST_MATCH_EXPECTED_TOKENS[t][0];
+    unsigned char *expected = TEST_MATCH_EXPECTED_TOKENS[t][1];
+    printf("  %s token %d %s \"%s\":",
+           (is_compiled == true) ? "Compiled" : "Rules",
+           t,
+           expected_rule,
+           expected);  fflush(stdout);
+    if (error != UTF8LEX_OK)
+    {
+      printf(" FAILED - error %d\n", (int) error);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    unsigned char copy[16];
+    error = utf8lex_token_copy_string(&token,  // self
+                                      copy,  // str
+                                      (size_t) 16);  // max_bytes
+    if (error != UTF8LEX_OK) { return error; }
+    if (strcmp(token.rule->name, expected_rule) != 0
+        || strcmp(copy, expected) != 0)
+    {
+      printf(" FAILED - %s \"%s\"\n",
+             token.rule->name,
+             copy);  fflush(stdout);
+      return UTF8LEX_ERROR_TOKEN;
+    }
+    printf(" OK\n");  fflush(stdout);
+  }
+
+  error = utf8lex_state_clear(&state);
+  if (error != UTF8LEX_OK) { return error; }
+  for (int b = TEST_UTF8LEX_NUM_BUFFERS - 1; b >= 0; b --)
+  {
+    error = utf8lex_buffer_clear(&(buffers[b]));
+    if (error != UTF8LEX_OK) { return error; }
+    error = utf8lex_string_clear(&(strs[b]));
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  if (is_compiled == true)
+  {
+    error = utf8lex_program_clear(&TEST_PROGRAM);
+    if (error != UTF8LEX_OK) { return error; }
+  }
+
+  // Clearing the rules also clears their definitions.
+  error = utf8lex_rule_clear(&space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&operator_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&word_space_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_rule_clear(&equals3_rule);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_literal_definition_clear(
+              (utf8lex_definition_t *) &equals_definition);
+  if (error != UTF8LEX_OK) { return error; }
+  error = utf8lex_cat_definition_clear(
+              (utf8lex_definition_t *) &word_definition);
+  if (error != UTF8LEX_OK) { return error; }
+
+  return UTF8LEX_OK;
+}
+
+
+int main(
+        int argc,
+        char *argv[]
+        )
+{
+  printf("Testing utf8lex_token...\n");  fflush(stdout);
+  utf8lex_error_t error = test_utf8lex_token_view();
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_token_intern_lines();
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_token_match(false);  // is_compiled
+  }
+  if (error == UTF8LEX_OK)
+  {
+    error = test_utf8lex_token_match(true);  // is_compiled
+  }
+  if (error == UTF8LEX_OK)
+  {
+    printf("SUCCESS testing utf8lex_token.\n");  fflush(stdout);
+  }
+  else
+  {
+    char error_bytes[256];
+    utf8lex_string_t error_string;
+    utf8lex_string_init(&error_string,
+                        256,  // max_length_bytes
+                        0,  // length_bytes
+                        &error_bytes[0]);
+    utf8lex_error_string(&error_string,
+                         error);
+    fprintf(stderr, "FAILED testing utf8lex_token: error %d %s\n",
+            error,
+            error_string.bytes);
+      fflush(stderr);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  return (int) error;
+}